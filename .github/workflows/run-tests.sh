@@ -4,6 +4,9 @@ set -ex
 set -o pipefail
 
 ninja -C ./build test
+if [[ "$TYPE" != valgrind ]]; then
+        meson test -C ./build --benchmark --verbose
+fi
 
 dfuzzer=("dfuzzer")
 if [[ "$TYPE" == valgrind ]]; then
@@ -29,11 +32,40 @@ set +e
 # https://github.com/dbus-fuzzer/dfuzzer/issues/45
 "${dfuzzer[@]}" -v -n org.freedesktop.dfuzzerServer
 [[ $? == 2 ]] || exit 1
+# The same with the scheduler, which should find the failures as well
+"${dfuzzer[@]}" --budget=5000 -v -n org.freedesktop.dfuzzerServer
+[[ $? == 2 ]] || exit 1
+# The same in batch mode, where unknown names are only reported
+log_out="$(mktemp)"
+printf '# comment\norg.freedesktop.dfuzzerServer\n\norg.freedesktop.dfuzzerNonexistent\n' >targets.txt
+"${dfuzzer[@]}" --targets=targets.txt -j 2 --parallel-targets=2 -v &>"$log_out"
+[[ $? == 2 ]] || exit 1
+grep -F "org.freedesktop.dfuzzerServer (system bus): FAILURES" "$log_out" || exit 1
+grep -F "org.freedesktop.dfuzzerNonexistent: NOT FOUND" "$log_out" || exit 1
+rm -f "$log_out" targets.txt
+# The harness runs the server on a private bus, where the spare instance
+# should take over after the first crash
+log_out="$(mktemp)"
+"${dfuzzer[@]}" --harness="dfuzzer-test-server --session" -v -n org.freedesktop.dfuzzerServer &>"$log_out"
+[[ $? == 2 ]] || exit 1
+grep -E "\[HARNESS: [0-9]+ instance\(s\) started, [1-9][0-9]* crash\(es\) taken over" "$log_out" || exit 1
+rm -f "$log_out"
+# The final metrics should account all calls
+metrics="$(mktemp)"
+"${dfuzzer[@]}" --stats-interval=1 --metrics="$metrics" -v -n org.freedesktop.dfuzzerServer
+[[ $? == 2 ]] || exit 1
+grep -E "^dfuzzer_calls_total [1-9][0-9]*$" "$metrics" || exit 1
+grep -E "^dfuzzer_exceptions_total\{name=\"[^\"]+\"\} [1-9][0-9]*$" "$metrics" || exit 1
+tail -n 1 "$metrics" | grep -Fx "# EOF" || exit 1
+rm -f "$metrics"
 set -e
 
 # Make sure we can process complex signatures without issues
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_2
+# ...and mutations of them
+"${dfuzzer[@]}" --mutate -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
+"${dfuzzer[@]}" --mutate -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_2
 
 # Crash on a specific string
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy
@@ -46,6 +78,35 @@ you guessed it - also a string
 no way this is a string as well
 EOF
 "${dfuzzer[@]}" -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+# Pipelined calls should attribute the crash to the right input
+log_out="$(mktemp)"
+"${dfuzzer[@]}" --seed=1234 --inflight=8 -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy &>"$log_out" && false
+grep -F "Leeroy Jenkins" "$log_out"
+# The reproducer should include the seed
+grep -F -- "--seed=1234" "$log_out"
+rm -f "$log_out"
+# Replay the logged inputs and find the one which kills the service
+mkdir dfuzzer-replay-logs
+"${dfuzzer[@]}" -L dfuzzer-replay-logs --log-format=binary -f inputs.txt -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_crash_on_leeroy && false
+log_out="$(mktemp)"
+"${dfuzzer[@]}" --replay=dfuzzer-replay-logs/org.freedesktop.dfuzzerServer --bisect -v -n org.freedesktop.dfuzzerServer &>"$log_out" && false
+grep -F "shortest prefix" "$log_out"
+grep -F "Leeroy Jenkins" "$log_out"
+# Bisecting restarts the service, which should be reported
+grep -F "WAITED FOR THE TESTED PROCESS" "$log_out"
+rm -rf "$log_out" dfuzzer-replay-logs
+"${dfuzzer[@]}" --inflight=8 -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
+"${dfuzzer[@]}" --generator=wire -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
+# Large messages which still fit under the limit of the broker
+"${dfuzzer[@]}" --message-size=1048576 -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
+"${dfuzzer[@]}" --message-size=1048576 --generator=wire -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
+# Inputs generated ahead on other threads are the same as the ones generated inline
+"${dfuzzer[@]}" --generator-threads=4 --inflight=8 --message-size=1048576 -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
+"${dfuzzer[@]}" -L dfuzzer-producer-logs --seed=1234 -x 64 -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
+mv dfuzzer-producer-logs/org.freedesktop.dfuzzerServer dfuzzer-producer-inline.log
+"${dfuzzer[@]}" -L dfuzzer-producer-logs --seed=1234 -x 64 --generator-threads=3 -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_complex_sig_1
+cmp dfuzzer-producer-inline.log dfuzzer-producer-logs/org.freedesktop.dfuzzerServer
+rm -rf dfuzzer-producer-inline.log dfuzzer-producer-logs
 rm -f inputs.txt
 
 # Test if we respect the org.freedesktop.DBus.Method.NoReply annotation
@@ -56,22 +117,63 @@ rm -f inputs.txt
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -p crash_on_write && false
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -p read_only
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -p write_only
+# Reading all properties at once should hit crash_on_read, pipelined writes
+# should hit crash_on_write
+log_out="$(mktemp)"
+"${dfuzzer[@]}" --inflight=8 -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface --skip-methods &>"$log_out" && false
+grep -E "FAIL.* \[P\] GetAll" "$log_out"
+grep -E "FAIL.* \[P\] crash_on_write" "$log_out"
+rm -f "$log_out"
 
 sudo systemctl stop dfuzzer-test-server
 
 # dfuzzer should return 0 by default when services it tests time out
 # https://github.com/dbus-fuzzer/dfuzzer/pull/57#issuecomment-1112191073
 "${dfuzzer[@]}" -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hang
+# Stress mode: concurrent clients with match rule churn, and the point the
+# hanging method starts timing out at
+log_out="$(mktemp)"
+"${dfuzzer[@]}" --stress=4 --stress-rate=200 --stress-duration=2 --stress-churn -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hello &>"$log_out"
+grep -E "\[STRESS: [1-9][0-9]* call\(s\)" "$log_out"
+grep -E "[1-9][0-9]* match rule\(s\) churned" "$log_out"
+"${dfuzzer[@]}" --stress=2 --stress-duration=2 --call-timeout=100 -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hang &>"$log_out"
+grep -F "[STRESS: timeouts started in step" "$log_out"
+rm -f "$log_out"
+"${dfuzzer[@]}" --stress=4 -v -n org.freedesktop.dfuzzerServer && false
+"${dfuzzer[@]}" --stress-churn -v -n org.freedesktop.dfuzzerServer && false
 
 sudo systemctl stop dfuzzer-test-server
 
+# Latency regressions should be reported as warnings (Valgrind makes the
+# baseline too noisy for this)
+if [[ "$TYPE" != valgrind ]]; then
+        set +e
+        log_out="$(mktemp)"
+        "${dfuzzer[@]}" -I 256 -s -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_slow_down &>"$log_out"
+        [[ $? == 3 ]] || exit 1
+        set -e
+        grep -F "latency regression" "$log_out"
+        grep -F "[LATENCY: 256 calls" "$log_out"
+        rm -f "$log_out"
+        sudo systemctl stop dfuzzer-test-server
+fi
+
 "${dfuzzer[@]}" -e true -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hello
 
 set +e
 "${dfuzzer[@]}" -e false -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hello
 [[ $? == 2 ]] || exit 1
+# A check failing no matter what can't be bisected
+log_out="$(mktemp)"
+"${dfuzzer[@]}" -e false --command-interval=end -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hello 2>&1 | tee "$log_out"
+[[ ${PIPESTATUS[0]} == 2 ]] || exit 1
+grep -F "kept failing when it was bisected" "$log_out" || exit 1
+rm -f "$log_out"
 set -e
 
+"${dfuzzer[@]}" -e 'while read -r object interface method iteration; do echo 0; done' --command-coprocess --command-interval=16 \
+                -v -n org.freedesktop.dfuzzerServer -o /org/freedesktop/dfuzzerObject -i org.freedesktop.dfuzzerInterface -t df_hello
+
 sudo systemctl stop dfuzzer-test-server
 
 # Make sure we can still test services, which cannot be auto-activated
@@ -156,6 +258,33 @@ for opt in "-y" "--min-iterations" "-x" "--max-iterations" "-I" "--iterations";
         "${dfuzzer[@]}" -v -n org.freedesktop.systemd1 "$opt" 10a && false
         "${dfuzzer[@]}" -v -n org.freedesktop.systemd1 "$opt" 10.1 && false
 done
+# Seed must be a valid guint64
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --seed=-1 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --seed=18446744073709551616 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --seed=abc && false
+# Number of jobs must be in range [1, 256]
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --jobs=0 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --jobs=257 && false
+# Number of calls in flight must be in range [1, 1024]
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --inflight=0 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --inflight=1025 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --inflight=a && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --generator= && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --generator=gvariant && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --message-size=4095 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --generator-threads=65 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --message-size=134217729 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --coverage= && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --coverage=/dfuzzer-this-should-not-exist && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --coverage-plateau=0 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --budget=0 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --discovery-inflight=0 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --call-timeout=0 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --discovery-inflight=1025 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --bisect && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --replay=/dfuzzer-this-should-not-exist && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --time-budget=0 && false
+"${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --budget=100 --jobs=2 && false
 # min-iterations <= max-iterations
 "${dfuzzer[@]}" -v -n org.freedesktop.systemd1 --max-iterations=1 --min-iterations=2 && false
 
@@ -175,9 +304,30 @@ fi
 "${dfuzzer[@]}" -v -n org.freedesktop.systemd1 "${bus_object[@]}"
 # Test as root (long options + duplicate options)
 sudo "${dfuzzer[@]}" --verbose --bus this.should.be.ignored --bus org.freedesktop.systemd1 "${bus_object[@]}"
+# Test parallel workers (with a sequential discovery)
+"${dfuzzer[@]}" -j 4 --discovery-inflight=1 -v -n org.freedesktop.systemd1 "${bus_object[@]}"
+sudo "${dfuzzer[@]}" --jobs=4 -v -n org.freedesktop.systemd1 "${bus_object[@]}"
 # Test logdir
 mkdir dfuzzer-logs
 "${dfuzzer[@]}" --log-dir dfuzzer-logs -v -n org.freedesktop.systemd1 -o /org/freedesktop/systemd1 -i org.freedesktop.systemd1.Manager
+# The binary log should decode to the same records as the text one
+mkdir dfuzzer-logs-binary
+"${dfuzzer[@]}" --log-dir dfuzzer-logs-binary --log-format=binary --seed=1234 -v -n org.freedesktop.systemd1 -o /org/freedesktop/systemd1 -i org.freedesktop.DBus.Peer
+"${dfuzzer[@]}" --decode-log=dfuzzer-logs-binary/org.freedesktop.systemd1 | grep -F "org.freedesktop.DBus.Peer;/org/freedesktop/systemd1;Ping;();();Success"
+"${dfuzzer[@]}" --decode-log=dfuzzer-logs/org.freedesktop.systemd1 && false
+"${dfuzzer[@]}" --log-format=csv -v -n org.freedesktop.systemd1 && false
+# The second run should reuse the cached introspection data
+"${dfuzzer[@]}" --log-dir dfuzzer-logs --introspection-cache -v -n org.freedesktop.systemd1 -o /org/freedesktop/systemd1 -i org.freedesktop.DBus.Peer
+test -s dfuzzer-logs/org.freedesktop.systemd1.system.introspection
+"${dfuzzer[@]}" --log-dir dfuzzer-logs --introspection-cache -v -n org.freedesktop.systemd1 -o /org/freedesktop/systemd1 -i org.freedesktop.DBus.Peer |& grep "Loaded introspection data of 1 object(s)"
+"${dfuzzer[@]}" --introspection-cache -v -n org.freedesktop.systemd1 && false
+# A resumed run should skip everything the first one finished
+mkdir dfuzzer-logs-resume
+"${dfuzzer[@]}" --log-dir dfuzzer-logs-resume --seed=1234 -v -n org.freedesktop.systemd1 -o /org/freedesktop/systemd1 -i org.freedesktop.DBus.Peer
+test -s dfuzzer-logs-resume/org.freedesktop.systemd1.journal
+"${dfuzzer[@]}" --log-dir dfuzzer-logs-resume --resume -v -n org.freedesktop.systemd1 -o /org/freedesktop/systemd1 -i org.freedesktop.DBus.Peer |& grep "org.freedesktop.DBus.Peer - tested in a previous run"
+"${dfuzzer[@]}" --log-dir dfuzzer-logs-resume --resume --seed=5678 -v -n org.freedesktop.systemd1 && false
+"${dfuzzer[@]}" --resume -v -n org.freedesktop.systemd1 && false
 # Test a non-existent bus
 sudo "${dfuzzer[@]}" --log-dir "" --bus this.should.not.exist && false
 # Test object & interface options
@@ -0,0 +1,114 @@
+/** @file arena.c */
+#include <gio/gio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "log.h"
+
+struct df_arena_chunk {
+        df_arena_chunk_t *next;
+        gsize size;
+        gsize used;
+        /* Keep the data 8-aligned */
+        guint64 data[];
+};
+
+static df_arena_chunk_t *df_arena_chunk_new(gsize size)
+{
+        df_arena_chunk_t *chunk;
+
+        chunk = malloc(sizeof(*chunk) + size);
+        if (!chunk)
+                return NULL;
+
+        chunk->next = NULL;
+        chunk->size = size;
+        chunk->used = 0;
+
+        return chunk;
+}
+
+static void df_arena_free_chunks(df_arena_chunk_t *chunk)
+{
+        while (chunk) {
+                df_arena_chunk_t *next = chunk->next;
+
+                free(chunk);
+                chunk = next;
+        }
+}
+
+df_arena_t *df_arena_new(void)
+{
+        df_arena_t *arena;
+
+        arena = calloc(1, sizeof(*arena));
+        if (!arena)
+                return NULL;
+
+        arena->chunks = df_arena_chunk_new(DF_ARENA_CHUNK_SIZE);
+        if (!arena->chunks) {
+                free(arena);
+                return NULL;
+        }
+
+        return arena;
+}
+
+void df_arena_free(df_arena_t *arena)
+{
+        if (!arena)
+                return;
+
+        df_arena_free_chunks(arena->chunks);
+        free(arena);
+}
+
+void *df_arena_alloc(df_arena_t *arena, gsize size)
+{
+        df_arena_chunk_t *chunk;
+        void *p;
+
+        g_assert(arena);
+
+        /* Round the size up to keep all allocations 8-aligned */
+        size = (size + 7) & ~(gsize) 7;
+
+        chunk = arena->chunks;
+        if (!chunk || chunk->size - chunk->used < size) {
+                chunk = df_arena_chunk_new(MAX(size, DF_ARENA_CHUNK_SIZE));
+                if (!chunk) {
+                        df_fail("Could not allocate memory for an arena chunk\n");
+                        return NULL;
+                }
+
+                chunk->next = arena->chunks;
+                arena->chunks = chunk;
+        }
+
+        p = (guint8 *) chunk->data + chunk->used;
+        chunk->used += size;
+        arena->used += size;
+
+        return p;
+}
+
+void df_arena_reset(df_arena_t *arena)
+{
+        gsize total = 0;
+
+        g_assert(arena);
+
+        if (arena->chunks && arena->chunks->next) {
+                /* Coalesce all chunks into a single one */
+                for (df_arena_chunk_t *c = arena->chunks; c; c = c->next)
+                        total += c->size;
+
+                df_arena_free_chunks(arena->chunks);
+                /* On failure the next df_arena_alloc() call tries again */
+                arena->chunks = df_arena_chunk_new(total);
+        } else if (arena->chunks)
+                arena->chunks->used = 0;
+
+        arena->used = 0;
+}
@@ -0,0 +1,50 @@
+/** @file arena.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/** Default size of a single arena chunk */
+#define DF_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct df_arena_chunk df_arena_chunk_t;
+
+/** Bump allocator for short-lived data (e.g. generated strings)
+  *
+  * Allocations are never freed individually; instead the whole arena is reset
+  * once the data are no longer needed (e.g. after each iteration), which keeps
+  * the memory around for the following allocations.
+  */
+typedef struct df_arena {
+        /** Chunks in use, the current one first */
+        df_arena_chunk_t *chunks;
+        /** Bytes allocated since the last reset */
+        gsize used;
+} df_arena_t;
+
+df_arena_t *df_arena_new(void);
+void df_arena_free(df_arena_t *arena);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_arena_t, df_arena_free)
+
+/**
+ * @function Allocates size bytes (8-aligned) from the arena. The memory is
+ * valid until the next df_arena_reset() call.
+ * @return Pointer to the allocated memory on success, NULL on error
+ */
+void *df_arena_alloc(df_arena_t *arena, gsize size);
+
+/**
+ * @function Releases all allocations made from the arena. If the allocations
+ * didn't fit into a single chunk, the chunks are coalesced into one big enough
+ * for the same amount of data, so there's no need to allocate a new chunk
+ * next time.
+ */
+void df_arena_reset(df_arena_t *arena);
+
+/**
+ * @return Number of bytes allocated since the last reset
+ */
+static inline gsize df_arena_get_used(const df_arena_t *arena)
+{
+        return arena->used;
+}
@@ -0,0 +1,329 @@
+/** @file binlog.c */
+#include <gio/gio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binlog.h"
+#include "log.h"
+#include "util.h"
+
+/* Size of the record header: payload size and record type */
+#define DF_BINLOG_HEADER_SIZE (sizeof(guint32) + sizeof(guint8))
+/* Upper bound of the record size when decoding, so a corrupted size doesn't
+ * make us allocate gigabytes */
+#define DF_BINLOG_MAX_RECORD_SIZE (64 * 1024 * 1024)
+
+static const char *const df_binlog_result_table[_DF_BINLOG_RESULT_MAX] = {
+        [DF_BINLOG_SUCCESS]       = "Success",
+        [DF_BINLOG_CRASH]         = "Crash",
+        [DF_BINLOG_COMMAND_ERROR] = "Command execution error",
+};
+
+/** String table of the current run (string => id + 1) and the scratch buffer
+  * for records; both are protected by the log lock */
+static GHashTable *df_binlog_strings;
+static GByteArray *df_binlog_record;
+
+static void df_binlog_put_u32(GByteArray *b, guint32 v)
+{
+        v = GUINT32_TO_LE(v);
+        g_byte_array_append(b, (const guint8 *) &v, sizeof(v));
+}
+
+static void df_binlog_put_u64(GByteArray *b, guint64 v)
+{
+        v = GUINT64_TO_LE(v);
+        g_byte_array_append(b, (const guint8 *) &v, sizeof(v));
+}
+
+static void df_binlog_begin(GByteArray *b, guint8 type)
+{
+        g_byte_array_set_size(b, 0);
+        /* Payload size is filled in by df_binlog_end() */
+        df_binlog_put_u32(b, 0);
+        g_byte_array_append(b, &type, sizeof(type));
+}
+
+static void df_binlog_end(GByteArray *b)
+{
+        guint32 size = GUINT32_TO_LE(b->len - DF_BINLOG_HEADER_SIZE);
+
+        memcpy(b->data, &size, sizeof(size));
+        df_log_write(b->data, b->len);
+}
+
+/* Returns id of the string, defining it first if it's not in the table yet */
+static guint32 df_binlog_string(const char *s)
+{
+        GByteArray *b = df_binlog_record;
+        guint32 id;
+
+        id = GPOINTER_TO_UINT(g_hash_table_lookup(df_binlog_strings, s));
+        if (id > 0)
+                return id - 1;
+
+        id = g_hash_table_size(df_binlog_strings);
+        g_hash_table_insert(df_binlog_strings, g_strdup(s), GUINT_TO_POINTER(id + 1));
+
+        df_binlog_begin(b, DF_BINLOG_RECORD_STRING);
+        df_binlog_put_u32(b, id);
+        g_byte_array_append(b, (const guint8 *) s, strlen(s));
+        df_binlog_end(b);
+
+        return id;
+}
+
+int df_binlog_start(guint64 seed)
+{
+        g_assert(df_log_file_is_open());
+        g_assert(!df_binlog_strings);
+
+        df_binlog_strings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        df_binlog_record = g_byte_array_new();
+        df_log_set_binary();
+
+        df_log_lock();
+        df_binlog_begin(df_binlog_record, DF_BINLOG_RECORD_RUN);
+        g_byte_array_append(df_binlog_record, (const guint8 *) DF_BINLOG_MAGIC, strlen(DF_BINLOG_MAGIC));
+        df_binlog_put_u64(df_binlog_record, seed);
+        df_binlog_end(df_binlog_record);
+        df_log_unlock();
+
+        return df_log_flush();
+}
+
+void df_binlog_stop(void)
+{
+        df_log_lock();
+        g_clear_pointer(&df_binlog_strings, g_hash_table_unref);
+        g_clear_pointer(&df_binlog_record, g_byte_array_unref);
+        df_log_unlock();
+}
+
+gboolean df_binlog_is_enabled(void)
+{
+        return !!df_binlog_strings;
+}
+
+void df_binlog_write_call(df_binlog_result_t result, const char *interface, const char *object,
+                          const char *method, const char *signature, guint64 seed, guint64 iteration,
+                          GVariant *value)
+{
+        g_autoptr(GVariant) swapped = NULL;
+        guint32 ids[4];
+        guint8 r = result;
+
+        g_assert(df_binlog_strings);
+        g_assert(result < _DF_BINLOG_RESULT_MAX);
+
+        if (G_BYTE_ORDER != G_LITTLE_ENDIAN)
+                value = swapped = g_variant_byteswap(value);
+
+        df_log_lock();
+
+        /* Define the strings (if needed) before the record referencing them */
+        ids[0] = df_binlog_string(interface);
+        ids[1] = df_binlog_string(object);
+        ids[2] = df_binlog_string(method);
+        ids[3] = df_binlog_string(signature);
+
+        df_binlog_begin(df_binlog_record, DF_BINLOG_RECORD_CALL);
+        g_byte_array_append(df_binlog_record, &r, sizeof(r));
+        for (size_t i = 0; i < G_N_ELEMENTS(ids); i++)
+                df_binlog_put_u32(df_binlog_record, ids[i]);
+        df_binlog_put_u64(df_binlog_record, seed);
+        df_binlog_put_u64(df_binlog_record, iteration);
+        g_byte_array_append(df_binlog_record, g_variant_get_data(value), g_variant_get_size(value));
+        df_binlog_end(df_binlog_record);
+
+        /* Make sure the interesting records don't get lost */
+        if (result != DF_BINLOG_SUCCESS)
+                (void) df_log_flush();
+
+        df_log_unlock();
+}
+
+static guint32 df_binlog_get_u32(const guint8 *p)
+{
+        guint32 v;
+
+        memcpy(&v, p, sizeof(v));
+        return GUINT32_FROM_LE(v);
+}
+
+static guint64 df_binlog_get_u64(const guint8 *p)
+{
+        guint64 v;
+
+        memcpy(&v, p, sizeof(v));
+        return GUINT64_FROM_LE(v);
+}
+
+static int df_binlog_read_call(const guint8 *p, guint32 size, GPtrArray *strings,
+                               df_binlog_call_func_t func, gpointer userdata)
+{
+        g_autoptr(GVariant) value = NULL;
+        g_autoptr(GBytes) data = NULL;
+        df_binlog_call_t call;
+        const char *s[4];
+        const size_t fixed = sizeof(guint8) + 4 * sizeof(guint32) + 2 * sizeof(guint64);
+        guint8 result;
+
+        if (size < fixed)
+                return df_fail_ret(-1, "Truncated call record\n");
+
+        result = p[0];
+        if (result >= _DF_BINLOG_RESULT_MAX)
+                return df_fail_ret(-1, "Invalid result %u in a call record\n", result);
+
+        for (size_t i = 0; i < G_N_ELEMENTS(s); i++) {
+                guint32 id = df_binlog_get_u32(p + 1 + i * sizeof(guint32));
+
+                if (id >= strings->len)
+                        return df_fail_ret(-1, "Undefined string %u in a call record\n", id);
+                s[i] = g_ptr_array_index(strings, id);
+        }
+
+        if (!g_variant_type_string_is_valid(s[3]))
+                return df_fail_ret(-1, "Invalid signature '%s' in a call record\n", s[3]);
+
+        data = g_bytes_new(p + fixed, size - fixed);
+        value = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(s[3]), data, FALSE));
+        if (G_BYTE_ORDER != G_LITTLE_ENDIAN) {
+                GVariant *swapped = g_variant_byteswap(value);
+
+                g_variant_unref(value);
+                value = swapped;
+        }
+
+        call = (df_binlog_call_t) {
+                .result = result,
+                .interface = s[0],
+                .object = s[1],
+                .method = s[2],
+                .signature = s[3],
+                .seed = df_binlog_get_u64(p + 1 + 4 * sizeof(guint32)),
+                .iteration = df_binlog_get_u64(p + 1 + 4 * sizeof(guint32) + sizeof(guint64)),
+                .value = value,
+        };
+
+        return func(&call, userdata);
+}
+
+int df_binlog_read(const char *file_name, df_binlog_call_func_t func, gpointer userdata)
+{
+        g_autoptr(FILE) f = NULL;
+        g_autoptr(GPtrArray) strings = NULL;
+        g_autoptr(GByteArray) payload = NULL;
+        guint8 header[DF_BINLOG_HEADER_SIZE];
+        size_t n;
+        int r;
+
+        f = fopen(file_name, "re");
+        if (!f)
+                return df_fail_ret(-1, "Failed to open file %s: %m\n", file_name);
+
+        payload = g_byte_array_new();
+
+        while ((n = fread(header, 1, sizeof(header), f)) > 0) {
+                guint32 size = df_binlog_get_u32(header);
+                guint8 type = header[sizeof(guint32)];
+
+                if (n != sizeof(header))
+                        return df_fail_ret(-1, "Truncated record header in %s\n", file_name);
+                if (!strings && type != DF_BINLOG_RECORD_RUN)
+                        return df_fail_ret(-1, "%s is not a binary dfuzzer log\n", file_name);
+                if (size > DF_BINLOG_MAX_RECORD_SIZE)
+                        return df_fail_ret(-1, "Record of %"G_GUINT32_FORMAT" bytes in %s is too large\n", size, file_name);
+
+                g_byte_array_set_size(payload, size);
+                if (fread(payload->data, 1, size, f) != size)
+                        return df_fail_ret(-1, "Truncated record in %s\n", file_name);
+
+                switch (type) {
+                case DF_BINLOG_RECORD_RUN:
+                        if (size != strlen(DF_BINLOG_MAGIC) + sizeof(guint64) ||
+                            memcmp(payload->data, DF_BINLOG_MAGIC, strlen(DF_BINLOG_MAGIC)) != 0)
+                                return df_fail_ret(-1, "%s is not a binary dfuzzer log\n", file_name);
+
+                        /* Each run has its own string table */
+                        g_clear_pointer(&strings, g_ptr_array_unref);
+                        strings = g_ptr_array_new_with_free_func(g_free);
+                        df_debug("Run with seed %"G_GUINT64_FORMAT"\n",
+                                 df_binlog_get_u64(payload->data + strlen(DF_BINLOG_MAGIC)));
+                        break;
+                case DF_BINLOG_RECORD_STRING:
+                        if (size < sizeof(guint32) || df_binlog_get_u32(payload->data) != strings->len)
+                                return df_fail_ret(-1, "Invalid string record in %s\n", file_name);
+
+                        g_ptr_array_add(strings, g_strndup((const char *) payload->data + sizeof(guint32),
+                                                           size - sizeof(guint32)));
+                        break;
+                case DF_BINLOG_RECORD_CALL:
+                        r = df_binlog_read_call(payload->data, size, strings, func, userdata);
+                        if (r < 0)
+                                return r;
+                        break;
+                default:
+                        /* Skip unknown records, so the format can be extended */
+                        df_debug("Skipping unknown record type %u\n", type);
+                        break;
+                }
+        }
+
+        if (ferror(f))
+                return df_fail_ret(-1, "Failed to read %s: %m\n", file_name);
+
+        return 0;
+}
+
+static int df_binlog_print_call(const df_binlog_call_t *call, gpointer userdata)
+{
+        g_autoptr(gchar) value_str = NULL;
+        FILE *out = userdata;
+
+        /* Seed and iteration aren't part of the text form */
+        value_str = g_variant_print(call->value, TRUE);
+        fprintf(out, "%s;%s;%s;%s;%s;%s\n", call->interface, call->object, call->method, call->signature,
+                value_str, df_binlog_result_to_string(call->result));
+
+        return 0;
+}
+
+int df_binlog_decode(const char *file_name, FILE *out)
+{
+        return df_binlog_read(file_name, df_binlog_print_call, out);
+}
+
+int df_binlog_probe(const char *file_name)
+{
+        g_autoptr(FILE) f = NULL;
+        guint8 header[DF_BINLOG_HEADER_SIZE + sizeof(DF_BINLOG_MAGIC) - 1];
+
+        f = fopen(file_name, "re");
+        if (!f)
+                return df_fail_ret(-1, "Failed to open file %s: %m\n", file_name);
+
+        if (fread(header, 1, sizeof(header), f) != sizeof(header))
+                return ferror(f) ? df_fail_ret(-1, "Failed to read %s: %m\n", file_name) : 0;
+
+        return header[sizeof(guint32)] == DF_BINLOG_RECORD_RUN &&
+               memcmp(header + DF_BINLOG_HEADER_SIZE, DF_BINLOG_MAGIC, strlen(DF_BINLOG_MAGIC)) == 0;
+}
+
+const char *df_binlog_result_to_string(df_binlog_result_t result)
+{
+        g_assert(result < _DF_BINLOG_RESULT_MAX);
+
+        return df_binlog_result_table[result];
+}
+
+df_binlog_result_t df_binlog_result_from_string(const char *s)
+{
+        for (df_binlog_result_t r = 0; r < _DF_BINLOG_RESULT_MAX; r++)
+                if (g_str_equal(s, df_binlog_result_table[r]))
+                        return r;
+
+        return _DF_BINLOG_RESULT_MAX;
+}
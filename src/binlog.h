@@ -0,0 +1,108 @@
+/** @file binlog.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <stdio.h>
+
+/* Binary log format (--log-format=binary)
+ *
+ * Instead of printing each logged value via g_variant_print(), the binary
+ * log stores its serialized form. The log is a sequence of records, each
+ * consisting of a 32-bit payload size, an 8-bit record type and the payload;
+ * all integers are little-endian. Each run starts with a "run" record, which
+ * resets the string table:
+ *
+ *   DF_BINLOG_RECORD_RUN:    DF_BINLOG_MAGIC, u64 seed
+ *   DF_BINLOG_RECORD_STRING: u32 id, bytes of the string (without NUL)
+ *   DF_BINLOG_RECORD_CALL:   u8 result, u32 interface, u32 object, u32 method,
+ *                            u32 signature (ids of strings defined earlier),
+ *                            u64 seed, u64 iteration, serialized GVariant in
+ *                            little-endian byte order
+ */
+#define DF_BINLOG_MAGIC "DFBINLOG"
+
+enum {
+        DF_BINLOG_RECORD_RUN = 1,
+        DF_BINLOG_RECORD_STRING,
+        DF_BINLOG_RECORD_CALL,
+};
+
+/** Result of a logged call; matches the last field of the text log */
+typedef enum df_binlog_result {
+        DF_BINLOG_SUCCESS = 0,
+        DF_BINLOG_CRASH,
+        DF_BINLOG_COMMAND_ERROR,
+        _DF_BINLOG_RESULT_MAX
+} df_binlog_result_t;
+
+/**
+ * @function Switches the (already opened) log file to the binary format and
+ * writes the run record.
+ * @param seed Global seed of the run
+ * @return 0 on success, -1 on error
+ */
+int df_binlog_start(guint64 seed);
+/**
+ * @function Drops the string table of the run, so it can be started again
+ * in another log file; call it before closing the log file
+ */
+void df_binlog_stop(void);
+/**
+ * @return TRUE if the binary log format is used
+ */
+gboolean df_binlog_is_enabled(void);
+
+/**
+ * @function Writes a record of a single call into the log; records which
+ * aren't successes are flushed right away.
+ * @param seed Seed the iteration was generated with
+ * @param iteration Iteration number
+ * @param value Method arguments
+ */
+void df_binlog_write_call(df_binlog_result_t result, const char *interface, const char *object,
+                          const char *method, const char *signature, guint64 seed, guint64 iteration,
+                          GVariant *value);
+
+/** Call record read from a binary log; it's valid only during the callback */
+typedef struct df_binlog_call {
+        df_binlog_result_t result;
+        const char *interface;
+        const char *object;
+        const char *method;
+        const char *signature;
+        guint64 seed;
+        guint64 iteration;
+        GVariant *value;
+} df_binlog_call_t;
+
+typedef int (*df_binlog_call_func_t)(const df_binlog_call_t *call, gpointer userdata);
+
+/**
+ * @function Reads all call records of a binary log in order.
+ * @param file_name Binary log
+ * @param func Called for each call record; a negative return value stops
+ * the reading
+ * @return 0 on success, -1 on error, or the negative value returned by func
+ */
+int df_binlog_read(const char *file_name, df_binlog_call_func_t func, gpointer userdata);
+
+/**
+ * @return 1 if the file is a binary log, 0 if it isn't, -1 on error
+ */
+int df_binlog_probe(const char *file_name);
+
+const char *df_binlog_result_to_string(df_binlog_result_t result);
+/**
+ * @return Result for the string from the text log, _DF_BINLOG_RESULT_MAX
+ * if it's unknown
+ */
+df_binlog_result_t df_binlog_result_from_string(const char *s);
+
+/**
+ * @function Converts a binary log into the text form written by dfuzzer
+ * without --log-format=binary.
+ * @param file_name Binary log
+ * @param out Output of the text log
+ * @return 0 on success, -1 on error
+ */
+int df_binlog_decode(const char *file_name, FILE *out);
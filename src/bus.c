@@ -5,6 +5,52 @@
 #include "log.h"
 #include "util.h"
 
+/** Timeout of the method calls in milliseconds, -1 for the default one */
+static gint df_bus_call_timeout = -1;
+
+void df_bus_set_call_timeout(gint msec)
+{
+        g_assert(msec == -1 || msec > 0);
+
+        df_bus_call_timeout = msec;
+}
+
+gint df_bus_get_call_timeout(void)
+{
+        return df_bus_call_timeout;
+}
+
+GDBusConnection *df_bus_new_private_connection(GBusType bus_type)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) address = NULL;
+        GDBusConnection *dcon;
+
+        /* Unlike g_bus_get_sync() this gives us a new connection every time
+         * instead of the shared singleton */
+        address = g_dbus_address_get_for_bus_sync(bus_type, NULL, &error);
+        if (!address) {
+                df_fail("Error: Unable to get address of the bus.\n");
+                df_error("Error in g_dbus_address_get_for_bus_sync()", error);
+                return NULL;
+        }
+
+        dcon = g_dbus_connection_new_for_address_sync(
+                        address,
+                        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                        NULL,
+                        NULL,
+                        &error);
+        if (!dcon) {
+                df_fail("Error: Unable to open a private connection to the bus.\n");
+                df_error("Error in g_dbus_connection_new_for_address_sync()", error);
+                return NULL;
+        }
+
+        return dcon;
+}
+
 GDBusProxy *df_bus_new_full(GDBusConnection *dcon, const char *name, const char *object,
                        const char *interface, GDBusProxyFlags flags, GError **ret_error)
 {
@@ -45,7 +91,7 @@ GVariant *df_bus_call_full(GDBusProxy *proxy, const char *method, GVariant *valu
                         method,
                         value,
                         flags,
-                        -1,
+                        df_bus_call_timeout,
                         NULL,
                         &error);
         if (!response) {
@@ -2,6 +2,17 @@
 
 #include <gio/gio.h>
 
+/**
+ * @function Sets the timeout of all method calls made by dfuzzer (both
+ * the fuzzed ones and the helper ones)
+ * @param msec Timeout in milliseconds, -1 for the default GDBus timeout
+ */
+void df_bus_set_call_timeout(gint msec);
+gint df_bus_get_call_timeout(void);
+
+/* Opens a new (i.e. not shared) connection to the bus bus_type */
+GDBusConnection *df_bus_new_private_connection(GBusType bus_type);
+
 GDBusProxy *df_bus_new_full(GDBusConnection *dcon, const char *name, const char *object,
                        const char *interface, GDBusProxyFlags flags, GError **ret_error);
 #define df_bus_new(d,n,o,i,f) df_bus_new_full(d, n, o, i, f, NULL)
@@ -0,0 +1,183 @@
+/** @file command.c */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "command.h"
+#include "log.h"
+#include "util.h"
+
+static int df_command_start_coprocess(df_command_t *c)
+{
+        int in[2], out[2];
+        pid_t pid;
+
+        if (pipe(in) < 0)
+                return df_fail_ret(-1, "Failed to create a pipe: %m\n");
+        if (pipe(out) < 0) {
+                (void) close(in[0]);
+                (void) close(in[1]);
+                return df_fail_ret(-1, "Failed to create a pipe: %m\n");
+        }
+
+        /* Neither the co-process nor anything else we start later gets the
+         * pipes, except for the ends duplicated to its stdin and stdout */
+        for (guint8 i = 0; i < 2; i++) {
+                (void) fcntl(in[i], F_SETFD, FD_CLOEXEC);
+                (void) fcntl(out[i], F_SETFD, FD_CLOEXEC);
+        }
+
+        pid = fork();
+        if (pid < 0) {
+                for (guint8 i = 0; i < 2; i++) {
+                        (void) close(in[i]);
+                        (void) close(out[i]);
+                }
+                return df_fail_ret(-1, "Failed to fork: %m\n");
+        }
+        if (pid == 0) {
+                /* Child process; don't touch stdio here, it might be locked
+                 * by another thread */
+                if (dup2(in[0], STDIN_FILENO) < 0 || dup2(out[1], STDOUT_FILENO) < 0)
+                        _exit(127);
+
+                if (!c->show_output) {
+                        int null_fd = open("/dev/null", O_WRONLY);
+
+                        if (null_fd < 0 || dup2(null_fd, STDERR_FILENO) < 0)
+                                _exit(127);
+                }
+
+                execl("/bin/sh", "sh", "-c", c->command, (char *) NULL);
+                _exit(127);
+        }
+
+        c->pid = pid;
+        (void) close(in[0]);
+        (void) close(out[1]);
+
+        c->input = fdopen(in[1], "w");
+        if (!c->input) {
+                (void) close(in[1]);
+                (void) close(out[0]);
+                return df_fail_ret(-1, "Failed to open the stdin of the co-process: %m\n");
+        }
+        c->output = fdopen(out[0], "r");
+        if (!c->output) {
+                (void) close(out[0]);
+                return df_fail_ret(-1, "Failed to open the stdout of the co-process: %m\n");
+        }
+
+        /* Report the death of the co-process as an error instead of being
+         * killed when writing to it */
+        (void) signal(SIGPIPE, SIG_IGN);
+
+        df_verbose("[COMMAND: started co-process %d]\n", pid);
+
+        return 0;
+}
+
+df_command_t *df_command_new(const char *command, gboolean show_output, guint64 interval, gboolean coprocess)
+{
+        g_autoptr(df_command_t) c = NULL;
+
+        g_assert(command);
+
+        c = calloc(1, sizeof(*c));
+        if (!c) {
+                df_oom();
+                return NULL;
+        }
+
+        g_mutex_init(&c->lock);
+        c->show_output = show_output;
+        c->interval = interval;
+        c->coprocess = coprocess;
+        c->command = strdup(command);
+        if (!c->command) {
+                df_oom();
+                return NULL;
+        }
+
+        if (coprocess && df_command_start_coprocess(c) < 0)
+                return NULL;
+
+        return g_steal_pointer(&c);
+}
+
+void df_command_free(df_command_t *c)
+{
+        if (!c)
+                return;
+
+        /* EOF on stdin tells the co-process to exit */
+        if (c->input)
+                (void) fclose(c->input);
+        if (c->output)
+                (void) fclose(c->output);
+
+        if (c->pid > 0) {
+                for (guint i = 0; ; i++) {
+                        pid_t r = waitpid(c->pid, NULL, WNOHANG);
+
+                        if (r < 0 && errno == EINTR)
+                                continue;
+                        if (r != 0)
+                                break;
+
+                        if (i == DF_COMMAND_STOP_TIMEOUT_MSEC / 10) {
+                                (void) kill(c->pid, SIGKILL);
+                                (void) waitpid(c->pid, NULL, 0);
+                                break;
+                        }
+
+                        g_usleep(10 * 1000);
+                }
+        }
+
+        free(c->command);
+        g_mutex_clear(&c->lock);
+        free(c);
+}
+
+static int df_command_run_coprocess(df_command_t *c, const char *object, const char *interface,
+                                    const char *method, guint64 iteration)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        g_autoptr(char) line = NULL;
+        size_t size = 0;
+        guint64 status;
+
+        locker = g_mutex_locker_new(&c->lock);
+
+        if (fprintf(c->input, "%s %s %s %"G_GUINT64_FORMAT"\n", object, interface, method, iteration) < 0 ||
+            fflush(c->input) != 0)
+                return df_fail_ret(-1, "Error: Failed to write to the co-process '%s': %m\n", c->command);
+
+        if (getline(&line, &size, c->output) < 0)
+                return df_fail_ret(-1, "Error: The co-process '%s' exited\n", c->command);
+
+        if (safe_strtoull(g_strstrip(line), &status) < 0 || status > INT_MAX)
+                return df_fail_ret(-1, "Error: Invalid reply from the co-process '%s': '%s'\n", c->command, line);
+
+        return (int) status;
+}
+
+int df_command_run(df_command_t *c, const char *object, const char *interface, const char *method,
+                   guint64 iteration)
+{
+        g_assert(c);
+
+        if (c->coprocess)
+                return df_command_run_coprocess(c, object, interface, method, iteration);
+
+        return df_execute_external_command(c->command, c->show_output);
+}
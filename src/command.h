@@ -0,0 +1,71 @@
+/** @file command.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/** How long the co-process gets to exit after its stdin is closed before
+  * it's killed */
+#define DF_COMMAND_STOP_TIMEOUT_MSEC 1000
+
+/** Check specified via -e/--command
+  *
+  * By default the command is executed via /bin/sh after every call. It can
+  * be executed only after every interval calls instead, or, with an interval
+  * of 0, after the last call of each method (with the failing batch of calls
+  * bisected by the caller), and it can run as a co-process which is started
+  * only once: for each check it gets a line with "OBJECT INTERFACE METHOD
+  * ITERATION" on its stdin and answers with a line with the exit status of
+  * the check on its stdout, which saves a fork() and exec() per check. The
+  * structure is shared by all workers, the co-process is protected by a lock.
+  */
+typedef struct df_command {
+        char *command;
+        gboolean show_output;
+        /** Run the check after this many calls, 0 means after the last call
+          * of each method only */
+        guint64 interval;
+        gboolean coprocess;
+        pid_t pid;
+        /** Stdin and stdout of the co-process */
+        FILE *input;
+        FILE *output;
+        GMutex lock;
+} df_command_t;
+
+/**
+ * @function Creates the check and starts the co-process if requested
+ * @param command Command line, executed via /bin/sh
+ * @param show_output Don't discard stdout (with a co-process stderr) of the
+ * command
+ * @param interval Number of calls between checks, 0 means once per method
+ * @param coprocess Start the command as a long-lived co-process
+ * @return New check on success (free it with df_command_free()), NULL on
+ * error
+ */
+df_command_t *df_command_new(const char *command, gboolean show_output, guint64 interval, gboolean coprocess);
+/**
+ * @function Closes stdin of the co-process and waits for it to exit
+ */
+void df_command_free(df_command_t *c);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_command_t, df_command_free)
+
+/**
+ * @param n_unchecked Number of calls since the last check
+ * @return TRUE if the check is due after n_unchecked calls
+ */
+static inline gboolean df_command_is_due(const df_command_t *c, guint64 n_unchecked)
+{
+        return c->interval > 0 && n_unchecked >= c->interval;
+}
+
+/**
+ * @function Runs the check after the given iteration of the method
+ * @param iteration Iteration of the last call before the check
+ * @return 0 if the check passed, its (positive) exit status if it failed,
+ * -1 on error (e.g. when the co-process exited)
+ */
+int df_command_run(df_command_t *c, const char *object, const char *interface, const char *method,
+                   guint64 iteration);
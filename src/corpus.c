@@ -0,0 +1,55 @@
+/** @file corpus.c */
+#include <gio/gio.h>
+#include <stdlib.h>
+
+#include "corpus.h"
+#include "rand.h"
+
+df_corpus_t *df_corpus_new(void)
+{
+        df_corpus_t *corpus;
+
+        corpus = calloc(1, sizeof(*corpus));
+        if (!corpus)
+                return NULL;
+
+        corpus->inputs = g_ptr_array_new_full(DF_CORPUS_MAX_SIZE, (GDestroyNotify) g_variant_unref);
+
+        return corpus;
+}
+
+void df_corpus_free(df_corpus_t *corpus)
+{
+        if (!corpus)
+                return;
+
+        g_ptr_array_unref(corpus->inputs);
+        free(corpus);
+}
+
+void df_corpus_add(df_corpus_t *corpus, df_rand_t *rnd, GVariant *input)
+{
+        g_assert(corpus);
+        g_assert(input);
+
+        if (corpus->inputs->len < DF_CORPUS_MAX_SIZE) {
+                g_ptr_array_add(corpus->inputs, g_variant_ref(input));
+                return;
+        }
+
+        /* Full, replace a random input */
+        guint idx = df_rand_next(rnd) % corpus->inputs->len;
+
+        g_variant_unref(corpus->inputs->pdata[idx]);
+        corpus->inputs->pdata[idx] = g_variant_ref(input);
+}
+
+GVariant *df_corpus_pick(df_corpus_t *corpus, df_rand_t *rnd)
+{
+        g_assert(corpus);
+
+        if (corpus->inputs->len == 0)
+                return NULL;
+
+        return corpus->inputs->pdata[df_rand_next(rnd) % corpus->inputs->len];
+}
@@ -0,0 +1,36 @@
+/** @file corpus.h */
+#pragma once
+
+#include <gio/gio.h>
+
+#include "rand.h"
+
+/** Maximum number of inputs kept in a corpus; when full, new inputs replace
+  * random old ones */
+#define DF_CORPUS_MAX_SIZE 64
+
+/** Per-method corpus of inputs which reached new code */
+typedef struct df_corpus {
+        GPtrArray *inputs;
+} df_corpus_t;
+
+df_corpus_t *df_corpus_new(void);
+void df_corpus_free(df_corpus_t *corpus);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_corpus_t, df_corpus_free)
+
+/**
+ * @function Adds (a reference to) input to the corpus
+ */
+void df_corpus_add(df_corpus_t *corpus, df_rand_t *rnd, GVariant *input);
+
+/**
+ * @return Pseudo-randomly picked input (borrowed reference), or NULL if the
+ * corpus is empty
+ */
+GVariant *df_corpus_pick(df_corpus_t *corpus, df_rand_t *rnd);
+
+static inline guint df_corpus_size(const df_corpus_t *corpus)
+{
+        return corpus->inputs->len;
+}
@@ -0,0 +1,161 @@
+/** @file coverage.c */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "coverage.h"
+#include "log.h"
+#include "util.h"
+
+/* Bucket hit counts into classes 1, 2, 3, 4-7, 8-15, 16-31, 32-127 and 128+,
+ * so loops that run a few more times don't count as a new coverage */
+static guint8 df_coverage_class(guint8 hits)
+{
+        if (hits <= 2)
+                return hits;
+        if (hits == 3)
+                return 1 << 2;
+        if (hits < 8)
+                return 1 << 3;
+        if (hits < 16)
+                return 1 << 4;
+        if (hits < 32)
+                return 1 << 5;
+        if (hits < 128)
+                return 1 << 6;
+
+        return 1 << 7;
+}
+
+df_coverage_t *df_coverage_new_from_map(const guint8 *map, gsize size)
+{
+        df_coverage_t *coverage;
+
+        g_assert(map);
+        g_assert(size > 0 && size % sizeof(guint64) == 0);
+
+        coverage = calloc(1, sizeof(*coverage));
+        if (!coverage)
+                return NULL;
+
+        coverage->map = map;
+        coverage->size = size;
+        coverage->previous = malloc(size);
+        coverage->seen = calloc(size, 1);
+        if (!coverage->previous || !coverage->seen) {
+                df_coverage_free(coverage);
+                return NULL;
+        }
+
+        /* Whatever happened before we started doesn't count */
+        memcpy(coverage->previous, map, size);
+        g_mutex_init(&coverage->lock);
+
+        return coverage;
+}
+
+df_coverage_t *df_coverage_open(const char *name)
+{
+        df_coverage_t *coverage;
+        struct stat st;
+        void *map;
+        fd_t fd;
+
+        g_assert(name);
+
+        fd = shm_open(name, O_RDONLY|O_CLOEXEC, 0);
+        if (fd < 0) {
+                df_fail("Failed to open coverage map '%s' (is the tested process running with %s=%s?): %m\n",
+                        name, DF_COVERAGE_SHM_ENV, name);
+                return NULL;
+        }
+
+        if (fstat(fd, &st) < 0 || st.st_size < DF_COVERAGE_MAP_SIZE) {
+                df_fail("Coverage map '%s' is too small or inaccessible\n", name);
+                safe_close(fd);
+                return NULL;
+        }
+
+        map = mmap(NULL, DF_COVERAGE_MAP_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        safe_close(fd);
+        if (map == MAP_FAILED) {
+                df_fail("Failed to map coverage map '%s': %m\n", name);
+                return NULL;
+        }
+
+        coverage = df_coverage_new_from_map(map, DF_COVERAGE_MAP_SIZE);
+        if (!coverage) {
+                munmap(map, DF_COVERAGE_MAP_SIZE);
+                return NULL;
+        }
+
+        coverage->mapped = TRUE;
+
+        return coverage;
+}
+
+void df_coverage_free(df_coverage_t *coverage)
+{
+        if (!coverage)
+                return;
+
+        if (coverage->mapped)
+                munmap((void *) coverage->map, coverage->size);
+
+        if (coverage->previous && coverage->seen)
+                g_mutex_clear(&coverage->lock);
+        free(coverage->previous);
+        free(coverage->seen);
+        free(coverage);
+}
+
+guint df_coverage_collect(df_coverage_t *coverage)
+{
+        const guint64 *map;
+        guint64 *previous;
+        guint n_new = 0;
+
+        g_assert(coverage);
+
+        map = (const guint64 *) coverage->map;
+        previous = (guint64 *) coverage->previous;
+
+        g_mutex_lock(&coverage->lock);
+
+        /* Most of the map doesn't change between two calls, so compare it
+         * a word at a time and look at the individual counters only if
+         * something changed */
+        for (gsize w = 0; w < coverage->size / sizeof(guint64); w++) {
+                /* The map is being updated concurrently, so work on a copy */
+                guint64 current = *(const volatile guint64 *) &map[w];
+                const guint8 *c = (const guint8 *) &current, *p = (const guint8 *) &previous[w];
+                guint8 *seen = coverage->seen + w * sizeof(guint64);
+
+                if (current == previous[w])
+                        continue;
+
+                for (gsize i = 0; i < sizeof(guint64); i++) {
+                        /* Counters wrap around, so the difference is the number of
+                         * hits since the last snapshot (modulo 256) */
+                        guint8 class = df_coverage_class(c[i] - p[i]);
+
+                        if (class & ~seen[i]) {
+                                if (seen[i] == 0)
+                                        coverage->n_edges++;
+                                seen[i] |= class;
+                                n_new++;
+                        }
+                }
+
+                previous[w] = current;
+        }
+
+        g_mutex_unlock(&coverage->lock);
+
+        return n_new;
+}
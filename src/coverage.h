@@ -0,0 +1,56 @@
+/** @file coverage.h */
+#pragma once
+
+#include <gio/gio.h>
+
+#include "dfuzzer-cov.h"
+
+/** Default number of iterations without new coverage after which testing of
+  * a method ends early */
+#define DF_COVERAGE_PLATEAU_DEFAULT 200
+
+/** Reader of the coverage map exported by libdfuzzer-cov.so
+  *
+  * The map is shared by the whole process, so it's compared against the
+  * snapshot from the previous df_coverage_collect() call; the difference
+  * (i.e. the hits caused by the last call) is bucketed into power-of-two
+  * classes, same as AFL does, and compared against all classes seen so far.
+  */
+typedef struct df_coverage {
+        /** Coverage map (read-only) */
+        const guint8 *map;
+        /** Map snapshot from the previous collection */
+        guint8 *previous;
+        /** Hit-count classes seen so far, for each edge */
+        guint8 *seen;
+        gsize size;
+        /** TRUE if map was mmap()ed by df_coverage_open() */
+        gboolean mapped;
+        /** Number of edges seen so far */
+        guint64 n_edges;
+        GMutex lock;
+} df_coverage_t;
+
+/**
+ * @function Maps the coverage map exported by a tested process under the POSIX
+ * shared memory object name (see dfuzzer-cov.c)
+ * @return New coverage reader on success (free it with df_coverage_free()),
+ * NULL on error
+ */
+df_coverage_t *df_coverage_open(const char *name);
+/**
+ * @function Creates a coverage reader over an existing map of size counters;
+ * the map must outlive the reader
+ */
+df_coverage_t *df_coverage_new_from_map(const guint8 *map, gsize size);
+void df_coverage_free(df_coverage_t *coverage);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_coverage_t, df_coverage_free)
+
+/**
+ * @function Takes a new snapshot of the map and compares it with the previous
+ * one. Safe to call from multiple threads, although the new coverage is then
+ * attributed to whichever thread called it first.
+ * @return Number of edges with a new hit-count class since the last call
+ */
+guint df_coverage_collect(df_coverage_t *coverage);
@@ -0,0 +1,91 @@
+/** @file dfuzzer-cov.c */
+/*
+ * Coverage exporter for dfuzzer's feedback mode (--coverage=NAME).
+ *
+ * Build the tested service with -fsanitize-coverage=trace-pc-guard and run it
+ * with:
+ *
+ *   LD_PRELOAD=libdfuzzer-cov.so DFUZZER_COVERAGE_SHM=/NAME <service>
+ *
+ * Each instrumented edge gets an 8-bit (wrapping) counter in the shared memory
+ * object NAME, which dfuzzer maps read-only to find out which inputs reach new
+ * code. The library is loaded into arbitrary processes, so it must not depend
+ * on anything but libc.
+ *
+ * See: https://clang.llvm.org/docs/SanitizerCoverage.html
+ */
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dfuzzer-cov.h"
+
+static uint8_t *df_cov_map;
+static uint32_t df_cov_n_guards;
+
+static void df_cov_map_init(void)
+{
+        static int initialized;
+        const char *name;
+        void *p;
+        int fd;
+
+        if (initialized)
+                return;
+        initialized = 1;
+
+        name = getenv(DF_COVERAGE_SHM_ENV);
+        if (!name || !*name)
+                return;
+
+        /* Readable by everyone, so dfuzzer doesn't need to run under the same
+         * user as the tested service */
+        fd = shm_open(name, O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+        if (fd < 0)
+                return;
+
+        if (ftruncate(fd, DF_COVERAGE_MAP_SIZE) < 0) {
+                close(fd);
+                return;
+        }
+
+        p = mmap(NULL, DF_COVERAGE_MAP_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+                return;
+
+        df_cov_map = p;
+}
+
+__attribute__((constructor))
+static void df_cov_init(void)
+{
+        df_cov_map_init();
+}
+
+void __sanitizer_cov_trace_pc_guard_init(uint32_t *start, uint32_t *stop)
+{
+        /* Called from the constructors of the instrumented modules, which may
+         * run before ours */
+        df_cov_map_init();
+
+        if (start == stop || *start)
+                return;
+
+        /* Guard 0 means "disabled", so start at 1 */
+        for (uint32_t *guard = start; guard < stop; guard++)
+                *guard = ++df_cov_n_guards;
+}
+
+void __sanitizer_cov_trace_pc_guard(uint32_t *guard)
+{
+        if (!df_cov_map || !*guard)
+                return;
+
+        /* dfuzzer looks at the differences between two snapshots, so the
+         * counters can simply wrap around */
+        df_cov_map[*guard % DF_COVERAGE_MAP_SIZE]++;
+}
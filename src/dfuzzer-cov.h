@@ -0,0 +1,13 @@
+/** @file dfuzzer-cov.h */
+#pragma once
+
+/* Shared between dfuzzer and the libdfuzzer-cov.so preload library; keep it
+ * free of any dependencies */
+
+/** Environment variable with the name of the POSIX shared memory object
+  * the coverage map is exported to (e.g. "/dfuzzer-cov") */
+#define DF_COVERAGE_SHM_ENV "DFUZZER_COVERAGE_SHM"
+
+/** Size of the coverage map, i.e. the number of 8-bit edge counters; edges
+  * beyond the size share the counters (modulo the size) */
+#define DF_COVERAGE_MAP_SIZE (1 << 16)
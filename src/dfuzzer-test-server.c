@@ -64,6 +64,21 @@ static const gchar introspection_xml[] =
 "               <method name='df_hang'>"
 "                       <arg type='t' name='lol' direction='in'/>"
 "               </method>"
+"               <method name='df_slow_down'>"
+"                       <arg type='t' name='lol' direction='in'/>"
+"               </method>"
+"               <method name='df_bench_s'>"
+"                       <arg type='s' name='in' direction='in'/>"
+"               </method>"
+"               <method name='df_bench_asv'>"
+"                       <arg type='a{sv}' name='in' direction='in'/>"
+"               </method>"
+"               <method name='df_bench_aay'>"
+"                       <arg type='aay' name='in' direction='in'/>"
+"               </method>"
+"               <method name='df_bench_v'>"
+"                       <arg type='v' name='in' direction='in'/>"
+"               </method>"
 "               <method name='df_noreply'>"
 "                       <arg type='t' name='lol' direction='in'/>"
 "               </method>"
@@ -122,6 +137,12 @@ static void handle_method_call(
 {
         g_autoptr(gchar) response = NULL;
 
+        /* Keep the benchmark methods as cheap as possible */
+        if (g_str_has_prefix(method_name, "df_bench_")) {
+                g_dbus_method_invocation_return_value(invocation, g_variant_new("()"));
+                return;
+        }
+
         g_printf("->[handle_method_call] %s\n", method_name);
 
         if (g_str_equal(method_name, "df_hello")) {
@@ -155,6 +176,15 @@ static void handle_method_call(
                 g_dbus_method_invocation_return_value(invocation, g_variant_new("()"));
         } else if (g_str_equal(method_name, "df_hang"))
                 pause();
+        else if (g_str_equal(method_name, "df_slow_down")) {
+                static unsigned calls = 0;
+
+                /* Replies get substantially slower after a while */
+                if (++calls > 128)
+                        g_usleep(20 * 1000);
+
+                g_dbus_method_invocation_return_value(invocation, g_variant_new("()"));
+        }
         else if (g_str_equal(method_name, "df_noreply") || g_str_equal(method_name, "df_noreply_expected"))
                 g_dbus_method_invocation_return_dbus_error(invocation, "org.freedesktop.DBus.Error.NoReply", "org.freedesktop.DBus.Error.NoReply");
         else if (g_str_equal(method_name, "df_complex_sig_1")) {
@@ -266,8 +296,13 @@ gboolean handle_signal(gpointer userdata)
 
 int main(int argc, char **argv)
 {
+        GBusType bus_type = G_BUS_TYPE_SYSTEM;
         guint name_id;
 
+        /* The benchmark runs the server on a private session bus */
+        if (argc > 1 && g_str_equal(argv[1], "--session"))
+                bus_type = G_BUS_TYPE_SESSION;
+
         // Parses introspection_xml and returns a GDBusNodeInfo representing the data.
         // The introspection XML must contain exactly one top-level <node> element.
         introspection_data = g_dbus_node_info_new_for_xml(introspection_xml, NULL);
@@ -283,7 +318,7 @@ int main(int argc, char **argv)
         // Starts acquiring name on the bus (G_BUS_TYPE_SESSION) and calls
         // name_acquired handler and name_lost when the name is acquired
         // respectively lost.
-        name_id = g_bus_own_name(G_BUS_TYPE_SYSTEM,
+        name_id = g_bus_own_name(bus_type,
                                 "org.freedesktop.dfuzzerServer",
                                 G_BUS_NAME_OWNER_FLAGS_NONE,
                                 bus_acquired,
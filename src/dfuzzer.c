@@ -29,15 +29,28 @@
 #include <errno.h>
 #include <getopt.h>
 
+#include "binlog.h"
 #include "bus.h"
+#include "command.h"
+#include "coverage.h"
 #include "fuzz.h"
+#include "harness.h"
 #include "introspection.h"
+#include "journal.h"
 #include "log.h"
+#include "metrics.h"
+#include "plan.h"
+#include "producer.h"
 #include "rand.h"
+#include "reconnect.h"
+#include "replay.h"
+#include "schedule.h"
+#include "stress.h"
 #include "suppression.h"
 #include "util.h"
 
 #define DF_BUS_ROOT_NODE "/"
+#define DF_MAX_JOBS 256
 
 enum {
         DF_BUS_OK = 0,
@@ -67,19 +80,93 @@ static char *df_test_property;
 static struct fuzzing_target target_proc = { "", "", "" };
 /** Option for listing names on the bus */
 static int df_list_names;
-/** Tested process PID */
-static int df_pid = -1;
-GList *suppressions;
+
+/** A tested bus name on one of the buses */
+typedef struct df_target {
+        char *name;
+        GBusType bus_type;
+        /** Tested process PID; shared by all workers, so access it atomically */
+        int pid;
+        /** DF_BUS_* result of the target */
+        int result;
+} df_target_t;
+
+/** Target the current thread works on; set by the thread processing the
+  * target and inherited by its workers, so multiple targets can be fuzzed
+  * at once */
+static __thread df_target_t *df_target;
+/** Batch mode: file with the bus names to test (--targets=) or all names on
+  * the buses (--all), and the number of them tested in parallel */
+static char *df_batch_file;
+static gboolean df_batch_all;
+static guint df_batch_jobs = 1;
+/** Results of all targets of the batch, for the final report */
+static GPtrArray *df_batch_targets;
+/** Command line of the service started by dfuzzer itself on a private bus
+  * (--harness=), and the harness running it */
+static char *df_harness_command;
+static df_harness_t *df_harness;
+/** Suppressions of all bus names, NULL with -s/--no-suppressions */
+static df_suppression_index_t *suppressions;
 /** If -s option is passed 1, otherwise 0 */
 static int df_supflg;
 /** Command/Script to execute by dfuzzer after each method call.
   * If command/script returns >0, dfuzzer prints fail message,
   * if 0 it continues */
 static char *df_execute_cmd;
+/** Don't suppress the output of the command (--show-command-output) */
+static gboolean df_show_command_output;
+/** Number of calls between runs of the command, 0 means once per method
+  * (--command-interval=) */
+static guint64 df_command_interval = 1;
+/** Run the command as a co-process (--command-coprocess) */
+static gboolean df_command_coprocess;
+/** Check created from the options above, NULL without -e/--command */
+static df_command_t *df_command;
+/** Interval of the status line in seconds, 0 if it's disabled
+  * (--stats-interval=) */
+static guint64 df_stats_interval;
+/** File or "unix:PATH" socket the metrics are exported to (--metrics=) */
+static char *df_metrics_target;
 /** Path to directory containing output logs */
 static char *df_log_dir_name;
+/** Skip the work recorded in the journal of an interrupted run (--resume) */
+static gboolean df_resume;
+/** Journal of the finished work of the current target, kept next to its log */
+static df_journal_t *df_journal;
+/** TRUE if the log should be written in the binary format (--log-format=) */
+static gboolean df_log_binary;
+/** Binary log to convert to text (--decode-log=) */
+static char *df_decode_log;
+/** Log to replay (--replay=), its records, and whether to look for the
+  * shortest prefix killing the tested process (--bisect) */
+static char *df_replay_file;
+static GPtrArray *df_replay_records;
+static gboolean df_replay_bisect;
+/** Persist the introspection data in the log dir between runs */
+static gboolean df_introspection_cache_enabled;
+/** Maximum number of Introspect calls in flight during the discovery */
+static guint df_discovery_inflight = DF_DISCOVERY_INFLIGHT_DEFAULT;
+/** Name of the shared memory object with the coverage map (--coverage=) */
+static char *df_coverage_name;
+static guint64 df_coverage_plateau = DF_COVERAGE_PLATEAU_DEFAULT;
 static guint64 df_max_iterations = G_MAXUINT32;
 static guint64 df_min_iterations = 10;
+/** Number of worker threads fuzzing objects/interfaces in parallel */
+static guint df_jobs = 1;
+/** TRUE if the seed was set explicitly via --seed= */
+static gboolean df_seed_set;
+/** Global budget of the scheduler in calls (--budget=) and seconds
+  * (--time-budget=); the scheduler is used if any of them is set */
+static guint64 df_budget;
+static guint64 df_time_budget;
+/** Number of concurrent clients calling the method (--stress=), 0 if the
+  * stress mode is disabled, their peak rate, duration and whether they churn
+  * match rules */
+static guint df_stress_clients;
+static guint64 df_stress_rate;
+static guint64 df_stress_duration = DF_STRESS_DEFAULT_DURATION_SEC;
+static gboolean df_stress_churn;
 
 /**
  * @function Checks if name is valid D-Bus name, obj is valid
@@ -107,48 +194,71 @@ static int df_is_valid_dbus(const char *name, const char *obj, const char *intf)
 }
 
 /**
- * @function Calls method ListNames to get all available connection names
- * on the bus and prints them on the program output.
- * @param dcon D-Bus connection structure
- * @return 0 on success, -1 on error
+ * @function Calls method ListNames or ListActivatableNames on the interface
+ * org.freedesktop.DBus to get the well-known names on the bus (unique
+ * connection names are skipped).
+ * @param proxy Proxy of the bus daemon
+ * @param method "ListNames" or "ListActivatableNames"
+ * @return New array of names on success, NULL on error
  */
-static int df_list_bus_names(GDBusConnection *dcon)
+static GPtrArray *df_get_bus_names(GDBusProxy *proxy, const char *method)
 {
-        g_autoptr(GDBusProxy) proxy = NULL;
+        g_autoptr(GPtrArray) names = NULL;
         g_autoptr(GVariantIter) iter = NULL;
         g_autoptr(GVariant) response = NULL;
         char *str;
 
-        proxy = df_bus_new(dcon,
-                           "org.freedesktop.DBus",
-                           "/org/freedesktop/DBus",
-                           "org.freedesktop.DBus",
-                           G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
-        if (!proxy)
-                return -1;
-
-        response = df_bus_call(proxy, "ListNames", NULL, G_DBUS_CALL_FLAGS_NONE);
+        response = df_bus_call(proxy, method, NULL, G_DBUS_CALL_FLAGS_NONE);
         if (!response)
-                return -1;
+                return NULL;
 
+        names = g_ptr_array_new_with_free_func(g_free);
         g_variant_get(response, "(as)", &iter);
         while (g_variant_iter_loop(iter, "s", &str)) {
                 if (str[0] != ':')
-                        printf("%s\n", str);
+                        g_ptr_array_add(names, g_strdup(str));
         }
 
-        response = safe_g_variant_unref(response);
-        iter = safe_g_variant_iter_free(iter);
+        return g_steal_pointer(&names);
+}
 
-        response = df_bus_call(proxy, "ListActivatableNames", NULL, G_DBUS_CALL_FLAGS_NONE);
-        if (!response)
+static GDBusProxy *df_bus_daemon_new(GDBusConnection *dcon)
+{
+        return df_bus_new(dcon,
+                          "org.freedesktop.DBus",
+                          "/org/freedesktop/DBus",
+                          "org.freedesktop.DBus",
+                          G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
+}
+
+/**
+ * @function Gets all available connection names on the bus and prints them
+ * on the program output.
+ * @param dcon D-Bus connection structure
+ * @return 0 on success, -1 on error
+ */
+static int df_list_bus_names(GDBusConnection *dcon)
+{
+        g_autoptr(GDBusProxy) proxy = NULL;
+        g_autoptr(GPtrArray) names = NULL, activatable = NULL;
+
+        proxy = df_bus_daemon_new(dcon);
+        if (!proxy)
                 return -1;
 
-        g_variant_get(response, "(as)", &iter);
-        while (g_variant_iter_loop(iter, "s", &str)) {
-                if (str[0] != ':')
-                        printf("%s (activatable)\n", str);
-        }
+        names = df_get_bus_names(proxy, "ListNames");
+        if (!names)
+                return -1;
+
+        for (guint i = 0; i < names->len; i++)
+                printf("%s\n", (char *) g_ptr_array_index(names, i));
+
+        activatable = df_get_bus_names(proxy, "ListActivatableNames");
+        if (!activatable)
+                return -1;
+
+        for (guint i = 0; i < activatable->len; i++)
+                printf("%s (activatable)\n", (char *) g_ptr_array_index(activatable, i));
 
         return 0;
 }
@@ -165,11 +275,7 @@ static int df_get_pid(GDBusConnection *dcon, gboolean activate)
         g_autoptr(GVariant) variant_pid = NULL;
         int pid = -1;
 
-        pproxy = df_bus_new(dcon,
-                            "org.freedesktop.DBus",
-                            "/org/freedesktop/DBus",
-                            "org.freedesktop.DBus",
-                            G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
+        pproxy = df_bus_daemon_new(dcon);
         if (!pproxy)
                 return -1;
 
@@ -187,12 +293,12 @@ static int df_get_pid(GDBusConnection *dcon, gboolean activate)
 
                 act_res = df_bus_call_full(pproxy,
                                            "StartServiceByName",
-                                           g_variant_new("(su)", target_proc.name, 0),
+                                           g_variant_new("(su)", df_target->name, 0),
                                            G_DBUS_CALL_FLAGS_NONE,
                                            &act_error);
                 if (!act_res) {
                         g_dbus_error_strip_remote_error(act_error);
-                        df_verbose("Error while activating '%s': %s.\n", target_proc.name, act_error->message);
+                        df_verbose("Error while activating '%s': %s.\n", df_target->name, act_error->message);
                         df_error("Failed to activate the target", act_error);
                         /* Don't make this a hard fail */
                 }
@@ -200,7 +306,7 @@ static int df_get_pid(GDBusConnection *dcon, gboolean activate)
 
         variant_pid = df_bus_call(pproxy,
                                   "GetConnectionUnixProcessID",
-                                  g_variant_new("(s)", target_proc.name),
+                                  g_variant_new("(s)", df_target->name),
                                   G_DBUS_CALL_FLAGS_NONE);
         if (!variant_pid)
                 return -1;
@@ -210,6 +316,93 @@ static int df_get_pid(GDBusConnection *dcon, gboolean activate)
         return pid;
 }
 
+/**
+ * @function Waits for the tested process to come back after a crash (i.e.
+ * for a new owner of the bus name) and updates the PID of the target.
+ * @param dcon D-Bus connection structure
+ * @param activate Activate the process if it's not running
+ * @return 0 on success, -1 on error
+ */
+static int df_wait_for_restart(GDBusConnection *dcon, gboolean activate)
+{
+        int pid;
+
+        // The harness restarts the service itself (if a spare instance
+        // isn't waiting for the name already)
+        if (df_harness) {
+                if (df_harness_prepare_restart(df_harness) < 0)
+                        return -1;
+                activate = FALSE;
+        }
+
+        pid = df_reconnect_wait_for_owner(dcon, df_target->name, activate);
+        if (pid < 0) {
+                df_debug("Error in df_reconnect_wait_for_owner() on getting pid of process\n");
+                return -1;
+        }
+        g_atomic_int_set(&df_target->pid, pid);
+        if (df_harness)
+                df_harness_set_owner(df_harness, pid);
+        df_fail("%s%s[RE-CONNECTED TO PID: %d]%s\n",
+                ansi_cr(), ansi_cyan(), pid, ansi_blue());
+
+        return 0;
+}
+
+/**
+ * @function Creates a new proxy for the given interface after the tested
+ * process was restarted (by this thread or by another worker).
+ * @param dcon D-Bus connection structure
+ * @param name D-Bus name
+ * @param object D-Bus object path
+ * @param interface D-Bus interface
+ * @return New proxy on success, NULL on error
+ */
+static GDBusProxy *df_reattach(GDBusConnection *dcon, const char *name, const char *object, const char *interface)
+{
+        g_autoptr(GDBusProxy) dproxy = NULL;
+
+        if (!df_is_valid_dbus(name, object, interface))
+                return NULL;
+
+        /* The properties proxy refers to the crashed process as well */
+        df_fuzz_release_properties_proxy();
+
+        dproxy = df_bus_new(dcon, name, object, interface,
+                            G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
+        if (!dproxy)
+                return NULL;
+
+        if (df_fuzz_init(dproxy) < 0) {
+                df_debug("Error in df_fuzz_add_proxy()\n");
+                return NULL;
+        }
+
+        return g_steal_pointer(&dproxy);
+}
+
+/**
+ * @function Waits for the tested process to come back after a crash and
+ * creates a new proxy for the given interface; the other workers waiting for
+ * the restart go on afterwards (see df_fuzz_set_crash_guard()).
+ * @param dcon D-Bus connection structure
+ * @param name D-Bus name
+ * @param object D-Bus object path
+ * @param interface D-Bus interface
+ * @return New proxy on success, NULL on error
+ */
+static GDBusProxy *df_reconnect(GDBusConnection *dcon, const char *name, const char *object, const char *interface)
+{
+        int r;
+
+        r = df_wait_for_restart(dcon, FALSE);
+        df_fuzz_crash_handled();
+        if (r < 0)
+                return NULL;
+
+        return df_reattach(dcon, name, object, interface);
+}
+
 /**
  * @function Controls fuzz testing of all methods of specified interface (intf)
  * and reports results.
@@ -217,21 +410,24 @@ static int df_get_pid(GDBusConnection *dcon, gboolean activate)
  * @param name D-Bus name
  * @param obj D-Bus object path
  * @param intf D-Bus interface
+ * @param schedule If not NULL, methods are not tested right away, but added
+ * to the scheduler instead (properties are still tested right away)
+ * @param target Data of the scheduled methods, see df_schedule_add()
  * @return 0 on success, 1 on error, 2 when testing detected any failures,
  * 3 on warnings
  */
-static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object, const char *interface)
+static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object, const char *interface,
+                   df_schedule_t *schedule, gpointer target)
 {
         g_autoptr(GDBusProxy) dproxy = NULL;
         g_autoptr(GDBusNodeInfo) node_info = NULL;
         GDBusInterfaceInfo *interface_info = NULL;
         guint64 iterations;
+        gint64 start_usec;
+        gboolean resumed;
         int method_found = 0, property_found = 0, ret;
         int rv = DF_BUS_OK;
 
-        // initialization of random module
-        df_rand_init(time(NULL));
-
         // Sanity check fuzzing target
         if (isempty(name) || isempty(object) || isempty(interface)) {
                 df_fail("Error in target specification.\n");
@@ -241,6 +437,12 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
         if (!df_is_valid_dbus(name, object, interface))
                 return DF_BUS_ERROR;
 
+        /* The scheduler tests the methods in slices, it's not journaled */
+        if (!schedule && df_journal_lookup(df_journal, DF_JOURNAL_INTERFACE, object, interface, NULL, &rv)) {
+                df_verbose("  %sDONE%s %s - tested in a previous run\n", ansi_blue(), ansi_normal(), interface);
+                return rv;
+        }
+
         dproxy = df_bus_new(dcon, name, object, interface,
                             G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
         if (!dproxy)
@@ -255,6 +457,29 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                 return DF_BUS_ERROR;
         }
 
+        /* Read all properties at once first, unless only a specific one is tested */
+        if (!df_skip_properties && !df_test_property && df_interface_has_readable_properties(interface_info)) {
+                while ((ret = df_fuzz_test_all_properties(dcon, name, object, interface,
+                                                          g_atomic_int_get(&df_target->pid))) == 5) {
+                        /* Another worker reported the crash and restarted the process */
+                        dproxy = safe_g_dbus_proxy_unref(dproxy);
+                        dproxy = df_reattach(dcon, name, object, interface);
+                        if (!dproxy)
+                                return DF_BUS_ERROR;
+                }
+                if (ret < 0) {
+                        df_debug("Error in df_fuzz_test_all_properties()\n");
+                        return DF_BUS_ERROR;
+                } else if (ret == 1) {
+                        // launch process again after crash
+                        rv = DF_BUS_FAIL;
+                        dproxy = safe_g_dbus_proxy_unref(dproxy);
+                        dproxy = df_reconnect(dcon, name, object, interface);
+                        if (!dproxy)
+                                return DF_BUS_ERROR;
+                }
+        }
+
         /* Test properties */
         STRV_FOREACH_COND(p, interface_info->properties, !df_skip_properties) {
                 g_auto(df_dbus_property_t) dbus_property = {0,};
@@ -273,46 +498,44 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
 
                 iterations = df_get_number_of_iterations(dbus_property.signature);
                 iterations = CLAMP(iterations, df_min_iterations, df_max_iterations);
-                ret = df_fuzz_test_property(
-                                dcon,
-                                &dbus_property,
-                                name,
-                                object,
-                                interface,
-                                df_pid,
-                                iterations);
+                resumed = df_journal_lookup(df_journal, DF_JOURNAL_PROPERTY, object, interface, p->name, &ret);
+                if (resumed)
+                        df_verbose("%s  %sDONE%s [P] %s - tested in a previous run%s\n", ansi_cr(), ansi_blue(),
+                                   ansi_normal(), p->name, ret == 0 ? "" : ", with failures");
+                else {
+                        start_usec = g_get_monotonic_time();
+                        while ((ret = df_fuzz_test_property(
+                                                dcon,
+                                                &dbus_property,
+                                                name,
+                                                object,
+                                                interface,
+                                                g_atomic_int_get(&df_target->pid),
+                                                iterations)) == 5) {
+                                dproxy = safe_g_dbus_proxy_unref(dproxy);
+                                dproxy = df_reattach(dcon, name, object, interface);
+                                if (!dproxy)
+                                        return DF_BUS_ERROR;
+                        }
+                        if (ret >= 0 && df_journal &&
+                            df_journal_append(df_journal, DF_JOURNAL_PROPERTY, ret, iterations,
+                                              g_get_monotonic_time() - start_usec, object, interface, p->name) < 0)
+                                return DF_BUS_ERROR;
+                }
                 if (ret < 0) {
                         // error during testing method
                         df_debug("Error in df_fuzz_test_property()\n");
                         return DF_BUS_ERROR;
+                } else if (ret == 1 && !df_test_property && resumed) {
+                        // the process was restarted in the previous run
+                        rv = DF_BUS_FAIL;
                 } else if (ret == 1 && !df_test_property) {
                         // launch process again after crash
                         rv = DF_BUS_FAIL;
                         dproxy = safe_g_dbus_proxy_unref(dproxy);
-
-                        if (!df_is_valid_dbus(name, object, interface))
-                                return DF_BUS_ERROR;
-
-                        dproxy = df_bus_new(dcon, name, object, interface,
-                                            G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
+                        dproxy = df_reconnect(dcon, name, object, interface);
                         if (!dproxy)
                                 return DF_BUS_ERROR;
-
-                        sleep(5);
-
-                        // gets pid of tested process
-                        df_pid = df_get_pid(dcon, FALSE);
-                        if (df_pid < 0) {
-                                df_debug("Error in df_get_pid() on getting pid of process\n");
-                                return DF_BUS_ERROR;
-                        }
-                        fprintf(stderr, "%s%s[RE-CONNECTED TO PID: %d]%s\n",
-                                        ansi_cr(), ansi_cyan(), df_pid, ansi_blue());
-
-                        if (df_fuzz_init(dproxy) < 0) {
-                                df_debug("Error in df_fuzz_add_proxy()\n");
-                                return DF_BUS_ERROR;
-                        }
                 } else if (ret == 1 && df_test_property)
                         rv = DF_BUS_FAIL;
         }
@@ -320,7 +543,7 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
         /* Test methods */
         STRV_FOREACH_COND(m, interface_info->methods, !df_skip_methods) {
                 g_auto(df_dbus_method_t) dbus_method = {0,};
-                char *description;
+                const char *description;
 
                 /* Test only a specific method if set */
                 if (df_test_method && !g_str_equal(df_test_method, m->name))
@@ -328,7 +551,7 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
 
                 method_found = 1;
 
-                if (df_suppression_check(suppressions, object, interface, m->name, &description) != 0) {
+                if (df_suppression_check(suppressions, name, object, interface, m->name, &description) != 0) {
                         df_verbose("%s  %sSKIP%s [M] %s - %s\n", ansi_cr(), ansi_blue(), ansi_normal(),
                                    m->name, description ?: "suppressed method");
                         continue;
@@ -339,50 +562,60 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                 dbus_method.returns_value = !!*(m->out_args);
                 dbus_method.expect_reply = df_object_returns_reply(m->annotations);
 
+                if (schedule) {
+                        if (!df_schedule_add(schedule, object, interface, &dbus_method, target)) {
+                                df_fail("Error: Could not allocate memory for a scheduled method.\n");
+                                return DF_BUS_ERROR;
+                        }
+
+                        continue;
+                }
+
                 iterations = df_get_number_of_iterations(dbus_method.signature);
                 iterations = CLAMP(iterations, df_min_iterations, df_max_iterations);
 
-                // tests for method
-                ret = df_fuzz_test_method(
-                                &dbus_method,
-                                name,
-                                object,
-                                interface,
-                                df_pid,
-                                df_execute_cmd,
-                                iterations);
+                resumed = df_journal_lookup(df_journal, DF_JOURNAL_METHOD, object, interface, m->name, &ret);
+                if (resumed)
+                        df_verbose("%s  %sDONE%s [M] %s - tested in a previous run%s\n", ansi_cr(), ansi_blue(),
+                                   ansi_normal(), m->name,
+                                   ret == 0 ? "" : ret == 3 ? ", with warnings" : ", with failures");
+                else {
+                        // tests for method
+                        start_usec = g_get_monotonic_time();
+                        while ((ret = df_fuzz_test_method(
+                                                &dbus_method,
+                                                name,
+                                                object,
+                                                interface,
+                                                g_atomic_int_get(&df_target->pid),
+                                                df_command,
+                                                0,
+                                                iterations,
+                                                NULL)) == 5) {
+                                dproxy = safe_g_dbus_proxy_unref(dproxy);
+                                dproxy = df_reattach(dcon, name, object, interface);
+                                if (!dproxy)
+                                        return DF_BUS_ERROR;
+                        }
+                        if (ret >= 0 && df_journal &&
+                            df_journal_append(df_journal, DF_JOURNAL_METHOD, ret, iterations,
+                                              g_get_monotonic_time() - start_usec, object, interface, m->name) < 0)
+                                return DF_BUS_ERROR;
+                }
                 if (ret < 0) {
                         // error during testing method
                         df_debug("Error in df_fuzz_test_method()\n");
                         return DF_BUS_ERROR;
+                } else if (ret == 1 && !df_test_method && resumed) {
+                        // the process was restarted in the previous run
+                        rv = DF_BUS_FAIL;
                 } else if (ret == 1 && !df_test_method) {
                         // launch process again after crash
                         rv = DF_BUS_FAIL;
                         dproxy = safe_g_dbus_proxy_unref(dproxy);
-
-                        if (!df_is_valid_dbus(name, object, interface))
-                                return DF_BUS_ERROR;
-
-                        dproxy = df_bus_new(dcon, name, object, interface,
-                                            G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
+                        dproxy = df_reconnect(dcon, name, object, interface);
                         if (!dproxy)
                                 return DF_BUS_ERROR;
-
-                        sleep(5);
-
-                        // gets pid of tested process
-                        df_pid = df_get_pid(dcon, FALSE);
-                        if (df_pid < 0) {
-                                df_debug("Error in df_get_pid() on getting pid of process\n");
-                                return DF_BUS_ERROR;
-                        }
-                        fprintf(stderr, "%s%s[RE-CONNECTED TO PID: %d]%s\n",
-                                        ansi_cr(), ansi_cyan(), df_pid, ansi_blue());
-
-                        if (df_fuzz_init(dproxy) < 0) {
-                                df_debug("Error in df_fuzz_add_proxy()\n");
-                                return DF_BUS_ERROR;
-                        }
                 } else if (ret == 1 && df_test_method) {
                         // for one method, testing ends with failure
                         rv = DF_BUS_FAIL;
@@ -409,80 +642,115 @@ static int df_fuzz(GDBusConnection *dcon, const char *name, const char *object,
                 return DF_BUS_ERROR;
         }
 
+        if (!schedule && df_journal &&
+            df_journal_append(df_journal, DF_JOURNAL_INTERFACE, rv, 0, 0, object, interface, NULL) < 0)
+                return DF_BUS_ERROR;
+
         return rv;
 }
 
+/** (object, interface) pair queued to be fuzzed by one of the workers */
+typedef struct df_fuzz_job {
+        char *object;
+        char *interface;
+        /** Proxy of the interface used by the scheduler, NULL if it has to be
+          * (re)created */
+        GDBusProxy *proxy;
+} df_fuzz_job_t;
+
+static df_fuzz_job_t *df_fuzz_job_new(const char *object, const char *interface)
+{
+        df_fuzz_job_t *job;
+
+        job = calloc(1, sizeof(*job));
+        if (!job)
+                return NULL;
+
+        job->object = strdup(object);
+        job->interface = strdup(interface);
+        if (!job->object || !job->interface) {
+                free(job->object);
+                free(job->interface);
+                free(job);
+                return NULL;
+        }
+
+        return job;
+}
+
+static void df_fuzz_job_free(df_fuzz_job_t *job)
+{
+        if (!job)
+                return;
+
+        free(job->object);
+        free(job->interface);
+        safe_g_dbus_proxy_unref(job->proxy);
+        free(job);
+}
+
+/**
+ * @function Merges result of a single fuzzing run into the overall result.
+ * Errors take precedence over everything else, failures over remaining
+ * non-OK results.
+ * @param ret Overall result so far
+ * @param r Result to merge
+ * @return Merged result
+ */
+static int df_merge_results(int ret, int r)
+{
+        if (ret == DF_BUS_ERROR || r == DF_BUS_ERROR)
+                return DF_BUS_ERROR;
+        if (ret != DF_BUS_FAIL && r != DF_BUS_OK)
+                return r;
+
+        return ret;
+}
+
 /**
  * @function Traverses through all interfaces and objects of bus
- * name target_proc.name and for each interface it calls df_fuzz()
- * to fuzz test all its methods.
+ * name df_target->name and queues each interface as a job to be fuzzed
+ * later, so the whole work list is known before fuzzing begins.
  * @param dcon D-Bus connection structure
  * @param root_node Starting object path (all nodes from this object path
  * will be traversed)
- * @return 0 on success, 1 on error, 2 when testing detected any failures
- * or warnings, 3 on warnings
+ * @param jobs Queue of df_fuzz_job_t jobs to fill
+ * @return 0 on success, 1 on error
  */
-static int df_traverse_node(GDBusConnection *dcon, const char *root_node)
+static int df_traverse_node(GDBusConnection *dcon, const char *root_node, GAsyncQueue *jobs)
 {
         char *intro_iface = "org.freedesktop.DBus.Introspectable";
-        char *intro_method = "Introspect";
-        g_autoptr(GVariant) response = NULL;
-        g_autoptr(GDBusProxy) dproxy = NULL;
-        g_autoptr(gchar) introspection_xml = NULL;
-        g_autoptr(GError) error = NULL;
         /** Information about nodes in a remote object hierarchy. */
         g_autoptr(GDBusNodeInfo) node_data = NULL;
-        /** Return values */
-        int rd = 0;          // return value from df_fuzz()
-        int rt = 0;          // return value from recursive transition
-        int ret = DF_BUS_OK; // return value of this function
-
-
-        if (!df_is_valid_dbus(target_proc.name, root_node, intro_iface))
-                return DF_BUS_ERROR;
-
-        dproxy = df_bus_new(dcon, target_proc.name, root_node, intro_iface,
-                            G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
-        if (!dproxy)
-                return DF_BUS_ERROR;
+        int r;
 
-        response = df_bus_call(dproxy, intro_method, NULL, G_DBUS_CALL_FLAGS_NONE);
-        if (!response)
-                return DF_BUS_ERROR;
 
-        g_variant_get(response, "(s)", &introspection_xml);
-        if (!introspection_xml) {
-                df_fail("Error: Unable to get introspection data from GVariant.\n");
+        if (!df_is_valid_dbus(df_target->name, root_node, intro_iface))
                 return DF_BUS_ERROR;
-        }
 
-        // Parses introspection_xml and returns a GDBusNodeInfo representing
-        // the data.
-        node_data = g_dbus_node_info_new_for_xml(introspection_xml, &error);
-        if (!node_data) {
-                df_fail("Error: Unable to get introspection data.\n");
-                df_error("Error in g_dbus_node_info_new_for_xml()", error);
+        // The data is cached, so df_fuzz() doesn't need to introspect
+        // the object again
+        node_data = df_introspect(dcon, df_target->name, root_node);
+        if (!node_data)
                 return DF_BUS_ERROR;
-        }
 
         // go through all interfaces
         STRV_FOREACH(interface, node_data->interfaces) {
-                fprintf(stderr, " Interface: %s%s%s\n",
-                        ansi_bold(), interface->name, ansi_normal());
-                // start fuzzing on the target_proc.name
-                rd = df_fuzz(dcon, target_proc.name, root_node, interface->name);
-                if (rd == DF_BUS_ERROR)
+                df_fuzz_job_t *job;
+
+                job = df_fuzz_job_new(root_node, interface->name);
+                if (!job) {
+                        df_fail("Error: Could not allocate memory for a fuzzing job.\n");
                         return DF_BUS_ERROR;
-                else if (ret != DF_BUS_FAIL) {
-                        if (rd != DF_BUS_OK)
-                                ret = rd;
                 }
+
+                g_async_queue_push(jobs, job);
         }
 
         // if object path was set as dfuzzer option, do not traverse
         // through all objects
         if (strlen(target_proc.obj_path) != 0)
-                return ret;
+                return DF_BUS_OK;
 
         // go through all nodes
         STRV_FOREACH(node, node_data->nodes) {
@@ -493,89 +761,555 @@ static int df_traverse_node(GDBusConnection *dcon, const char *root_node)
                         df_fail("Error: Could not allocate memory for root_node string.\n");
                         return DF_BUS_ERROR;
                 }
-                fprintf(stderr, "Object: %s%s%s\n", ansi_bold(), object, ansi_normal());
-                rt = df_traverse_node(dcon, object);
-                if (rt == DF_BUS_ERROR)
+                r = df_traverse_node(dcon, object, jobs);
+                if (r == DF_BUS_ERROR)
+                        return DF_BUS_ERROR;
+        }
+
+        return DF_BUS_OK;
+}
+
+/**
+ * @function Fuzzes all queued jobs one by one over the connection dcon.
+ * @param dcon D-Bus connection structure
+ * @param jobs Queue of df_fuzz_job_t jobs
+ * @return Merged DF_BUS_* result of all jobs
+ */
+static int df_fuzz_jobs(GDBusConnection *dcon, GAsyncQueue *jobs)
+{
+        df_fuzz_job_t *job;
+        int r, ret = DF_BUS_OK;
+
+        while ((job = g_async_queue_try_pop(jobs))) {
+                fprintf(stderr, "Object: %s%s%s\n", ansi_bold(), job->object, ansi_normal());
+                fprintf(stderr, " Interface: %s%s%s\n", ansi_bold(), job->interface, ansi_normal());
+
+                r = df_fuzz(dcon, df_target->name, job->object, job->interface, NULL, NULL);
+                df_fuzz_job_free(job);
+
+                ret = df_merge_results(ret, r);
+                if (ret == DF_BUS_ERROR)
                         return DF_BUS_ERROR;
-                else if (ret != DF_BUS_FAIL) {
-                        if (rt != DF_BUS_OK)
-                                ret = rt;
-                }
         }
 
         return ret;
 }
 
-static void df_print_process_info(int pid)
+/** Idle private connections of finished workers, one queue per bus, so the
+  * workers of the next target of a batch don't have to connect again */
+static GAsyncQueue *df_idle_connections[2];
+
+static void df_connection_free(GDBusConnection *dcon)
 {
-        char proc_path[15 + DECIMAL_STR_MAX(int)]; // "/proc/(int)/[exe|cmdline]"
-        char name[PATH_MAX + 1];
-        g_auto(fd_t) fd = -1;
-        int ret;
+        (void) g_dbus_connection_close_sync(dcon, NULL, NULL);
+        g_object_unref(dcon);
+}
 
-        sprintf(proc_path, "/proc/%d/exe", pid);
-        ret = readlink(proc_path, name, PATH_MAX);
-        if (ret > 0) {
-                name[ret] = '\0';
+static GAsyncQueue *df_idle_connections_get(GBusType bus_type)
+{
+        return df_idle_connections[bus_type == G_BUS_TYPE_SYSTEM];
+}
 
-                if (ret == PATH_MAX)
-                        df_verbose("The process name was truncated\n");
+/**
+ * @function Takes an idle private connection to the bus, or opens a new one
+ * @return Connection on success (give it back via df_connection_release()),
+ * NULL on error
+ */
+static GDBusConnection *df_connection_acquire(GBusType bus_type)
+{
+        GDBusConnection *dcon;
 
-                if (!strstr(name, "python") && !strstr(name, "perl")) {
-                        fprintf(stderr, "%s%s[PROCESS: %s]%s\n",
-                                ansi_cr(), ansi_cyan(), name, ansi_normal());
-                        return;
-                }
+        while ((dcon = g_async_queue_try_pop(df_idle_connections_get(bus_type)))) {
+                if (!g_dbus_connection_is_closed(dcon))
+                        return dcon;
+
+                g_object_unref(dcon);
         }
 
-        // if readlink failed or executable was interpret (and our target is
-        // interpreted script), try to read cmdline
-        sprintf(proc_path, "/proc/%d/cmdline", pid);
-        fd = open(proc_path, O_RDONLY);
-        if (fd <= 0) {
-                perror("open");
-                return;
+        return df_bus_new_private_connection(bus_type);
+}
+
+static void df_connection_release(GBusType bus_type, GDBusConnection *dcon)
+{
+        g_async_queue_push(df_idle_connections_get(bus_type), dcon);
+}
+
+/** State shared by all workers */
+typedef struct df_worker_pool {
+        GBusType bus_type;
+        /** Target the jobs belong to */
+        df_target_t *target;
+        /** Queue of df_fuzz_job_t jobs; it's completely filled before the
+          * workers are started */
+        GAsyncQueue *jobs;
+        /** Crashes of the target noticed by the workers, so only one of them
+          * reports each crash and restarts the target */
+        df_crash_guard_t *crash_guard;
+        GMutex lock;
+        /** Merged results of all finished jobs, protected by lock */
+        int result;
+} df_worker_pool_t;
+
+/**
+ * @function Worker thread: takes jobs from the shared queue and fuzzes them
+ * over its own private bus connection (so each worker has its own proxy and
+ * reply processing) until the queue is empty or any worker hits an error.
+ * The output of each job is written at once, so it's not interleaved with
+ * the output of the jobs of the other workers.
+ * @param user_data Pointer to the df_worker_pool_t structure
+ * @return Always NULL
+ */
+static gpointer df_worker_run(gpointer user_data)
+{
+        df_worker_pool_t *pool = user_data;
+        GDBusConnection *dcon;
+        df_fuzz_job_t *job;
+
+        df_target = pool->target;
+
+        dcon = df_connection_acquire(pool->bus_type);
+        if (!dcon) {
+                g_mutex_lock(&pool->lock);
+                pool->result = DF_BUS_ERROR;
+                g_mutex_unlock(&pool->lock);
+                return NULL;
         }
 
-        for (int i = 0;; i++) {
-                if (i >= PATH_MAX) {
-                        df_verbose("The process name was truncated\n");
-                        name[PATH_MAX] = '\0';
+        df_fuzz_set_crash_guard(pool->crash_guard);
+
+        while ((job = g_async_queue_try_pop(pool->jobs))) {
+                int r;
+
+                g_mutex_lock(&pool->lock);
+                r = pool->result;
+                g_mutex_unlock(&pool->lock);
+                if (r == DF_BUS_ERROR) {
+                        df_fuzz_job_free(job);
                         break;
                 }
 
-                ret = read(fd, (name + i), 1);
-                if (ret < 0) {
-                        perror("read");
-                        return;
-                }
+                df_log_begin_record();
+                df_fail("Object: %s%s%s\n", ansi_bold(), job->object, ansi_normal());
+                df_fail(" Interface: %s%s%s\n", ansi_bold(), job->interface, ansi_normal());
 
-                if (name[i] == '\0')
-                        break;
+                r = df_fuzz(dcon, df_target->name, job->object, job->interface, NULL, NULL);
+                df_fuzz_job_free(job);
+                /* Don't keep the other workers waiting if the job didn't get to
+                 * restarting the target after reporting its crash */
+                df_fuzz_crash_handled();
+                df_log_end_record();
+
+                g_mutex_lock(&pool->lock);
+                pool->result = df_merge_results(pool->result, r);
+                g_mutex_unlock(&pool->lock);
         }
 
-        fprintf(stderr, "%s%s[PROCESS: %s]%s\n",
-                ansi_cr(), ansi_cyan(), name, ansi_normal());
+        df_fuzz_release_properties_proxy();
+        df_connection_release(pool->bus_type, dcon);
+        df_fuzz_set_crash_guard(NULL);
+
+        return NULL;
 }
 
-static void df_print_help(const char *name)
+/**
+ * @function Fuzzes all queued jobs using df_jobs worker threads.
+ * @param bus_type Bus the workers connect to
+ * @param jobs Queue of df_fuzz_job_t jobs
+ * @return Merged DF_BUS_* result of all jobs
+ */
+static int df_run_workers(GBusType bus_type, GAsyncQueue *jobs)
 {
-        printf(
-         "Usage: %1$s -n BUS_NAME [OTHER_OPTIONS]\n\n"
-         "Tool for fuzz testing processes communicating through D-Bus.\n"
-         "The fuzzer traverses through all the methods on the given bus name.\n"
-         "By default only failures and warnings are printed."
-         " Use -v for verbose mode.\n\n"
-         "REQUIRED OPTIONS:\n"
-         "  -n --bus=BUS_NAME           D-Bus service name.\n\n"
-         "OTHER OPTIONS:\n"
-         "  -V --version                Show dfuzzer version and exit.\n"
-         "  -h --help                   Show this help text.\n"
-         "  -l --list                   List all available services on both buses.\n"
-         "  -v --verbose                Be more verbose.\n"
+        df_worker_pool_t pool = {
+                .bus_type = bus_type,
+                .target = df_target,
+                .jobs = jobs,
+                .result = DF_BUS_OK,
+        };
+        g_autoptr(df_crash_guard_t) crash_guard = NULL;
+        GThread *threads[DF_MAX_JOBS];
+        guint n_threads;
+
+        n_threads = MIN(df_jobs, (guint) g_async_queue_length(jobs));
+        if (n_threads == 0)
+                return DF_BUS_OK;
+
+        crash_guard = df_crash_guard_new();
+        if (!crash_guard)
+                return df_fail_ret(DF_BUS_ERROR, "Error: Could not allocate memory for the workers.\n");
+        pool.crash_guard = crash_guard;
+
+        df_verbose("Fuzzing %d interface(s) using %u worker(s)\n", g_async_queue_length(jobs), n_threads);
+
+        g_mutex_init(&pool.lock);
+
+        for (guint i = 0; i < n_threads; i++)
+                threads[i] = g_thread_new("dfuzzer-worker", df_worker_run, &pool);
+        for (guint i = 0; i < n_threads; i++)
+                g_thread_join(threads[i]);
+
+        g_mutex_clear(&pool.lock);
+
+        return pool.result;
+}
+
+/**
+ * @function Fuzzes all interfaces under root_node (or just the given one)
+ * within the global budget: properties are tested right away, methods of all
+ * the interfaces are then tested in slices picked by the scheduler, leaving
+ * more iterations for the methods that keep producing new errors (or
+ * coverage) and fewer for the ones rejecting all inputs.
+ * @param dcon D-Bus connection structure
+ * @param root_node Starting object path (or the object path of interface)
+ * @param interface Interface to test, NULL to traverse the whole tree
+ * @return DF_BUS_* result
+ */
+static int df_fuzz_scheduled(GDBusConnection *dcon, const char *root_node, const char *interface)
+{
+        g_autoptr(GAsyncQueue) jobs = NULL;
+        g_autoptr(GPtrArray) targets = NULL;
+        g_autoptr(df_schedule_t) schedule = NULL;
+        df_schedule_entry_t *entry;
+        df_fuzz_job_t *job;
+        guint64 iterations;
+        int r, rv = DF_BUS_OK;
+
+        jobs = g_async_queue_new_full((GDestroyNotify) df_fuzz_job_free);
+        if (interface) {
+                job = df_fuzz_job_new(root_node, interface);
+                if (!job) {
+                        df_fail("Error: Could not allocate memory for a fuzzing job.\n");
+                        return DF_BUS_ERROR;
+                }
+
+                g_async_queue_push(jobs, job);
+        } else {
+                r = df_traverse_node(dcon, root_node, jobs);
+                if (r == DF_BUS_ERROR)
+                        return r;
+        }
+
+        schedule = df_schedule_new(df_budget, df_time_budget, df_min_iterations, df_max_iterations);
+        if (!schedule)
+                return df_fail_ret(DF_BUS_ERROR, "Error: Could not allocate memory for the scheduler.\n");
+
+        /* The scheduled methods point to their jobs, so keep them around */
+        targets = g_ptr_array_new_with_free_func((GDestroyNotify) df_fuzz_job_free);
+        while ((job = g_async_queue_try_pop(jobs))) {
+                g_ptr_array_add(targets, job);
+
+                fprintf(stderr, "Object: %s%s%s\n", ansi_bold(), job->object, ansi_normal());
+                fprintf(stderr, " Interface: %s%s%s\n", ansi_bold(), job->interface, ansi_normal());
+
+                r = df_fuzz(dcon, df_target->name, job->object, job->interface, schedule, job);
+                rv = df_merge_results(rv, r);
+                if (rv == DF_BUS_ERROR)
+                        return rv;
+        }
+
+        df_verbose("Scheduling %u method(s) of %u interface(s)\n", schedule->entries->len, targets->len);
+
+        while ((entry = df_schedule_next(schedule, &iterations))) {
+                job = entry->target;
+
+                if (!job->proxy) {
+                        job->proxy = df_bus_new(dcon, df_target->name, job->object, job->interface,
+                                                G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
+                        if (!job->proxy)
+                                return DF_BUS_ERROR;
+                }
+
+                if (df_fuzz_init(job->proxy) < 0) {
+                        df_debug("Error in df_fuzz_add_proxy()\n");
+                        return DF_BUS_ERROR;
+                }
+
+                r = df_fuzz_test_method(
+                                &entry->method,
+                                df_target->name,
+                                job->object,
+                                job->interface,
+                                g_atomic_int_get(&df_target->pid),
+                                df_command,
+                                entry->next,
+                                iterations,
+                                &entry->stats);
+                df_schedule_update(schedule, entry);
+                if (r < 0) {
+                        df_debug("Error in df_fuzz_test_method()\n");
+                        return DF_BUS_ERROR;
+                }
+
+                /* Don't retest methods which already failed */
+                if (r > 0)
+                        entry->done = TRUE;
+
+                if (r == 1) {
+                        rv = df_merge_results(rv, DF_BUS_FAIL);
+
+                        /* All the proxies refer to the crashed process */
+                        for (guint i = 0; i < targets->len; i++) {
+                                df_fuzz_job_t *t = g_ptr_array_index(targets, i);
+
+                                t->proxy = safe_g_dbus_proxy_unref(t->proxy);
+                        }
+
+                        job->proxy = df_reconnect(dcon, df_target->name, job->object, job->interface);
+                        if (!job->proxy)
+                                return DF_BUS_ERROR;
+                } else if (r == 2 || r == 4)
+                        rv = df_merge_results(rv, DF_BUS_FAIL);
+                else if (r == 3)
+                        rv = df_merge_results(rv, DF_BUS_WARNING);
+        }
+
+        df_schedule_log_stats(schedule);
+
+        return rv;
+}
+
+/**
+ * @function Fuzzes all objects and interfaces in the tree under root_node,
+ * either directly or by running the jobs in parallel if more than one worker
+ * was requested.
+ * @param dcon D-Bus connection structure
+ * @param bus_type Bus type of the connection (for the private connections of
+ * the workers)
+ * @param root_node Starting object path
+ * @return DF_BUS_* result
+ */
+static int df_fuzz_tree(GDBusConnection *dcon, GBusType bus_type, const char *root_node)
+{
+        g_autoptr(GAsyncQueue) jobs = NULL;
+        int r;
+
+        // Discover the whole tree asynchronously first, the traversal then
+        // just walks the cached data
+        if (isempty(target_proc.obj_path) &&
+            df_introspect_tree(dcon, df_target->name, root_node, df_discovery_inflight) < 0)
+                return DF_BUS_ERROR;
+
+        if (df_budget > 0 || df_time_budget > 0)
+                return df_fuzz_scheduled(dcon, root_node, NULL);
+
+        jobs = g_async_queue_new_full((GDestroyNotify) df_fuzz_job_free);
+        r = df_traverse_node(dcon, root_node, jobs);
+        if (r == DF_BUS_ERROR)
+                return r;
+
+        if (df_jobs <= 1)
+                return df_fuzz_jobs(dcon, jobs);
+
+        return df_run_workers(bus_type, jobs);
+}
+
+/**
+ * @function Replays the loaded log records to the tested process and, with
+ * --bisect, looks for the shortest prefix of them which still kills it.
+ * Bisecting assumes the prefixes behave monotonically, i.e. if a prefix
+ * kills the process every longer one does as well; the process is restarted
+ * (or re-activated) after each probe which killed it.
+ * @param dcon D-Bus connection structure
+ * @return DF_BUS_OK if the process survived, DF_BUS_FAIL if it died,
+ * DF_BUS_ERROR on error
+ */
+static int df_replay(GDBusConnection *dcon)
+{
+        guint n = df_replay_records->len, lo = 0, hi, culprit;
+        int r;
+
+        fprintf(stderr, "%s%s[REPLAY: %u input(s)]%s\n", ansi_cr(), ansi_cyan(), n, ansi_normal());
+
+        r = df_replay_stream(dcon, df_target->name, g_atomic_int_get(&df_target->pid), df_replay_records, n, &culprit);
+        if (r < 0)
+                return DF_BUS_ERROR;
+        if (r == 0) {
+                df_verbose("%s  %sPASS%s process %d survived all %u input(s)\n",
+                           ansi_cr(), ansi_green(), ansi_normal(), g_atomic_int_get(&df_target->pid), n);
+                return DF_BUS_OK;
+        }
+
+        df_fail("%s  %sFAIL%s process %d exited after input #%u:\n",
+                ansi_cr(), ansi_red(), ansi_normal(), g_atomic_int_get(&df_target->pid), culprit + 1);
+        df_replay_print_record(g_ptr_array_index(df_replay_records, culprit));
+
+        if (!df_replay_bisect)
+                return DF_BUS_FAIL;
+
+        /* Invariant: the first hi inputs kill the process, the first lo don't */
+        hi = culprit + 1;
+        while (lo + 1 < hi) {
+                guint mid = lo + (hi - lo) / 2;
+
+                if (df_wait_for_restart(dcon, TRUE) < 0)
+                        return DF_BUS_ERROR;
+
+                r = df_replay_stream(dcon, df_target->name, g_atomic_int_get(&df_target->pid), df_replay_records, mid, &culprit);
+                if (r < 0)
+                        return DF_BUS_ERROR;
+
+                df_verbose("  First %u input(s): process %s\n", mid, r > 0 ? "exited" : "survived");
+                if (r > 0)
+                        hi = culprit + 1;
+                else
+                        lo = mid;
+        }
+
+        df_fail("%s  %sFAIL%s shortest prefix killing the process: %u input(s), ending with:\n",
+                ansi_cr(), ansi_red(), ansi_normal(), hi);
+        df_replay_print_record(g_ptr_array_index(df_replay_records, hi - 1));
+
+        return DF_BUS_FAIL;
+}
+
+/**
+ * @function Calls the method given by -t from --stress= clients at once
+ * instead of fuzzing it.
+ * @param dcon D-Bus connection structure
+ * @return DF_BUS_OK if the process survived, DF_BUS_FAIL if it died,
+ * DF_BUS_ERROR on error
+ */
+static int df_stress(GDBusConnection *dcon)
+{
+        g_autoptr(GDBusProxy) dproxy = NULL;
+        g_autoptr(GDBusNodeInfo) node_info = NULL;
+        g_autoptr(char) signature = NULL;
+        GDBusInterfaceInfo *interface_info = NULL;
+        GDBusMethodInfo *method;
+        df_stress_config_t config = {
+                .bus_type = df_target->bus_type,
+                .clients = df_stress_clients,
+                .rate = df_stress_rate,
+                .duration_sec = df_stress_duration,
+                .churn = df_stress_churn,
+                .generator = df_fuzz_get_generator(),
+        };
+        int r;
+
+        if (!df_is_valid_dbus(df_target->name, target_proc.obj_path, target_proc.interface))
+                return DF_BUS_ERROR;
+
+        dproxy = df_bus_new(dcon, df_target->name, target_proc.obj_path, target_proc.interface,
+                            G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
+        if (!dproxy)
+                return DF_BUS_ERROR;
+
+        node_info = df_get_interface_info(dproxy, target_proc.interface, &interface_info);
+        if (!node_info)
+                return DF_BUS_ERROR;
+
+        method = g_dbus_interface_info_lookup_method(interface_info, df_test_method);
+        if (!method)
+                return df_fail_ret(DF_BUS_ERROR, "Error: Method '%s' is not in the interface '%s'.\n",
+                                   df_test_method, target_proc.interface);
+
+        signature = df_method_get_full_signature(method);
+        if (!signature)
+                return df_fail_ret(DF_BUS_ERROR, "Error: Could not allocate memory for the method signature.\n");
+
+        /* The same inputs as when fuzzing the method */
+        config.seed = df_fuzz_member_seed(target_proc.obj_path, target_proc.interface, df_test_method);
+
+        r = df_stress_run(&config, df_target->name, target_proc.obj_path, target_proc.interface,
+                          df_test_method, signature, g_atomic_int_get(&df_target->pid));
+        if (r < 0)
+                return DF_BUS_ERROR;
+
+        return r > 0 ? DF_BUS_FAIL : DF_BUS_OK;
+}
+
+static void df_print_process_info(int pid)
+{
+        char proc_path[15 + DECIMAL_STR_MAX(int)]; // "/proc/(int)/[exe|cmdline]"
+        char name[PATH_MAX + 1];
+        g_auto(fd_t) fd = -1;
+        int ret;
+
+        sprintf(proc_path, "/proc/%d/exe", pid);
+        ret = readlink(proc_path, name, PATH_MAX);
+        if (ret > 0) {
+                name[ret] = '\0';
+
+                if (ret == PATH_MAX)
+                        df_verbose("The process name was truncated\n");
+
+                if (!strstr(name, "python") && !strstr(name, "perl")) {
+                        fprintf(stderr, "%s%s[PROCESS: %s]%s\n",
+                                ansi_cr(), ansi_cyan(), name, ansi_normal());
+                        return;
+                }
+        }
+
+        // if readlink failed or executable was interpret (and our target is
+        // interpreted script), try to read cmdline
+        sprintf(proc_path, "/proc/%d/cmdline", pid);
+        fd = open(proc_path, O_RDONLY);
+        if (fd <= 0) {
+                perror("open");
+                return;
+        }
+
+        for (int i = 0;; i++) {
+                if (i >= PATH_MAX) {
+                        df_verbose("The process name was truncated\n");
+                        name[PATH_MAX] = '\0';
+                        break;
+                }
+
+                ret = read(fd, (name + i), 1);
+                if (ret < 0) {
+                        perror("read");
+                        return;
+                }
+
+                if (name[i] == '\0')
+                        break;
+        }
+
+        fprintf(stderr, "%s%s[PROCESS: %s]%s\n",
+                ansi_cr(), ansi_cyan(), name, ansi_normal());
+}
+
+static void df_print_help(const char *name)
+{
+        printf(
+         "Usage: %1$s -n BUS_NAME [OTHER_OPTIONS]\n"
+         "       %1$s --targets=FILENAME|--all [OTHER_OPTIONS]\n\n"
+         "Tool for fuzz testing processes communicating through D-Bus.\n"
+         "The fuzzer traverses through all the methods on the given bus name.\n"
+         "By default only failures and warnings are printed."
+         " Use -v for verbose mode.\n\n"
+         "REQUIRED OPTIONS:\n"
+         "  -n --bus=BUS_NAME           D-Bus service name.\n"
+         "     --targets=FILENAME       Instead of -n, test all bus names listed in FILENAME (one per line,\n"
+         "                              empty lines and lines starting with '#' are ignored) on the\n"
+         "                              bus(es) they are available on, and report the results of all\n"
+         "                              of them at the end.\n"
+         "     --all                    Same as --targets=, but test all well-known names on both buses\n"
+         "                              except org.freedesktop.DBus, including the activatable ones.\n\n"
+         "OTHER OPTIONS:\n"
+         "  -V --version                Show dfuzzer version and exit.\n"
+         "  -h --help                   Show this help text.\n"
+         "  -l --list                   List all available services on both buses.\n"
+         "  -v --verbose                Be more verbose.\n"
          "  -d --debug                  Enable debug logging; implies -v.\n"
-         "  -L --log-dir=DIRNAME        Write full, parseable log into DIRNAME/BUS_NAME.\n"
-         "                              The directory must already exist.\n"
+         "  -L --log-dir=DIRNAME        Write full, parseable log into DIRNAME/BUS_NAME (for each of the\n"
+         "                              tested bus names in batch mode).\n"
+         "                              The directory must already exist. Finished work is recorded\n"
+         "                              in the journal DIRNAME/BUS_NAME.journal.\n"
+         "     --resume                 Skip the work recorded in the journal of an interrupted run,\n"
+         "                              with the same seed. Requires -L/--log-dir=.\n"
+         "     --log-format=FORMAT      Format of the -L log: 'text' or 'binary'. The binary log\n"
+         "                              stores serialized values and is much faster to write.\n"
+         "                              Default: text.\n"
+         "     --decode-log=FILENAME    Convert a binary log into the text form and exit.\n"
+         "     --replay=FILENAME        Instead of fuzzing send the calls logged via -L (in any format)\n"
+         "                              to the service again, in order. Use -o/-i/-t to replay\n"
+         "                              only some of them.\n"
+         "     --bisect                 With --replay=, find the shortest prefix of the calls which\n"
+         "                              still kills the service.\n"
+         "     --introspection-cache    Keep the introspection data of the service in\n"
+         "                              DIRNAME/BUS_NAME.BUS.introspection (requires -L) and reuse it\n"
+         "                              in the next runs instead of introspecting all objects again.\n"
          "  -s --no-suppressions        Don't load suppression file(s).\n"
          "  -o --object=OBJECT_PATH     Optional object path to test. All children objects are traversed.\n"
          "  -i --interface=INTERFACE    Interface to test. Requires -o to be set as well.\n"
@@ -598,8 +1332,66 @@ static void df_print_help(const char *name)
          "                              See --max-iterations= and --min-iterations= above\n"
          "  -e --command=COMMAND        Command/script to execute after each method call.\n"
          "     --show-command-output    Don't suppress stdout/stderr of a COMMAND.\n"
+         "     --command-interval=N|end Execute COMMAND only after every N method calls, or with 'end'\n"
+         "                              after the last call of each method. When it fails, the batch\n"
+         "                              of calls since the last check is bisected to find the input\n"
+         "                              COMMAND started to fail after. Default: 1.\n"
+         "     --command-coprocess      Start COMMAND only once and keep it running: for each check\n"
+         "                              it reads a line with 'OBJECT INTERFACE METHOD ITERATION' on\n"
+         "                              stdin and writes a line with its exit status to stdout.\n"
          "  -f --dictionary=FILENAME    Name of a file with custom dictionary which is used as input\n"
          "                              for fuzzed methods before generating random data.\n"
+         "  -j --jobs=N                 Fuzz up to N objects/interfaces in parallel, each over its own\n"
+         "                              bus connection. Default: 1, maximum: 256.\n"
+         "     --inflight=N             Maximum number of method calls in flight at once.\n"
+         "                              Default: 1 (no pipelining), maximum: 1024.\n"
+         "     --call-timeout=MSEC      Timeout of each method call in milliseconds.\n"
+         "                              Default: 25000 (the D-Bus default).\n"
+         "     --discovery-inflight=N   Maximum number of Introspect calls in flight while discovering\n"
+         "                              the object tree. Default: 32, maximum: 1024.\n"
+         "     --seed=SEED              Seed for the generated data. Default: random.\n"
+         "     --generator=BACKEND      How generated values are constructed: 'variant' builds them\n"
+         "                              from GVariant instances, 'wire' serializes them directly.\n"
+         "                              Both generate the same values. Default: variant.\n"
+         "     --generator-threads=N    Generate the inputs of each method ahead on N threads, while\n"
+         "                              the calls are made. The inputs stay the same. Default: 0\n"
+         "                              (between the calls), maximum: 64.\n"
+         "     --message-size=SIZE      Spread SIZE bytes over the containers of each signature, so\n"
+         "                              the generated messages fill it without going over it.\n"
+         "                              Default: no limit, range: 4096 to 134217728 (128M).\n"
+         "     --coverage=NAME          Use coverage feedback from the shared memory object NAME\n"
+         "                              exported by libdfuzzer-cov.so in the tested process.\n"
+         "     --coverage-plateau=N     With --coverage, stop testing a method after N iterations\n"
+         "                              without new coverage. Default: 200.\n"
+         "     --mutate                 Keep inputs which got past the argument validation of a method\n"
+         "                              (a success or an error other than InvalidArgs) and mutate them\n"
+         "                              in a type-aware way half of the time. With --coverage=, inputs\n"
+         "                              reaching new code are kept instead.\n"
+         "     --stress=K               Instead of fuzzing call the method given by -t from K clients\n"
+         "                              at once, each over its own connection, ramping the rate up in\n"
+         "                              10 steps, and report the achieved rate and the step the\n"
+         "                              service started timing out in; the calls time out after\n"
+         "                              a step unless --call-timeout= is set. Maximum: 256.\n"
+         "     --stress-rate=QPS        Peak rate of the --stress= calls over all clients.\n"
+         "                              Default: 0 (as fast as possible).\n"
+         "     --stress-duration=SEC    Duration of the --stress= run in seconds. Default: 10.\n"
+         "     --stress-churn           With --stress=, subscribe to and unsubscribe from a signal\n"
+         "                              after each call, so the bus adds and removes match rules.\n"
+         "     --budget=CALLS           Test the methods of all interfaces in slices within a global\n"
+         "                              budget of CALLS calls, moving iterations from methods which\n"
+         "                              reject all inputs to the ones producing new errors.\n"
+         "                              Can't be used together with -j/--jobs=.\n"
+         "     --time-budget=SECONDS    Same as --budget=, but with a global time budget.\n"
+         "     --harness=COMMAND        Start the service as COMMAND on a private bus (instead of testing\n"
+         "                              an already running one) and keep a spare instance waiting for\n"
+         "                              the bus name, so it takes over right after a crash.\n"
+         "     --parallel-targets=N     With --targets= or --all, test up to N bus names in parallel;\n"
+         "                              each of them still uses -j/--jobs= workers. Can't be used\n"
+         "                              together with -L/--log-dir=. Default: 1, maximum: 256.\n"
+         "     --stats-interval=SEC     Print a status line with the number of calls, exceptions,\n"
+         "                              generated bytes, reconnects and latencies every SEC seconds.\n"
+         "     --metrics=FILE|unix:PATH Export the same counters in the OpenMetrics text format: rewrite\n"
+         "                              FILE periodically, or serve them on the unix socket PATH.\n"
          "\nExamples:\n\n"
          "Test all methods of GNOME Shell. Be verbose.\n"
          "# %1$s -v -n org.gnome.Shell\n\n"
@@ -623,7 +1415,37 @@ static void df_parse_parameters(int argc, char **argv)
                  * short variant */
                 ARG_SKIP_METHODS = 0x100,
                 ARG_SKIP_PROPERTIES,
-                ARG_SHOW_COMMAND_OUTPUT
+                ARG_SHOW_COMMAND_OUTPUT,
+                ARG_INFLIGHT,
+                ARG_SEED,
+                ARG_GENERATOR,
+                ARG_GENERATOR_THREADS,
+                ARG_MESSAGE_SIZE,
+                ARG_COVERAGE,
+                ARG_COVERAGE_PLATEAU,
+                ARG_BUDGET,
+                ARG_TIME_BUDGET,
+                ARG_LOG_FORMAT,
+                ARG_DECODE_LOG,
+                ARG_REPLAY,
+                ARG_BISECT,
+                ARG_INTROSPECTION_CACHE,
+                ARG_DISCOVERY_INFLIGHT,
+                ARG_CALL_TIMEOUT,
+                ARG_MUTATE,
+                ARG_TARGETS,
+                ARG_ALL,
+                ARG_PARALLEL_TARGETS,
+                ARG_HARNESS,
+                ARG_COMMAND_INTERVAL,
+                ARG_COMMAND_COPROCESS,
+                ARG_STATS_INTERVAL,
+                ARG_METRICS,
+                ARG_RESUME,
+                ARG_STRESS,
+                ARG_STRESS_RATE,
+                ARG_STRESS_DURATION,
+                ARG_STRESS_CHURN
         };
 
         static const struct option options[] = {
@@ -646,13 +1468,44 @@ static void df_parse_parameters(int argc, char **argv)
                 { "max-iterations",      required_argument,  NULL,   'x'                     },
                 { "min-iterations",      required_argument,  NULL,   'y'                     },
                 { "iterations",          required_argument,  NULL,   'I'                     },
+                { "jobs",                required_argument,  NULL,   'j'                     },
                 { "skip-methods",        no_argument,        NULL,   ARG_SKIP_METHODS        },
                 { "skip-properties",     no_argument,        NULL,   ARG_SKIP_PROPERTIES     },
                 { "show-command-output", no_argument,        NULL,   ARG_SHOW_COMMAND_OUTPUT },
+                { "inflight",            required_argument,  NULL,   ARG_INFLIGHT            },
+                { "seed",                required_argument,  NULL,   ARG_SEED                },
+                { "generator",           required_argument,  NULL,   ARG_GENERATOR           },
+                { "generator-threads",   required_argument,  NULL,   ARG_GENERATOR_THREADS   },
+                { "message-size",        required_argument,  NULL,   ARG_MESSAGE_SIZE        },
+                { "coverage",            required_argument,  NULL,   ARG_COVERAGE            },
+                { "coverage-plateau",    required_argument,  NULL,   ARG_COVERAGE_PLATEAU    },
+                { "budget",              required_argument,  NULL,   ARG_BUDGET              },
+                { "time-budget",         required_argument,  NULL,   ARG_TIME_BUDGET         },
+                { "log-format",          required_argument,  NULL,   ARG_LOG_FORMAT          },
+                { "decode-log",          required_argument,  NULL,   ARG_DECODE_LOG          },
+                { "replay",              required_argument,  NULL,   ARG_REPLAY              },
+                { "bisect",              no_argument,        NULL,   ARG_BISECT              },
+                { "introspection-cache", no_argument,        NULL,   ARG_INTROSPECTION_CACHE },
+                { "discovery-inflight",  required_argument,  NULL,   ARG_DISCOVERY_INFLIGHT  },
+                { "call-timeout",        required_argument,  NULL,   ARG_CALL_TIMEOUT        },
+                { "mutate",              no_argument,        NULL,   ARG_MUTATE              },
+                { "targets",             required_argument,  NULL,   ARG_TARGETS             },
+                { "all",                 no_argument,        NULL,   ARG_ALL                 },
+                { "parallel-targets",    required_argument,  NULL,   ARG_PARALLEL_TARGETS    },
+                { "harness",             required_argument,  NULL,   ARG_HARNESS             },
+                { "command-interval",    required_argument,  NULL,   ARG_COMMAND_INTERVAL    },
+                { "command-coprocess",   no_argument,        NULL,   ARG_COMMAND_COPROCESS   },
+                { "stats-interval",      required_argument,  NULL,   ARG_STATS_INTERVAL      },
+                { "metrics",             required_argument,  NULL,   ARG_METRICS             },
+                { "resume",              no_argument,        NULL,   ARG_RESUME              },
+                { "stress",              required_argument,  NULL,   ARG_STRESS              },
+                { "stress-rate",         required_argument,  NULL,   ARG_STRESS_RATE         },
+                { "stress-duration",     required_argument,  NULL,   ARG_STRESS_DURATION     },
+                { "stress-churn",        no_argument,        NULL,   ARG_STRESS_CHURN        },
                 {}
         };
 
-        while ((c = getopt_long(argc, argv, "n:o:i:m:b:t:e:L:x:y:f:I:p:sdvlhV", options, NULL)) >= 0) {
+        while ((c = getopt_long(argc, argv, "n:o:i:m:b:t:e:L:x:y:f:I:j:p:sdvlhV", options, NULL)) >= 0) {
                 switch (c) {
                         case 'n':
                                 if (strlen(optarg) >= MAX_OBJECT_PATH_LENGTH) {
@@ -792,6 +1645,23 @@ static void df_parse_parameters(int argc, char **argv)
                                 }
 
                                 break;
+                        case 'j': {
+                                guint64 jobs;
+
+                                r = safe_strtoull(optarg, &jobs);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option -%c: %s\n", c, strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (jobs < 1 || jobs > DF_MAX_JOBS) {
+                                        df_fail("Error: number of jobs must be in range [1, %d]\n", DF_MAX_JOBS);
+                                        exit(1);
+                                }
+
+                                df_jobs = jobs;
+                                break;
+                        }
                         case ARG_SKIP_METHODS:
                                 df_skip_methods = TRUE;
                                 break;
@@ -799,138 +1669,1008 @@ static void df_parse_parameters(int argc, char **argv)
                                 df_skip_properties = TRUE;
                                 break;
                         case ARG_SHOW_COMMAND_OUTPUT:
-                                df_fuzz_set_show_command_output(TRUE);
+                                df_show_command_output = TRUE;
                                 break;
-                        default:    // '?'
-                                exit(1);
-                                break;
-                }
-        }
-
-        if (isempty(target_proc.name) && !df_list_names) {
-                df_fail("Error: Connection name is required!\nSee -h for help.\n");
-                exit(1);
-        }
+                        case ARG_INFLIGHT: {
+                                guint64 inflight;
 
-        if (!isempty(target_proc.interface) && isempty(target_proc.obj_path)) {
-                df_fail("Error: Object path is required if interface specified!\nSee -h for help.\n");
-                exit(1);
-        }
+                                r = safe_strtoull(optarg, &inflight);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --inflight: %s\n", strerror(-r));
+                                        exit(1);
+                                }
 
-        if (df_min_iterations > df_max_iterations) {
-                df_fail("Error: minimal # of iterations can't be larger that the max one.\n");
-                exit(1);
-        }
+                                if (inflight < 1 || inflight > MAX_INFLIGHT_CALLS) {
+                                        df_fail("Error: number of calls in flight must be in range [1, %d]\n", MAX_INFLIGHT_CALLS);
+                                        exit(1);
+                                }
 
-        if (df_test_method && df_test_property) {
-                df_fail("Error: -t/--method= and -p/--property= are mutually exclusive.\n");
-                exit(1);
-        }
-}
+                                df_fuzz_set_inflight(inflight);
+                                break;
+                        }
+                        case ARG_SEED: {
+                                guint64 seed;
 
-static int df_process_bus(GBusType bus_type)
-{
-        g_autoptr(GDBusConnection) dcon = NULL;
-        g_autoptr(GError) error = NULL;
+                                r = safe_strtoull(optarg, &seed);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --seed: %s\n", strerror(-r));
+                                        exit(1);
+                                }
 
-        switch (bus_type) {
-        case G_BUS_TYPE_SESSION:
-                fprintf(stderr, "%s%s[SESSION BUS]%s\n", ansi_cr(), ansi_cyan(), ansi_normal());
-                break;
-        case G_BUS_TYPE_SYSTEM:
-                fprintf(stderr, "%s%s[SYSTEM BUS]%s\n", ansi_cr(), ansi_cyan(), ansi_normal());
-                break;
-        default:
-                df_fail("Invalid bus type\n");
-                return DF_BUS_ERROR;
-        }
+                                df_fuzz_set_seed(seed);
+                                df_seed_set = TRUE;
+                                break;
+                        }
+                        case ARG_GENERATOR: {
+                                df_plan_backend_t backend;
 
-        dcon = g_bus_get_sync(bus_type, NULL, &error);
-        if (!dcon) {
-                df_fail("Bus not found.\n");
-                df_error("Error in g_bus_get_sync()", error);
-                return DF_BUS_SKIP;
-        }
+                                backend = df_plan_backend_from_string(optarg);
+                                if (backend == _DF_PLAN_BACKEND_MAX) {
+                                        df_fail("Error: invalid value for option --generator: %s\n", optarg);
+                                        exit(1);
+                                }
 
-        if (df_list_names) {
-                // list names on the bus
-                if (df_list_bus_names(dcon) == -1) {
-                        df_debug("Error in df_list_bus_names() for session bus\n");
-                        return DF_BUS_ERROR;
-                }
-        } else {
-                // gets pid of tested process
-                df_pid = df_get_pid(dcon, TRUE);
-                if (df_pid > 0) {
-                        df_print_process_info(df_pid);
-                        fprintf(stderr, "%s%s[CONNECTED TO PID: %d]%s\n", ansi_cr(), ansi_cyan(), df_pid, ansi_normal());
-                        if (!isempty(target_proc.interface)) {
-                                fprintf(stderr, "Object: %s%s%s\n", ansi_bold(), target_proc.obj_path, ansi_normal());
-                                fprintf(stderr, " Interface: %s%s%s\n", ansi_bold(), target_proc.interface, ansi_normal());
-                                return df_fuzz(dcon, target_proc.name, target_proc.obj_path, target_proc.interface);
-                        } else if (!isempty(target_proc.obj_path)) {
-                                fprintf(stderr, "Object: %s%s%s\n", ansi_bold(), target_proc.obj_path, ansi_normal());
-                                return df_traverse_node(dcon, target_proc.obj_path);
-                        } else {
-                                fprintf(stderr, "Object: %s/%s\n", ansi_bold(), ansi_normal());
-                                return df_traverse_node(dcon, DF_BUS_ROOT_NODE);
+                                df_fuzz_set_generator(backend);
+                                break;
                         }
-                } else {
-                        df_fail("Couldn't get the PID of the tested process\n");
-                        return DF_BUS_NO_PID;
-                }
-        }
+                        case ARG_GENERATOR_THREADS: {
+                                guint64 n_threads;
 
-        return DF_BUS_OK;
-}
+                                r = safe_strtoull(optarg, &n_threads);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --generator-threads: %s\n", strerror(-r));
+                                        exit(1);
+                                }
 
-int main(int argc, char **argv)
+                                if (n_threads > DF_PRODUCER_MAX_THREADS) {
+                                        df_fail("Error: --generator-threads must be in range [0, %d]\n",
+                                                DF_PRODUCER_MAX_THREADS);
+                                        exit(1);
+                                }
+
+                                df_fuzz_set_generator_threads(n_threads);
+                                break;
+                        }
+                        case ARG_MESSAGE_SIZE: {
+                                guint64 size;
+
+                                r = safe_strtoull(optarg, &size);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --message-size: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (size < MIN_MESSAGE_SIZE || size > MAX_MESSAGE_SIZE) {
+                                        df_fail("Error: --message-size must be in range [%d, %d]\n",
+                                                MIN_MESSAGE_SIZE, MAX_MESSAGE_SIZE);
+                                        exit(1);
+                                }
+
+                                df_fuzz_set_message_size(size);
+                                break;
+                        }
+                        case ARG_COVERAGE:
+                                if (isempty(optarg)) {
+                                        df_fail("Error: --coverage requires a shared memory object name\n");
+                                        exit(1);
+                                }
+
+                                df_coverage_name = optarg;
+                                break;
+                        case ARG_COVERAGE_PLATEAU:
+                                r = safe_strtoull(optarg, &df_coverage_plateau);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --coverage-plateau: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (df_coverage_plateau == 0) {
+                                        df_fail("Error: --coverage-plateau must be greater than 0\n");
+                                        exit(1);
+                                }
+                                break;
+                        case ARG_BUDGET:
+                                r = safe_strtoull(optarg, &df_budget);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --budget: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (df_budget == 0) {
+                                        df_fail("Error: --budget must be greater than 0\n");
+                                        exit(1);
+                                }
+                                break;
+                        case ARG_TIME_BUDGET:
+                                r = safe_strtoull(optarg, &df_time_budget);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --time-budget: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (df_time_budget == 0 || df_time_budget > G_MAXINT32) {
+                                        df_fail("Error: --time-budget must be in range [1, %d]\n", G_MAXINT32);
+                                        exit(1);
+                                }
+                                break;
+                        case ARG_LOG_FORMAT:
+                                if (g_str_equal(optarg, "text"))
+                                        df_log_binary = FALSE;
+                                else if (g_str_equal(optarg, "binary"))
+                                        df_log_binary = TRUE;
+                                else {
+                                        df_fail("Error: invalid value for option --log-format: %s\n", optarg);
+                                        exit(1);
+                                }
+                                break;
+                        case ARG_DECODE_LOG:
+                                df_decode_log = optarg;
+                                break;
+                        case ARG_REPLAY:
+                                df_replay_file = optarg;
+                                break;
+                        case ARG_BISECT:
+                                df_replay_bisect = TRUE;
+                                break;
+                        case ARG_INTROSPECTION_CACHE:
+                                df_introspection_cache_enabled = TRUE;
+                                break;
+                        case ARG_DISCOVERY_INFLIGHT: {
+                                guint64 inflight;
+
+                                r = safe_strtoull(optarg, &inflight);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --discovery-inflight: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (inflight < 1 || inflight > MAX_INFLIGHT_CALLS) {
+                                        df_fail("Error: number of Introspect calls in flight must be in range [1, %d]\n",
+                                                MAX_INFLIGHT_CALLS);
+                                        exit(1);
+                                }
+
+                                df_discovery_inflight = inflight;
+                                break;
+                        }
+                        case ARG_CALL_TIMEOUT: {
+                                guint64 timeout;
+
+                                r = safe_strtoull(optarg, &timeout);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --call-timeout: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (timeout == 0 || timeout > G_MAXINT32) {
+                                        df_fail("Error: --call-timeout must be in range [1, %d]\n", G_MAXINT32);
+                                        exit(1);
+                                }
+
+                                df_bus_set_call_timeout(timeout);
+                                break;
+                        }
+                        case ARG_MUTATE:
+                                df_fuzz_set_mutate(TRUE);
+                                break;
+                        case ARG_TARGETS:
+                                df_batch_file = optarg;
+                                break;
+                        case ARG_ALL:
+                                df_batch_all = TRUE;
+                                break;
+                        case ARG_PARALLEL_TARGETS: {
+                                guint64 jobs;
+
+                                r = safe_strtoull(optarg, &jobs);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --parallel-targets: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (jobs < 1 || jobs > DF_MAX_JOBS) {
+                                        df_fail("Error: number of parallel targets must be in range [1, %d]\n", DF_MAX_JOBS);
+                                        exit(1);
+                                }
+
+                                df_batch_jobs = jobs;
+                                break;
+                        }
+                        case ARG_HARNESS:
+                                if (isempty(optarg)) {
+                                        df_fail("Error: --harness requires the command line of the service\n");
+                                        exit(1);
+                                }
+
+                                df_harness_command = optarg;
+                                break;
+                        case ARG_COMMAND_INTERVAL:
+                                if (g_str_equal(optarg, "end")) {
+                                        df_command_interval = 0;
+                                        break;
+                                }
+
+                                r = safe_strtoull(optarg, &df_command_interval);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --command-interval: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (df_command_interval < 1) {
+                                        df_fail("Error: --command-interval= must be at least 1 or 'end'\n");
+                                        exit(1);
+                                }
+                                break;
+                        case ARG_COMMAND_COPROCESS:
+                                df_command_coprocess = TRUE;
+                                break;
+                        case ARG_STATS_INTERVAL:
+                                r = safe_strtoull(optarg, &df_stats_interval);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --stats-interval: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+                                break;
+                        case ARG_METRICS:
+                                if (isempty(optarg) || g_str_equal(optarg, "unix:")) {
+                                        df_fail("Error: --metrics= requires a file name or unix:PATH\n");
+                                        exit(1);
+                                }
+
+                                df_metrics_target = optarg;
+                                break;
+                        case ARG_RESUME:
+                                df_resume = TRUE;
+                                break;
+                        case ARG_STRESS: {
+                                guint64 clients;
+
+                                r = safe_strtoull(optarg, &clients);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --stress: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+
+                                if (clients < 1 || clients > DF_STRESS_MAX_CLIENTS) {
+                                        df_fail("Error: number of stress clients must be in range [1, %d]\n", DF_STRESS_MAX_CLIENTS);
+                                        exit(1);
+                                }
+
+                                df_stress_clients = clients;
+                                break;
+                        }
+                        case ARG_STRESS_RATE:
+                                r = safe_strtoull(optarg, &df_stress_rate);
+                                if (r < 0) {
+                                        df_fail("Error: invalid value for option --stress-rate: %s\n", strerror(-r));
+                                        exit(1);
+                                }
+                                break;
+                        case ARG_STRESS_DURATION:
+                                r = safe_strtoull(optarg, &df_stress_duration);
+                                if (r < 0 || df_stress_duration == 0) {
+                                        df_fail("Error: invalid value for option --stress-duration: %s\n",
+                                                r < 0 ? strerror(-r) : "must be at least 1 second");
+                                        exit(1);
+                                }
+                                break;
+                        case ARG_STRESS_CHURN:
+                                df_stress_churn = TRUE;
+                                break;
+                        default:    // '?'
+                                exit(1);
+                                break;
+                }
+        }
+
+        /* Decoding a log doesn't need anything else */
+        if (df_decode_log)
+                return;
+
+        if (df_batch_file && df_batch_all) {
+                df_fail("Error: --targets= and --all are mutually exclusive.\n");
+                exit(1);
+        }
+
+        if (df_batch_file || df_batch_all) {
+                if (!isempty(target_proc.name) || !isempty(target_proc.obj_path) || df_test_method ||
+                    df_test_property || df_replay_file || df_list_names) {
+                        df_fail("Error: --targets= and --all can't be used together with -n, -o, -i, -t, -p,"
+                                " -l or --replay=.\n");
+                        exit(1);
+                }
+
+                if (df_coverage_name || df_harness_command) {
+                        df_fail("Error: --coverage= and --harness= can't be used together with --targets= or --all.\n");
+                        exit(1);
+                }
+
+                if (df_log_dir_name && df_batch_jobs > 1) {
+                        df_fail("Error: -L/--log-dir= requires --parallel-targets=1.\n");
+                        exit(1);
+                }
+        } else if (df_batch_jobs > 1) {
+                df_fail("Error: --parallel-targets= requires --targets= or --all.\n");
+                exit(1);
+        } else if (isempty(target_proc.name) && !df_list_names) {
+                df_fail("Error: Connection name is required!\nSee -h for help.\n");
+                exit(1);
+        }
+
+        if (!isempty(target_proc.interface) && isempty(target_proc.obj_path)) {
+                df_fail("Error: Object path is required if interface specified!\nSee -h for help.\n");
+                exit(1);
+        }
+
+        if (df_min_iterations > df_max_iterations) {
+                df_fail("Error: minimal # of iterations can't be larger that the max one.\n");
+                exit(1);
+        }
+
+        if (df_test_method && df_test_property) {
+                df_fail("Error: -t/--method= and -p/--property= are mutually exclusive.\n");
+                exit(1);
+        }
+
+        if ((df_command_interval != 1 || df_command_coprocess) && !df_execute_cmd) {
+                df_fail("Error: --command-interval= and --command-coprocess require -e/--command=.\n");
+                exit(1);
+        }
+
+        if (df_replay_bisect && !df_replay_file) {
+                df_fail("Error: --bisect requires --replay=.\n");
+                exit(1);
+        }
+
+        if (df_resume && !df_log_dir_name) {
+                df_fail("Error: --resume requires -L/--log-dir=.\n");
+                exit(1);
+        }
+
+        if (df_resume && (df_budget > 0 || df_time_budget > 0 || df_replay_file)) {
+                df_fail("Error: --resume can't be used together with --budget=, --time-budget= or --replay=.\n");
+                exit(1);
+        }
+
+        if ((df_stress_rate > 0 || df_stress_duration != DF_STRESS_DEFAULT_DURATION_SEC || df_stress_churn) &&
+            df_stress_clients == 0) {
+                df_fail("Error: --stress-rate=, --stress-duration= and --stress-churn require --stress=.\n");
+                exit(1);
+        }
+
+        if (df_stress_clients > 0) {
+                if (!df_test_method || isempty(target_proc.interface)) {
+                        df_fail("Error: --stress= requires -o/--object=, -i/--interface= and -t/--method=.\n");
+                        exit(1);
+                }
+
+                if (df_replay_file || df_budget > 0 || df_time_budget > 0 || df_resume) {
+                        df_fail("Error: --stress= can't be used together with --replay=, --budget=,"
+                                " --time-budget= or --resume.\n");
+                        exit(1);
+                }
+        }
+
+        if (df_introspection_cache_enabled && !df_log_dir_name) {
+                df_fail("Error: --introspection-cache requires -L/--log-dir=.\n");
+                exit(1);
+        }
+
+        if ((df_budget > 0 || df_time_budget > 0) && df_jobs > 1) {
+                df_fail("Error: --budget= and --time-budget= can't be used together with -j/--jobs=.\n");
+                exit(1);
+        }
+}
+
+/**
+ * @function Fuzzes the target selected by the -o/-i options (or the whole
+ * object tree) on the connection dcon.
+ * @return 0 on success, 1 on error, 2 when testing detected any failures
+ * or warnings, 3 on warnings
+ */
+static int df_fuzz_target(GDBusConnection *dcon, GBusType bus_type)
+{
+        int r;
+
+        if (!isempty(target_proc.interface)) {
+                if (df_budget > 0 || df_time_budget > 0)
+                        r = df_fuzz_scheduled(dcon, target_proc.obj_path, target_proc.interface);
+                else {
+                        fprintf(stderr, "Object: %s%s%s\n", ansi_bold(), target_proc.obj_path, ansi_normal());
+                        fprintf(stderr, " Interface: %s%s%s\n", ansi_bold(), target_proc.interface, ansi_normal());
+                        r = df_fuzz(dcon, target_proc.name, target_proc.obj_path, target_proc.interface, NULL, NULL);
+                }
+        } else if (!isempty(target_proc.obj_path))
+                r = df_fuzz_tree(dcon, bus_type, target_proc.obj_path);
+        else
+                r = df_fuzz_tree(dcon, bus_type, DF_BUS_ROOT_NODE);
+
+        df_fuzz_release_properties_proxy();
+
+        return r;
+}
+
+static const char *df_bus_type_to_string(GBusType bus_type)
+{
+        return bus_type == G_BUS_TYPE_SESSION ? "session" : "system";
+}
+
+static const char *df_bus_result_to_string(int result)
+{
+        static const char *const table[] = {
+                [DF_BUS_OK]      = "OK",
+                [DF_BUS_SKIP]    = "SKIPPED",
+                [DF_BUS_NO_PID]  = "NO PID",
+                [DF_BUS_WARNING] = "WARNINGS",
+                [DF_BUS_FAIL]    = "FAILURES",
+                [DF_BUS_ERROR]   = "ERROR",
+        };
+
+        g_assert(result >= 0 && result < (int) G_N_ELEMENTS(table));
+
+        return table[result];
+}
+
+static df_target_t *df_target_new(const char *name, GBusType bus_type)
+{
+        df_target_t *target;
+
+        target = calloc(1, sizeof(*target));
+        if (!target)
+                return NULL;
+
+        target->name = strdup(name);
+        if (!target->name) {
+                free(target);
+                return NULL;
+        }
+
+        target->bus_type = bus_type;
+        target->pid = -1;
+        target->result = DF_BUS_SKIP;
+
+        return target;
+}
+
+static void df_target_free(df_target_t *target)
+{
+        if (!target)
+                return;
+
+        free(target->name);
+        free(target);
+}
+
+/**
+ * @function Opens the log file DIRNAME/BUS_NAME given by -L/--log-dir=
+ * @return 0 on success, -1 on error
+ */
+static int df_open_log(const char *name)
 {
         const char *log_file_name;
-        int rses = 0;               // return value from session bus testing
-        int rsys = 0;               // return value from system bus testing
+
+        log_file_name = strjoina(df_log_dir_name, "/", name);
+        if (df_log_open_log_file(log_file_name) < 0)
+                return -1;
+
+        // Replaying doesn't finish any work, so keep the journal of the fuzzing run
+        if (!df_replay_file) {
+                df_journal = df_journal_open(strjoina(log_file_name, ".journal"), df_resume);
+                if (!df_journal)
+                        return -1;
+
+                /* The seed is all of the state of the generator, so the remaining
+                 * work gets the same data as it would have in the interrupted run */
+                if (df_journal->have_seed) {
+                        if (df_seed_set && df_journal->seed != df_fuzz_get_seed())
+                                return df_fail_ret(-1, "Error: The interrupted run of '%s' used --seed=%"G_GUINT64_FORMAT".\n",
+                                                   name, df_journal->seed);
+
+                        df_fuzz_set_seed(df_journal->seed);
+                } else if (df_journal_set_seed(df_journal, df_fuzz_get_seed()) < 0)
+                        return -1;
+        }
+
+        if (df_log_binary && df_binlog_start(df_fuzz_get_seed()) < 0)
+                return -1;
+
+        return 0;
+}
+
+static int df_close_log(void)
+{
+        df_journal_free(g_steal_pointer(&df_journal));
+
+        if (df_log_binary)
+                df_binlog_stop();
+
+        return df_log_close_log_file();
+}
+
+/**
+ * @function Fuzzes the target (or replays the loaded log to it) on the
+ * connection dcon; the target becomes the one of the calling thread.
+ * @return DF_BUS_* result
+ */
+static int df_process_target(GDBusConnection *dcon, df_target_t *target)
+{
+        g_autoptr(gchar) cache_file_name = NULL;
+        int pid, r;
+
+        df_target = target;
+
+        // gets pid of tested process; the harness just started it, so wait
+        // for it to acquire the name
+        pid = df_harness ? df_reconnect_wait_for_owner(dcon, target->name, FALSE) : df_get_pid(dcon, TRUE);
+        if (pid <= 0) {
+                df_fail("Couldn't get the PID of the tested process '%s'\n", target->name);
+                return DF_BUS_NO_PID;
+        }
+
+        g_atomic_int_set(&target->pid, pid);
+        if (df_harness)
+                df_harness_set_owner(df_harness, pid);
+        df_print_process_info(pid);
+        fprintf(stderr, "%s%s[CONNECTED TO PID: %d]%s\n", ansi_cr(), ansi_cyan(), pid, ansi_normal());
+        if (df_replay_records)
+                return df_replay(dcon);
+
+        fprintf(stderr, "%s%s[SEED: %"G_GUINT64_FORMAT"]%s\n", ansi_cr(), ansi_cyan(),
+                df_fuzz_get_seed(), ansi_normal());
+        if (df_stress_clients > 0)
+                return df_stress(dcon);
+        if (!df_introspection_cache_enabled)
+                return df_fuzz_target(dcon, target->bus_type);
+
+        cache_file_name = g_strconcat(df_log_dir_name, "/", target->name, ".",
+                                      df_bus_type_to_string(target->bus_type), ".introspection", NULL);
+        if (df_introspection_cache_load(cache_file_name, target->name) < 0)
+                return DF_BUS_ERROR;
+
+        r = df_fuzz_target(dcon, target->bus_type);
+        if (df_introspection_cache_save(cache_file_name, target->name) < 0)
+                return DF_BUS_ERROR;
+
+        return r;
+}
+
+/**
+ * @function Loads the bus names to test in batch mode from the file, one per
+ * line; empty lines, lines starting with '#' and duplicates are skipped.
+ * @return New array of names on success, NULL on error
+ */
+static GPtrArray *df_batch_load_names(const char *file_name)
+{
+        g_autoptr(GPtrArray) names = NULL;
+        g_autoptr(GHashTable) seen = NULL;
+        g_autoptr(FILE) f = NULL;
+        g_autoptr(char) line = NULL;
+        size_t len = 0;
+        ssize_t n;
+
+        f = fopen(file_name, "r");
+        if (!f) {
+                df_fail("Cannot open file with targets '%s': %m\n", file_name);
+                return NULL;
+        }
+
+        names = g_ptr_array_new_with_free_func(g_free);
+        seen = g_hash_table_new(g_str_hash, g_str_equal);
+        while ((n = getline(&line, &len, f)) > 0) {
+                char *name = g_strstrip(line);
+
+                if (isempty(name) || name[0] == '#')
+                        continue;
+
+                if (!g_dbus_is_name(name) || g_dbus_is_unique_name(name)) {
+                        df_fail("Error: Invalid bus name '%s' in '%s'.\n", name, file_name);
+                        return NULL;
+                }
+
+                if (g_hash_table_contains(seen, name))
+                        continue;
+
+                g_ptr_array_add(names, g_strdup(name));
+                g_hash_table_add(seen, g_ptr_array_index(names, names->len - 1));
+        }
+
+        if (names->len == 0) {
+                df_fail("Error: No bus names found in '%s'.\n", file_name);
+                return NULL;
+        }
+
+        return g_steal_pointer(&names);
+}
+
+/**
+ * @function Collects the names of the batch available on the bus, i.e. the
+ * ones from --targets= which are owned or activatable there, or all of them
+ * (except the bus itself) with --all.
+ * @param dcon D-Bus connection structure
+ * @param names Names loaded from --targets=, NULL with --all
+ * @return New array of names on success, NULL on error
+ */
+static GPtrArray *df_batch_get_names(GDBusConnection *dcon, GPtrArray *names)
+{
+        g_autoptr(GDBusProxy) proxy = NULL;
+        g_autoptr(GPtrArray) owned = NULL, activatable = NULL, ret = NULL;
+        g_autoptr(GHashTable) available = NULL;
+
+        proxy = df_bus_daemon_new(dcon);
+        if (!proxy)
+                return NULL;
+
+        owned = df_get_bus_names(proxy, "ListNames");
+        if (!owned)
+                return NULL;
+
+        activatable = df_get_bus_names(proxy, "ListActivatableNames");
+        if (!activatable)
+                return NULL;
+
+        /* Names owned by the bus as well as activatable ones are listed
+         * only once */
+        available = g_hash_table_new(g_str_hash, g_str_equal);
+        ret = g_ptr_array_new_with_free_func(g_free);
+        for (guint i = 0; i < owned->len + activatable->len; i++) {
+                char *name = i < owned->len ? g_ptr_array_index(owned, i)
+                                            : g_ptr_array_index(activatable, i - owned->len);
+
+                if (!g_hash_table_add(available, name))
+                        continue;
+
+                if (!names && !g_str_equal(name, "org.freedesktop.DBus"))
+                        g_ptr_array_add(ret, g_strdup(name));
+        }
+
+        if (names)
+                for (guint i = 0; i < names->len; i++) {
+                        const char *name = g_ptr_array_index(names, i);
+
+                        if (g_hash_table_contains(available, name))
+                                g_ptr_array_add(ret, g_strdup(name));
+                }
+
+        return g_steal_pointer(&ret);
+}
+
+/** State shared by the threads processing the targets of a batch */
+typedef struct df_batch_pool {
+        /** Bus connection shared by all targets */
+        GDBusConnection *dcon;
+        /** Queue of (borrowed) df_target_t targets; it's completely filled
+          * before the threads are started */
+        GAsyncQueue *targets;
+} df_batch_pool_t;
+
+/**
+ * @function Batch thread: takes targets from the shared queue and processes
+ * them one by one until the queue is empty; results are stored in the
+ * targets, an error of one of them doesn't stop the others.
+ * @param user_data Pointer to the df_batch_pool_t structure
+ * @return Always NULL
+ */
+static gpointer df_batch_run(gpointer user_data)
+{
+        df_batch_pool_t *pool = user_data;
+        df_target_t *target;
+
+        while ((target = g_async_queue_try_pop(pool->targets))) {
+                fprintf(stderr, "%s%s[TARGET: %s]%s\n", ansi_cr(), ansi_cyan(), target->name, ansi_normal());
+
+                if (df_log_dir_name && df_open_log(target->name) < 0) {
+                        target->result = DF_BUS_ERROR;
+                        continue;
+                }
+
+                target->result = df_process_target(pool->dcon, target);
+
+                if (df_log_dir_name && df_close_log() < 0)
+                        target->result = DF_BUS_ERROR;
+        }
+
+        return NULL;
+}
+
+/**
+ * @function Processes all targets of the batch available on the bus using
+ * df_batch_jobs threads; the targets are added to df_batch_targets.
+ * @param dcon D-Bus connection structure
+ * @param bus_type Bus type of the connection
+ * @param names Names loaded from --targets=, NULL with --all
+ * @return DF_BUS_OK on success, DF_BUS_ERROR on error
+ */
+static int df_process_batch(GDBusConnection *dcon, GBusType bus_type, GPtrArray *names)
+{
+        g_autoptr(GPtrArray) available = NULL;
+        g_autoptr(GAsyncQueue) targets = NULL;
+        df_batch_pool_t pool = {
+                .dcon = dcon,
+        };
+        GThread *threads[DF_MAX_JOBS];
+        guint n_threads;
+
+        available = df_batch_get_names(dcon, names);
+        if (!available) {
+                df_debug("Error in df_batch_get_names()\n");
+                return DF_BUS_ERROR;
+        }
+
+        targets = g_async_queue_new();
+        for (guint i = 0; i < available->len; i++) {
+                df_target_t *target;
+
+                target = df_target_new(g_ptr_array_index(available, i), bus_type);
+                if (!target)
+                        return df_fail_ret(DF_BUS_ERROR, "Error: Could not allocate memory for a target.\n");
+
+                g_ptr_array_add(df_batch_targets, target);
+                g_async_queue_push(targets, target);
+        }
+
+        fprintf(stderr, "%s%s[BATCH: %u target(s)]%s\n", ansi_cr(), ansi_cyan(), available->len, ansi_normal());
+
+        pool.targets = targets;
+        n_threads = MIN(df_batch_jobs, available->len);
+        if (n_threads <= 1) {
+                (void) df_batch_run(&pool);
+                return DF_BUS_OK;
+        }
+
+        df_verbose("Fuzzing %u target(s) using %u thread(s)\n", available->len, n_threads);
+
+        for (guint i = 0; i < n_threads; i++)
+                threads[i] = g_thread_new("dfuzzer-target", df_batch_run, &pool);
+        for (guint i = 0; i < n_threads; i++)
+                g_thread_join(threads[i]);
+
+        return DF_BUS_OK;
+}
+
+/**
+ * @function Prints the results of all targets of the batch, including the
+ * names from --targets= which weren't found on any bus.
+ * @param names Names loaded from --targets=, NULL with --all
+ */
+static void df_batch_print_report(GPtrArray *names)
+{
+        g_autoptr(GHashTable) found = NULL;
+
+        fprintf(stderr, "%s%s[BATCH REPORT: %u target(s)]%s\n", ansi_cr(), ansi_cyan(),
+                df_batch_targets->len, ansi_normal());
+
+        found = g_hash_table_new(g_str_hash, g_str_equal);
+        for (guint i = 0; i < df_batch_targets->len; i++) {
+                df_target_t *target = g_ptr_array_index(df_batch_targets, i);
+
+                fprintf(stderr, "  %s (%s bus): %s%s%s\n", target->name, df_bus_type_to_string(target->bus_type),
+                        target->result == DF_BUS_OK ? "" : ansi_bold(),
+                        df_bus_result_to_string(target->result), ansi_normal());
+                g_hash_table_add(found, target->name);
+        }
+
+        if (names)
+                for (guint i = 0; i < names->len; i++) {
+                        const char *name = g_ptr_array_index(names, i);
+
+                        if (!g_hash_table_contains(found, name))
+                                fprintf(stderr, "  %s: %sNOT FOUND%s\n", name, ansi_bold(), ansi_normal());
+                }
+}
+
+/**
+ * @function Maps DF_BUS_* results to the exit status: errors take
+ * precedence over failures and failures over warnings.
+ * @return 0 if at least one test passed (and none failed), 1 on error,
+ * 2 on failures, 3 on warnings, 4 if no test was run at all
+ */
+static int df_exit_status(const int *results, guint n)
+{
+        static const int priority[] = { DF_BUS_ERROR, DF_BUS_FAIL, DF_BUS_WARNING, DF_BUS_OK };
+        static const int status[] = { 1, 2, 3, 0 };
+
+        for (guint i = 0; i < G_N_ELEMENTS(priority); i++)
+                for (guint j = 0; j < n; j++)
+                        if (results[j] == priority[i])
+                                return status[i];
+
+        // all remaining combinations, like both results missing
+        return 4;
+}
+
+static int df_process_bus(GBusType bus_type, GPtrArray *batch_names)
+{
+        g_autoptr(GDBusConnection) dcon = NULL;
+        g_autoptr(GError) error = NULL;
+        df_target_t target = {
+                .name = target_proc.name,
+                .bus_type = bus_type,
+                .pid = -1,
+        };
+
+        switch (bus_type) {
+        case G_BUS_TYPE_SESSION:
+                fprintf(stderr, "%s%s[SESSION BUS]%s\n", ansi_cr(), ansi_cyan(), ansi_normal());
+                break;
+        case G_BUS_TYPE_SYSTEM:
+                fprintf(stderr, "%s%s[SYSTEM BUS]%s\n", ansi_cr(), ansi_cyan(), ansi_normal());
+                break;
+        default:
+                df_fail("Invalid bus type\n");
+                return DF_BUS_ERROR;
+        }
+
+        // The same name on the other bus is a different service
+        df_introspection_cache_clear();
+
+        // The connection is shared by all targets of a batch
+        dcon = g_bus_get_sync(bus_type, NULL, &error);
+        if (!dcon) {
+                df_fail("Bus not found.\n");
+                df_error("Error in g_bus_get_sync()", error);
+                return DF_BUS_SKIP;
+        }
+
+        // The private bus of the harness is stopped before dfuzzer exits,
+        // which mustn't terminate dfuzzer
+        if (df_harness)
+                g_dbus_connection_set_exit_on_close(dcon, FALSE);
+
+        if (df_list_names) {
+                // list names on the bus
+                if (df_list_bus_names(dcon) == -1) {
+                        df_debug("Error in df_list_bus_names() for session bus\n");
+                        return DF_BUS_ERROR;
+                }
+
+                return DF_BUS_OK;
+        }
+
+        if (df_batch_targets)
+                return df_process_batch(dcon, bus_type, batch_names);
+
+        return df_process_target(dcon, &target);
+}
+
+int main(int argc, char **argv)
+{
+        g_autoptr(df_coverage_t) coverage = NULL;
+        g_autoptr(GPtrArray) batch_names = NULL;
+        int results[2];             // return values from session and system bus testing
         int ret = 0;
         df_parse_parameters(argc, argv);
 
-        if (df_log_dir_name) {
-                log_file_name = strjoina(df_log_dir_name, "/", target_proc.name);
-                if (df_log_open_log_file(log_file_name) < 0) {
+        if (df_decode_log)
+                return df_binlog_decode(df_decode_log, stdout) < 0 ? 1 : 0;
+
+        for (guint i = 0; i < G_N_ELEMENTS(df_idle_connections); i++)
+                df_idle_connections[i] = g_async_queue_new_full((GDestroyNotify) df_connection_free);
+
+        if (df_batch_file || df_batch_all) {
+                if (df_batch_file) {
+                        batch_names = df_batch_load_names(df_batch_file);
+                        if (!batch_names) {
+                                ret = 1;
+                                goto cleanup;
+                        }
+                }
+
+                df_batch_targets = g_ptr_array_new_with_free_func((GDestroyNotify) df_target_free);
+        }
+
+        if (df_replay_file) {
+                df_replay_records = df_replay_load(df_replay_file,
+                                                   isempty(target_proc.obj_path) ? NULL : target_proc.obj_path,
+                                                   isempty(target_proc.interface) ? NULL : target_proc.interface,
+                                                   df_test_method);
+                if (!df_replay_records) {
                         ret = 1;
                         goto cleanup;
                 }
         }
+
+        if (!df_seed_set)
+                df_fuzz_set_seed(((guint64) g_random_int() << 32) | g_random_int());
+
+        if (df_coverage_name) {
+                coverage = df_coverage_open(df_coverage_name);
+                if (!coverage) {
+                        ret = 1;
+                        goto cleanup;
+                }
+
+                df_fuzz_set_coverage(coverage, df_coverage_plateau);
+        }
+
+        // In batch mode each target has its own log, see df_batch_run()
+        if (df_log_dir_name && !df_batch_targets && df_open_log(target_proc.name) < 0) {
+                ret = 1;
+                goto cleanup;
+        }
         if (!df_supflg) {
-                if (df_suppression_load(&suppressions, target_proc.name) < 0) {
+                if (df_suppression_load(&suppressions) < 0) {
                         printf("%sExit status: 1%s\n", ansi_bold(), ansi_normal());
                         ret = 1;
                         goto cleanup;
                 }
+
+                if (df_batch_targets)
+                        df_verbose("Found %u suppression(s)\n", suppressions->n_items);
+                else
+                        df_verbose("Found %u suppression(s) for bus: '%s'\n",
+                                   df_suppression_count(suppressions, target_proc.name), target_proc.name);
         }
 
-        rses = df_process_bus(G_BUS_TYPE_SESSION);
-        rsys = df_process_bus(G_BUS_TYPE_SYSTEM);
+        if (df_harness_command) {
+                df_harness = df_harness_new(df_harness_command);
+                if (!df_harness || df_harness_start(df_harness) < 0) {
+                        ret = 1;
+                        goto cleanup;
+                }
+        }
 
-        // both tests ended with error
-        if (rses == DF_BUS_ERROR || rsys == DF_BUS_ERROR)
+        if (df_metrics_start(df_stats_interval, df_metrics_target) < 0) {
                 ret = 1;
-        else if (rses == DF_BUS_FAIL || rsys == DF_BUS_FAIL)
-                // at least one test found failures
-                ret = 2;
-        else if (rses == DF_BUS_WARNING || rsys == DF_BUS_WARNING)
-                // at least one test found warnings
-                ret = 3;
-        else if (rses == DF_BUS_OK || rsys == DF_BUS_OK)
-                // at least one of the tests passed (and the other one is not in
-                // a fail state)
-                ret = 0;
-        else
-                // all remaining combinations, like both results missing
-                ret = 4;
+                goto cleanup;
+        }
+
+        // Started after the harness, so a co-process uses its private bus as well
+        if (df_execute_cmd) {
+                df_command = df_command_new(df_execute_cmd, df_show_command_output, df_command_interval,
+                                            df_command_coprocess);
+                if (!df_command) {
+                        ret = 1;
+                        goto cleanup;
+                }
+        }
 
+        results[0] = df_process_bus(G_BUS_TYPE_SESSION, batch_names);
+        // The harness runs the service on its private (session) bus only
+        results[1] = df_harness ? DF_BUS_SKIP : df_process_bus(G_BUS_TYPE_SYSTEM, batch_names);
+
+        if (df_batch_targets) {
+                g_autoptr(GArray) batch_results = NULL;
+
+                df_batch_print_report(batch_names);
+
+                batch_results = g_array_new(FALSE, FALSE, sizeof(int));
+                for (guint i = 0; i < df_batch_targets->len; i++)
+                        g_array_append_val(batch_results, ((df_target_t *) g_ptr_array_index(df_batch_targets, i))->result);
+                // failing to get the list of targets is an error as well
+                for (guint i = 0; i < G_N_ELEMENTS(results); i++)
+                        if (results[i] == DF_BUS_ERROR)
+                                g_array_append_val(batch_results, results[i]);
+
+                ret = df_exit_status((int *) batch_results->data, batch_results->len);
+        } else
+                ret = df_exit_status(results, G_N_ELEMENTS(results));
+
+        df_fuzz_print_throughput_summary();
+        df_fuzz_print_latency_summary();
+        if (df_reconnect_get_waited_usec() > 0)
+                fprintf(stderr, "%s[WAITED FOR THE TESTED PROCESS: %.2f s]%s\n", ansi_cyan(),
+                        df_reconnect_get_waited_usec() / (double) G_USEC_PER_SEC, ansi_normal());
+        if (coverage)
+                fprintf(stderr, "%s[COVERAGE: %"G_GUINT64_FORMAT" edges]%s\n",
+                        ansi_cyan(), coverage->n_edges, ansi_normal());
+        if (df_harness)
+                df_harness_print_summary(df_harness);
         fprintf(stderr, "%sExit status: %d%s\n", ansi_bold(), ret, ansi_normal());
 
 cleanup:
-        df_suppression_free(&suppressions);
+        df_metrics_stop();
+        df_command_free(g_steal_pointer(&df_command));
+        df_harness_free(g_steal_pointer(&df_harness));
+        df_suppression_index_free(g_steal_pointer(&suppressions));
+        if (df_batch_targets)
+                g_ptr_array_unref(g_steal_pointer(&df_batch_targets));
+        for (guint i = 0; i < G_N_ELEMENTS(df_idle_connections); i++)
+                if (df_idle_connections[i])
+                        g_async_queue_unref(g_steal_pointer(&df_idle_connections[i]));
+        if (df_log_dir_name)
+                (void) df_close_log();
+        if (df_replay_records)
+                g_ptr_array_unref(df_replay_records);
 
         return ret;
 }
@@ -0,0 +1,129 @@
+/** @file dictionary.c */
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dictionary.h"
+#include "log.h"
+#include "util.h"
+
+df_dictionary_t *df_dictionary_new(const char *filename)
+{
+        g_autoptr(df_dictionary_t) d = NULL;
+        g_autoptr(GError) error = NULL;
+
+        g_assert(filename);
+
+        d = calloc(1, sizeof(*d));
+        if (!d) {
+                df_oom();
+                return NULL;
+        }
+
+        g_mutex_init(&d->lock);
+        d->offsets = g_array_new(FALSE, FALSE, sizeof(gsize));
+
+        /* Writable, but private, so the newlines can be replaced in place
+         * without touching the file itself */
+        d->file = g_mapped_file_new(filename, TRUE, &error);
+        if (!d->file) {
+                df_fail("Failed to map file '%s': %s\n", filename, error->message);
+                return NULL;
+        }
+
+        d->bytes = g_mapped_file_get_bytes(d->file);
+        d->data = g_mapped_file_get_contents(d->file);
+        d->size = g_mapped_file_get_length(d->file);
+
+        return g_steal_pointer(&d);
+}
+
+void df_dictionary_free(df_dictionary_t *d)
+{
+        if (!d)
+                return;
+
+        if (d->bytes)
+                g_bytes_unref(d->bytes);
+        if (d->file)
+                g_mapped_file_unref(d->file);
+        if (d->offsets)
+                g_array_unref(d->offsets);
+        free(d->tail);
+        g_mutex_clear(&d->lock);
+        free(d);
+}
+
+/* Indexes the next line, the lock must be held */
+static gboolean df_dictionary_index_next(df_dictionary_t *d)
+{
+        char *line, *nl;
+        gsize offset;
+
+        if (d->scanned >= d->size)
+                return FALSE;
+
+        offset = d->scanned;
+        line = d->data + offset;
+        nl = memchr(line, '\n', d->size - d->scanned);
+        if (nl) {
+                *nl = 0;
+                d->scanned = nl - d->data + 1;
+        } else {
+                /* There's no room for the NUL byte after the last line in the
+                 * mapping, so keep a copy of it instead */
+                d->tail = strndup(line, d->size - d->scanned);
+                if (!d->tail) {
+                        df_oom();
+                        return FALSE;
+                }
+                d->scanned = d->size;
+        }
+
+        g_array_append_val(d->offsets, offset);
+
+        return TRUE;
+}
+
+const char *df_dictionary_get(df_dictionary_t *d, guint64 index)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        gsize offset;
+
+        g_assert(d);
+
+        locker = g_mutex_locker_new(&d->lock);
+
+        while (index >= d->offsets->len)
+                if (!df_dictionary_index_next(d))
+                        return NULL;
+
+        if (d->tail && index == d->offsets->len - 1)
+                return d->tail;
+
+        offset = g_array_index(d->offsets, gsize, index);
+
+        return d->data + offset;
+}
+
+guint64 df_dictionary_get_n_indexed(df_dictionary_t *d)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+
+        g_assert(d);
+
+        locker = g_mutex_locker_new(&d->lock);
+
+        return d->offsets->len;
+}
+
+GBytes *df_dictionary_get_bytes(df_dictionary_t *d, const char *str)
+{
+        g_assert(d);
+
+        if (!str || str < d->data || str >= d->data + d->size)
+                return NULL;
+
+        return g_bytes_new_from_bytes(d->bytes, str - d->data, strlen(str) + 1);
+}
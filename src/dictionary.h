@@ -0,0 +1,67 @@
+/** @file dictionary.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/** Dictionary of strings, one per line of a memory-mapped file
+  *
+  * The file is mapped privately (copy-on-write) and indexed lazily, i.e. only
+  * up to the line that was asked for, so loading even a huge dictionary is
+  * cheap and only the pages with the used entries are ever read. Indexed
+  * lines are NUL-terminated in place, so entries are served directly from
+  * the mapping without copying them. The dictionary can be shared between
+  * threads.
+  */
+typedef struct df_dictionary {
+        GMappedFile *file;
+        /** Mapping as a whole, entries are slices of it */
+        GBytes *bytes;
+        char *data;
+        gsize size;
+        /** Offsets of the already indexed lines */
+        GArray *offsets;
+        /** Offset of the first line which wasn't indexed yet */
+        gsize scanned;
+        /** Copy of the last line if it's not terminated by a newline */
+        char *tail;
+        GMutex lock;
+} df_dictionary_t;
+
+/**
+ * @function Maps the file; nothing is read until the first lookup
+ * @param filename Path of the dictionary, one entry per line
+ * @return New dictionary on success (free it with df_dictionary_free()),
+ * NULL on error
+ */
+df_dictionary_t *df_dictionary_new(const char *filename);
+void df_dictionary_free(df_dictionary_t *d);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_dictionary_t, df_dictionary_free)
+
+static inline gboolean df_dictionary_is_empty(const df_dictionary_t *d)
+{
+        return d->size == 0;
+}
+
+/**
+ * @function Looks up the index-th entry (without the trailing newline),
+ * indexing the file up to it if necessary
+ * @return NUL-terminated entry owned by the dictionary, NULL if the file
+ * has fewer lines
+ */
+const char *df_dictionary_get(df_dictionary_t *d, guint64 index);
+
+/**
+ * @return Number of lines indexed so far, i.e. all of them once a lookup
+ * returned NULL
+ */
+guint64 df_dictionary_get_n_indexed(df_dictionary_t *d);
+
+/**
+ * @function Wraps an entry returned by df_dictionary_get() including its
+ * trailing NUL byte, i.e. in the serialized form of a 's' GVariant, without
+ * copying it
+ * @return New GBytes reference (a slice of the mapping), NULL if str is not
+ * an entry of the mapped file
+ */
+GBytes *df_dictionary_get_bytes(df_dictionary_t *d, const char *str);
@@ -24,21 +24,78 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
 #include "fuzz.h"
+#include "arena.h"
+#include "binlog.h"
 #include "bus.h"
+#include "command.h"
+#include "corpus.h"
+#include "coverage.h"
+#include "histogram.h"
 #include "log.h"
+#include "metrics.h"
+#include "monitor.h"
+#include "mutate.h"
+#include "plan.h"
+#include "producer.h"
 #include "rand.h"
+#include "reconnect.h"
 #include "util.h"
 
 static guint64 fuzz_buffer_length = MAX_BUFFER_LENGTH;
-static gboolean show_command_output = FALSE;
-/** Pointer on D-Bus interface proxy for calling methods. */
-static GDBusProxy *df_dproxy;
+/** Target size of the messages with generated values, 0 for no limit */
+static guint64 df_message_size;
+/** Pointer on D-Bus interface proxy for calling methods; each worker thread
+  * has its own. */
+static __thread GDBusProxy *df_dproxy;
+/** Properties proxy of the object tested last, so it's not created again for
+  * each property; each worker thread has its own. */
+static __thread GDBusProxy *df_pproxy;
 /** Exceptions counter; if MAX_EXCEPTIONS is reached testing continues
   * with a next method */
-static char df_except_counter = 0;
+static __thread char df_except_counter = 0;
+/** Maximum number of method calls in flight */
+static guint df_inflight = 1;
+/** Seed all the generated data are derived from */
+static guint64 df_seed;
+/** How the generated values are constructed */
+static df_plan_backend_t df_generator = DF_PLAN_BACKEND_VARIANT;
+/** Number of threads generating the inputs of a method ahead, 0 to generate
+  * them between the calls */
+static guint df_generator_threads;
+/** Coverage feedback from the tested process, NULL if disabled */
+static df_coverage_t *df_coverage;
+/** Iterations without new coverage after which a method is done */
+static guint64 df_coverage_plateau = DF_COVERAGE_PLATEAU_DEFAULT;
+/** Mutate inputs which got interesting replies, even without coverage */
+static gboolean df_mutate_interesting;
+
+struct df_crash_guard {
+        GMutex lock;
+        GCond cond;
+        /** Number of restarts of the tested process after a crash */
+        guint generation;
+        /** TRUE while a worker reports a crash and restarts the process */
+        gboolean reporting;
+        /** Number of workers testing a member of the current generation */
+        guint n_active;
+        /** Descriptions of the calls the other workers had in flight when
+          * the process crashed, for the report */
+        GPtrArray *in_flight;
+};
+
+/** Guard shared with the other workers testing the same process, NULL if
+  * there are none */
+static __thread df_crash_guard_t *df_crash_guard;
+/** Generation of the process the thread tests */
+static __thread guint df_crash_generation;
+/** TRUE while the thread is counted in n_active */
+static __thread gboolean df_crash_active;
+/** TRUE if the thread reports the crash */
+static __thread gboolean df_crash_reporting;
 
 void df_fuzz_set_buffer_length(const guint64 length)
 {
@@ -52,9 +109,277 @@ guint64 df_fuzz_get_buffer_length(void)
         return fuzz_buffer_length;
 }
 
-void df_fuzz_set_show_command_output(gboolean value)
+void df_fuzz_set_message_size(guint64 size)
 {
-        show_command_output = value;
+        g_assert(size == 0 || (size >= MIN_MESSAGE_SIZE && size <= MAX_MESSAGE_SIZE));
+
+        df_message_size = size;
+}
+
+guint64 df_fuzz_get_message_size(void)
+{
+        return df_message_size;
+}
+
+df_plan_t *df_fuzz_plan_new(const char *signature, const char *const *strings)
+{
+        /* The fixed part of the header, the length of its fields and the
+         * SENDER field added by the broker (unique names are short), all
+         * with padding */
+        guint64 overhead = 16 + 4 + 4 + 4 + 32 + 7;
+
+        if (df_message_size == 0)
+                return df_plan_new(signature);
+
+        /* Every header field or string argument takes at most 16 bytes
+         * more than the string itself: the field code and the signature of
+         * its value, the length, the NUL byte and padding */
+        for (const char *const *s = strings; s && *s; s++)
+                overhead += strlen(*s) + 16;
+
+        return df_plan_new_sized(signature, df_message_size > overhead + 1 ? df_message_size - overhead : 1);
+}
+
+void df_fuzz_set_inflight(guint inflight)
+{
+        g_assert(inflight > 0 && inflight <= MAX_INFLIGHT_CALLS);
+
+        df_inflight = inflight;
+}
+
+void df_fuzz_set_seed(guint64 seed)
+{
+        df_seed = seed;
+}
+
+guint64 df_fuzz_get_seed(void)
+{
+        return df_seed;
+}
+
+void df_fuzz_set_generator(df_plan_backend_t backend)
+{
+        g_assert(backend < _DF_PLAN_BACKEND_MAX);
+
+        df_generator = backend;
+}
+
+df_plan_backend_t df_fuzz_get_generator(void)
+{
+        return df_generator;
+}
+
+void df_fuzz_set_generator_threads(guint n_threads)
+{
+        g_assert(n_threads <= DF_PRODUCER_MAX_THREADS);
+
+        df_generator_threads = n_threads;
+}
+
+void df_fuzz_set_coverage(df_coverage_t *coverage, guint64 plateau)
+{
+        g_assert(plateau > 0);
+
+        df_coverage = coverage;
+        df_coverage_plateau = plateau;
+}
+
+void df_fuzz_set_mutate(gboolean mutate)
+{
+        df_mutate_interesting = mutate;
+}
+
+df_crash_guard_t *df_crash_guard_new(void)
+{
+        df_crash_guard_t *guard;
+
+        guard = calloc(1, sizeof(*guard));
+        if (!guard)
+                return NULL;
+
+        g_mutex_init(&guard->lock);
+        g_cond_init(&guard->cond);
+        guard->in_flight = g_ptr_array_new_with_free_func(g_free);
+
+        return guard;
+}
+
+void df_crash_guard_free(df_crash_guard_t *guard)
+{
+        if (!guard)
+                return;
+
+        g_ptr_array_unref(guard->in_flight);
+        g_cond_clear(&guard->cond);
+        g_mutex_clear(&guard->lock);
+        free(guard);
+}
+
+void df_fuzz_set_crash_guard(df_crash_guard_t *guard)
+{
+        g_assert(!df_crash_active && !df_crash_reporting);
+
+        df_crash_guard = guard;
+        df_crash_generation = guard ? guard->generation : 0;
+}
+
+/* Called before testing a member; returns FALSE if the process was restarted
+ * since the thread tested it last, so the proxy has to be created again */
+static gboolean df_fuzz_crash_enter(void)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        gboolean restarted;
+
+        if (!df_crash_guard)
+                return TRUE;
+
+        locker = g_mutex_locker_new(&df_crash_guard->lock);
+
+        /* Don't call the process while it's being restarted */
+        while (df_crash_guard->reporting)
+                g_cond_wait(&df_crash_guard->cond, &df_crash_guard->lock);
+
+        restarted = df_crash_generation != df_crash_guard->generation;
+        df_crash_generation = df_crash_guard->generation;
+        if (restarted)
+                return FALSE;
+
+        df_crash_guard->n_active++;
+        df_crash_active = TRUE;
+
+        return TRUE;
+}
+
+static void df_fuzz_crash_leave_locked(void)
+{
+        if (!df_crash_active)
+                return;
+
+        df_crash_guard->n_active--;
+        df_crash_active = FALSE;
+        g_cond_broadcast(&df_crash_guard->cond);
+}
+
+static void df_fuzz_crash_leave(void)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+
+        if (!df_crash_guard)
+                return;
+
+        locker = g_mutex_locker_new(&df_crash_guard->lock);
+        df_fuzz_crash_leave_locked();
+}
+
+/**
+ * @function Decides which worker reports a crash of the process: the first
+ * one to notice it, which then gives the others a moment to notice it as
+ * well. The others leave the description of their calls in flight for the
+ * report and wait until the process is restarted.
+ * @param in_flight Description of the thread's calls in flight (taken over)
+ * @return TRUE if the thread reports the crash, FALSE if it has to test the
+ * member again
+ */
+static gboolean df_fuzz_crash_claim(gchar *in_flight)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        g_autoptr(gchar) description = in_flight;
+        gint64 deadline;
+
+        if (!df_crash_guard)
+                return TRUE;
+
+        locker = g_mutex_locker_new(&df_crash_guard->lock);
+        df_fuzz_crash_leave_locked();
+
+        /* The thread's calls went to a process which was restarted already */
+        if (df_crash_generation != df_crash_guard->generation) {
+                df_crash_generation = df_crash_guard->generation;
+                return FALSE;
+        }
+
+        if (!df_crash_guard->reporting) {
+                df_crash_guard->reporting = TRUE;
+                df_crash_reporting = TRUE;
+
+                deadline = g_get_monotonic_time() + DF_CRASH_REPORT_WAIT_MSEC * 1000;
+                while (df_crash_guard->n_active > 0)
+                        if (!g_cond_wait_until(&df_crash_guard->cond, &df_crash_guard->lock, deadline))
+                                break;
+
+                return TRUE;
+        }
+
+        if (description)
+                g_ptr_array_add(df_crash_guard->in_flight, g_steal_pointer(&description));
+        g_cond_broadcast(&df_crash_guard->cond);
+
+        while (df_crash_guard->generation == df_crash_generation)
+                g_cond_wait(&df_crash_guard->cond, &df_crash_guard->lock);
+        df_crash_generation = df_crash_guard->generation;
+
+        return FALSE;
+}
+
+/* Prints the calls the other workers had in flight, as part of the report of
+ * the crash */
+static void df_fuzz_crash_report(void)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+
+        if (!df_crash_guard || !df_crash_reporting)
+                return;
+
+        locker = g_mutex_locker_new(&df_crash_guard->lock);
+        if (df_crash_guard->in_flight->len == 0)
+                return;
+
+        df_fail("   -- %u other worker(s) had calls in flight as well:\n", df_crash_guard->in_flight->len);
+        for (guint i = 0; i < df_crash_guard->in_flight->len; i++)
+                df_fail("%s", (const char *) g_ptr_array_index(df_crash_guard->in_flight, i));
+        g_ptr_array_set_size(df_crash_guard->in_flight, 0);
+}
+
+void df_fuzz_crash_handled(void)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+
+        if (!df_crash_guard || !df_crash_reporting)
+                return;
+
+        locker = g_mutex_locker_new(&df_crash_guard->lock);
+        df_crash_guard->generation++;
+        df_crash_guard->reporting = FALSE;
+        g_ptr_array_set_size(df_crash_guard->in_flight, 0);
+        g_cond_broadcast(&df_crash_guard->cond);
+
+        df_crash_generation = df_crash_guard->generation;
+        df_crash_reporting = FALSE;
+}
+
+/* With parallel workers an unexpected reply may be due to an input of another
+ * worker killing the process, which is then reported as a crash instead */
+static gboolean df_fuzz_crashed_meanwhile(int pid)
+{
+        return df_crash_guard && df_check_if_exited(pid) == 0;
+}
+
+guint64 df_fuzz_member_seed(const char *object, const char *interface, const char *member)
+{
+        const char *parts[] = { object, interface, member };
+        guint64 hash = 0xcbf29ce484222325ULL ^ df_seed;
+
+        for (size_t i = 0; i < G_N_ELEMENTS(parts); i++) {
+                /* Include the terminating NUL as a separator */
+                for (const char *p = parts[i]; ; p++) {
+                        hash ^= (guint8) *p;
+                        hash *= 0x100000001b3ULL;
+                        if (*p == 0)
+                                break;
+                }
+        }
+
+        return hash;
 }
 
 guint64 df_get_number_of_iterations(const char *signature)
@@ -170,68 +495,22 @@ static void df_fuzz_write_log(const struct df_dbus_method *method, GVariant *val
         }
 }
 
-static int df_check_if_exited(const int pid) {
-        g_autoptr(FILE) f = NULL;
-        g_autoptr(char) line = NULL;
-        char proc_pid[14 + DECIMAL_STR_MAX(pid)];
-        size_t len = 0;
-        int dumping;
-
-        g_assert(pid > 0);
-
-        sprintf(proc_pid, "/proc/%d/status", pid);
-
-        f = fopen(proc_pid, "r");
-        if (!f) {
-                if (errno == ENOENT || errno == ENOTDIR || errno == ESRCH)
-                        return 0;
-
-                return -1;
-        }
-
-        /* Check if the process is not currently dumping a core */
-        while (getline(&line, &len, f) > 0) {
-                if (sscanf(line, "CoreDumping: %d", &dumping) == 1) {
-                        if (dumping > 0)
-                                return 0;
-
-                        break;
-                }
-        }
-
-        /* Assume the process exited if we fail while reading the stat file */
-        if (ferror(f))
-                return 0;
-
-        return 1;
-}
-
 /**
- * @function Calls method from df_list (using its name) with its arguments.
- * @param value GVariant tuple containing all method arguments signatures and
- * their values
- * @param void_method If method has out args 1, 0 otherwise
+ * @function Processes a reply (or an error) of a fuzzed method call.
+ * @param method Called method
+ * @param response Reply to the method call, NULL on error
+ * @param error Error returned by the method call, if response is NULL
  * @return 0 on success, -1 on error, 1 if void method returned non-void
  * value or 2 when tested method raised exception (so it should be skipped)
  */
-static int df_fuzz_call_method(const struct df_dbus_method *method, GVariant *value)
+static int df_fuzz_process_method_reply(const struct df_dbus_method *method, GVariant *response, GError *error)
 {
-        g_autoptr(GError) error = NULL;
-        g_autoptr(GVariant) response = NULL;
         g_autoptr(gchar) dbus_error = NULL;
         const gchar *fmt;
 
-        // Synchronously invokes method with arguments stored in value (GVariant *)
-        // on df_dproxy.
-        response = g_dbus_proxy_call_sync(
-                        df_dproxy,
-                        method->name,
-                        value,
-                        G_DBUS_CALL_FLAGS_NONE,
-                        -1,
-                        NULL,
-                        &error);
         if (!response) {
+                g_assert(error);
+
                 if (g_dbus_connection_is_closed(g_dbus_proxy_get_connection(df_dproxy)))
                         return df_fail_ret(2, "%s  %sFAIL%s [M] %s - the connection is closed (this is most likely a bug in dfuzzer, "
                                           "please report it at https://github.com/dbus-fuzzer/dfuzzer together with dbus-daemon/dbus-broker logs)\n",
@@ -245,7 +524,8 @@ static int df_fuzz_call_method(const struct df_dbus_method *method, GVariant *va
                                  * not replying as an error */
                                 return method->expect_reply ? -1 : 0;
                         else if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.Timeout")) {
-                                sleep(10);
+                                (void) df_reconnect_wait_for_reply(g_dbus_proxy_get_connection(df_dproxy),
+                                                                   g_dbus_proxy_get_name(df_dproxy));
                                 return -1;
                         } else if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AccessDenied") ||
                                    g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AuthFailed"))
@@ -276,9 +556,529 @@ static int df_fuzz_call_method(const struct df_dbus_method *method, GVariant *va
         return 0;
 }
 
+/**
+ * @function Checks if the reply is worth mutating the input further: either
+ * a success, or an error raised by the method itself, i.e. the input got past
+ * the argument validation
+ */
+static gboolean df_fuzz_is_interesting_reply(GVariant *response, GError *error)
+{
+        static const char *const boring[] = {
+                "org.freedesktop.DBus.Error.InvalidArgs",
+                "org.freedesktop.DBus.Error.NoReply",
+                "org.freedesktop.DBus.Error.Timeout",
+                "org.freedesktop.DBus.Error.AccessDenied",
+                "org.freedesktop.DBus.Error.AuthFailed",
+        };
+        g_autoptr(gchar) dbus_error = NULL;
+
+        if (response)
+                return TRUE;
+
+        /* Local errors (e.g. timeouts) don't tell anything about the input */
+        dbus_error = g_dbus_error_get_remote_error(error);
+        if (!dbus_error)
+                return FALSE;
+
+        for (size_t i = 0; i < G_N_ELEMENTS(boring); i++)
+                if (g_str_equal(dbus_error, boring[i]))
+                        return FALSE;
+
+        return TRUE;
+}
+
+/* A method call issued asynchronously, together with the input it was issued
+ * with, so we can attribute a bad reply (or a crash) to the exact input even
+ * when multiple calls are in flight */
+typedef struct df_pending_call {
+        GVariant *value;
+        /** Iteration the value was generated in */
+        guint64 iteration;
+        GVariant *response;
+        GError *error;
+        gboolean done;
+        /** Monotonic time the call was issued and its reply arrived at */
+        gint64 issued_usec;
+        gint64 finished_usec;
+} df_pending_call_t;
+
+static void df_pending_call_free(df_pending_call_t *call)
+{
+        if (!call)
+                return;
+
+        safe_g_variant_unref(call->value);
+        safe_g_variant_unref(call->response);
+        if (call->error)
+                g_error_free(call->error);
+        free(call);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_pending_call_t, df_pending_call_free)
+
+static void df_fuzz_call_method_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+        df_pending_call_t *call = user_data;
+
+        call->response = g_dbus_proxy_call_finish(G_DBUS_PROXY(source), result, &call->error);
+        call->finished_usec = g_get_monotonic_time();
+        call->done = TRUE;
+}
+
+/**
+ * @function Calls member of the proxy asynchronously. The reply is collected
+ * by df_fuzz_call_method_done() when the thread-default main context is
+ * iterated.
+ * @param proxy Proxy to call the member on
+ * @param member Name of the member
+ * @param parameters Arguments of the call
+ * @param value Generated value the call is attributed to (the same as
+ * parameters for method calls)
+ * @param cancellable Cancellable used to abort the call prematurely
+ * @return Pending call structure owning the value
+ */
+static df_pending_call_t *df_fuzz_call(GDBusProxy *proxy, const char *member, GVariant *parameters,
+                                       GVariant *value, GCancellable *cancellable)
+{
+        df_pending_call_t *call;
+
+        call = calloc(1, sizeof(*call));
+        if (!call)
+                return NULL;
+
+        call->value = g_variant_ref(value);
+        call->issued_usec = g_get_monotonic_time();
+
+        g_dbus_proxy_call(
+                        proxy,
+                        member,
+                        parameters,
+                        G_DBUS_CALL_FLAGS_NONE,
+                        df_bus_get_call_timeout(),
+                        cancellable,
+                        df_fuzz_call_method_done,
+                        call);
+
+        return call;
+}
+
+/**
+ * @function Calls method from df_list (using its name) with its arguments
+ * asynchronously, see df_fuzz_call().
+ * @param method Method to call
+ * @param value GVariant tuple containing all method arguments signatures and
+ * their values
+ * @param cancellable Cancellable used to abort the call prematurely
+ * @return Pending call structure owning the value
+ */
+static df_pending_call_t *df_fuzz_call_method(const struct df_dbus_method *method, GVariant *value,
+                                              GCancellable *cancellable)
+{
+        return df_fuzz_call(df_dproxy, method->name, value, value, cancellable);
+}
+
+static void df_fuzz_wait_for_call(GMainContext *context, df_pending_call_t *call)
+{
+        while (!call->done)
+                g_main_context_iteration(context, TRUE);
+}
+
+/* Wait until all pending calls finish (or get cancelled) and free them */
+static void df_fuzz_drain_calls(GMainContext *context, GQueue *pending, GCancellable *cancellable)
+{
+        df_pending_call_t *call;
+
+        if (cancellable)
+                g_cancellable_cancel(cancellable);
+
+        while ((call = g_queue_pop_head(pending))) {
+                df_fuzz_wait_for_call(context, call);
+                df_pending_call_free(call);
+        }
+}
+
+/* Find the input responsible for the death of the tested process. Assuming
+ * the process handles incoming calls in order, it's the first call which
+ * didn't get a reply, or the last one we sent if all of them got a reply. */
+static GVariant *df_fuzz_find_crashing_input(GMainContext *context, GQueue *pending, guint64 *ret_iteration)
+{
+        df_pending_call_t *culprit = NULL;
+
+        for (GList *l = pending->head; l; l = l->next) {
+                df_pending_call_t *call = l->data;
+
+                df_fuzz_wait_for_call(context, call);
+                if (!culprit && !call->response)
+                        culprit = call;
+        }
+
+        if (!culprit)
+                culprit = g_queue_peek_tail(pending);
+
+        *ret_iteration = culprit->iteration;
+        return g_variant_ref(culprit->value);
+}
+
+/* Calls since the last passing check of the -e command */
+typedef struct df_command_batch {
+        GPtrArray *inputs;
+        /** Iteration of the first input */
+        guint64 first;
+        /** Number of calls after which the check failed, 0 if it didn't */
+        guint n_failed;
+        /** TRUE if the input the check started to fail after was found by
+          * bisecting the batch */
+        gboolean bisected;
+} df_command_batch_t;
+
+static void df_command_batch_clear(df_command_batch_t *batch)
+{
+        if (batch->inputs)
+                g_ptr_array_unref(batch->inputs);
+        memset(batch, 0, sizeof(*batch));
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(df_command_batch_t, df_command_batch_clear)
+
+/**
+ * @function Finds the call of a failing batch the -e command started to fail
+ * after: prefixes of the batch are sent again, one call at a time, and the
+ * command is run after each of them. Like --bisect of --replay= this assumes
+ * that once a prefix makes the command fail, all longer ones do as well, and
+ * that the command passes again once the effect of the failing calls is
+ * gone, which is checked before each probe.
+ * @param ret_index Where the index of the culprit in the batch is stored
+ * @return 0 on success, 1 if the command keeps failing, so the culprit can't
+ * be found, -1 on error
+ */
+static int df_fuzz_bisect_command(df_command_t *command, const struct df_dbus_method *method,
+                                  const char *obj, const char *intf, GMainContext *context,
+                                  const df_command_batch_t *batch, guint *ret_index)
+{
+        guint64 last = batch->first + batch->inputs->len - 1;
+        guint lo = 0, hi = batch->inputs->len, n_probes = 0;
+        int r;
+
+        /* The whole batch fails, no prefix of it is known to pass */
+        while (hi - lo > 1) {
+                guint mid = lo + (hi - lo) / 2;
+
+                r = df_command_run(command, obj, intf, method->name, last);
+                if (r < 0)
+                        return -1;
+                if (r > 0) {
+                        df_debug("    '%s' keeps failing, can't bisect the batch\n", command->command);
+                        return 1;
+                }
+
+                for (guint j = 0; j < mid; j++) {
+                        g_autoptr(df_pending_call_t) call = NULL;
+
+                        call = df_fuzz_call_method(method, g_ptr_array_index(batch->inputs, j), NULL);
+                        if (!call)
+                                return df_oom();
+                        df_fuzz_wait_for_call(context, call);
+                }
+
+                r = df_command_run(command, obj, intf, method->name, batch->first + mid - 1);
+                if (r < 0)
+                        return -1;
+                if (r > 0)
+                        hi = mid;
+                else
+                        lo = mid;
+                n_probes++;
+        }
+
+        df_debug("    Bisected the batch of %u calls to iteration %"G_GUINT64_FORMAT" in %u probe(s)\n",
+                 batch->inputs->len, batch->first + hi - 1, n_probes);
+        *ret_index = hi - 1;
+
+        return 0;
+}
+
+/**
+ * @function Runs the -e command after the calls in the batch; if it fails
+ * after more than one call, the batch is bisected
+ * @param value Input of the last call, replaced by the culprit if the batch
+ * was bisected
+ * @param value_iteration Iteration of value, replaced along with it
+ * @return 0 if the check passed (and the batch is emptied), its exit status
+ * if it failed, -1 on error
+ */
+static int df_fuzz_check_batch(df_command_t *command, const struct df_dbus_method *method,
+                               const char *obj, const char *intf, GMainContext *context,
+                               df_command_batch_t *batch, GVariant **value, guint64 *value_iteration)
+{
+        guint index;
+        int r, k;
+
+        r = df_command_run(command, obj, intf, method->name, batch->first + batch->inputs->len - 1);
+        if (r <= 0) {
+                g_ptr_array_set_size(batch->inputs, 0);
+                return r;
+        }
+
+        df_fail("%s  %sFAIL%s [M] %s - '%s' returned %s%d%s\n",
+                ansi_cr(), ansi_red(), ansi_normal(), method->name,
+                command->command, ansi_red(), r, ansi_normal());
+
+        batch->n_failed = batch->inputs->len;
+        if (batch->n_failed == 1)
+                return r;
+
+        k = df_fuzz_bisect_command(command, method, obj, intf, context, batch, &index);
+        if (k < 0)
+                return -1;
+        if (k == 0) {
+                batch->bisected = TRUE;
+                *value = safe_g_variant_unref(*value);
+                *value = g_variant_ref(g_ptr_array_index(batch->inputs, index));
+                *value_iteration = batch->first + index;
+        }
+
+        return r;
+}
+
+/* Account a finished call in the method's statistics; it has to be done
+ * before the reply is processed, since that strips the remote error name */
+static void df_fuzz_update_stats(df_method_stats_t *stats, const df_pending_call_t *call)
+{
+        gchar *error_name;
+
+        stats->calls++;
+        stats->latency_usec += call->finished_usec - call->issued_usec;
+
+        if (!call->error)
+                return;
+
+        stats->exceptions++;
+        error_name = g_dbus_error_get_remote_error(call->error);
+        if (!error_name)
+                error_name = g_strdup(g_quark_to_string(call->error->domain));
+        if (g_hash_table_add(stats->error_names, error_name))
+                stats->new_errors++;
+}
+
+/** Latency of the calls of a single method */
+typedef struct df_latency {
+        df_histogram_t all;
+        /** Calls since the last complete window */
+        df_histogram_t window;
+        /** Median latency of the first window */
+        guint64 baseline_usec;
+        gboolean have_baseline;
+        /** Median latency of the first window (or the latency of the first
+          * call timing out) which was substantially worse than the baseline,
+          * 0 if there was none */
+        guint64 regression_usec;
+} df_latency_t;
+
+/** Latency of the calls of a single member, for the final summary */
+typedef struct df_latency_record {
+        char *member;
+        guint64 calls;
+        guint64 p50;
+        guint64 p99;
+        guint64 max;
+} df_latency_record_t;
+
+/** Latencies of all calls and of the individual methods, protected by
+  * the lock, since all workers contribute to them */
+static GMutex df_latency_lock;
+static df_histogram_t df_latency_total;
+static GPtrArray *df_latency_records;
+/** Totals of all df_fuzz_test_method() runs, protected by the same lock */
+static guint64 df_total_calls;
+/** Size of the generated (serialized) inputs */
+static guint64 df_total_bytes;
+/** Time spent in the call loops */
+static gint64 df_total_usec;
+
+static void df_latency_record_free(df_latency_record_t *record)
+{
+        if (!record)
+                return;
+
+        free(record->member);
+        free(record);
+}
+
+static void df_latency_add(df_latency_t *latency, const df_pending_call_t *call)
+{
+        guint64 p50;
+
+        if (call->finished_usec == 0)
+                return;
+
+        df_histogram_add(&latency->all, call->finished_usec - call->issued_usec);
+        df_histogram_add(&latency->window, call->finished_usec - call->issued_usec);
+        if (latency->window.count < DF_LATENCY_WINDOW)
+                return;
+
+        p50 = df_histogram_percentile(&latency->window, 50);
+        if (!latency->have_baseline) {
+                latency->baseline_usec = p50;
+                latency->have_baseline = TRUE;
+        } else if (latency->regression_usec == 0 &&
+                   p50 > MAX(latency->baseline_usec * DF_LATENCY_REGRESSION_FACTOR, DF_LATENCY_REGRESSION_MIN_USEC))
+                latency->regression_usec = p50;
+
+        df_histogram_reset(&latency->window);
+}
+
+/* Formats a duration into buf, using a unit matching its magnitude */
+static const char *df_latency_format(guint64 usec, char *buf, size_t size)
+{
+        if (usec < 1000)
+                snprintf(buf, size, "%"G_GUINT64_FORMAT" us", usec);
+        else if (usec < G_USEC_PER_SEC)
+                snprintf(buf, size, "%.1f ms", usec / 1000.0);
+        else
+                snprintf(buf, size, "%.2f s", usec / (double) G_USEC_PER_SEC);
+
+        return buf;
+}
+
+/* Returns " (p50 ..., p99 ..., max ...)" for the histogram, or an empty string
+ * if it's empty */
+static char *df_latency_summary(const df_histogram_t *h)
+{
+        char p50[32], p99[32], max[32];
+
+        if (h->count == 0)
+                return g_strdup("");
+
+        return g_strdup_printf(" (p50 %s, p99 %s, max %s)",
+                               df_latency_format(df_histogram_percentile(h, 50), p50, sizeof(p50)),
+                               df_latency_format(df_histogram_percentile(h, 99), p99, sizeof(p99)),
+                               df_latency_format(h->max, max, sizeof(max)));
+}
+
+/* Adds latencies of the member to the final summary */
+static void df_latency_save(const char *obj, const char *intf, const char *member, const df_histogram_t *h)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        df_latency_record_t *record;
+
+        if (h->count == 0)
+                return;
+
+        record = calloc(1, sizeof(*record));
+        if (!record)
+                return;
+
+        record->member = g_strdup_printf("%s %s.%s", obj, intf, member);
+        record->calls = h->count;
+        record->p50 = df_histogram_percentile(h, 50);
+        record->p99 = df_histogram_percentile(h, 99);
+        record->max = h->max;
+
+        locker = g_mutex_locker_new(&df_latency_lock);
+        if (!df_latency_records)
+                df_latency_records = g_ptr_array_new_with_free_func((GDestroyNotify) df_latency_record_free);
+        g_ptr_array_add(df_latency_records, record);
+        df_histogram_merge(&df_latency_total, h);
+}
+
+static void df_fuzz_account(guint64 calls, guint64 bytes, gint64 start_usec)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+
+        locker = g_mutex_locker_new(&df_latency_lock);
+        df_total_calls += calls;
+        df_total_bytes += bytes;
+        df_total_usec += g_get_monotonic_time() - start_usec;
+}
+
+void df_fuzz_print_throughput_summary(void)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        struct rusage usage = {};
+        double seconds;
+
+        locker = g_mutex_locker_new(&df_latency_lock);
+        if (df_total_usec <= 0)
+                return;
+
+        seconds = df_total_usec / (double) G_USEC_PER_SEC;
+        (void) getrusage(RUSAGE_SELF, &usage);
+        fprintf(stderr, "%s[THROUGHPUT: %.0f calls/s, %.0f B/s generated, peak RSS %ld kB]%s\n", ansi_cyan(),
+                df_total_calls / seconds, df_total_bytes / seconds, usage.ru_maxrss, ansi_normal());
+}
+
+static gint df_latency_record_compare(gconstpointer a, gconstpointer b)
+{
+        const df_latency_record_t *x = *(df_latency_record_t * const *) a;
+        const df_latency_record_t *y = *(df_latency_record_t * const *) b;
+
+        /* Slowest first */
+        if (x->p99 != y->p99)
+                return x->p99 < y->p99 ? 1 : -1;
+        if (x->max != y->max)
+                return x->max < y->max ? 1 : -1;
+
+        return 0;
+}
+
+void df_fuzz_print_latency_summary(void)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        g_autoptr(gchar) summary = NULL;
+        char p99[32], max[32];
+
+        locker = g_mutex_locker_new(&df_latency_lock);
+        if (df_latency_total.count == 0)
+                return;
+
+        summary = df_latency_summary(&df_latency_total);
+        fprintf(stderr, "%s[LATENCY: %"G_GUINT64_FORMAT" calls%s]%s\n", ansi_cyan(),
+                df_latency_total.count, summary, ansi_normal());
+
+        g_ptr_array_sort(df_latency_records, df_latency_record_compare);
+        for (guint i = 0; i < MIN(df_latency_records->len, DF_LATENCY_SUMMARY_TOP); i++) {
+                const df_latency_record_t *record = g_ptr_array_index(df_latency_records, i);
+
+                df_verbose("  p99 %s, max %s: %s (%"G_GUINT64_FORMAT" calls)\n",
+                           df_latency_format(record->p99, p99, sizeof(p99)),
+                           df_latency_format(record->max, max, sizeof(max)),
+                           record->member, record->calls);
+        }
+}
+
+/* Command line testing the method up to iteration i the same way */
+static gchar *df_fuzz_reproducer(const char *name, const char *obj, const char *intf, const char *member,
+                                 df_command_t *command, guint64 offset, guint64 i)
+{
+        GString *s;
+
+        s = g_string_new(NULL);
+        g_string_append_printf(s, "dfuzzer -v -n %s -o %s -i %s -t %s", name, obj, intf, member);
+        g_string_append_printf(s, " -b %"G_GUINT64_FORMAT, fuzz_buffer_length);
+        if (df_message_size > 0)
+                g_string_append_printf(s, " --message-size=%"G_GUINT64_FORMAT, df_message_size);
+        g_string_append_printf(s, " --seed=%"G_GUINT64_FORMAT, df_seed);
+        if (df_inflight > 1)
+                g_string_append_printf(s, " --inflight=%u", df_inflight);
+        if (df_generator == DF_PLAN_BACKEND_WIRE)
+                g_string_append(s, " --generator=wire");
+        /* Reach the same iteration when the method was tested in slices */
+        if (offset > 0)
+                g_string_append_printf(s, " -I %"G_GUINT64_FORMAT, i);
+        if (command) {
+                g_string_append_printf(s, " -e '%s'", command->command);
+                if (command->coprocess)
+                        g_string_append(s, " --command-coprocess");
+        }
+
+        return g_string_free(s, FALSE);
+}
+
 /**
  * @function Function is testing a method in a cycle, each cycle generates
- * data for function arguments, calls method and waits for result.
+ * data for function arguments, calls method and waits for result. If more
+ * than one call is allowed to be in flight (see df_fuzz_set_inflight()),
+ * calls are pipelined and their replies are processed in order.
  * @param statfd FD of process status file
  * @param buf_size Maximum buffer size for generated strings
  * by rand module (in Bytes)
@@ -287,172 +1087,558 @@ static int df_fuzz_call_method(const struct df_dbus_method *method, GVariant *va
  * @param intf D-Bus interface
  * @param pid PID of tested process
  * @param void_method If method has out args 1, 0 otherwise
- * @param execute_cmd Command/Script to execute after each method call.
+ * @param command Check specified via -e/--command, NULL if there's none
+ * @param offset Number of the first iteration
+ * @param iterations Number of iterations to do
+ * @param stats If not NULL, statistics of the calls are added to it
  * @return 0 on success, -1 on error, 1 on tested process crash, 2 on void
- * function returning non-void value, 3 on warnings and 4 when executed
- * command finished unsuccessfuly
+ * function returning non-void value, 3 on warnings (e.g. a latency
+ * regression), 4 when executed command finished unsuccessfuly and 5 when
+ * another worker reported the crash of the process
  */
-int df_fuzz_test_method(
+static int df_fuzz_run_method(
                 const struct df_dbus_method *method, const char *name,
-                const char *obj, const char *intf, const int pid, const char *execute_cmd,
-                guint64 iterations)
+                const char *obj, const char *intf, const int pid, df_command_t *command,
+                guint64 offset, guint64 iterations, df_method_stats_t *stats)
 {
+        g_autoptr(GMainContext) context = NULL;
+        g_autoptr(GCancellable) cancellable = NULL;
+        g_autoptr(df_plan_t) plan = NULL;
+        g_autoptr(GByteArray) buffer = NULL;
+        g_autoptr(df_arena_t) arena = NULL;
+        g_autoptr(df_monitor_t) monitor = NULL;
+        g_autoptr(df_corpus_t) corpus = NULL;
+        g_autoptr(df_producer_t) producer = NULL;
         g_autoptr(GVariant) value = NULL;
-        int ret = 0;            // return value from df_fuzz_call_method()
-        int execr = 0;          // return value from execution of execute_cmd
-
-        df_debug("  Method: %s%s %s => %"G_GUINT64_FORMAT" iterations%s\n", ansi_bold(),
-                 method->name, method->signature, iterations, ansi_normal());
+        g_autoptr(gchar) summary = NULL, reproducer = NULL;
+        g_auto(df_command_batch_t) batch = {};
+        GQueue pending = G_QUEUE_INIT;
+        df_latency_t latency = {0,};
+        df_rand_t rnd;
+        guint64 n_bytes = 0;
+        gint64 start_usec;
+        guint64 stale = 0;
+        gsize arena_total = 0, arena_peak = 0, arena_used;
+        guint in_flight = 0;
+        guint64 i = offset, end = offset + iterations, seed, value_iteration = 0;
+        gboolean interesting;
+        int ret = 0;            // return value from df_fuzz_process_method_reply()
+        int execr = 0;          // return value of the -e command
+        int r = 0;
+
+        if (offset > 0)
+                df_debug("  Method: %s%s %s => iterations %"G_GUINT64_FORMAT"-%"G_GUINT64_FORMAT"%s\n", ansi_bold(),
+                         method->name, method->signature, offset, end - 1, ansi_normal());
+        else
+                df_debug("  Method: %s%s %s => %"G_GUINT64_FORMAT" iterations%s\n", ansi_bold(),
+                         method->name, method->signature, iterations, ansi_normal());
 
         df_verbose("  [M] %s...", method->name);
 
-        df_except_counter = 0;
+        /* Continue where the previous slice of the method left off */
+        df_except_counter = stats ? stats->except_counter : 0;
+        stale = stats ? stats->stale : 0;
+        seed = df_fuzz_member_seed(obj, intf, method->name);
+
+        /* Compile the signature only once for all iterations */
+        plan = df_fuzz_plan_new(method->signature,
+                                (const char *[]) { name, obj, intf, method->name, method->signature, NULL });
+        if (!plan)
+                return df_debug_ret(-1, "Failed to compile signature '%s'\n", method->signature);
+
+        /* Scratch buffer for the wire generator, reused by all iterations */
+        buffer = g_byte_array_new();
+        /* Scratch memory for generated strings, reset after each call */
+        arena = df_arena_new();
+        if (!arena)
+                return df_oom();
+        rnd.arena = arena;
+
+        /* Watch the process in the background, so we don't have to go through
+         * /proc after each call */
+        monitor = df_monitor_new(pid);
+        if (!monitor)
+                return df_fail_ret(-1, "Failed to start monitoring process %d\n", pid);
+
+        if (df_coverage || df_mutate_interesting) {
+                corpus = df_corpus_new();
+                if (!corpus)
+                        return df_oom();
+        }
 
-        for (guint64 i = 0; i < iterations; i++) {
-                int r;
+        /* Inputs mutated from the corpus depend on the replies so far, so
+         * they can't be generated ahead */
+        if (df_generator_threads > 0 && !corpus) {
+                producer = df_producer_new(plan, df_generator, seed, offset, end, df_generator_threads);
+                if (!producer)
+                        return -1;
+        }
 
-                value = safe_g_variant_unref(value);
+        if (command)
+                batch.inputs = g_ptr_array_new_with_free_func((GDestroyNotify) g_variant_unref);
+
+        /* Don't attribute whatever happened so far to this method */
+        if (df_coverage)
+                (void) df_coverage_collect(df_coverage);
+
+        /* Replies to the asynchronous calls are dispatched in this context,
+         * which is iterated only by us */
+        context = g_main_context_new();
+        cancellable = g_cancellable_new();
+        g_main_context_push_thread_default(context);
+        start_usec = g_get_monotonic_time();
+
+        while (i < end || !g_queue_is_empty(&pending)) {
+                g_autoptr(df_pending_call_t) call = NULL;
+
+                /* Keep up to df_inflight calls in flight */
+                while (i < end && g_queue_get_length(&pending) < df_inflight) {
+                        g_autoptr(GVariant) input = NULL;
+                        df_pending_call_t *c;
+
+                        /* Create a random GVariant based on method's signature; seed
+                         * each iteration separately, so any of them can be replayed */
+                        if (producer)
+                                /* Generated ahead the very same way on the producer's
+                                 * threads */
+                                input = df_producer_take(producer, i, &arena_used);
+                        else {
+                                df_rand_init(&rnd, seed + i);
+                                if (corpus && df_corpus_size(corpus) > 0 && df_rand_next(&rnd) % 2)
+                                        /* Mutate inputs which reached new code (or got
+                                         * interesting replies) half of the time */
+                                        input = df_mutate(&rnd, df_corpus_pick(corpus, &rnd), i);
+                                else {
+                                        input = df_plan_generate_with(plan, df_generator, &rnd, i, buffer);
+                                        /* Convert the floating variant reference into a full one */
+                                        if (input)
+                                                input = g_variant_ref_sink(input);
+                                }
+                                arena_used = df_arena_get_used(arena);
+                        }
+                        if (!input) {
+                                r = df_debug_ret(-1, "Failed to generate a variant for signature '%s'\n", method->signature);
+                                goto finish;
+                        }
+
+                        n_bytes += g_variant_get_size(input);
+                        df_metrics_add_bytes(g_variant_get_size(input));
+                        c = df_fuzz_call_method(method, input, cancellable);
+                        if (!c) {
+                                r = df_oom();
+                                goto finish;
+                        }
+                        c->iteration = i;
+
+                        /* The input holds its own copy of the data */
+                        arena_total += arena_used;
+                        arena_peak = MAX(arena_peak, arena_used);
+                        df_arena_reset(arena);
+
+                        g_queue_push_tail(&pending, c);
+                        i++;
+                }
 
-                /* Create a random GVariant based on method's signature */
-                value = df_generate_random_from_signature(method->signature, i);
-                if (!value)
-                        return df_debug_ret(-1, "Failed to generate a variant for signature '%s'\n", method->signature);
+                /* Process the replies in the same order the calls were issued */
+                call = g_queue_pop_head(&pending);
+                df_fuzz_wait_for_call(context, call);
+                df_latency_add(&latency, call);
+                df_metrics_add_call(call->error, call->finished_usec - call->issued_usec);
 
-                /* Convert the floating variant reference into a full one */
-                value = g_variant_ref_sink(value);
-                ret = df_fuzz_call_method(method, value);
-                execr = execute_cmd ? df_execute_external_command(execute_cmd, show_command_output) : 0;
+                value = safe_g_variant_unref(value);
+                value = g_variant_ref(call->value);
+                value_iteration = call->iteration;
+                if (stats)
+                        df_fuzz_update_stats(stats, call);
+                /* Before the reply processing strips the remote error name */
+                interesting = df_fuzz_is_interesting_reply(call->response, call->error);
+                ret = df_fuzz_process_method_reply(method, call->response, call->error);
+                if (command) {
+                        /* Keep the inputs since the last check, so a failing
+                         * batch can be bisected */
+                        if (batch.inputs->len == 0)
+                                batch.first = value_iteration;
+                        g_ptr_array_add(batch.inputs, g_variant_ref(value));
+                        if (df_command_is_due(command, batch.inputs->len))
+                                execr = df_fuzz_check_batch(command, method, obj, intf, context, &batch,
+                                                            &value, &value_iteration);
+                }
 
-                if (ret < 0) {
+                /* With parallel workers the reply may be due to an input of
+                 * another worker killing the process, see below */
+                if (ret < 0 && !(df_crash_guard && df_monitor_check(monitor) == 0)) {
                         df_fail("%s  %sFAIL%s [M] %s - unexpected response\n",
                                 ansi_cr(), ansi_red(), ansi_normal(), method->name);
                         break;
                 }
 
-                if (execr < 0)
-                        return df_fail_ret(-1, "df_execute_external_command() failed: %m");
-                else if (execr > 0) {
-                        df_fail("%s  %sFAIL%s [M] %s - '%s' returned %s%d%s\n",
-                                ansi_cr(), ansi_red(), ansi_normal(), method->name,
-                                execute_cmd, ansi_red(), execr, ansi_normal());
+                if (execr < 0) {
+                        r = df_fail_ret(-1, "Error: Failed to run the command '%s'\n", command->command);
+                        goto finish;
+                } else if (execr > 0)
                         break;
-                }
 
-                r = df_check_if_exited(pid);
-                if (r < 0)
-                        return df_fail_ret(-1, "Error while reading process' stat file: %m\n");
-                else if (r == 0) {
+                /* Check the process synchronously after the very last call (and
+                 * after an unexpected reply), since the monitor may be lagging
+                 * behind */
+                if (ret < 0 || (i == end && g_queue_is_empty(&pending)))
+                        r = df_monitor_check(monitor);
+                else
+                        r = df_monitor_is_alive(monitor);
+                if (r < 0) {
+                        r = df_fail_ret(-1, "Error while reading process' stat file: %m\n");
+                        goto finish;
+                } else if (r == 0) {
+                        in_flight = g_queue_get_length(&pending);
+                        if (df_crash_guard) {
+                                g_autoptr(gchar) command_line = NULL;
+
+                                /* Leave the report to the first worker which noticed
+                                 * the crash */
+                                command_line = df_fuzz_reproducer(name, obj, intf, method->name, command, offset, i);
+                                if (!df_fuzz_crash_claim(g_strdup_printf(
+                                                        "      [M] %s (%s on %s), iterations %"G_GUINT64_FORMAT"-%"G_GUINT64_FORMAT"\n"
+                                                        "      reproducer: %s%s%s\n",
+                                                        method->name, intf, obj, value_iteration, i - 1,
+                                                        ansi_yellow(), command_line, ansi_normal()))) {
+                                        r = 5;
+                                        goto finish;
+                                }
+                        }
+
                         ret = -1;
+                        if (in_flight > 0) {
+                                /* The reply to this call arrived before the process
+                                 * died, so blame one of the calls still in flight */
+                                value = safe_g_variant_unref(value);
+                                value = df_fuzz_find_crashing_input(context, &pending, &value_iteration);
+                        }
                         df_fail("%s  %sFAIL%s [M] %s - process %d exited\n",
                                 ansi_cr(), ansi_red(), ansi_normal(), method->name, pid);
                         break;
                 }
+                r = 0;
 
                 /* Ignore exceptions returned by the test method */
-                if (ret == 2)
-                        return 0;
+                if (ret == 2) {
+                        if (stats)
+                                stats->skipped = TRUE;
+
+                        /* A call timing out after the method kept replying
+                         * before means the target hung */
+                        if (latency.have_baseline && call->error &&
+                            g_error_matches(call->error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT)) {
+                                latency.regression_usec = call->finished_usec - call->issued_usec;
+                                ret = 0;
+                                break;
+                        }
+
+                        goto finish;
+                }
                 else if (ret > 0)
                         break;
 
-                df_log_file("%s;%s;", intf, obj);
+                if (corpus && !df_coverage) {
+                        /* Without coverage feedback keep the inputs which got
+                         * past the argument validation */
+                        if (interesting)
+                                df_corpus_add(corpus, &rnd, value);
+                } else if (corpus) {
+                        /* Keep inputs which reached new code and stop once the
+                         * coverage doesn't grow anymore */
+                        guint n_edges = df_coverage_collect(df_coverage);
+
+                        if (stats)
+                                stats->new_edges += n_edges;
+
+                        if (n_edges > 0) {
+                                df_corpus_add(corpus, &rnd, value);
+                                stale = 0;
+                        } else if (++stale >= df_coverage_plateau && i < end) {
+                                df_debug("    No new coverage in %"G_GUINT64_FORMAT" iterations, stopping after %"G_GUINT64_FORMAT"/%"G_GUINT64_FORMAT"\n",
+                                         stale, i, end);
+                                /* Don't issue any more calls, just process the ones in flight */
+                                end = i;
+                                if (stats)
+                                        stats->ended_early = TRUE;
+                        }
+                }
 
-                if (df_log_file_is_open())
+                if (df_binlog_is_enabled())
+                        df_binlog_write_call(DF_BINLOG_SUCCESS, intf, obj, method->name, method->signature,
+                                             seed, value_iteration, value);
+                else if (df_log_file_is_open()) {
+                        df_log_lock();
+                        df_log_file("%s;%s;", intf, obj);
                         df_fuzz_write_log(method, value);
-                df_log_file("Success\n");
+                        df_log_file("Success\n");
+                        df_log_unlock();
+                }
 
-                if (df_except_counter == MAX_EXCEPTIONS)
+                if (df_except_counter >= MAX_EXCEPTIONS) {
+                        if (stats)
+                                stats->ended_early = TRUE;
                         break;
+                }
+        }
+
+        if (stats) {
+                stats->except_counter = df_except_counter;
+                stats->stale = stale;
         }
 
+        /* Check the rest of the calls, i.e. all of them with
+         * --command-interval=end */
+        if (command && ret == 0 && execr == 0 && batch.inputs->len > 0) {
+                execr = df_fuzz_check_batch(command, method, obj, intf, context, &batch, &value, &value_iteration);
+                if (execr < 0) {
+                        r = df_fail_ret(-1, "Error: Failed to run the command '%s'\n", command->command);
+                        goto finish;
+                }
+        }
+
+        df_fuzz_drain_calls(context, &pending, cancellable);
+        g_main_context_pop_thread_default(context);
+
+        if (i > offset)
+                df_debug("    Arena: %"G_GSIZE_FORMAT" B/iteration on average, %"G_GSIZE_FORMAT" B peak\n",
+                         arena_total / (i - offset), arena_peak);
+        if (corpus && df_coverage)
+                df_debug("    Coverage: %"G_GUINT64_FORMAT" edges in total, %u input(s) in corpus\n",
+                         df_coverage->n_edges, df_corpus_size(corpus));
+        else if (corpus)
+                df_debug("    Mutation pool: %u input(s) with interesting replies\n", df_corpus_size(corpus));
+
+        df_fuzz_account(i - offset, n_bytes, start_usec);
+        df_latency_save(obj, intf, method->name, &latency.all);
+        summary = df_latency_summary(&latency.all);
+
         if (ret != 0 || execr != 0)
                 goto fail_label;
 
-        df_verbose("%s  %sPASS%s [M] %s\n",
-                   ansi_cr(), ansi_green(), ansi_normal(), method->name);
+        if (latency.regression_usec > 0) {
+                char baseline[32], regression[32];
+
+                df_fail("%s  %sWARN%s [M] %s - latency regression: %s after a median of %s in the first %d calls%s\n",
+                        ansi_cr(), ansi_yellow(), ansi_normal(), method->name,
+                        df_latency_format(latency.regression_usec, regression, sizeof(regression)),
+                        df_latency_format(latency.baseline_usec, baseline, sizeof(baseline)),
+                        DF_LATENCY_WINDOW, summary);
+                return 3;
+        }
+
+        df_verbose("%s  %sPASS%s [M] %s%s\n",
+                   ansi_cr(), ansi_green(), ansi_normal(), method->name, summary);
         return 0;
 
 
 fail_label:
+        df_log_lock();
+        if (!isempty(summary))
+                df_fail("   latency:%s\n", summary);
         if (ret != 1) {
                 df_fail("   on input:\n");
                 df_log_file("%s;%s;", intf, obj);
                 df_fuzz_write_log(method, value);
         }
 
-        df_fail("   reproducer: %sdfuzzer -v -n %s -o %s -i %s -t %s",
-                ansi_yellow(), name, obj, intf, method->name);
-        df_fail(" -b %"G_GUINT64_FORMAT, fuzz_buffer_length);
-        if (execute_cmd != NULL)
-                df_fail(" -e '%s'", execute_cmd);
-        df_fail("%s\n", ansi_normal());
+        if (in_flight > 0)
+                df_fail("   -- %u other call(s) were in flight when the process exited\n", in_flight);
+        df_fuzz_crash_report();
+        if (batch.n_failed > 1 && batch.bisected)
+                df_fail("   -- '%s' failed after a batch of %u calls, the input was found by bisecting it\n",
+                        command->command, batch.n_failed);
+        else if (batch.n_failed > 1)
+                df_fail("   -- '%s' failed after a batch of %u calls and kept failing when it was bisected,\n"
+                        "      the input is the last one of the batch\n", command->command, batch.n_failed);
+
+        reproducer = df_fuzz_reproducer(name, obj, intf, method->name, command, offset, i);
+        df_fail("   reproducer: %s%s%s\n", ansi_yellow(), reproducer, ansi_normal());
+        if (df_coverage)
+                df_fail("   -- note: with coverage feedback the input may be a mutation of an earlier one,\n"
+                        "      so the seed alone may not reproduce it\n");
 
         /* Method with a void return type returned a non-void value */
         if (ret == 1)
-                return 2;
+                r = 2;
         /* Command specified via -e/--command returned a non-zero exit code */
-        if (execr > 0) {
+        else if (execr > 0) {
                 df_log_file("Command execution error\n");
-                return 4;
+                if (df_binlog_is_enabled())
+                        df_binlog_write_call(DF_BINLOG_COMMAND_ERROR, intf, obj, method->name, method->signature,
+                                             seed, value_iteration, value);
+                r = 4;
+        } else {
+                df_log_file("Crash\n");
+                if (df_binlog_is_enabled())
+                        df_binlog_write_call(DF_BINLOG_CRASH, intf, obj, method->name, method->signature,
+                                             seed, value_iteration, value);
+                r = 1;
         }
-        df_log_file("Crash\n");
+        df_log_unlock();
+
+        return r;
 
-        return 1;
+finish:
+        if (stats) {
+                stats->except_counter = df_except_counter;
+                stats->stale = stale;
+        }
+        df_fuzz_drain_calls(context, &pending, cancellable);
+        g_main_context_pop_thread_default(context);
+        df_fuzz_account(i - offset, n_bytes, start_usec);
+        df_latency_save(obj, intf, method->name, &latency.all);
+
+        return r;
 }
 
-static int df_fuzz_get_property(GDBusProxy *pproxy, const char *interface,
-                                const struct df_dbus_property *property)
+int df_fuzz_test_method(
+                const struct df_dbus_method *method, const char *name,
+                const char *obj, const char *intf, const int pid, df_command_t *command,
+                guint64 offset, guint64 iterations, df_method_stats_t *stats)
 {
-        g_autoptr(GVariant) response = NULL;
+        int r;
 
-        response = df_bus_call(pproxy, "Get",
-                               g_variant_new("(ss)", interface, property->name),
-                               G_DBUS_CALL_FLAGS_NONE);
-        if (!response)
-                return -1;
+        if (!df_fuzz_crash_enter())
+                return 5;
+
+        r = df_fuzz_run_method(method, name, obj, intf, pid, command, offset, iterations, stats);
+        df_fuzz_crash_leave();
+
+        return r;
+}
+
+/**
+ * @function Returns the org.freedesktop.DBus.Properties proxy of the object,
+ * reusing the one of the previous call if it's the same object.
+ * @param dcon D-Bus connection structure
+ * @param bus D-Bus name
+ * @param object D-Bus object path
+ * @return Proxy owned by this module on success, NULL on error
+ */
+static GDBusProxy *df_fuzz_get_properties_proxy(GDBusConnection *dcon, const char *bus, const char *object)
+{
+        if (df_pproxy &&
+            g_dbus_proxy_get_connection(df_pproxy) == dcon &&
+            g_str_equal(g_dbus_proxy_get_name(df_pproxy), bus) &&
+            g_str_equal(g_dbus_proxy_get_object_path(df_pproxy), object))
+                return df_pproxy;
+
+        df_pproxy = safe_g_dbus_proxy_unref(df_pproxy);
+
+        /* See: https://dbus.freedesktop.org/doc/dbus-specification.html#standard-interfaces-properties */
+        df_pproxy = df_bus_new(dcon, bus, object, "org.freedesktop.DBus.Properties",
+                               G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
+
+        return df_pproxy;
+}
+
+void df_fuzz_release_properties_proxy(void)
+{
+        df_pproxy = safe_g_dbus_proxy_unref(df_pproxy);
+}
+
+/* Checks the reply to a Get or GetAll call; returns 0 if it's fine, 2 if the
+ * access was denied and -1 on an unexpected response */
+static int df_fuzz_process_get_property_reply(const char *member, const char *name,
+                                              const df_pending_call_t *call, const GVariantType *reply_type)
+{
+        g_autoptr(gchar) dbus_error = NULL;
+
+        if (!call->response) {
+                dbus_error = g_dbus_error_get_remote_error(call->error);
+                if (dbus_error && (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AccessDenied") ||
+                                   g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AuthFailed")))
+                        return df_verbose_ret(2, "%s  %sSKIP%s [P] %s - raised exception '%s'\n",
+                                              ansi_cr(), ansi_blue(), ansi_normal(), name, dbus_error);
+
+                return df_fail_ret(-1, "%sError while calling method '%s': %s\n",
+                                   ansi_cr(), member, call->error->message);
+        }
+
+        if (!g_variant_is_of_type(call->response, reply_type))
+                return df_fail_ret(-1, "%sUnexpected reply of type '%s' to method '%s'\n",
+                                   ansi_cr(), g_variant_get_type_string(call->response), member);
 
         if (df_get_log_level() >= DF_LOG_LEVEL_DEBUG) {
                 g_autoptr(gchar) value_str = NULL;
-                value_str = g_variant_print(response, TRUE);
-                df_debug("Got value for property %s.%s: %s\n", interface, property->name, value_str);
+                value_str = g_variant_print(call->response, TRUE);
+                df_debug("Got value for property %s: %s\n", name, value_str);
         }
 
         return 0;
 }
 
-static int df_fuzz_set_property(GDBusProxy *pproxy, const char *interface,
-                                const struct df_dbus_property *property, GVariant *value)
+/**
+ * @function Issues DF_PROPERTY_READS identical read calls (Get or GetAll) at
+ * once and checks their replies.
+ * @param pproxy Properties proxy of the object
+ * @param member Get or GetAll
+ * @param parameters Arguments of the calls
+ * @param name Name of the property the calls read (for the messages)
+ * @param reply_type Expected type of the replies
+ * @return 0 on success, 1 on unexpected response, 2 if the access was denied,
+ * -1 on error
+ */
+static int df_fuzz_read_properties(GDBusProxy *pproxy, const char *member, GVariant *parameters,
+                                   const char *name, const GVariantType *reply_type)
+{
+        g_autoptr(GMainContext) context = NULL;
+        g_autoptr(GVariant) args = NULL;
+        GQueue pending = G_QUEUE_INIT;
+        df_pending_call_t *call;
+        int r = 0;
+
+        args = g_variant_ref_sink(parameters);
+        context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+
+        for (guint i = 0; i < DF_PROPERTY_READS; i++) {
+                call = df_fuzz_call(pproxy, member, args, args, NULL);
+                if (!call) {
+                        r = df_oom();
+                        break;
+                }
+
+                g_queue_push_tail(&pending, call);
+        }
+
+        while ((call = g_queue_pop_head(&pending))) {
+                df_fuzz_wait_for_call(context, call);
+                df_metrics_add_call(call->error, call->finished_usec - call->issued_usec);
+                if (r == 0) {
+                        r = df_fuzz_process_get_property_reply(member, name, call, reply_type);
+                        if (r < 0)
+                                r = 1;
+                }
+                df_pending_call_free(call);
+        }
+
+        g_main_context_pop_thread_default(context);
+
+        return r;
+}
+
+static int df_fuzz_process_set_property_reply(GDBusProxy *pproxy, const char *interface,
+                                              const struct df_dbus_property *property, df_pending_call_t *call)
 {
-        g_autoptr(GVariant) val = NULL, response = NULL;
-        g_autoptr(GError) error = NULL;
         g_autoptr(gchar) dbus_error = NULL;
 
-        /* Unwrap the variant, since our generator automagically wraps it in a tuple
-         * to make generating method signatures easier. Property signatures should
-         * consist of a single complete type, hence getting the first child from
-         * the tuple should achieve just that. */
-        val = g_variant_get_child_value(value, 0);
-        response = g_dbus_proxy_call_sync(
-                        pproxy,
-                        "Set",
-                        g_variant_new("(ssv)", interface, property->name, val),
-                        G_DBUS_CALL_FLAGS_NONE,
-                        -1,
-                        NULL,
-                        &error);
-        if (!response) {
+        if (!call->response) {
                 if (g_dbus_connection_is_closed(g_dbus_proxy_get_connection(pproxy)))
                         return df_fail_ret(2, "%s  %sFAIL%s [P] %s - the connection is closed (this is most likely a bug in dfuzzer, "
                                           "please report it at https://github.com/dbus-fuzzer/dfuzzer together with dbus-daemon/dbus-broker logs)\n",
                                            ansi_cr(), ansi_red(), ansi_normal(), property->name);
 
-                dbus_error = g_dbus_error_get_remote_error(error);
+                dbus_error = g_dbus_error_get_remote_error(call->error);
                 if (dbus_error) {
                         if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.NoReply"))
                                 /* If the property is annotated as "NoReply", don't consider
                                  * not replying as an error */
                                 return property->expect_reply ? -1 : 0;
                         else if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.Timeout")) {
-                                sleep(10);
+                                (void) df_reconnect_wait_for_reply(g_dbus_proxy_get_connection(pproxy),
+                                                                   g_dbus_proxy_get_name(pproxy));
                                 return -1;
                         } else if (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AccessDenied") ||
                                    g_str_equal(dbus_error, "org.freedesktop.DBus.Error.AuthFailed"))
@@ -461,113 +1647,287 @@ static int df_fuzz_set_property(GDBusProxy *pproxy, const char *interface,
                                                       property->name, dbus_error);
                 }
 
-                g_dbus_error_strip_remote_error(error);
-                if (strstr(error->message, "Timeout"))
+                g_dbus_error_strip_remote_error(call->error);
+                if (strstr(call->error->message, "Timeout"))
                         return df_verbose_ret(2, "%s  %sSKIP%s [P] %s - timeout reached\n",
                                               ansi_cr(), ansi_blue(), ansi_normal(), property->name);
 
                 df_debug("%s  EXCE [P] %s - D-Bus exception thrown: %s\n",
-                         ansi_cr(), property->name, error->message);
+                         ansi_cr(), property->name, call->error->message);
                 df_except_counter++;
                 return 0;
         }
 
         if (df_get_log_level() >= DF_LOG_LEVEL_DEBUG) {
                 g_autoptr(gchar) value_str = NULL;
-                value_str = g_variant_print(value, TRUE);
+                value_str = g_variant_print(call->value, TRUE);
                 df_debug("Set value for property %s.%s: %s\n", interface, property->name, value_str);
         }
 
         return 0;
 }
 
-int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *property,
-                          const char *bus, const char *object, const char *interface,
-                          const int pid, guint64 iterations)
+/**
+ * @function Writes random values to the property, keeping up to df_inflight
+ * Set calls in flight the same way df_fuzz_test_method() does, until the
+ * property refuses the writes or raises MAX_EXCEPTIONS exceptions.
+ * @return 0 on success, 1 on unexpected response, 2 if the property was
+ * skipped (access denied, timeout, ...), -1 on error
+ */
+static int df_fuzz_write_property(GDBusProxy *pproxy, const struct df_dbus_property *property,
+                                  const char *object, const char *interface, guint64 iterations)
 {
-        g_autoptr(GDBusProxy) pproxy = NULL;
-        int r;
+        g_autoptr(GMainContext) context = NULL;
+        g_autoptr(GCancellable) cancellable = NULL;
+        g_autoptr(df_plan_t) plan = NULL;
+        g_autoptr(GByteArray) buffer = NULL;
+        g_autoptr(df_arena_t) arena = NULL;
+        GQueue pending = G_QUEUE_INIT;
+        df_rand_t rnd;
+        guint64 seed, i = 0;
+        int k, r = 0;
+
+        df_except_counter = 0;
+        seed = df_fuzz_member_seed(object, interface, property->name);
+        plan = df_fuzz_plan_new(property->signature,
+                                (const char *[]) { g_dbus_proxy_get_name(pproxy), object,
+                                                   "org.freedesktop.DBus.Properties", "Set", "ssv",
+                                                   interface, property->name, NULL });
+        if (!plan)
+                return df_debug_ret(-1, "Failed to compile signature '%s'\n", property->signature);
+
+        buffer = g_byte_array_new();
+        arena = df_arena_new();
+        if (!arena)
+                return df_oom();
+        rnd.arena = arena;
+
+        context = g_main_context_new();
+        cancellable = g_cancellable_new();
+        g_main_context_push_thread_default(context);
+
+        while (i < iterations || !g_queue_is_empty(&pending)) {
+                g_autoptr(df_pending_call_t) call = NULL;
+
+                while (i < iterations && g_queue_get_length(&pending) < df_inflight) {
+                        g_autoptr(GVariant) value = NULL, val = NULL;
+                        df_pending_call_t *c;
+
+                        /* Create a random GVariant based on method's signature */
+                        df_rand_init(&rnd, seed + i);
+                        value = df_plan_generate_with(plan, df_generator, &rnd, i, buffer);
+                        if (!value) {
+                                r = df_debug_ret(-1, "Failed to generate a variant for signature '%s'\n", property->signature);
+                                goto finish;
+                        }
+
+                        /* Convert the floating variant reference into a full one */
+                        value = g_variant_ref_sink(value);
+                        df_arena_reset(arena);
+
+                        /* Unwrap the variant, since our generator automagically wraps it in a tuple
+                         * to make generating method signatures easier. Property signatures should
+                         * consist of a single complete type, hence getting the first child from
+                         * the tuple should achieve just that. */
+                        val = g_variant_get_child_value(value, 0);
+                        df_metrics_add_bytes(g_variant_get_size(val));
+                        c = df_fuzz_call(pproxy, "Set", g_variant_new("(ssv)", interface, property->name, val),
+                                         value, cancellable);
+                        if (!c) {
+                                r = df_oom();
+                                goto finish;
+                        }
+                        c->iteration = i;
+
+                        g_queue_push_tail(&pending, c);
+                        i++;
+                }
+
+                call = g_queue_pop_head(&pending);
+                df_fuzz_wait_for_call(context, call);
+                df_metrics_add_call(call->error, call->finished_usec - call->issued_usec);
+                k = df_fuzz_process_set_property_reply(pproxy, interface, property, call);
+                if (k < 0) {
+                        r = 1;
+                        goto finish;
+                } else if (k == 2) {
+                        /* Don't issue any more calls, the writes are refused (or
+                         * the connection is gone) */
+                        r = 2;
+                        goto finish;
+                }
+
+                if (df_except_counter >= MAX_EXCEPTIONS)
+                        break;
+        }
 
-        /* Create a "property proxy"
-         * See: https://dbus.freedesktop.org/doc/dbus-specification.html#standard-interfaces-properties
-         */
-        pproxy = df_bus_new(dcon, bus, object, "org.freedesktop.DBus.Properties",
-                            G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES|G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS);
+finish:
+        df_fuzz_drain_calls(context, &pending, cancellable);
+        g_main_context_pop_thread_default(context);
+
+        return r;
+}
+
+/* Leaves the report of a crash noticed while testing a property to the first
+ * worker which noticed it; returns FALSE if it's another one */
+static gboolean df_fuzz_claim_property_crash(const char *name, const char *object, const char *interface)
+{
+        if (!df_crash_guard)
+                return TRUE;
+
+        return df_fuzz_crash_claim(g_strdup_printf("      [P] %s (%s on %s)\n", name, interface, object));
+}
+
+static int df_fuzz_run_all_properties(GDBusConnection *dcon, const char *bus, const char *object,
+                                      const char *interface, const int pid)
+{
+        GDBusProxy *pproxy;
+        int k, r;
+
+        pproxy = df_fuzz_get_properties_proxy(dcon, bus, object);
+        if (!pproxy)
+                return df_fail_ret(-1, "Failed to create a property proxy for object '%s'\n", object);
+
+        df_debug("  Properties: %sGetAll%s => %d iterations\n", ansi_bold(), ansi_normal(), DF_PROPERTY_READS);
+        df_verbose("  [P] GetAll...");
+
+        k = df_fuzz_read_properties(pproxy, "GetAll", g_variant_new("(s)", interface), "GetAll",
+                                    G_VARIANT_TYPE("(a{sv})"));
+        if (k < 0)
+                return k;
+        if (k == 1 && !df_fuzz_crashed_meanwhile(pid))
+                return df_fail_ret(1, "%s  %sFAIL%s [P] GetAll - unexpected response while reading all properties\n",
+                                   ansi_cr(), ansi_red(), ansi_normal());
+
+        /* Check if the remote side is still alive */
+        r = df_check_if_exited(pid);
+        if (r < 0)
+                return df_fail_ret(-1, "Error while reading process' stat file: %m\n");
+        else if (r == 0) {
+                if (!df_fuzz_claim_property_crash("GetAll", object, interface))
+                        return 5;
+
+                df_fail("%s  %sFAIL%s [P] GetAll - process %d exited\n",
+                        ansi_cr(), ansi_red(), ansi_normal(), pid);
+                df_fuzz_crash_report();
+                return 1;
+        }
+
+        if (k == 0)
+                df_verbose("%s  %sPASS%s [P] GetAll\n", ansi_cr(), ansi_green(), ansi_normal());
+
+        return 0;
+}
+
+static int df_fuzz_run_property(GDBusConnection *dcon, const struct df_dbus_property *property,
+                                const char *bus, const char *object, const char *interface,
+                                const int pid, guint64 iterations)
+{
+        GDBusProxy *pproxy;
+        int k, r;
+
+        pproxy = df_fuzz_get_properties_proxy(dcon, bus, object);
         if (!pproxy)
                 return df_fail_ret(-1, "Failed to create a property proxy for object '%s'\n", object);
 
-        /* Try to read the property if it's readable.
-         *
-         * For performance reasons read readable property only twice, since that
-         * should be enough to trigger most of the issues.
-         */
-        iterations = 2;
+        /* Try to read the property if it's readable */
         if (property->is_readable) {
-                df_debug("  Property: %s%s %s (read) => %"G_GUINT64_FORMAT" iterations%s\n", ansi_bold(),
-                         property->name, property->signature, iterations, ansi_normal());
+                df_debug("  Property: %s%s %s (read) => %d iterations%s\n", ansi_bold(),
+                         property->name, property->signature, DF_PROPERTY_READS, ansi_normal());
 
                 df_verbose("  [P] %s (read)...", property->name);
 
-                for (guint8 i = 0; i < iterations; i++) {
-                        r = df_fuzz_get_property(pproxy, interface, property);
-                        if (r < 0)
-                                return df_fail_ret(1, "%s  %sFAIL%s [P] %s - unexpected response while reading a property\n",
-                                                   ansi_cr(), ansi_red(), ansi_normal(), property->name);
-                }
+                k = df_fuzz_read_properties(pproxy, "Get", g_variant_new("(ss)", interface, property->name),
+                                            property->name, G_VARIANT_TYPE("(v)"));
+                if (k < 0)
+                        return k;
+                if (k == 1 && !df_fuzz_crashed_meanwhile(pid))
+                        return df_fail_ret(1, "%s  %sFAIL%s [P] %s - unexpected response while reading a property\n",
+                                           ansi_cr(), ansi_red(), ansi_normal(), property->name);
 
                 /* Check if the remote side is still alive */
                 r = df_check_if_exited(pid);
                 if (r < 0)
                         return df_fail_ret(-1, "Error while reading process' stat file: %m\n");
                 else if (r == 0) {
+                        if (!df_fuzz_claim_property_crash(property->name, object, interface))
+                                return 5;
+
                         df_fail("%s  %sFAIL%s [P] %s (read) - process %d exited\n",
                                 ansi_cr(), ansi_red(), ansi_normal(), property->name, pid);
+                        df_fuzz_crash_report();
                         return 1;
                 }
 
-                df_verbose("%s  %sPASS%s [P] %s (read)\n",
-                           ansi_cr(), ansi_green(), ansi_normal(), property->name);
+                if (k == 0)
+                        df_verbose("%s  %sPASS%s [P] %s (read)\n",
+                                   ansi_cr(), ansi_green(), ansi_normal(), property->name);
         }
 
-        /* Try to write a random value to the property if it's writable
-         *
-         * Cap the iterations for writable properties to 16 for now, since without
-         * dictionaries doing the "full" loop is mostly a waste of time.
-         */
-        iterations = CLAMP(iterations, 1, 16);
+        /* Try to write random values to the property if it's writable; the
+         * calls are pipelined, so it gets the same (signature based) number
+         * of iterations as a method would */
         if (property->is_writable) {
                 df_debug("  Property: %s%s %s (write) => %"G_GUINT64_FORMAT" iterations%s\n", ansi_bold(),
                          property->name, property->signature, iterations, ansi_normal());
 
                 df_verbose("  [P] %s (write)...", property->name);
 
-                for (guint64 i = 0; i < iterations; i++) {
-                        g_autoptr(GVariant) value = NULL;
-
-                        /* Create a random GVariant based on method's signature */
-                        value = df_generate_random_from_signature(property->signature, i);
-                        if (!value)
-                                return df_debug_ret(-1, "Failed to generate a variant for signature '%s'\n", property->signature);
-
-                        /* Convert the floating variant reference into a full one */
-                        value = g_variant_ref_sink(value);
-                        r = df_fuzz_set_property(pproxy, interface, property, value);
-                        if (r < 0)
-                                return df_fail_ret(1, "%s  %sFAIL%s [P] %s (write) - unexpected response while writing to a property\n",
-                                                   ansi_cr(), ansi_red(), ansi_normal(), property->name);
-                }
+                k = df_fuzz_write_property(pproxy, property, object, interface, iterations);
+                if (k < 0)
+                        return k;
+                if (k == 1 && !df_fuzz_crashed_meanwhile(pid))
+                        return df_fail_ret(1, "%s  %sFAIL%s [P] %s (write) - unexpected response while writing to a property\n",
+                                           ansi_cr(), ansi_red(), ansi_normal(), property->name);
 
                 /* Check if the remote side is still alive */
                 r = df_check_if_exited(pid);
                 if (r < 0)
                         return df_fail_ret(-1, "Error while reading process' stat file: %m\n");
-                else if (r == 0)
-                        return df_fail_ret(1, "%s  %sFAIL%s [P] %s (write) - process %d exited\n",
-                                           ansi_cr(), ansi_red(), ansi_normal(), property->name, pid);
+                else if (r == 0) {
+                        if (!df_fuzz_claim_property_crash(property->name, object, interface))
+                                return 5;
+
+                        df_fail("%s  %sFAIL%s [P] %s (write) - process %d exited\n",
+                                ansi_cr(), ansi_red(), ansi_normal(), property->name, pid);
+                        df_fuzz_crash_report();
+                        return 1;
+                }
 
-                df_verbose("%s  %sPASS%s [P] %s (write)\n",
-                           ansi_cr(), ansi_green(), ansi_normal(), property->name);
+                /* A skipped property was reported already */
+                if (k == 0)
+                        df_verbose("%s  %sPASS%s [P] %s (write)\n",
+                                   ansi_cr(), ansi_green(), ansi_normal(), property->name);
         }
 
         return 0;
 }
+
+int df_fuzz_test_all_properties(GDBusConnection *dcon, const char *bus, const char *object,
+                                const char *interface, const int pid)
+{
+        int r;
+
+        if (!df_fuzz_crash_enter())
+                return 5;
+
+        r = df_fuzz_run_all_properties(dcon, bus, object, interface, pid);
+        df_fuzz_crash_leave();
+
+        return r;
+}
+
+int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *property,
+                          const char *bus, const char *object, const char *interface,
+                          const int pid, guint64 iterations)
+{
+        int r;
+
+        if (!df_fuzz_crash_enter())
+                return 5;
+
+        r = df_fuzz_run_property(dcon, property, bus, object, interface, pid, iterations);
+        df_fuzz_crash_leave();
+
+        return r;
+}
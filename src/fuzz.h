@@ -29,6 +29,10 @@
 /** Maximum length of D-Bus signature string */
 #define MAX_SIGNATURE_LENGTH 255
 #define MAX_SIGNATURE_NEST_LEVEL 64
+/** Maximum size of a D-Bus message (128 MiB), as per the D-Bus specification */
+#define MAX_MESSAGE_SIZE 134217728
+/** Minimum of --message-size=, so there's more room than just for the header */
+#define MIN_MESSAGE_SIZE 4096
 #define MAX_SUPPRESSIONS 256
 
 /* Basic (non-container) types which can appear in a signature
@@ -37,10 +41,48 @@
  */
 #define SIGNATURE_BASIC_TYPES "ybnqiuxtdsogh"
 
+/** How generated values are constructed, see plan.h */
+typedef enum df_plan_backend {
+        /** Build a tree of GVariant instances via g_variant_new_*() */
+        DF_PLAN_BACKEND_VARIANT = 0,
+        /** Write the serialized GVariant form directly into a buffer */
+        DF_PLAN_BACKEND_WIRE,
+        _DF_PLAN_BACKEND_MAX
+} df_plan_backend_t;
+
+/* See coverage.h */
+struct df_coverage;
+/* See plan.h */
+struct df_plan;
+/* See command.h */
+struct df_command;
+
 /** Maximum amount of unimportant exceptions for one method; if reached
   * testing continues with a next method */
 #define MAX_EXCEPTIONS 50
 
+/** Maximum number of method calls which can be in flight at once */
+#define MAX_INFLIGHT_CALLS 1024
+
+/** A worker reporting a crash of the tested process waits this long for the
+  * other workers to notice it as well, see df_fuzz_set_crash_guard() */
+#define DF_CRASH_REPORT_WAIT_MSEC 1000
+
+/** Number of reads of each readable property (and of all properties of an
+  * interface via GetAll), which should be enough to trigger most issues */
+#define DF_PROPERTY_READS 2
+
+/** Latency of a method is tracked in windows of this many calls: the first
+  * one is the baseline, the following ones are compared against it */
+#define DF_LATENCY_WINDOW 64
+/** Median latency of a window this many times worse than the baseline one
+  * is reported as a regression... */
+#define DF_LATENCY_REGRESSION_FACTOR 10
+/** ...unless it's still below this (in microseconds) */
+#define DF_LATENCY_REGRESSION_MIN_USEC 10000
+/** Number of the slowest methods listed in the final summary */
+#define DF_LATENCY_SUMMARY_TOP 5
+
 typedef struct df_dbus_method {
         char *name;
         char *signature;
@@ -73,9 +115,164 @@ static inline void df_dbus_property_clear(df_dbus_property_t *p)
 G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(df_dbus_method_t, df_dbus_method_clear)
 G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(df_dbus_property_t, df_dbus_property_clear)
 
+/** Statistics of the calls of a single method, accumulated over all runs of
+  * df_fuzz_test_method() with the same structure */
+typedef struct df_method_stats {
+        /** Number of processed replies */
+        guint64 calls;
+        /** Number of replies which were D-Bus errors */
+        guint64 exceptions;
+        /** Number of errors with a name not seen before by this method */
+        guint64 new_errors;
+        /** Number of new coverage edges (with coverage feedback only) */
+        guint64 new_edges;
+        /** Sum of the call latencies in microseconds */
+        gint64 latency_usec;
+        /** Set of distinct error names */
+        GHashTable *error_names;
+        /** TRUE if the method was skipped (access denied, timeout, ...) */
+        gboolean skipped;
+        /** Unimportant exceptions counted towards MAX_EXCEPTIONS and
+          * iterations without new coverage so far, so the limits apply to
+          * all the runs (slices) instead of each of them */
+        guint except_counter;
+        guint64 stale;
+        /** TRUE if the method reached either of the limits above */
+        gboolean ended_early;
+} df_method_stats_t;
+
+static inline void df_method_stats_init(df_method_stats_t *p)
+{
+        memset(p, 0, sizeof(*p));
+        p->error_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static inline void df_method_stats_clear(df_method_stats_t *p)
+{
+        if (p->error_names)
+                g_hash_table_unref(p->error_names);
+        memset(p, 0, sizeof(*p));
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(df_method_stats_t, df_method_stats_clear)
+
 void df_fuzz_set_buffer_length(const guint64 length);
 guint64 df_fuzz_get_buffer_length(void);
-void df_fuzz_set_show_command_output(gboolean value);
+/**
+ * @function Sets the target size of the messages with generated values, which
+ * is spread over the containers of each signature (see df_plan_new_sized()),
+ * so the values fill the messages up without going over the limit of the
+ * broker.
+ * @param size Size in bytes, 0 for no limit
+ */
+void df_fuzz_set_message_size(guint64 size);
+guint64 df_fuzz_get_message_size(void);
+/**
+ * @function Compiles a signature of values sent in a message, with the part
+ * of the message size (see df_fuzz_set_message_size()) which is left after
+ * the header and the other arguments
+ * @param signature D-Bus signature of the values
+ * @param strings NULL-terminated list of the header fields (destination,
+ * object path, interface, member, signature) and of the string arguments
+ * sent along with the values
+ * @return New plan on success, NULL on error
+ */
+struct df_plan *df_fuzz_plan_new(const char *signature, const char *const *strings);
+/**
+ * @function Sets the maximum number of method calls in flight. With more than
+ * one call in flight calls are pipelined, i.e. a new call is issued before a
+ * reply to the previous one arrives.
+ * @param inflight Number of calls in flight, 1 disables pipelining
+ */
+void df_fuzz_set_inflight(guint inflight);
+/**
+ * @function Sets the seed all generated data are derived from. Data for each
+ * method/property iteration depend only on the seed, the object path,
+ * interface and member name, and the iteration number.
+ * @param seed Seed
+ */
+void df_fuzz_set_seed(guint64 seed);
+guint64 df_fuzz_get_seed(void);
+/**
+ * @function Derives a seed for the given method/property from the global
+ * seed (using FNV-1a), so the generated data depend only on the seed and
+ * the tested member, not on the order in which the members are tested.
+ * This allows a single method to be replayed with the same data using
+ * the reproducer (or called under --stress= with the same data).
+ * @param object D-Bus object path
+ * @param interface D-Bus interface
+ * @param member Name of the method/property
+ * @return Seed for the member
+ */
+guint64 df_fuzz_member_seed(const char *object, const char *interface, const char *member);
+/**
+ * @function Sets how generated values are constructed; both backends generate
+ * the same values for the same seed.
+ * @param backend DF_PLAN_BACKEND_VARIANT or DF_PLAN_BACKEND_WIRE
+ */
+void df_fuzz_set_generator(df_plan_backend_t backend);
+df_plan_backend_t df_fuzz_get_generator(void);
+/**
+ * @function Sets the number of threads generating the inputs of each method
+ * ahead, while the calls are made (see producer.h); the inputs are the same
+ * as without them. Inputs mutated from a corpus (--coverage=, --mutate) are
+ * still generated between the calls.
+ * @param n_threads Number of threads, 0 to generate all inputs between the
+ * calls
+ */
+void df_fuzz_set_generator_threads(guint n_threads);
+/**
+ * @function Enables coverage feedback: inputs reaching new code are kept in
+ * a per-method corpus and mutated, and methods end early once there's no new
+ * coverage for plateau iterations.
+ * @param coverage Coverage reader, NULL disables the feedback
+ * @param plateau Number of iterations without new coverage
+ */
+void df_fuzz_set_coverage(struct df_coverage *coverage, guint64 plateau);
+/**
+ * @function Enables mutations without coverage feedback: inputs which got
+ * a success reply or an error other than InvalidArgs (and similar ones raised
+ * before the method got to the arguments) are kept in a per-method pool and
+ * mutated. With coverage feedback the pool holds inputs reaching new code
+ * instead.
+ */
+void df_fuzz_set_mutate(gboolean mutate);
+
+/** Crashes of the tested process seen by the workers testing it in parallel */
+typedef struct df_crash_guard df_crash_guard_t;
+
+df_crash_guard_t *df_crash_guard_new(void);
+void df_crash_guard_free(df_crash_guard_t *guard);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_crash_guard_t, df_crash_guard_free)
+
+/**
+ * @function Shares crashes of the tested process with the other workers
+ * testing it in parallel: the first worker to notice a crash reports it along
+ * with the calls the others had in flight and restarts the process, while
+ * the others wait for the restart without reporting anything and then test
+ * their member again (see the return value 5 of df_fuzz_test_method()).
+ * @param guard Guard shared by the workers of the thread's target, NULL if the
+ * thread is the only one testing it
+ */
+void df_fuzz_set_crash_guard(df_crash_guard_t *guard);
+/**
+ * @function Lets the other workers go on after the crash reported by this
+ * thread was dealt with (i.e. the process was restarted or it was given up);
+ * does nothing if the thread doesn't report any crash.
+ */
+void df_fuzz_crash_handled(void);
+
+/**
+ * @function Prints the number of method calls per second, generated bytes per
+ * second (both over the time spent in the call loops) and peak RSS of dfuzzer
+ */
+void df_fuzz_print_throughput_summary(void);
+/**
+ * @function Prints latency percentiles of all method calls made so far and
+ * (with -v) the methods with the worst p99 latency.
+ */
+void df_fuzz_print_latency_summary(void);
 
 guint64 df_get_number_of_iterations(const char *signature);
 /**
@@ -120,16 +317,45 @@ int df_fuzz_add_method_arg(const char *signature);
  * @param intf D-Bus interface
  * @param pid PID of tested process
  * @param void_method If method has out args 1, 0 otherwise
- * @param execute_cmd Command/Script to execute after each method call.
+ * @param command Check specified via -e/--command, run after every call or
+ * batch of calls (see command.h), NULL if there's none
+ * @param offset Number of the first iteration, so a method can be tested in
+ * several consecutive runs (slices) with the same data as in a single run
+ * @param iterations Number of iterations to do
+ * @param stats If not NULL, statistics of the calls are added to it
  * @return 0 on success, -1 on error, 1 on tested process crash, 2 on void
- * function returning non-void value, 3 on warnings and 4 when executed
- * command finished unsuccessfuly
+ * function returning non-void value, 3 on warnings (e.g. a latency
+ * regression), 4 when executed command finished unsuccessfuly and 5 when the
+ * process was restarted by another worker meanwhile, so the method has to be
+ * tested again with a new proxy (see df_fuzz_set_crash_guard())
  */
 int df_fuzz_test_method(
                 const struct df_dbus_method *method, const char *name,
-                const char *obj, const char *intf, const int pid, const char *execute_cmd,
-                guint64 iterations);
+                const char *obj, const char *intf, const int pid, struct df_command *command,
+                guint64 offset, guint64 iterations, df_method_stats_t *stats);
 
+/**
+ * @function Reads and writes the property via org.freedesktop.DBus.Properties
+ * of the object; the properties proxy is kept for the next properties of the
+ * same object (see df_fuzz_release_properties_proxy()).
+ * @param iterations Number of values written to a writable property
+ * @return 0 on success, -1 on error, 1 on unexpected response or tested
+ * process crash, 5 when the process was restarted by another worker (see
+ * df_fuzz_test_method())
+ */
 int df_fuzz_test_property(GDBusConnection *dcon, const struct df_dbus_property *property,
                           const char *bus, const char *object, const char *interface,
                           const int pid, guint64 iterations);
+/**
+ * @function Reads all properties of the interface at once via GetAll
+ * @return 0 on success, -1 on error, 1 on unexpected response or tested
+ * process crash, 5 when the process was restarted by another worker (see
+ * df_fuzz_test_method())
+ */
+int df_fuzz_test_all_properties(GDBusConnection *dcon, const char *bus, const char *object,
+                                const char *interface, const int pid);
+/**
+ * @function Drops the properties proxy kept by df_fuzz_test_property(); call
+ * it after the tested process was restarted and before the thread exits.
+ */
+void df_fuzz_release_properties_proxy(void);
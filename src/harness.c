@@ -0,0 +1,329 @@
+/** @file harness.c */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "harness.h"
+#include "log.h"
+#include "util.h"
+
+df_harness_t *df_harness_new(const char *command)
+{
+        g_autoptr(GError) error = NULL;
+        df_harness_t *h;
+        char **argv = NULL;
+
+        g_assert(command);
+
+        if (!g_shell_parse_argv(command, NULL, &argv, &error)) {
+                df_fail("Error: Failed to parse the command line of the service '%s': %s\n",
+                        command, error->message);
+                return NULL;
+        }
+
+        h = calloc(1, sizeof(*h));
+        if (!h) {
+                g_strfreev(argv);
+                df_oom();
+                return NULL;
+        }
+
+        h->argv = argv;
+        h->instances = g_ptr_array_new_with_free_func(free);
+        h->standby = TRUE;
+        g_mutex_init(&h->lock);
+        g_cond_init(&h->cond);
+
+        return h;
+}
+
+static gboolean df_harness_all_exited(df_harness_t *h)
+{
+        for (guint i = 0; i < h->instances->len; i++) {
+                df_harness_instance_t *instance = g_ptr_array_index(h->instances, i);
+
+                if (!instance->exited)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+/* Must be called with the lock held */
+static void df_harness_signal_all(df_harness_t *h, int sig)
+{
+        for (guint i = 0; i < h->instances->len; i++) {
+                df_harness_instance_t *instance = g_ptr_array_index(h->instances, i);
+
+                if (!instance->exited)
+                        (void) kill(instance->pid, sig);
+        }
+}
+
+void df_harness_free(df_harness_t *h)
+{
+        gboolean exited;
+        gint64 deadline;
+
+        if (!h)
+                return;
+
+        g_mutex_lock(&h->lock);
+        df_harness_signal_all(h, SIGTERM);
+        deadline = g_get_monotonic_time() + DF_HARNESS_STOP_TIMEOUT_SEC * G_USEC_PER_SEC;
+        while (!(exited = df_harness_all_exited(h)))
+                if (!g_cond_wait_until(&h->cond, &h->lock, deadline))
+                        break;
+
+        if (!exited) {
+                df_harness_signal_all(h, SIGKILL);
+                while (!df_harness_all_exited(h))
+                        g_cond_wait(&h->cond, &h->lock);
+        }
+        g_mutex_unlock(&h->lock);
+
+        if (h->bus_pid > 0) {
+                (void) kill(h->bus_pid, SIGTERM);
+                (void) waitpid(h->bus_pid, NULL, 0);
+        }
+
+        g_ptr_array_unref(h->instances);
+        g_strfreev(h->argv);
+        free(h->bus_address);
+        g_mutex_clear(&h->lock);
+        g_cond_clear(&h->cond);
+        free(h);
+}
+
+/**
+ * @function Reaper thread: waits for the instance to exit, so it doesn't
+ * linger as a zombie, and reports how it exited.
+ * @param user_data Pointer to the df_harness_instance_t structure
+ * @return Always NULL
+ */
+static gpointer df_harness_reap(gpointer user_data)
+{
+        df_harness_instance_t *instance = user_data;
+        df_harness_t *h = instance->harness;
+        siginfo_t status = {};
+
+        for (;;) {
+                if (waitid(P_PID, instance->pid, &status, WEXITED) < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        df_debug("Error when waiting for instance %d: %m\n", instance->pid);
+                }
+
+                break;
+        }
+
+        if (status.si_code == CLD_EXITED)
+                df_verbose("[HARNESS: instance %d exited with status %d]\n", instance->pid, status.si_status);
+        else
+                df_verbose("[HARNESS: instance %d was killed by signal %d]\n", instance->pid, status.si_status);
+
+        g_mutex_lock(&h->lock);
+        instance->exited = TRUE;
+        /* A spare instance gave up while the owner is fine, so the service
+         * doesn't wait in the queue of the name */
+        if (!instance->was_owner && h->standby && h->owner && !h->owner->exited) {
+                h->standby = FALSE;
+                df_verbose("[HARNESS: the service doesn't wait for the bus name, starting instances on demand]\n");
+        }
+        g_cond_broadcast(&h->cond);
+        g_mutex_unlock(&h->lock);
+
+        return NULL;
+}
+
+/* Must be called with the lock held */
+static int df_harness_spawn(df_harness_t *h, gboolean standby)
+{
+        df_harness_instance_t *instance;
+        pid_t pid;
+
+        instance = calloc(1, sizeof(*instance));
+        if (!instance)
+                return df_oom();
+
+        pid = fork();
+        if (pid < 0) {
+                free(instance);
+                return df_fail_ret(-1, "Failed to fork: %m\n");
+        }
+        if (pid == 0) {
+                /* Child process */
+                execvp(h->argv[0], h->argv);
+                /* Reported by the reaper as exit status 127; don't touch
+                 * stdio here, it might be locked by another thread */
+                _exit(127);
+        }
+
+        instance->pid = pid;
+        instance->standby = standby;
+        instance->harness = h;
+        g_ptr_array_add(h->instances, instance);
+        h->n_started++;
+
+        /* The thread holds no reference to itself once it's done */
+        g_thread_unref(g_thread_new("dfuzzer-reaper", df_harness_reap, instance));
+
+        df_verbose("[HARNESS: started %sinstance %d]\n", standby ? "spare " : "", pid);
+
+        return 0;
+}
+
+int df_harness_start(df_harness_t *h)
+{
+        char address[1024];
+        g_auto(fd_t) read_fd = -1;
+        int fds[2];
+        size_t n = 0;
+        pid_t pid;
+        int r;
+
+        g_assert(h);
+        g_assert(h->bus_pid == 0);
+
+        if (pipe(fds) < 0)
+                return df_fail_ret(-1, "Failed to create a pipe: %m\n");
+        /* Only dbus-daemon needs the write end */
+        (void) fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+        pid = fork();
+        if (pid < 0) {
+                (void) close(fds[0]);
+                (void) close(fds[1]);
+                return df_fail_ret(-1, "Failed to fork: %m\n");
+        }
+        if (pid == 0) {
+                /* Child process */
+                char print_address[strlen("--print-address=") + DECIMAL_STR_MAX(int)];
+
+                /* Don't outlive dfuzzer; this is tied to the forking thread,
+                 * which is the main one here */
+                (void) prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+                sprintf(print_address, "--print-address=%d", fds[1]);
+                execlp("dbus-daemon", "dbus-daemon", "--session", "--nofork", "--nopidfile", print_address,
+                       (char *) NULL);
+                _exit(127);
+        }
+
+        h->bus_pid = pid;
+        read_fd = fds[0];
+        (void) close(fds[1]);
+
+        /* dbus-daemon prints the address followed by a newline once it's
+         * listening */
+        while (n < sizeof(address) - 1) {
+                ssize_t k;
+
+                k = read(read_fd, address + n, sizeof(address) - 1 - n);
+                if (k < 0 && errno == EINTR)
+                        continue;
+                if (k <= 0)
+                        break;
+
+                n += k;
+                if (memchr(address, '\n', n))
+                        break;
+        }
+        address[n] = 0;
+        address[strcspn(address, "\n")] = 0;
+        if (isempty(address))
+                return df_fail_ret(-1, "Error: Failed to start a private dbus-daemon\n");
+
+        h->bus_address = strdup(address);
+        if (!h->bus_address)
+                return df_oom();
+
+        if (setenv("DBUS_SESSION_BUS_ADDRESS", h->bus_address, 1) < 0)
+                return df_fail_ret(-1, "Failed to set DBUS_SESSION_BUS_ADDRESS: %m\n");
+
+        fprintf(stderr, "%s%s[HARNESS: private bus %s]%s\n", ansi_cr(), ansi_cyan(), h->bus_address, ansi_normal());
+
+        g_mutex_lock(&h->lock);
+        r = df_harness_spawn(h, FALSE);
+        g_mutex_unlock(&h->lock);
+
+        return r;
+}
+
+/* Must be called with the lock held */
+static gboolean df_harness_has_spare(df_harness_t *h)
+{
+        for (guint i = 0; i < h->instances->len; i++) {
+                df_harness_instance_t *instance = g_ptr_array_index(h->instances, i);
+
+                if (instance != h->owner && !instance->exited)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+void df_harness_set_owner(df_harness_t *h, int pid)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        df_harness_instance_t *owner = NULL;
+
+        g_assert(h);
+
+        locker = g_mutex_locker_new(&h->lock);
+        for (guint i = 0; i < h->instances->len; i++) {
+                df_harness_instance_t *instance = g_ptr_array_index(h->instances, i);
+
+                if (instance->pid == pid && !instance->exited) {
+                        owner = instance;
+                        break;
+                }
+        }
+
+        if (!owner)
+                df_verbose("[HARNESS: the bus name is owned by process %d, which wasn't started by dfuzzer]\n", pid);
+        else if (owner != h->owner && !owner->was_owner) {
+                owner->was_owner = TRUE;
+                if (owner->standby)
+                        h->n_takeovers++;
+        }
+        h->owner = owner;
+
+        if (h->standby && !df_harness_has_spare(h))
+                (void) df_harness_spawn(h, TRUE);
+}
+
+int df_harness_prepare_restart(df_harness_t *h)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+
+        g_assert(h);
+
+        locker = g_mutex_locker_new(&h->lock);
+        /* A spare instance is already waiting for the name (or another
+         * worker started one after the same crash) */
+        if (df_harness_has_spare(h))
+                return 0;
+
+        return df_harness_spawn(h, FALSE);
+}
+
+void df_harness_print_summary(df_harness_t *h)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+
+        g_assert(h);
+
+        locker = g_mutex_locker_new(&h->lock);
+        fprintf(stderr, "%s[HARNESS: %"G_GUINT64_FORMAT" instance(s) started, %"G_GUINT64_FORMAT
+                " crash(es) taken over by a spare instance]%s\n",
+                ansi_cyan(), h->n_started, h->n_takeovers, ansi_normal());
+}
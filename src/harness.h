@@ -0,0 +1,97 @@
+/** @file harness.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <sys/types.h>
+
+/** How long the instances get to exit after SIGTERM before they are killed */
+#define DF_HARNESS_STOP_TIMEOUT_SEC 5
+
+struct df_harness;
+
+/** An instance of the tested service started by the harness */
+typedef struct df_harness_instance {
+        pid_t pid;
+        /** Started as a spare instance while another one owned the name */
+        gboolean standby;
+        /** TRUE once the instance owned the bus name */
+        gboolean was_owner;
+        /** Set by the thread reaping the instance */
+        gboolean exited;
+        struct df_harness *harness;
+} df_harness_instance_t;
+
+/** Tested service started (and restarted) by dfuzzer itself (--harness=)
+  *
+  * The service runs on a private dbus-daemon, so nothing else competes for
+  * its bus name. Once an instance owns the name, a spare one is started and
+  * waits in the queue of the name (RequestName without DO_NOT_QUEUE, which
+  * is what e.g. g_bus_own_name() does by default): when the owner dies, the
+  * bus daemon hands the name over to the spare instance right away, which
+  * is already initialized, so no activation or startup is waited for. A new
+  * spare instance is then started in the background. If the service gives
+  * up instead of waiting in the queue, instances are started on demand
+  * after each crash. Each instance is reaped by its own thread, so a dead
+  * one doesn't linger as a zombie (which would still look alive in /proc).
+  */
+typedef struct df_harness {
+        /** Command line of the service */
+        char **argv;
+        pid_t bus_pid;
+        char *bus_address;
+        /** All instances started so far, including the exited ones */
+        GPtrArray *instances;
+        /** Instance owning the bus name, NULL if it's not known */
+        df_harness_instance_t *owner;
+        /** FALSE once a spare instance exited while the owner was alive */
+        gboolean standby;
+        /** Number of started instances and of crashes after which a spare
+          * instance took over */
+        guint64 n_started;
+        guint64 n_takeovers;
+        GMutex lock;
+        GCond cond;
+} df_harness_t;
+
+/**
+ * @function Parses the command line of the service (it's not started yet)
+ * @param command Command line, split as in the shell
+ * @return New harness on success (free it with df_harness_free()), NULL on
+ * error
+ */
+df_harness_t *df_harness_new(const char *command);
+/**
+ * @function Stops all instances and the private bus
+ */
+void df_harness_free(df_harness_t *h);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_harness_t, df_harness_free)
+
+/**
+ * @function Starts the private dbus-daemon, points DBUS_SESSION_BUS_ADDRESS
+ * of dfuzzer (and so of the service) to it and starts the first instance.
+ * Call it before connecting to the session bus.
+ * @return 0 on success, -1 on error
+ */
+int df_harness_start(df_harness_t *h);
+
+/**
+ * @function Tells the harness which process owns the bus name now, i.e.
+ * after the first instance acquired it or after a crash; starts a spare
+ * instance unless one is already running.
+ * @param pid PID of the owner of the bus name
+ */
+void df_harness_set_owner(df_harness_t *h, int pid);
+
+/**
+ * @function Makes sure an instance is about to take over the bus name after
+ * its owner died: if no spare instance is running, a new one is started.
+ * Can be called by multiple workers which detected the same crash.
+ * @return 0 on success, -1 on error
+ */
+int df_harness_prepare_restart(df_harness_t *h);
+
+/**
+ * @function Prints the number of started instances and takeovers
+ */
+void df_harness_print_summary(df_harness_t *h);
@@ -0,0 +1,91 @@
+/** @file histogram.c */
+#include <gio/gio.h>
+#include <string.h>
+
+#include "histogram.h"
+
+guint df_histogram_index(guint64 value)
+{
+        guint e, i;
+
+        if (value < DF_HISTOGRAM_SUB_BUCKETS)
+                return value;
+
+        /* Position of the highest bit, i.e. the power of two */
+        e = 63 - __builtin_clzll(value);
+        if (e > DF_HISTOGRAM_MAX_LOG)
+                return DF_HISTOGRAM_BUCKETS - 1;
+
+        /* The bits following the highest one pick the sub-bucket */
+        i = (value >> (e - DF_HISTOGRAM_SUB_BUCKETS_LOG)) & (DF_HISTOGRAM_SUB_BUCKETS - 1);
+
+        return DF_HISTOGRAM_SUB_BUCKETS * (e - DF_HISTOGRAM_SUB_BUCKETS_LOG + 1) + i;
+}
+
+guint64 df_histogram_upper_bound(guint index)
+{
+        guint e, i;
+
+        if (index < DF_HISTOGRAM_SUB_BUCKETS)
+                return index;
+        if (index >= DF_HISTOGRAM_BUCKETS - 1)
+                return G_MAXUINT64;
+
+        e = index / DF_HISTOGRAM_SUB_BUCKETS + DF_HISTOGRAM_SUB_BUCKETS_LOG - 1;
+        i = index % DF_HISTOGRAM_SUB_BUCKETS;
+
+        return ((guint64) (DF_HISTOGRAM_SUB_BUCKETS + i + 1) << (e - DF_HISTOGRAM_SUB_BUCKETS_LOG)) - 1;
+}
+
+void df_histogram_add(df_histogram_t *h, guint64 value)
+{
+        g_assert(h);
+
+        h->buckets[df_histogram_index(value)]++;
+        h->count++;
+        h->max = MAX(h->max, value);
+}
+
+void df_histogram_merge(df_histogram_t *dst, const df_histogram_t *src)
+{
+        g_assert(dst);
+        g_assert(src);
+
+        for (guint i = 0; i < DF_HISTOGRAM_BUCKETS; i++)
+                dst->buckets[i] += src->buckets[i];
+        dst->count += src->count;
+        dst->max = MAX(dst->max, src->max);
+}
+
+void df_histogram_reset(df_histogram_t *h)
+{
+        g_assert(h);
+
+        memset(h, 0, sizeof(*h));
+}
+
+guint64 df_histogram_percentile(const df_histogram_t *h, double p)
+{
+        guint64 rank, seen = 0;
+        double exact;
+
+        g_assert(h);
+        g_assert(p >= 0 && p <= 100);
+
+        if (h->count == 0)
+                return 0;
+
+        /* Rank of the value (1-based), rounded up */
+        exact = p / 100.0 * h->count;
+        rank = (guint64) exact;
+        if ((double) rank < exact)
+                rank++;
+        rank = MAX(rank, 1);
+        for (guint i = 0; i < DF_HISTOGRAM_BUCKETS; i++) {
+                seen += h->buckets[i];
+                if (seen >= rank)
+                        return MIN(df_histogram_upper_bound(i), h->max);
+        }
+
+        return h->max;
+}
@@ -0,0 +1,50 @@
+/** @file histogram.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/** Number of linear sub-buckets per power of two, i.e. the recorded values
+  * are precise to 1/DF_HISTOGRAM_SUB_BUCKETS (12.5 %) */
+#define DF_HISTOGRAM_SUB_BUCKETS_LOG 3
+#define DF_HISTOGRAM_SUB_BUCKETS (1 << DF_HISTOGRAM_SUB_BUCKETS_LOG)
+/** Values up to 2^40 (i.e. ~12 days in microseconds); bigger ones end up in
+  * the last bucket */
+#define DF_HISTOGRAM_MAX_LOG 40
+#define DF_HISTOGRAM_BUCKETS \
+        (DF_HISTOGRAM_SUB_BUCKETS * (DF_HISTOGRAM_MAX_LOG - DF_HISTOGRAM_SUB_BUCKETS_LOG + 2))
+
+/** Log-scale histogram of non-negative values (e.g. call latencies)
+  *
+  * Values below DF_HISTOGRAM_SUB_BUCKETS are counted exactly, bigger ones in
+  * DF_HISTOGRAM_SUB_BUCKETS equally wide buckets per power of two. It's a
+  * plain structure, so it can live on the stack and be reset by memset().
+  */
+typedef struct df_histogram {
+        guint64 buckets[DF_HISTOGRAM_BUCKETS];
+        guint64 count;
+        guint64 max;
+} df_histogram_t;
+
+/**
+ * @return Index of the bucket the value is counted in
+ */
+guint df_histogram_index(guint64 value);
+/**
+ * @return Largest value which belongs to the bucket, G_MAXUINT64 for the
+ * last one
+ */
+guint64 df_histogram_upper_bound(guint index);
+
+void df_histogram_add(df_histogram_t *h, guint64 value);
+/**
+ * @function Adds all values recorded in src to dst
+ */
+void df_histogram_merge(df_histogram_t *dst, const df_histogram_t *src);
+void df_histogram_reset(df_histogram_t *h);
+
+/**
+ * @param p Percentile in range [0, 100]
+ * @return Approximate value of the p-th percentile (the upper bound of its
+ * bucket, but never more than the maximum), 0 for an empty histogram
+ */
+guint64 df_histogram_percentile(const df_histogram_t *h, double p);
@@ -27,42 +27,294 @@
 #include "util.h"
 
 
-GDBusNodeInfo *df_get_interface_info(GDBusProxy *dproxy, const char *interface, GDBusInterfaceInfo **ret_iinfo)
+/** Cached introspection data of a single object */
+typedef struct df_introspection_entry {
+        gchar *xml;
+        /** Parsed xml, NULL until it's needed */
+        GDBusNodeInfo *info;
+} df_introspection_entry_t;
+
+/** Cache of the introspection data keyed by "<bus name>\n<object path>", so
+  * each object is introspected (and parsed) only once; it's shared by all
+  * workers, hence protected by the lock */
+static GHashTable *df_introspection_cache;
+static GMutex df_introspection_lock;
+
+static void df_introspection_entry_free(df_introspection_entry_t *entry)
 {
-        g_autoptr(GError) error = NULL;
-        g_autoptr(gchar) introspection_xml = NULL;
-        g_autoptr(GVariant) response = NULL;
-        GDBusNodeInfo *introspection_data = NULL;
-        GDBusInterfaceInfo *interface_info = NULL;
+        if (!entry)
+                return;
 
-        g_assert(dproxy);
-        g_assert(interface);
-        g_assert(ret_iinfo);
+        g_free(entry->xml);
+        if (entry->info)
+                g_dbus_node_info_unref(entry->info);
+        free(entry);
+}
 
-        // Synchronously invokes the org.freedesktop.DBus.Introspectable.Introspect
-        // method on dproxy to get introspection data in XML format
-        response = df_bus_call(dproxy,
-                               "org.freedesktop.DBus.Introspectable.Introspect",
-                               NULL,
-                               G_DBUS_CALL_FLAGS_NONE);
-        if (!response)
-                return NULL;;
+static void df_introspection_cache_put(char *key, gchar *xml)
+{
+        df_introspection_entry_t *entry;
 
-        g_variant_get(response, "(s)", &introspection_xml);
-        if (!introspection_xml) {
-                df_fail("Error: Unable to get introspection data from GVariant.\n");
-                return NULL;
+        if (!df_introspection_cache)
+                df_introspection_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                               (GDestroyNotify) df_introspection_entry_free);
+
+        entry = calloc(1, sizeof(*entry));
+        if (!entry) {
+                g_free(key);
+                g_free(xml);
+                return;
         }
 
+        entry->xml = xml;
+        g_hash_table_replace(df_introspection_cache, key, entry);
+}
+
+/* Must be called with df_introspection_lock held */
+static GDBusNodeInfo *df_introspection_entry_get_info(df_introspection_entry_t *entry, GError **error)
+{
         // Parses introspection_xml and returns a GDBusNodeInfo representing
         // the data.
-        introspection_data = g_dbus_node_info_new_for_xml(introspection_xml, &error);
-        if (!introspection_data) {
+        if (!entry->info)
+                entry->info = g_dbus_node_info_new_for_xml(entry->xml, error);
+
+        return entry->info;
+}
+
+void df_introspection_cache_clear(void)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+
+        locker = g_mutex_locker_new(&df_introspection_lock);
+        g_clear_pointer(&df_introspection_cache, g_hash_table_unref);
+}
+
+GDBusNodeInfo *df_introspect(GDBusConnection *dcon, const char *name, const char *object)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) response = NULL;
+        g_autoptr(gchar) key = NULL;
+        df_introspection_entry_t *entry = NULL;
+        gchar *introspection_xml = NULL;
+
+        g_assert(dcon);
+        g_assert(name);
+        g_assert(object);
+
+        key = g_strconcat(name, "\n", object, NULL);
+
+        locker = g_mutex_locker_new(&df_introspection_lock);
+        if (df_introspection_cache)
+                entry = g_hash_table_lookup(df_introspection_cache, key);
+        if (!entry) {
+                // Don't block other workers during the call; if someone else
+                // introspects the same object meanwhile, the latter wins
+                g_clear_pointer(&locker, g_mutex_locker_free);
+
+                // Synchronously invokes the org.freedesktop.DBus.Introspectable.Introspect
+                // method to get introspection data in XML format
+                response = g_dbus_connection_call_sync(dcon, name, object,
+                                                       "org.freedesktop.DBus.Introspectable", "Introspect",
+                                                       NULL, G_VARIANT_TYPE("(s)"), G_DBUS_CALL_FLAGS_NONE,
+                                                       df_bus_get_call_timeout(), NULL, &error);
+                if (!response) {
+                        df_fail("Error while calling method 'Introspect': %s\n", error->message);
+                        df_error("Error in g_dbus_connection_call_sync()", error);
+                        return NULL;
+                }
+
+                g_variant_get(response, "(s)", &introspection_xml);
+
+                locker = g_mutex_locker_new(&df_introspection_lock);
+                df_introspection_cache_put(g_strdup(key), introspection_xml);
+                entry = g_hash_table_lookup(df_introspection_cache, key);
+                if (!entry) {
+                        df_oom();
+                        return NULL;
+                }
+        }
+
+        if (!df_introspection_entry_get_info(entry, &error)) {
                 df_fail("Error: Unable to get introspection data.\n");
                 df_error("Error in g_dbus_node_info_new_for_xml()", error);
                 return NULL;
         }
 
+        return g_dbus_node_info_ref(entry->info);
+}
+
+/** State of df_introspect_tree() */
+typedef struct df_discovery {
+        const char *name;
+        /** Object paths waiting to be introspected */
+        GQueue frontier;
+        guint n_pending;
+        guint n_objects;
+} df_discovery_t;
+
+typedef struct df_discovery_call {
+        df_discovery_t *discovery;
+        char *object;
+} df_discovery_call_t;
+
+/* Queues all children of the object (if its data is valid) */
+static void df_discovery_add_children(df_discovery_t *discovery, const char *object, const char *key)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        g_autoptr(GError) error = NULL;
+        df_introspection_entry_t *entry;
+        GDBusNodeInfo *info;
+
+        discovery->n_objects++;
+
+        locker = g_mutex_locker_new(&df_introspection_lock);
+        entry = g_hash_table_lookup(df_introspection_cache, key);
+        if (!entry)
+                return;
+
+        info = df_introspection_entry_get_info(entry, &error);
+        if (!info) {
+                df_debug("Failed to parse introspection data of %s: %s\n", object, error->message);
+                return;
+        }
+
+        STRV_FOREACH(node, info->nodes)
+                g_queue_push_tail(&discovery->frontier,
+                                  g_strconcat(object, strlen(object) == 1 ? "" : "/", node->path, NULL));
+}
+
+static void df_discovery_call_done(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) response = NULL;
+        g_autoptr(gchar) key = NULL;
+        df_discovery_call_t *call = user_data;
+        df_discovery_t *discovery = call->discovery;
+        gchar *introspection_xml = NULL;
+
+        discovery->n_pending--;
+
+        response = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), res, &error);
+        if (!response) {
+                /* Not fatal here, the traversal reports it when it gets
+                 * to the object */
+                df_debug("Failed to introspect %s: %s\n", call->object, error->message);
+                goto finish;
+        }
+
+        key = g_strconcat(discovery->name, "\n", call->object, NULL);
+        g_variant_get(response, "(s)", &introspection_xml);
+        g_mutex_lock(&df_introspection_lock);
+        df_introspection_cache_put(g_strdup(key), introspection_xml);
+        g_mutex_unlock(&df_introspection_lock);
+
+        df_discovery_add_children(discovery, call->object, key);
+
+finish:
+        free(call->object);
+        free(call);
+}
+
+int df_introspect_tree(GDBusConnection *dcon, const char *name, const char *root, guint max_pending)
+{
+        g_autoptr(GMainContext) context = NULL;
+        df_discovery_t discovery = {
+                .name = name,
+                .frontier = G_QUEUE_INIT,
+        };
+        gint64 start;
+        char *object;
+
+        g_assert(dcon);
+        g_assert(name);
+        g_assert(root);
+        g_assert(max_pending > 0);
+
+        start = g_get_monotonic_time();
+
+        /* Replies are dispatched in this context, which is iterated only
+         * by us */
+        context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+
+        g_queue_push_tail(&discovery.frontier, g_strdup(root));
+        while (!g_queue_is_empty(&discovery.frontier) || discovery.n_pending > 0) {
+                while (discovery.n_pending < max_pending && (object = g_queue_pop_head(&discovery.frontier))) {
+                        g_autoptr(gchar) key = NULL;
+                        df_discovery_call_t *call;
+                        gboolean cached;
+
+                        key = g_strconcat(name, "\n", object, NULL);
+                        g_mutex_lock(&df_introspection_lock);
+                        cached = df_introspection_cache && g_hash_table_contains(df_introspection_cache, key);
+                        g_mutex_unlock(&df_introspection_lock);
+                        if (cached) {
+                                df_discovery_add_children(&discovery, object, key);
+                                g_free(object);
+                                continue;
+                        }
+
+                        call = calloc(1, sizeof(*call));
+                        if (!call) {
+                                g_free(object);
+                                break;
+                        }
+
+                        call->discovery = &discovery;
+                        call->object = strdup(object);
+                        g_free(object);
+                        if (!call->object) {
+                                free(call);
+                                break;
+                        }
+
+                        g_dbus_connection_call(dcon, name, call->object,
+                                               "org.freedesktop.DBus.Introspectable", "Introspect",
+                                               NULL, G_VARIANT_TYPE("(s)"), G_DBUS_CALL_FLAGS_NONE,
+                                               df_bus_get_call_timeout(), NULL, df_discovery_call_done, call);
+                        discovery.n_pending++;
+                }
+
+                if (discovery.n_pending == 0) {
+                        /* Out of memory, unless the frontier is empty */
+                        if (!g_queue_is_empty(&discovery.frontier))
+                                break;
+
+                        continue;
+                }
+
+                g_main_context_iteration(context, TRUE);
+        }
+
+        g_main_context_pop_thread_default(context);
+
+        if (!g_queue_is_empty(&discovery.frontier)) {
+                g_queue_clear_full(&discovery.frontier, g_free);
+                return df_oom();
+        }
+
+        df_verbose("Discovered %u object(s) under %s in %.2f s\n", discovery.n_objects, root,
+                   (g_get_monotonic_time() - start) / (double) G_USEC_PER_SEC);
+
+        return 0;
+}
+
+GDBusNodeInfo *df_get_interface_info(GDBusProxy *dproxy, const char *interface, GDBusInterfaceInfo **ret_iinfo)
+{
+        g_autoptr(GDBusNodeInfo) introspection_data = NULL;
+        GDBusInterfaceInfo *interface_info = NULL;
+
+        g_assert(dproxy);
+        g_assert(interface);
+        g_assert(ret_iinfo);
+
+        introspection_data = df_introspect(g_dbus_proxy_get_connection(dproxy),
+                                           g_dbus_proxy_get_name(dproxy),
+                                           g_dbus_proxy_get_object_path(dproxy));
+        if (!introspection_data)
+                return NULL;
+
         // Looks up information about an interface (methods, their arguments, etc).
         interface_info = g_dbus_node_info_lookup_interface(introspection_data, interface);
         if (!interface_info) {
@@ -73,7 +325,91 @@ GDBusNodeInfo *df_get_interface_info(GDBusProxy *dproxy, const char *interface,
 
         *ret_iinfo = interface_info;
 
-        return introspection_data;
+        return g_steal_pointer(&introspection_data);
+}
+
+int df_introspection_cache_load(const char *file_name, const char *name)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) cache = NULL;
+        g_autoptr(GVariantIter) iter = NULL;
+        g_autoptr(GMutexLocker) locker = NULL;
+        g_autoptr(gchar) cached_name = NULL;
+        gchar *contents = NULL, *object, *xml;
+        gsize size;
+        guint n = 0;
+
+        if (!g_file_get_contents(file_name, &contents, &size, &error)) {
+                if (g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+                        return 0;
+
+                return df_fail_ret(-1, "Failed to read introspection cache %s: %s\n", file_name, error->message);
+        }
+
+        cache = g_variant_new_from_data(G_VARIANT_TYPE(DF_INTROSPECTION_CACHE_TYPE), contents, size, FALSE,
+                                        g_free, contents);
+        cache = g_variant_ref_sink(cache);
+        if (G_BYTE_ORDER != G_LITTLE_ENDIAN) {
+                GVariant *swapped = g_variant_byteswap(cache);
+
+                g_variant_unref(cache);
+                cache = swapped;
+        }
+
+        g_variant_get(cache, "(sa{ss})", &cached_name, &iter);
+        if (!g_str_equal(cached_name, name))
+                return df_fail_ret(-1, "Introspection cache %s belongs to '%s', not '%s'\n",
+                                   file_name, cached_name, name);
+
+        locker = g_mutex_locker_new(&df_introspection_lock);
+        while (g_variant_iter_next(iter, "{ss}", &object, &xml)) {
+                df_introspection_cache_put(g_strconcat(name, "\n", object, NULL), xml);
+                g_free(object);
+                n++;
+        }
+
+        df_verbose("Loaded introspection data of %u object(s) from %s\n", n, file_name);
+
+        return 0;
+}
+
+int df_introspection_cache_save(const char *file_name, const char *name)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) cache = NULL;
+        g_autoptr(GMutexLocker) locker = NULL;
+        g_autoptr(gchar) prefix = NULL;
+        GVariantBuilder builder;
+        GHashTableIter iter;
+        gpointer key, value;
+
+        prefix = g_strconcat(name, "\n", NULL);
+        g_variant_builder_init(&builder, G_VARIANT_TYPE("a{ss}"));
+
+        locker = g_mutex_locker_new(&df_introspection_lock);
+        if (df_introspection_cache) {
+                g_hash_table_iter_init(&iter, df_introspection_cache);
+                while (g_hash_table_iter_next(&iter, &key, &value)) {
+                        const df_introspection_entry_t *entry = value;
+
+                        if (g_str_has_prefix(key, prefix))
+                                g_variant_builder_add(&builder, "{ss}", (const char *) key + strlen(prefix), entry->xml);
+                }
+        }
+        g_clear_pointer(&locker, g_mutex_locker_free);
+
+        cache = g_variant_ref_sink(g_variant_new("(sa{ss})", name, &builder));
+        if (G_BYTE_ORDER != G_LITTLE_ENDIAN) {
+                GVariant *swapped = g_variant_byteswap(cache);
+
+                g_variant_unref(cache);
+                cache = swapped;
+        }
+
+        if (!g_file_set_contents(file_name, g_variant_get_data(cache), g_variant_get_size(cache), &error))
+                return df_fail_ret(-1, "Failed to write introspection cache %s: %s\n", file_name, error->message);
+
+        return 0;
 }
 
 char *df_method_get_full_signature(const GDBusMethodInfo *method)
@@ -114,3 +450,14 @@ gboolean df_object_returns_reply(GDBusAnnotationInfo **annotations)
 
         return TRUE;
 }
+
+gboolean df_interface_has_readable_properties(const GDBusInterfaceInfo *interface)
+{
+        g_assert(interface);
+
+        STRV_FOREACH(p, interface->properties)
+                if (p->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE)
+                        return TRUE;
+
+        return FALSE;
+}
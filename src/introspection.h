@@ -19,6 +19,63 @@
  */
 #pragma once
 
+/** Type of the on-disk introspection cache: bus name and XML data of each
+  * object path (little-endian) */
+#define DF_INTROSPECTION_CACHE_TYPE "(sa{ss})"
+
+/** Default number of Introspect calls in flight during the discovery */
+#define DF_DISCOVERY_INFLIGHT_DEFAULT 32
+
+/**
+ * @function Gets introspection data of the object; each object is
+ * introspected and parsed only once, further calls return the cached data.
+ * @param dcon D-Bus connection structure
+ * @param name D-Bus name
+ * @param object D-Bus object path
+ * @return New reference to the introspection data on success, NULL on error
+ */
+GDBusNodeInfo *df_introspect(GDBusConnection *dcon, const char *name, const char *object);
+/**
+ * @function Discovers the whole object tree under root breadth-first,
+ * introspecting up to max_pending objects at once asynchronously, and fills
+ * the cache with their data, so the following traversal doesn't need to wait
+ * for any calls. Objects which can't be introspected are skipped (together
+ * with their children).
+ * @param dcon D-Bus connection structure
+ * @param name D-Bus name
+ * @param root Object path the discovery starts from
+ * @param max_pending Maximum number of Introspect calls in flight
+ * @return 0 on success, negative value on error
+ */
+int df_introspect_tree(GDBusConnection *dcon, const char *name, const char *root, guint max_pending);
+/**
+ * @function Same as df_introspect(), but looks up the interface implemented
+ * by the proxy's object as well.
+ * @return New reference to the introspection data of the whole object on
+ * success, NULL on error
+ */
 GDBusNodeInfo *df_get_interface_info(GDBusProxy *dproxy, const char *interface, GDBusInterfaceInfo **ret_iinfo);
 char *df_method_get_full_signature(const GDBusMethodInfo *method);
 gboolean df_object_returns_reply(GDBusAnnotationInfo **annotations);
+/**
+ * @function Checks whether GetAll on the interface would return anything
+ * @return TRUE if the interface has at least one readable property
+ */
+gboolean df_interface_has_readable_properties(const GDBusInterfaceInfo *interface);
+
+/**
+ * @function Fills the introspection cache with data (of the bus name) saved
+ * by df_introspection_cache_save(), so the objects don't need to be
+ * introspected again; a missing file is not an error.
+ * @return 0 on success, -1 on error
+ */
+int df_introspection_cache_load(const char *file_name, const char *name);
+/**
+ * @function Saves the cached introspection data of the bus name into the file
+ * @return 0 on success, -1 on error
+ */
+int df_introspection_cache_save(const char *file_name, const char *name);
+/**
+ * @function Drops all cached introspection data
+ */
+void df_introspection_cache_clear(void);
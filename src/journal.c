@@ -0,0 +1,219 @@
+/** @file journal.c */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "journal.h"
+#include "log.h"
+#include "util.h"
+
+static char *df_journal_key(df_journal_kind_t kind, const char *object, const char *interface,
+                            const char *member)
+{
+        return g_strdup_printf("%c\n%s\n%s\n%s", kind, object, interface, member ?: "");
+}
+
+/* Parses a complete line of the journal */
+static int df_journal_parse_line(df_journal_t *j, const char *line)
+{
+        g_auto(GStrv) fields = NULL;
+        guint64 result, n;
+        guint n_fields;
+
+        if (isempty(line) || line[0] == '#')
+                return 0;
+
+        fields = g_strsplit(line, " ", 0);
+        n_fields = g_strv_length(fields);
+
+        if (g_str_equal(fields[0], "S")) {
+                if (n_fields != 2 || safe_strtoull(fields[1], &j->seed) < 0)
+                        return -EINVAL;
+                j->have_seed = TRUE;
+                return 0;
+        }
+
+        if (strlen(fields[0]) != 1 || !strchr("MPI", fields[0][0]))
+                return -EINVAL;
+        if (n_fields != (fields[0][0] == DF_JOURNAL_INTERFACE ? 6 : 7))
+                return -EINVAL;
+        if (safe_strtoull(fields[1], &result) < 0 || result >= INT_MAX ||
+            safe_strtoull(fields[2], &n) < 0 || safe_strtoull(fields[3], &n) < 0)
+                return -EINVAL;
+
+        g_hash_table_replace(j->done, df_journal_key(fields[0][0], fields[4], fields[5], fields[6]),
+                             GINT_TO_POINTER((int) result + 1));
+
+        return 0;
+}
+
+static int df_journal_load(df_journal_t *j)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) contents = NULL;
+        gsize size, valid = 0;
+        guint line_number = 0;
+
+        if (!g_file_get_contents(j->path, &contents, &size, &error)) {
+                if (g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+                        return 0;
+
+                return df_fail_ret(-1, "Error: Failed to read the journal '%s': %s\n", j->path, error->message);
+        }
+
+        /* Only complete lines count, the last one might be torn */
+        for (char *p = contents, *e; (e = memchr(p, '\n', size - (p - contents))); p = e + 1) {
+                *e = 0;
+                line_number++;
+                if (df_journal_parse_line(j, p) < 0)
+                        return df_fail_ret(-1, "Error: Invalid line %u of the journal '%s'\n", line_number, j->path);
+                valid = e + 1 - contents;
+        }
+
+        if (valid < size) {
+                df_verbose("Dropping the incomplete last line of the journal '%s'\n", j->path);
+                if (truncate(j->path, valid) < 0)
+                        return df_fail_ret(-1, "Error: Failed to truncate the journal '%s': %m\n", j->path);
+        }
+
+        df_verbose("Resuming: %u finished item(s) in the journal '%s'\n", g_hash_table_size(j->done), j->path);
+
+        return 0;
+}
+
+df_journal_t *df_journal_open(const char *path, gboolean resume)
+{
+        g_autoptr(df_journal_t) j = NULL;
+
+        g_assert(path);
+
+        j = calloc(1, sizeof(*j));
+        if (!j) {
+                df_oom();
+                return NULL;
+        }
+
+        j->fd = -1;
+        g_mutex_init(&j->lock);
+        j->done = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        j->path = strdup(path);
+        if (!j->path) {
+                df_oom();
+                return NULL;
+        }
+
+        if (resume && df_journal_load(j) < 0)
+                return NULL;
+
+        j->fd = open(path, O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC|(resume ? 0 : O_TRUNC), 0644);
+        if (j->fd < 0) {
+                df_fail("Error: Failed to open the journal '%s': %m\n", path);
+                return NULL;
+        }
+        j->synced_usec = g_get_monotonic_time();
+
+        return g_steal_pointer(&j);
+}
+
+void df_journal_free(df_journal_t *j)
+{
+        if (!j)
+                return;
+
+        if (j->fd >= 0) {
+                (void) fdatasync(j->fd);
+                (void) close(j->fd);
+        }
+        if (j->done)
+                g_hash_table_unref(j->done);
+        free(j->path);
+        g_mutex_clear(&j->lock);
+        free(j);
+}
+
+/* Must be called with the lock held */
+static int df_journal_write(df_journal_t *j, const char *line)
+{
+        size_t size = strlen(line);
+        gint64 now;
+        ssize_t n;
+
+        /* A single write() for the whole line, so it's never interleaved
+         * with another one */
+        do
+                n = write(j->fd, line, size);
+        while (n < 0 && errno == EINTR);
+        if (n < 0 || (size_t) n != size)
+                return df_fail_ret(-1, "Error: Failed to write to the journal '%s': %m\n", j->path);
+
+        now = g_get_monotonic_time();
+        if (now - j->synced_usec >= DF_JOURNAL_SYNC_INTERVAL_SEC * G_USEC_PER_SEC) {
+                (void) fdatasync(j->fd);
+                j->synced_usec = now;
+        }
+
+        return 0;
+}
+
+int df_journal_set_seed(df_journal_t *j, guint64 seed)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        char line[sizeof("S \n") + DECIMAL_STR_MAX(guint64)];
+
+        g_assert(j);
+
+        locker = g_mutex_locker_new(&j->lock);
+        if (j->have_seed)
+                return 0;
+
+        sprintf(line, "S %"G_GUINT64_FORMAT"\n", seed);
+        if (df_journal_write(j, line) < 0)
+                return -1;
+
+        j->seed = seed;
+        j->have_seed = TRUE;
+
+        return 0;
+}
+
+gboolean df_journal_lookup(const df_journal_t *j, df_journal_kind_t kind, const char *object,
+                           const char *interface, const char *member, int *ret_result)
+{
+        g_autoptr(gchar) key = NULL;
+        gpointer value;
+
+        if (!j || g_hash_table_size(j->done) == 0)
+                return FALSE;
+
+        key = df_journal_key(kind, object, interface, member);
+        value = g_hash_table_lookup(j->done, key);
+        if (!value)
+                return FALSE;
+
+        *ret_result = GPOINTER_TO_INT(value) - 1;
+
+        return TRUE;
+}
+
+int df_journal_append(df_journal_t *j, df_journal_kind_t kind, int result, guint64 iterations, gint64 usec,
+                      const char *object, const char *interface, const char *member)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        g_autoptr(gchar) line = NULL;
+
+        g_assert(j);
+        g_assert(result >= 0);
+        g_assert(!!member == (kind != DF_JOURNAL_INTERFACE));
+
+        line = g_strdup_printf("%c %d %"G_GUINT64_FORMAT" %"G_GINT64_FORMAT" %s %s%s%s\n", kind, result,
+                               iterations, MAX(usec, 0), object, interface, member ? " " : "", member ?: "");
+
+        locker = g_mutex_locker_new(&j->lock);
+
+        return df_journal_write(j, line);
+}
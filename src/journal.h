@@ -0,0 +1,86 @@
+/** @file journal.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/** The journal is synced to the disk at most this often, so a crash of the
+  * host loses at most this much work */
+#define DF_JOURNAL_SYNC_INTERVAL_SEC 5
+
+/** Kinds of the journal entries */
+typedef enum df_journal_kind {
+        /** Method tested by df_fuzz_test_method() */
+        DF_JOURNAL_METHOD   = 'M',
+        /** Property tested by df_fuzz_test_property() */
+        DF_JOURNAL_PROPERTY = 'P',
+        /** All members of an interface tested by df_fuzz() */
+        DF_JOURNAL_INTERFACE = 'I',
+} df_journal_kind_t;
+
+/** Append-only journal of the finished work, so an interrupted run can be
+  * resumed (--resume)
+  *
+  * The journal lives next to the log in the -L/--log-dir= directory. Each
+  * line is written by a single write(), right after the method, property or
+  * interface it records finished, so nothing is rewritten and a killed
+  * dfuzzer loses nothing; the file is synced only every
+  * DF_JOURNAL_SYNC_INTERVAL_SEC. The lines are:
+  *
+  *   S SEED
+  *   KIND RESULT ITERATIONS USEC OBJECT INTERFACE [MEMBER]
+  *
+  * where the seed is all the state of the generator, since every iteration
+  * is seeded separately. A torn last line (after a crash of the host) is
+  * dropped when the journal is loaded. The loaded entries are not modified
+  * afterwards, so they can be looked up by all workers; appends are
+  * serialized by the lock.
+  */
+typedef struct df_journal {
+        int fd;
+        char *path;
+        /** "KIND\nOBJECT\nINTERFACE\nMEMBER" -> result + 1 (as a pointer) of
+          * the work finished in the previous runs */
+        GHashTable *done;
+        gboolean have_seed;
+        guint64 seed;
+        gint64 synced_usec;
+        GMutex lock;
+} df_journal_t;
+
+/**
+ * @function Opens the journal, loading the existing entries when resuming
+ * @param path Path of the journal
+ * @param resume If FALSE, the existing journal is truncated
+ * @return New journal on success (free it with df_journal_free()), NULL on
+ * error
+ */
+df_journal_t *df_journal_open(const char *path, gboolean resume);
+/**
+ * @function Syncs and closes the journal
+ */
+void df_journal_free(df_journal_t *j);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_journal_t, df_journal_free)
+
+/**
+ * @function Records the seed of the run, unless the journal already has one
+ * @return 0 on success, -1 on error
+ */
+int df_journal_set_seed(df_journal_t *j, guint64 seed);
+
+/**
+ * @function Looks up work finished in a previous run
+ * @param member Method or property name, NULL for DF_JOURNAL_INTERFACE
+ * @param ret_result Where the recorded result is stored
+ * @return TRUE if the work was finished, FALSE otherwise (or if j is NULL)
+ */
+gboolean df_journal_lookup(const df_journal_t *j, df_journal_kind_t kind, const char *object,
+                           const char *interface, const char *member, int *ret_result);
+
+/**
+ * @function Records finished work
+ * @param member Method or property name, NULL for DF_JOURNAL_INTERFACE
+ * @return 0 on success, -1 on error
+ */
+int df_journal_append(df_journal_t *j, df_journal_kind_t kind, int result, guint64 iterations, gint64 usec,
+                      const char *object, const char *interface, const char *member);
@@ -5,6 +5,20 @@
 
 static guint8 log_level_max = DF_LOG_LEVEL_INFO;
 static FILE *log_file;
+/** TRUE if the log file is in the binary format, see binlog.h */
+static gboolean log_binary;
+/** Serializes multi-line log records written by parallel workers */
+static GRecMutex log_lock;
+
+/** Part of a buffered record going to the same stream */
+typedef struct df_log_chunk {
+        FILE *target;
+        GString *text;
+} df_log_chunk_t;
+
+/** Chunks of the record buffered by the thread, NULL if it's not buffering,
+  * see df_log_begin_record() */
+static __thread GArray *log_record;
 
 void df_set_log_level(guint8 log_level)
 {
@@ -28,17 +42,95 @@ int df_log_open_log_file(const char *file_name)
         if (!log_file)
                 return df_fail_ret(-1, "Failed to open file %s: %m\n", file_name);
 
+        /* A record is written after each iteration, so don't go through
+         * a syscall after every few of them */
+        if (setvbuf(log_file, NULL, _IOFBF, DF_LOG_BUFFER_SIZE) != 0)
+                return df_fail_ret(-1, "Failed to set up buffering of file %s\n", file_name);
+
         return 0;
 }
 
+int df_log_close_log_file(void)
+{
+        int r;
+
+        if (!log_file)
+                return 0;
+
+        r = df_log_flush();
+        if (fclose(log_file) != 0 && r == 0)
+                r = df_fail_ret(-1, "Failed to close the log file: %m\n");
+
+        log_file = NULL;
+        log_binary = FALSE;
+
+        return r;
+}
+
 gboolean df_log_file_is_open(void)
 {
         return !!log_file;
 }
 
+void df_log_lock(void)
+{
+        g_rec_mutex_lock(&log_lock);
+}
+
+void df_log_unlock(void)
+{
+        g_rec_mutex_unlock(&log_lock);
+}
+
+void df_log_begin_record(void)
+{
+        g_assert(!log_record);
+
+        log_record = g_array_new(FALSE, FALSE, sizeof(df_log_chunk_t));
+}
+
+void df_log_end_record(void)
+{
+        g_assert(log_record);
+
+        df_log_lock();
+        for (guint i = 0; i < log_record->len; i++) {
+                df_log_chunk_t *chunk = &g_array_index(log_record, df_log_chunk_t, i);
+
+                fputs(chunk->text->str, chunk->target);
+                fflush(chunk->target);
+                g_string_free(chunk->text, TRUE);
+        }
+        df_log_unlock();
+
+        g_array_unref(log_record);
+        log_record = NULL;
+}
+
+static void df_log_buffer(FILE *target, const char *format, va_list args)
+{
+        df_log_chunk_t *chunk = NULL;
+
+        if (log_record->len > 0)
+                chunk = &g_array_index(log_record, df_log_chunk_t, log_record->len - 1);
+        if (!chunk || chunk->target != target) {
+                df_log_chunk_t next = { .target = target, .text = g_string_new(NULL) };
+
+                g_array_append_val(log_record, next);
+                chunk = &g_array_index(log_record, df_log_chunk_t, log_record->len - 1);
+        }
+
+        g_string_append_vprintf(chunk->text, format, args);
+}
+
+void df_log_set_binary(void)
+{
+        log_binary = TRUE;
+}
+
 void df_log_file(const char *format, ...)
 {
-        if (log_file) {
+        if (log_file && !log_binary) {
                 va_list args;
 
                 va_start(args, format);
@@ -47,6 +139,20 @@ void df_log_file(const char *format, ...)
         }
 }
 
+void df_log_write(const void *data, size_t size)
+{
+        if (log_file)
+                (void) fwrite(data, 1, size, log_file);
+}
+
+int df_log_flush(void)
+{
+        if (log_file && fflush(log_file) != 0)
+                return df_fail_ret(-1, "Failed to write the log file: %m\n");
+
+        return 0;
+}
+
 void df_log_full(gint8 log_level, FILE *target, const char *format, ...)
 {
         if (log_level > log_level_max)
@@ -55,9 +161,13 @@ void df_log_full(gint8 log_level, FILE *target, const char *format, ...)
         va_list args;
 
         va_start(args, format);
-        vfprintf(target, format, args);
+        if (log_record)
+                df_log_buffer(target, format, args);
+        else {
+                vfprintf(target, format, args);
+                fflush(target);
+        }
         va_end(args);
-        fflush(target);
 }
 
 void df_error(const char *message, GError *error)
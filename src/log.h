@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/** Size of the buffer of the log file */
+#define DF_LOG_BUFFER_SIZE (1024 * 1024)
+
 enum {
         DF_LOG_LEVEL_INFO = 0,
         DF_LOG_LEVEL_VERBOSE,
@@ -15,10 +18,26 @@ enum {
 void df_set_log_level(guint8 log_level);
 guint8 df_get_log_level(void);
 int df_log_open_log_file(const char *file_name);
+/* Flushes and closes the log file, so another one can be opened */
+int df_log_close_log_file(void);
 gboolean df_log_file_is_open(void);
+/* Keep a record consisting of multiple log calls together when logging
+ * from multiple threads; the lock is recursive */
+void df_log_lock(void);
+void df_log_unlock(void);
+/* Buffer all the output of the thread (via df_log_full()) until
+ * df_log_end_record() writes it at once, so the output of a longer piece of
+ * work (e.g. a whole interface) isn't interleaved with other threads */
+void df_log_begin_record(void);
+void df_log_end_record(void);
 
 /* Normal logging */
 void df_log_file(const char *format, ...) __attribute__((__format__(printf, 1, 2)));
+/* Raw data (see binlog.h); once the log is switched to the binary format
+ * df_log_file() doesn't write anything */
+void df_log_set_binary(void);
+void df_log_write(const void *data, size_t size);
+int df_log_flush(void);
 void df_log_full(gint8 log_level, FILE *target, const char *format, ...) __attribute__((__format__(printf, 3, 4)));
 
 #define df_log(...)         df_log_full(DF_LOG_LEVEL_INFO, stdout, __VA_ARGS__)
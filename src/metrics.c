@@ -0,0 +1,525 @@
+/** @file metrics.c */
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "log.h"
+#include "util.h"
+
+/** Counters of all threads, new ones are pushed to the head */
+static df_metrics_thread_t *df_metrics_threads;
+static __thread df_metrics_thread_t *df_metrics_self;
+
+/** Thread exporting the metrics, see df_metrics_start() */
+typedef struct df_metrics_exporter {
+        GThread *thread;
+        guint64 interval_sec;
+        /** Metrics file, NULL with a socket */
+        char *path;
+        /** Path of the unix socket, NULL without one */
+        char *socket_path;
+        int listen_fd;
+        /** The write end is closed to stop the thread */
+        int stop_fds[2];
+} df_metrics_exporter_t;
+
+static df_metrics_exporter_t *df_metrics_exporter;
+
+/* Only the owning thread writes its counters, so no read-modify-write
+ * atomics are needed, just untorn loads and stores */
+static inline void df_metrics_inc(guint64 *counter, guint64 n)
+{
+        __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline guint64 df_metrics_load(const guint64 *counter)
+{
+        return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static df_metrics_thread_t *df_metrics_get_self(void)
+{
+        df_metrics_thread_t *t = df_metrics_self;
+
+        if (G_LIKELY(t))
+                return t;
+
+        /* The counters are just lost if we run out of memory */
+        t = calloc(1, sizeof(*t));
+        if (!t)
+                return NULL;
+
+        do
+                t->next = g_atomic_pointer_get(&df_metrics_threads);
+        while (!g_atomic_pointer_compare_and_exchange(&df_metrics_threads, t->next, t));
+
+        df_metrics_self = t;
+
+        return t;
+}
+
+static void df_metrics_add_error(df_metrics_thread_t *t, const GError *error)
+{
+        g_autoptr(gchar) remote = NULL;
+        const char *name;
+
+        remote = g_dbus_error_get_remote_error(error);
+        name = remote ?: g_quark_to_string(error->domain);
+
+        for (guint i = 0; i < DF_METRICS_MAX_ERROR_NAMES; i++) {
+                df_metrics_error_t *e = &t->errors[i];
+                char *e_name = g_atomic_pointer_get(&e->name);
+
+                if (!e_name) {
+                        e_name = strdup(name);
+                        if (!e_name)
+                                break;
+                        /* Published before its count is, readers stop at the
+                         * first unset name */
+                        g_atomic_pointer_set(&e->name, e_name);
+                }
+
+                if (g_str_equal(e_name, name)) {
+                        df_metrics_inc(&e->count, 1);
+                        return;
+                }
+        }
+
+        df_metrics_inc(&t->other_errors, 1);
+}
+
+void df_metrics_add_call(const GError *error, guint64 latency_usec)
+{
+        df_metrics_thread_t *t = df_metrics_get_self();
+        guint64 *bucket;
+
+        if (!t)
+                return;
+
+        df_metrics_inc(&t->calls, 1);
+        df_metrics_inc(&t->latency_usec, latency_usec);
+        bucket = &t->latency.buckets[df_histogram_index(latency_usec)];
+        df_metrics_inc(bucket, 1);
+        df_metrics_inc(&t->latency.count, 1);
+        if (latency_usec > df_metrics_load(&t->latency.max))
+                __atomic_store_n(&t->latency.max, latency_usec, __ATOMIC_RELAXED);
+
+        if (error) {
+                df_metrics_inc(&t->exceptions, 1);
+                df_metrics_add_error(t, error);
+        }
+}
+
+void df_metrics_add_bytes(guint64 bytes)
+{
+        df_metrics_thread_t *t = df_metrics_get_self();
+
+        if (t)
+                df_metrics_inc(&t->bytes, bytes);
+}
+
+void df_metrics_add_reconnect(guint64 waited_usec)
+{
+        df_metrics_thread_t *t = df_metrics_get_self();
+
+        if (!t)
+                return;
+
+        df_metrics_inc(&t->reconnects, 1);
+        df_metrics_inc(&t->reconnect_usec, waited_usec);
+}
+
+void df_metrics_snapshot_clear(df_metrics_snapshot_t *s)
+{
+        if (s->errors)
+                g_hash_table_unref(s->errors);
+        memset(s, 0, sizeof(*s));
+}
+
+void df_metrics_collect(df_metrics_snapshot_t *ret)
+{
+        g_assert(ret);
+
+        memset(ret, 0, sizeof(*ret));
+        ret->errors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+        for (df_metrics_thread_t *t = g_atomic_pointer_get(&df_metrics_threads); t; t = t->next) {
+                ret->calls += df_metrics_load(&t->calls);
+                ret->exceptions += df_metrics_load(&t->exceptions);
+                ret->bytes += df_metrics_load(&t->bytes);
+                ret->reconnects += df_metrics_load(&t->reconnects);
+                ret->reconnect_usec += df_metrics_load(&t->reconnect_usec);
+                ret->latency_usec += df_metrics_load(&t->latency_usec);
+                ret->other_errors += df_metrics_load(&t->other_errors);
+
+                for (guint i = 0; i < DF_HISTOGRAM_BUCKETS; i++)
+                        ret->latency.buckets[i] += df_metrics_load(&t->latency.buckets[i]);
+                ret->latency.count += df_metrics_load(&t->latency.count);
+                ret->latency.max = MAX(ret->latency.max, df_metrics_load(&t->latency.max));
+
+                for (guint i = 0; i < DF_METRICS_MAX_ERROR_NAMES; i++) {
+                        const char *name = g_atomic_pointer_get(&t->errors[i].name);
+                        guint64 *count;
+
+                        if (!name)
+                                break;
+
+                        count = g_hash_table_lookup(ret->errors, name);
+                        if (!count) {
+                                count = g_new0(guint64, 1);
+                                g_hash_table_insert(ret->errors, g_strdup(name), count);
+                        }
+                        *count += df_metrics_load(&t->errors[i].count);
+                }
+        }
+}
+
+/* Appends the label value, escaped as required by OpenMetrics */
+static void df_metrics_append_label(GString *out, const char *value)
+{
+        for (const char *p = value; *p; p++) {
+                if (*p == '\\' || *p == '"')
+                        g_string_append_c(out, '\\');
+                if (*p == '\n')
+                        g_string_append(out, "\\n");
+                else
+                        g_string_append_c(out, *p);
+        }
+}
+
+char *df_metrics_format_openmetrics(const df_metrics_snapshot_t *s)
+{
+        g_autoptr(GList) names = NULL;
+        GString *out;
+        guint64 cumulative = 0;
+        guint b = 0;
+
+        g_assert(s);
+
+        out = g_string_new(NULL);
+        g_string_append_printf(out,
+                        "# TYPE dfuzzer_calls counter\n"
+                        "# HELP dfuzzer_calls Finished method calls.\n"
+                        "dfuzzer_calls_total %"G_GUINT64_FORMAT"\n"
+                        "# TYPE dfuzzer_generated_bytes counter\n"
+                        "# UNIT dfuzzer_generated_bytes bytes\n"
+                        "# HELP dfuzzer_generated_bytes Size of the generated (serialized) inputs.\n"
+                        "dfuzzer_generated_bytes_total %"G_GUINT64_FORMAT"\n"
+                        "# TYPE dfuzzer_reconnects counter\n"
+                        "# HELP dfuzzer_reconnects Waits for the tested process to come back.\n"
+                        "dfuzzer_reconnects_total %"G_GUINT64_FORMAT"\n"
+                        "# TYPE dfuzzer_reconnect_wait_seconds counter\n"
+                        "# UNIT dfuzzer_reconnect_wait_seconds seconds\n"
+                        "# HELP dfuzzer_reconnect_wait_seconds Time spent waiting for the tested process.\n"
+                        "dfuzzer_reconnect_wait_seconds_total %.6f\n",
+                        s->calls, s->bytes, s->reconnects, s->reconnect_usec / (double) G_USEC_PER_SEC);
+
+        g_string_append(out,
+                        "# TYPE dfuzzer_exceptions counter\n"
+                        "# HELP dfuzzer_exceptions Method calls which failed, by D-Bus error name.\n");
+        names = g_list_sort(g_hash_table_get_keys(s->errors), (GCompareFunc) g_strcmp0);
+        for (GList *l = names; l; l = l->next) {
+                g_string_append(out, "dfuzzer_exceptions_total{name=\"");
+                df_metrics_append_label(out, l->data);
+                g_string_append_printf(out, "\"} %"G_GUINT64_FORMAT"\n",
+                                       *(guint64 *) g_hash_table_lookup(s->errors, l->data));
+        }
+        if (s->other_errors > 0)
+                g_string_append_printf(out, "dfuzzer_exceptions_total{name=\"other\"} %"G_GUINT64_FORMAT"\n",
+                                       s->other_errors);
+
+        /* The bounds of the histogram buckets are aligned to powers of two,
+         * so the cumulative counts are exact */
+        g_string_append(out,
+                        "# TYPE dfuzzer_call_latency_seconds histogram\n"
+                        "# UNIT dfuzzer_call_latency_seconds seconds\n"
+                        "# HELP dfuzzer_call_latency_seconds Latency of the method calls.\n");
+        for (guint e = DF_METRICS_LATENCY_MIN_LOG; e <= DF_METRICS_LATENCY_MAX_LOG; e++) {
+                guint64 bound = ((guint64) 1 << e) - 1;
+
+                while (b < DF_HISTOGRAM_BUCKETS && df_histogram_upper_bound(b) <= bound)
+                        cumulative += s->latency.buckets[b++];
+                g_string_append_printf(out, "dfuzzer_call_latency_seconds_bucket{le=\"%.6f\"} %"G_GUINT64_FORMAT"\n",
+                                       bound / (double) G_USEC_PER_SEC, cumulative);
+        }
+        while (b < DF_HISTOGRAM_BUCKETS)
+                cumulative += s->latency.buckets[b++];
+        g_string_append_printf(out,
+                               "dfuzzer_call_latency_seconds_bucket{le=\"+Inf\"} %"G_GUINT64_FORMAT"\n"
+                               "dfuzzer_call_latency_seconds_sum %.6f\n"
+                               "dfuzzer_call_latency_seconds_count %"G_GUINT64_FORMAT"\n"
+                               "# EOF\n",
+                               cumulative, s->latency_usec / (double) G_USEC_PER_SEC, cumulative);
+
+        return g_string_free(out, FALSE);
+}
+
+char *df_metrics_format_status(const df_metrics_snapshot_t *s, const df_metrics_snapshot_t *previous,
+                               gint64 elapsed_usec)
+{
+        g_autoptr(gchar) bytes = NULL;
+        guint64 calls;
+
+        g_assert(s);
+
+        calls = s->calls - (previous ? previous->calls : 0);
+        bytes = g_format_size(s->bytes);
+
+        return g_strdup_printf("[STATS: %"G_GUINT64_FORMAT" calls (%.1f/s), %"G_GUINT64_FORMAT" exceptions, "
+                               "%s generated, %"G_GUINT64_FORMAT" reconnects, p50 %.1f ms, p99 %.1f ms]",
+                               s->calls, elapsed_usec > 0 ? calls * (double) G_USEC_PER_SEC / elapsed_usec : 0.0,
+                               s->exceptions, bytes, s->reconnects,
+                               df_histogram_percentile(&s->latency, 50) / 1000.0,
+                               df_histogram_percentile(&s->latency, 99) / 1000.0);
+}
+
+static int df_metrics_write_file(const char *path, const df_metrics_snapshot_t *s)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) text = NULL;
+
+        text = df_metrics_format_openmetrics(s);
+        /* Written to a temporary file and renamed, so the scraper never
+         * sees a partial file */
+        if (!g_file_set_contents(path, text, -1, &error))
+                return df_fail_ret(-1, "Error: Failed to write the metrics to '%s': %s\n", path, error->message);
+
+        return 0;
+}
+
+static void df_metrics_send(int fd, const char *data, size_t size)
+{
+        while (size > 0) {
+                ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0)
+                        return;
+
+                data += n;
+                size -= n;
+        }
+}
+
+static void df_metrics_serve(df_metrics_exporter_t *x)
+{
+        g_auto(df_metrics_snapshot_t) s = {};
+        g_autoptr(gchar) body = NULL, header = NULL;
+        g_auto(fd_t) fd = -1;
+        struct timeval timeout = { .tv_sec = 1 };
+        struct pollfd pfd;
+        char request[4096];
+        ssize_t n = 0;
+
+        fd = accept(x->listen_fd, NULL, NULL);
+        if (fd < 0)
+                return;
+        (void) fcntl(fd, F_SETFD, FD_CLOEXEC);
+        /* Don't get stuck on a client which doesn't read */
+        (void) setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        /* Plain readers (e.g. socat) don't send anything */
+        pfd = (struct pollfd) { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, DF_METRICS_REQUEST_TIMEOUT_MSEC) > 0)
+                n = recv(fd, request, sizeof(request), 0);
+
+        df_metrics_collect(&s);
+        body = df_metrics_format_openmetrics(&s);
+        if (n >= 4 && memcmp(request, "GET ", 4) == 0) {
+                header = g_strdup_printf("HTTP/1.0 200 OK\r\n"
+                                         "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                                         "Content-Length: %zu\r\n"
+                                         "Connection: close\r\n"
+                                         "\r\n", strlen(body));
+                df_metrics_send(fd, header, strlen(header));
+        }
+        df_metrics_send(fd, body, strlen(body));
+}
+
+static gpointer df_metrics_run(gpointer user_data)
+{
+        df_metrics_exporter_t *x = user_data;
+        g_auto(df_metrics_snapshot_t) previous = {};
+        gint64 period, last, next;
+
+        period = (x->interval_sec > 0 ? x->interval_sec : DF_METRICS_FILE_INTERVAL_SEC) * G_USEC_PER_SEC;
+        last = g_get_monotonic_time();
+        next = last + period;
+
+        for (;;) {
+                struct pollfd fds[] = {
+                        { .fd = x->stop_fds[0], .events = POLLIN },
+                        { .fd = x->listen_fd,   .events = POLLIN },
+                };
+                g_auto(df_metrics_snapshot_t) s = {};
+                gint64 now = g_get_monotonic_time();
+                int r;
+
+                r = poll(fds, x->listen_fd >= 0 ? 2 : 1, now >= next ? 0 : (int) MIN((next - now + 999) / 1000, INT_MAX));
+                if (r < 0 && errno != EINTR) {
+                        df_debug("Error while polling in the metrics thread: %m\n");
+                        break;
+                }
+                /* The write end was closed, see df_metrics_stop() */
+                if (r > 0 && fds[0].revents)
+                        break;
+                if (r > 0 && (fds[1].revents & POLLIN))
+                        df_metrics_serve(x);
+
+                now = g_get_monotonic_time();
+                if (now < next)
+                        continue;
+
+                df_metrics_collect(&s);
+                if (x->interval_sec > 0) {
+                        g_autoptr(gchar) status = NULL;
+
+                        status = df_metrics_format_status(&s, previous.errors ? &previous : NULL, now - last);
+                        fprintf(stderr, "%s%s%s%s\n", ansi_cr(), ansi_cyan(), status, ansi_normal());
+                }
+                if (x->path)
+                        (void) df_metrics_write_file(x->path, &s);
+
+                df_metrics_snapshot_clear(&previous);
+                previous = s;
+                memset(&s, 0, sizeof(s));
+                last = now;
+                next = now + period;
+        }
+
+        return NULL;
+}
+
+static int df_metrics_listen(df_metrics_exporter_t *x)
+{
+        struct sockaddr_un sa = { .sun_family = AF_UNIX };
+        struct stat st;
+
+        if (strlen(x->socket_path) >= sizeof(sa.sun_path))
+                return df_fail_ret(-1, "Error: Path of the metrics socket is too long: %s\n", x->socket_path);
+        strcpy(sa.sun_path, x->socket_path);
+
+        /* Replace a stale socket of a previous run, but nothing else */
+        if (lstat(x->socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+                (void) unlink(x->socket_path);
+
+        x->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (x->listen_fd < 0)
+                return df_fail_ret(-1, "Error: Failed to create the metrics socket: %m\n");
+        (void) fcntl(x->listen_fd, F_SETFD, FD_CLOEXEC);
+
+        if (bind(x->listen_fd, (struct sockaddr *) &sa, sizeof(sa)) < 0)
+                return df_fail_ret(-1, "Error: Failed to bind the metrics socket to '%s': %m\n", x->socket_path);
+        if (listen(x->listen_fd, SOMAXCONN) < 0)
+                return df_fail_ret(-1, "Error: Failed to listen on the metrics socket: %m\n");
+
+        return 0;
+}
+
+static void df_metrics_exporter_free(df_metrics_exporter_t *x)
+{
+        if (!x)
+                return;
+
+        if (x->listen_fd >= 0) {
+                (void) close(x->listen_fd);
+                (void) unlink(x->socket_path);
+        }
+        for (guint i = 0; i < 2; i++)
+                if (x->stop_fds[i] >= 0)
+                        (void) close(x->stop_fds[i]);
+        free(x->path);
+        free(x->socket_path);
+        free(x);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_metrics_exporter_t, df_metrics_exporter_free)
+
+int df_metrics_start(guint64 interval_sec, const char *target)
+{
+        g_autoptr(df_metrics_exporter_t) x = NULL;
+        g_auto(df_metrics_snapshot_t) s = {};
+
+        g_assert(!df_metrics_exporter);
+
+        if (interval_sec == 0 && !target)
+                return 0;
+
+        x = calloc(1, sizeof(*x));
+        if (!x)
+                return df_oom();
+
+        x->interval_sec = interval_sec;
+        x->listen_fd = x->stop_fds[0] = x->stop_fds[1] = -1;
+
+        if (target && g_str_has_prefix(target, "unix:")) {
+                x->socket_path = strdup(target + strlen("unix:"));
+                if (!x->socket_path)
+                        return df_oom();
+                if (df_metrics_listen(x) < 0)
+                        return -1;
+        } else if (target) {
+                x->path = strdup(target);
+                if (!x->path)
+                        return df_oom();
+                /* Fail early if the file can't be written */
+                df_metrics_collect(&s);
+                if (df_metrics_write_file(x->path, &s) < 0)
+                        return -1;
+        }
+
+        if (pipe(x->stop_fds) < 0)
+                return df_fail_ret(-1, "Failed to create a pipe: %m\n");
+        (void) fcntl(x->stop_fds[0], F_SETFD, FD_CLOEXEC);
+        (void) fcntl(x->stop_fds[1], F_SETFD, FD_CLOEXEC);
+
+        x->thread = g_thread_new("dfuzzer-metrics", df_metrics_run, x);
+        df_metrics_exporter = g_steal_pointer(&x);
+
+        return 0;
+}
+
+void df_metrics_stop(void)
+{
+        df_metrics_exporter_t *x = g_steal_pointer(&df_metrics_exporter);
+        df_metrics_thread_t *t;
+
+        if (x) {
+                (void) close(x->stop_fds[1]);
+                x->stop_fds[1] = -1;
+                g_thread_join(x->thread);
+
+                /* Final values for the scraper */
+                if (x->path) {
+                        g_auto(df_metrics_snapshot_t) s = {};
+
+                        df_metrics_collect(&s);
+                        (void) df_metrics_write_file(x->path, &s);
+                }
+
+                df_metrics_exporter_free(x);
+        }
+
+        t = g_atomic_pointer_get(&df_metrics_threads);
+        g_atomic_pointer_set(&df_metrics_threads, NULL);
+        df_metrics_self = NULL;
+        while (t) {
+                df_metrics_thread_t *next = t->next;
+
+                for (guint i = 0; i < DF_METRICS_MAX_ERROR_NAMES; i++)
+                        free(t->errors[i].name);
+                free(t);
+                t = next;
+        }
+}
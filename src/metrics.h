@@ -0,0 +1,119 @@
+/** @file metrics.h */
+#pragma once
+
+#include <gio/gio.h>
+
+#include "histogram.h"
+
+/** Number of distinct D-Bus error names counted per thread, the rest is
+  * counted as "other" */
+#define DF_METRICS_MAX_ERROR_NAMES 64
+/** How often the --metrics= file is rewritten without --stats-interval= */
+#define DF_METRICS_FILE_INTERVAL_SEC 10
+/** How long a client of the --metrics=unix: socket gets to send its request */
+#define DF_METRICS_REQUEST_TIMEOUT_MSEC 100
+/** Latency buckets exported in the OpenMetrics output, as powers of two of
+  * microseconds (i.e. 15 us up to ~33.5 s) */
+#define DF_METRICS_LATENCY_MIN_LOG 4
+#define DF_METRICS_LATENCY_MAX_LOG 25
+
+/** Number of exceptions with the same D-Bus error name */
+typedef struct df_metrics_error {
+        /** Set once by the owning thread, never changed afterwards */
+        char *name;
+        guint64 count;
+} df_metrics_error_t;
+
+/** Counters of a single thread
+  *
+  * Only the owning thread updates the counters, so they are written with
+  * plain (relaxed) atomic stores, without any lock or read-modify-write
+  * cycle; readers load them atomically and sum all threads. The structure is
+  * registered in a lock-free list on the first update and outlives its
+  * thread, so nothing is lost when a worker exits.
+  */
+typedef struct df_metrics_thread {
+        guint64 calls;
+        guint64 exceptions;
+        guint64 bytes;
+        guint64 reconnects;
+        guint64 reconnect_usec;
+        /** Latencies of the calls in microseconds, and their sum */
+        df_histogram_t latency;
+        guint64 latency_usec;
+        df_metrics_error_t errors[DF_METRICS_MAX_ERROR_NAMES];
+        guint64 other_errors;
+        struct df_metrics_thread *next;
+} df_metrics_thread_t;
+
+/** Sum of the counters of all threads at some point in time */
+typedef struct df_metrics_snapshot {
+        guint64 calls;
+        guint64 exceptions;
+        guint64 bytes;
+        guint64 reconnects;
+        guint64 reconnect_usec;
+        df_histogram_t latency;
+        guint64 latency_usec;
+        /** Error name -> pointer to the number of exceptions (guint64) */
+        GHashTable *errors;
+        guint64 other_errors;
+} df_metrics_snapshot_t;
+
+void df_metrics_snapshot_clear(df_metrics_snapshot_t *s);
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(df_metrics_snapshot_t, df_metrics_snapshot_clear)
+
+/**
+ * @function Accounts a finished method call of the calling thread
+ * @param error Error the call failed with, NULL if it got a reply
+ * @param latency_usec Time the call took
+ */
+void df_metrics_add_call(const GError *error, guint64 latency_usec);
+/**
+ * @function Accounts bytes of a generated (serialized) input
+ */
+void df_metrics_add_bytes(guint64 bytes);
+/**
+ * @function Accounts a wait for the tested process to come back
+ * @param waited_usec How long the wait took
+ */
+void df_metrics_add_reconnect(guint64 waited_usec);
+
+/**
+ * @function Sums the counters of all threads
+ * @param ret Where the sums are stored, clear it with
+ * df_metrics_snapshot_clear()
+ */
+void df_metrics_collect(df_metrics_snapshot_t *ret);
+/**
+ * @return The snapshot in the OpenMetrics text format (including the
+ * terminating "# EOF" line), free it with g_free()
+ */
+char *df_metrics_format_openmetrics(const df_metrics_snapshot_t *s);
+/**
+ * @param previous Snapshot of the previous status line, NULL if there's none
+ * @param elapsed_usec Time since the previous snapshot (or the start)
+ * @return One-line summary of the snapshot, free it with g_free()
+ */
+char *df_metrics_format_status(const df_metrics_snapshot_t *s, const df_metrics_snapshot_t *previous,
+                               gint64 elapsed_usec);
+
+/**
+ * @function Starts a thread printing a status line to stderr every interval
+ * seconds and exporting the metrics in the OpenMetrics text format
+ * @param interval_sec Interval of the status line, 0 disables it
+ * @param target Where the metrics are exported: a file, which is rewritten
+ * periodically (atomically, via rename()), or "unix:PATH", a unix socket
+ * which serves the metrics to each client, either as a plain HTTP response
+ * or, if the client doesn't send a GET request, as bare text. NULL disables
+ * the export.
+ * @return 0 on success, -1 on error
+ */
+int df_metrics_start(guint64 interval_sec, const char *target);
+/**
+ * @function Stops the thread started by df_metrics_start() (the metrics file
+ * is written once more), and frees the counters of all threads; call it
+ * once all threads finished
+ */
+void df_metrics_stop(void);
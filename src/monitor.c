@@ -0,0 +1,202 @@
+/** @file monitor.c */
+#include <errno.h>
+#include <gio/gio.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "monitor.h"
+#include "log.h"
+#include "util.h"
+
+int df_check_if_exited(const int pid) {
+        g_autoptr(FILE) f = NULL;
+        g_autoptr(char) line = NULL;
+        char proc_pid[14 + DECIMAL_STR_MAX(pid)];
+        size_t len = 0;
+        int dumping;
+
+        g_assert(pid > 0);
+
+        sprintf(proc_pid, "/proc/%d/status", pid);
+
+        f = fopen(proc_pid, "r");
+        if (!f) {
+                if (errno == ENOENT || errno == ENOTDIR || errno == ESRCH)
+                        return 0;
+
+                return -1;
+        }
+
+        /* Check if the process is not currently dumping a core */
+        while (getline(&line, &len, f) > 0) {
+                if (sscanf(line, "CoreDumping: %d", &dumping) == 1) {
+                        if (dumping > 0)
+                                return 0;
+
+                        break;
+                }
+        }
+
+        /* Assume the process exited if we fail while reading the stat file */
+        if (ferror(f))
+                return 0;
+
+        return 1;
+}
+
+static fd_t df_pidfd_open(int pid)
+{
+#ifdef SYS_pidfd_open
+        return syscall(SYS_pidfd_open, pid, 0);
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+}
+
+static void df_monitor_set_state(df_monitor_t *monitor, int state, int error)
+{
+        g_atomic_int_set(&monitor->error, error);
+        g_atomic_int_set(&monitor->state, state);
+}
+
+static gpointer df_monitor_run(gpointer user_data)
+{
+        df_monitor_t *monitor = user_data;
+        struct pollfd fds[] = {
+                { .fd = monitor->wakeup_fd, .events = POLLIN },
+                { .fd = monitor->pidfd,     .events = POLLIN },
+        };
+        nfds_t n_fds = monitor->pidfd >= 0 ? 2 : 1;
+        int r;
+
+        for (;;) {
+                r = poll(fds, n_fds, DF_MONITOR_INTERVAL_MSEC);
+                if (r < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        df_monitor_set_state(monitor, -1, errno);
+                        break;
+                }
+
+                /* Asked to stop */
+                if (fds[0].revents)
+                        break;
+
+                /* pidfd becomes readable once the process exits */
+                if (n_fds > 1 && fds[1].revents) {
+                        df_monitor_set_state(monitor, 0, 0);
+                        break;
+                }
+
+                /* Timeout; pidfd doesn't tell us if the process is dumping
+                 * a core (which may take a while), so check /proc as well */
+                r = df_check_if_exited(monitor->pid);
+                if (r <= 0) {
+                        df_monitor_set_state(monitor, r, errno);
+                        break;
+                }
+        }
+
+        return NULL;
+}
+
+df_monitor_t *df_monitor_new(int pid)
+{
+        static gint pidfd_warned;
+        g_autoptr(GError) error = NULL;
+        df_monitor_t *monitor;
+
+        g_assert(pid > 0);
+
+        monitor = calloc(1, sizeof(*monitor));
+        if (!monitor)
+                return NULL;
+
+        monitor->pid = pid;
+        monitor->state = 1;
+        monitor->pidfd = df_pidfd_open(pid);
+        if (monitor->pidfd < 0) {
+                if (errno == ESRCH)
+                        monitor->state = 0;
+                else if (g_atomic_int_compare_and_exchange(&pidfd_warned, 0, 1))
+                        df_debug("pidfd_open() failed (%m), falling back to polling /proc\n");
+        }
+
+        monitor->wakeup_fd = eventfd(0, EFD_CLOEXEC);
+        if (monitor->wakeup_fd < 0) {
+                df_fail("Failed to create an eventfd: %m\n");
+                safe_close(monitor->pidfd);
+                free(monitor);
+                return NULL;
+        }
+
+        /* The process is already gone, no need to watch it */
+        if (monitor->state == 0)
+                return monitor;
+
+        monitor->thread = g_thread_try_new("df-monitor", df_monitor_run, monitor, &error);
+        if (!monitor->thread) {
+                df_fail("Failed to start a monitor thread: %s\n", error->message);
+                df_monitor_free(monitor);
+                return NULL;
+        }
+
+        return monitor;
+}
+
+void df_monitor_free(df_monitor_t *monitor)
+{
+        if (!monitor)
+                return;
+
+        if (monitor->thread) {
+                eventfd_write(monitor->wakeup_fd, 1);
+                g_thread_join(monitor->thread);
+        }
+
+        safe_close(monitor->wakeup_fd);
+        safe_close(monitor->pidfd);
+        free(monitor);
+}
+
+int df_monitor_is_alive(df_monitor_t *monitor)
+{
+        int state;
+
+        g_assert(monitor);
+
+        state = g_atomic_int_get(&monitor->state);
+        if (state < 0)
+                errno = g_atomic_int_get(&monitor->error);
+
+        return state;
+}
+
+int df_monitor_check(df_monitor_t *monitor)
+{
+        struct pollfd fd = { .fd = monitor->pidfd, .events = POLLIN };
+        int r;
+
+        g_assert(monitor);
+
+        r = df_monitor_is_alive(monitor);
+        if (r <= 0)
+                return r;
+
+        if (monitor->pidfd >= 0) {
+                r = poll(&fd, 1, 0);
+                if (r < 0)
+                        return -1;
+                if (r > 0)
+                        return 0;
+        }
+
+        return df_check_if_exited(monitor->pid);
+}
@@ -0,0 +1,58 @@
+/** @file monitor.h */
+#pragma once
+
+#include <gio/gio.h>
+
+#include "util.h"
+
+/** How often the monitor looks into /proc (to catch processes dumping
+  * a core, or when pidfds are not available) */
+#define DF_MONITOR_INTERVAL_MSEC 10
+
+/** Asynchronous monitor of the tested process
+  *
+  * A background thread waits on a pidfd of the process (with a fallback to
+  * polling /proc/<pid>/status if pidfd_open() is not available), so checking
+  * if the process is still alive is just a load of an atomic variable.
+  */
+typedef struct df_monitor {
+        int pid;
+        fd_t pidfd;
+        fd_t wakeup_fd;
+        GThread *thread;
+        /* Same values as returned by df_monitor_is_alive() */
+        gint state;
+        gint error;
+} df_monitor_t;
+
+/**
+ * @function Starts monitoring the process pid
+ * @return New monitor on success (free it with df_monitor_free()), NULL on error
+ */
+df_monitor_t *df_monitor_new(int pid);
+void df_monitor_free(df_monitor_t *monitor);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_monitor_t, df_monitor_free)
+
+/**
+ * @function Checks the last state reported by the monitor thread; the
+ * state may lag behind by up to DF_MONITOR_INTERVAL_MSEC when the process
+ * is dumping a core.
+ * @return 1 if the process is alive, 0 if it exited (or is dumping a core),
+ * -1 on error (errno is set)
+ */
+int df_monitor_is_alive(df_monitor_t *monitor);
+
+/**
+ * @function Same as df_monitor_is_alive(), but checks the process
+ * synchronously, i.e. the result is up-to-date.
+ */
+int df_monitor_check(df_monitor_t *monitor);
+
+/**
+ * @function Checks if the process pid is still alive by reading its
+ * /proc/<pid>/status file.
+ * @return 1 if the process is alive, 0 if it exited (or is dumping a core),
+ * -1 on error
+ */
+int df_check_if_exited(const int pid);
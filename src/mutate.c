@@ -0,0 +1,402 @@
+/** @file mutate.c */
+#include <float.h>
+#include <gio/gio.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mutate.h"
+#include "log.h"
+#include "rand.h"
+#include "util.h"
+
+/* Children of containers up to this size are kept on the stack; inputs from
+ * sized plans (see df_plan_new_sized()) may have much larger arrays */
+#define DF_MUTATE_STACK_CHILDREN (DF_MUTATE_MAX_ARRAY_SIZE + 1)
+
+static void df_mutate_unref_values(GVariant **values, gsize n)
+{
+        for (gsize i = 0; i < n; i++)
+                g_variant_unref(values[i]);
+}
+
+/* Build a container of the given type from children (all of them are
+ * non-floating references, which are consumed) */
+static GVariant *df_mutate_rebuild(const GVariantType *type, GVariant **children, gsize n)
+{
+        GVariant *container;
+
+        if (g_variant_type_is_array(type))
+                container = g_variant_new_array(g_variant_type_element(type), children, n);
+        else if (g_variant_type_is_variant(type))
+                container = g_variant_new_variant(children[0]);
+        else if (g_variant_type_is_dict_entry(type))
+                container = g_variant_new_dict_entry(children[0], children[1]);
+        else
+                container = g_variant_new_tuple(children, n);
+
+        df_mutate_unref_values(children, n);
+
+        return g_variant_ref_sink(container);
+}
+
+/* Mutate the array node by dropping, duplicating, inserting or swapping its
+ * elements; in arrays of dict entries the values of two entries are swapped
+ * instead, so the keys stay where they were */
+static GVariant *df_mutate_array(df_rand_t *rnd, GVariant *node, guint64 iteration)
+{
+        const GVariantType *element_type = g_variant_type_element(g_variant_get_type(node));
+        gsize n = g_variant_n_children(node), victim, target;
+        GVariant *stack[DF_MUTATE_STACK_CHILDREN], **children = stack, *tmp;
+        g_autoptr(GPtrArray) heap = NULL;
+        guint op;
+
+        if (n == 0)
+                op = DF_MUTATE_ARRAY_INSERT;
+        else if (n >= DF_MUTATE_MAX_ARRAY_SIZE)
+                op = DF_MUTATE_ARRAY_DROP;
+        else
+                op = df_rand_next(rnd) % (n >= 2 ? _DF_MUTATE_ARRAY_MAX : DF_MUTATE_ARRAY_SWAP);
+
+        victim = n > 0 ? df_rand_next(rnd) % n : 0;
+        /* Position of the new element, or the other one to swap */
+        if (op == DF_MUTATE_ARRAY_SWAP)
+                target = (victim + 1 + df_rand_next(rnd) % (n - 1)) % n;
+        else
+                target = df_rand_next(rnd) % (n + 1);
+
+        /* Room for an inserted element as well */
+        if (n + 1 > G_N_ELEMENTS(stack)) {
+                heap = g_ptr_array_sized_new(n + 1);
+                children = (GVariant **) heap->pdata;
+        }
+        for (gsize i = 0; i < n; i++)
+                children[i] = g_variant_get_child_value(node, i);
+
+        switch (op) {
+        case DF_MUTATE_ARRAY_DROP:
+                g_variant_unref(children[victim]);
+                memmove(children + victim, children + victim + 1, (n - victim - 1) * sizeof(*children));
+                n--;
+                break;
+        case DF_MUTATE_ARRAY_DUPLICATE:
+        case DF_MUTATE_ARRAY_INSERT:
+                if (op == DF_MUTATE_ARRAY_DUPLICATE)
+                        tmp = g_variant_ref(children[victim]);
+                else {
+                        g_autoptr(gchar) signature = g_variant_type_dup_string(element_type);
+
+                        tmp = df_generate_random_from_signature(rnd, signature, iteration);
+                        if (!tmp) {
+                                df_mutate_unref_values(children, n);
+                                return NULL;
+                        }
+                        g_variant_ref_sink(tmp);
+                }
+
+                memmove(children + target + 1, children + target, (n - target) * sizeof(*children));
+                children[target] = tmp;
+                n++;
+                break;
+        case DF_MUTATE_ARRAY_SWAP:
+                if (g_variant_type_is_dict_entry(element_type)) {
+                        g_autoptr(GVariant) key_a = g_variant_get_child_value(children[victim], 0);
+                        g_autoptr(GVariant) key_b = g_variant_get_child_value(children[target], 0);
+                        g_autoptr(GVariant) value_a = g_variant_get_child_value(children[victim], 1);
+                        g_autoptr(GVariant) value_b = g_variant_get_child_value(children[target], 1);
+
+                        g_variant_unref(children[victim]);
+                        g_variant_unref(children[target]);
+                        children[victim] = g_variant_ref_sink(g_variant_new_dict_entry(key_a, value_b));
+                        children[target] = g_variant_ref_sink(g_variant_new_dict_entry(key_b, value_a));
+                } else {
+                        tmp = children[victim];
+                        children[victim] = children[target];
+                        children[target] = tmp;
+                }
+                break;
+        default:
+                g_assert_not_reached();
+        }
+
+        return df_mutate_rebuild(g_variant_get_type(node), children, n);
+}
+
+/* Interesting bit patterns of a width bits wide integer: 0, 1, -1/MAX,
+ * MIN/MAX + 1, MAX/MAX - 1, MIN + 1 and -2/MAX - 1 (for signed/unsigned
+ * integers) */
+static guint64 df_mutate_boundary(df_rand_t *rnd, guint width)
+{
+        guint64 mask = width == 64 ? G_MAXUINT64 : (G_GUINT64_CONSTANT(1) << width) - 1;
+        guint64 sign = G_GUINT64_CONSTANT(1) << (width - 1);
+        const guint64 values[] = { 0, 1, mask, sign, sign - 1, sign + 1, mask - 1 };
+
+        return values[df_rand_next(rnd) % G_N_ELEMENTS(values)];
+}
+
+/* Mutate the lowest width bits of value */
+static guint64 df_mutate_bits(df_rand_t *rnd, guint64 value, guint width)
+{
+        guint64 mask = width == 64 ? G_MAXUINT64 : (G_GUINT64_CONSTANT(1) << width) - 1;
+        guint64 r = df_rand_next(rnd);
+
+        switch (r % 4) {
+        case 0:
+                value = df_mutate_boundary(rnd, width);
+                break;
+        case 1:
+                /* Flip a single bit */
+                value ^= G_GUINT64_CONSTANT(1) << ((r >> 2) % width);
+                break;
+        case 2:
+                value += ((r >> 2) % DF_MUTATE_MAX_DELTA) + 1;
+                break;
+        case 3:
+                value -= ((r >> 2) % DF_MUTATE_MAX_DELTA) + 1;
+                break;
+        }
+
+        return value & mask;
+}
+
+static gdouble df_mutate_double(df_rand_t *rnd, gdouble value)
+{
+        const gdouble values[] = {
+                0.0, -0.0, 1.0, -1.0, DBL_MIN, DBL_MAX, -DBL_MAX, DBL_EPSILON,
+                INFINITY, -INFINITY, NAN,
+        };
+        guint64 bits;
+
+        if (df_rand_next(rnd) % 2)
+                return values[df_rand_next(rnd) % G_N_ELEMENTS(values)];
+
+        /* Flip a bit of the representation */
+        memcpy(&bits, &value, sizeof(bits));
+        bits = df_mutate_bits(rnd, bits, 64);
+        memcpy(&value, &bits, sizeof(value));
+
+        return value;
+}
+
+/* Mutate a fixed-size basic value; NULL if the node is not one */
+static GVariant *df_mutate_number(df_rand_t *rnd, GVariant *node)
+{
+        GVariant *mutated;
+
+        switch (g_variant_classify(node)) {
+        case G_VARIANT_CLASS_BOOLEAN:
+                mutated = g_variant_new_boolean(!g_variant_get_boolean(node));
+                break;
+        case G_VARIANT_CLASS_BYTE:
+                mutated = g_variant_new_byte(df_mutate_bits(rnd, g_variant_get_byte(node), 8));
+                break;
+        case G_VARIANT_CLASS_INT16:
+                mutated = g_variant_new_int16(df_mutate_bits(rnd, (guint16) g_variant_get_int16(node), 16));
+                break;
+        case G_VARIANT_CLASS_UINT16:
+                mutated = g_variant_new_uint16(df_mutate_bits(rnd, g_variant_get_uint16(node), 16));
+                break;
+        case G_VARIANT_CLASS_INT32:
+                mutated = g_variant_new_int32(df_mutate_bits(rnd, (guint32) g_variant_get_int32(node), 32));
+                break;
+        case G_VARIANT_CLASS_HANDLE:
+                mutated = g_variant_new_handle(df_mutate_bits(rnd, (guint32) g_variant_get_handle(node), 32));
+                break;
+        case G_VARIANT_CLASS_UINT32:
+                mutated = g_variant_new_uint32(df_mutate_bits(rnd, g_variant_get_uint32(node), 32));
+                break;
+        case G_VARIANT_CLASS_INT64:
+                mutated = g_variant_new_int64(df_mutate_bits(rnd, g_variant_get_int64(node), 64));
+                break;
+        case G_VARIANT_CLASS_UINT64:
+                mutated = g_variant_new_uint64(df_mutate_bits(rnd, g_variant_get_uint64(node), 64));
+                break;
+        case G_VARIANT_CLASS_DOUBLE:
+                mutated = g_variant_new_double(df_mutate_double(rnd, g_variant_get_double(node)));
+                break;
+        default:
+                return NULL;
+        }
+
+        return g_variant_ref_sink(mutated);
+}
+
+/* Splice a dictionary token into the string, overwrite its tail by one,
+ * truncate it, or repeat it; cuts are made at character boundaries, so the
+ * result stays valid UTF-8 */
+static GVariant *df_mutate_string(df_rand_t *rnd, GVariant *node, guint64 iteration)
+{
+        g_autoptr(GString) mutated = NULL;
+        const char *str, *token;
+        gsize len, at;
+
+        str = g_variant_get_string(node, &len);
+        token = df_rand_token(rnd, iteration);
+        at = g_utf8_offset_to_pointer(str, df_rand_next(rnd) % (g_utf8_strlen(str, len) + 1)) - str;
+        mutated = g_string_new_len(str, len);
+
+        switch (df_rand_next(rnd) % 4) {
+        case 0:
+                g_string_insert(mutated, at, token);
+                break;
+        case 1:
+                g_string_truncate(mutated, at);
+                g_string_append(mutated, token);
+                break;
+        case 2:
+                g_string_truncate(mutated, at);
+                break;
+        case 3:
+                g_string_append_len(mutated, str, len);
+                break;
+        }
+
+        /* Stay within -b/--buffer-limit= */
+        if (mutated->len >= df_fuzz_get_buffer_length())
+                g_string_truncate(mutated, MIN(at, len));
+
+        /* Tokens from the external dictionary don't have to be valid UTF-8 */
+        if (!g_utf8_validate(mutated->str, mutated->len, NULL))
+                return NULL;
+
+        return g_variant_ref_sink(g_variant_new_string(mutated->str));
+}
+
+/* Wrap the variant into another one, or unwrap a nested one */
+static GVariant *df_mutate_variant(df_rand_t *rnd, GVariant *node)
+{
+        g_autoptr(GVariant) child = NULL, inner = NULL;
+        guint depth = 1;
+
+        child = g_variant_get_variant(node);
+        if (g_variant_is_of_type(child, G_VARIANT_TYPE_VARIANT) && df_rand_next(rnd) % 2)
+                return g_steal_pointer(&child);
+
+        for (inner = g_variant_ref(child); g_variant_is_of_type(inner, G_VARIANT_TYPE_VARIANT); depth++) {
+                GVariant *next = g_variant_get_variant(inner);
+
+                g_variant_unref(inner);
+                inner = next;
+        }
+        if (depth >= DF_MUTATE_MAX_VARIANT_DEPTH)
+                return NULL;
+
+        return g_variant_ref_sink(g_variant_new_variant(node));
+}
+
+/* Mutate the value with respect to its type: strings get dictionary tokens
+ * spliced in, numbers boundary values or flipped bits, arrays grow, shrink or
+ * get their elements swapped and variants are nested. Fall back to
+ * generating the value anew if there's no such mutation for the type, and
+ * once in a while anyway, to not stay too close to the original. */
+static GVariant *df_mutate_value(df_rand_t *rnd, GVariant *node, guint64 iteration)
+{
+        GVariant *mutated = NULL;
+
+        if (df_rand_next(rnd) % 4 != 0) {
+                switch (g_variant_classify(node)) {
+                case G_VARIANT_CLASS_STRING:
+                        mutated = df_mutate_string(rnd, node, iteration);
+                        break;
+                case G_VARIANT_CLASS_ARRAY:
+                        return df_mutate_array(rnd, node, iteration);
+                case G_VARIANT_CLASS_VARIANT:
+                        mutated = df_mutate_variant(rnd, node);
+                        break;
+                default:
+                        mutated = df_mutate_number(rnd, node);
+                        break;
+                }
+
+                if (mutated)
+                        return mutated;
+        }
+
+        mutated = df_generate_random_from_signature(rnd, g_variant_get_type_string(node), iteration);
+        if (!mutated)
+                return NULL;
+
+        return g_variant_ref_sink(mutated);
+}
+
+static GVariant *df_mutate_node(df_rand_t *rnd, GVariant *node, gint64 *left, guint64 iteration)
+{
+        GVariant *stack[DF_MUTATE_STACK_CHILDREN], **children = stack;
+        g_autoptr(GPtrArray) heap = NULL;
+        gboolean changed = FALSE;
+        gsize n;
+
+        /* Already mutated */
+        if (*left < 0)
+                return g_variant_ref(node);
+
+        if ((*left)-- == 0) {
+                *left = -1;
+
+                return df_mutate_value(rnd, node, iteration);
+        }
+
+        if (!g_variant_is_container(node))
+                return g_variant_ref(node);
+
+        n = g_variant_n_children(node);
+        if (n > G_N_ELEMENTS(stack)) {
+                heap = g_ptr_array_sized_new(n);
+                children = (GVariant **) heap->pdata;
+        }
+        for (gsize i = 0; i < n; i++) {
+                g_autoptr(GVariant) child = g_variant_get_child_value(node, i);
+
+                children[i] = df_mutate_node(rnd, child, left, iteration);
+                if (!children[i]) {
+                        df_mutate_unref_values(children, i);
+                        return NULL;
+                }
+
+                if (children[i] != child)
+                        changed = TRUE;
+        }
+
+        if (!changed) {
+                df_mutate_unref_values(children, n);
+                return g_variant_ref(node);
+        }
+
+        return df_mutate_rebuild(g_variant_get_type(node), children, n);
+}
+
+/* Count all values in the tree, including the containers */
+static gint64 df_mutate_count_nodes(GVariant *node)
+{
+        gint64 count = 1;
+
+        if (!g_variant_is_container(node))
+                return count;
+
+        for (gsize i = 0; i < g_variant_n_children(node); i++) {
+                g_autoptr(GVariant) child = g_variant_get_child_value(node, i);
+
+                count += df_mutate_count_nodes(child);
+        }
+
+        return count;
+}
+
+GVariant *df_mutate(df_rand_t *rnd, GVariant *input, guint64 iteration)
+{
+        gint64 left;
+
+        g_assert(rnd);
+        g_assert(input);
+
+        /* Don't mutate the top-level tuple itself, since it only holds the
+         * method arguments */
+        left = df_mutate_count_nodes(input);
+        if (left > 1 && g_variant_is_of_type(input, G_VARIANT_TYPE_TUPLE))
+                left = (df_rand_next(rnd) % (left - 1)) + 1;
+        else
+                left = df_rand_next(rnd) % left;
+
+        return df_mutate_node(rnd, input, &left, iteration);
+}
@@ -0,0 +1,37 @@
+/** @file mutate.h */
+#pragma once
+
+#include <gio/gio.h>
+
+#include "rand.h"
+
+/** Maximum number of elements an array can grow to by mutations */
+#define DF_MUTATE_MAX_ARRAY_SIZE 64
+/** Maximum difference of a mutated integer from the original one (unless
+  * it's replaced by a boundary value) */
+#define DF_MUTATE_MAX_DELTA 16
+/** Maximum number of variants nested into each other by mutations */
+#define DF_MUTATE_MAX_VARIANT_DEPTH 8
+
+/** Mutations of arrays; swapping needs at least two elements */
+typedef enum df_mutate_array_op {
+        DF_MUTATE_ARRAY_DROP,
+        DF_MUTATE_ARRAY_DUPLICATE,
+        DF_MUTATE_ARRAY_INSERT,
+        DF_MUTATE_ARRAY_SWAP,
+        _DF_MUTATE_ARRAY_MAX
+} df_mutate_array_op_t;
+
+/**
+ * @function Creates a mutated copy of input of the same type: a pseudo-randomly
+ * picked value in the tree is either mutated with respect to its type (tokens
+ * from the dictionary are spliced into strings, integers are set to boundary
+ * values, have bits flipped or are shifted slightly, arrays grow, shrink or
+ * get their elements or dict entry values swapped, and variants are nested or
+ * unwrapped), or generated anew. Unchanged subtrees are shared with input.
+ * @param rnd Pseudo-random number generator context
+ * @param input Value to mutate
+ * @param iteration Current iteration (used for generating new values)
+ * @return New (non-floating) reference on success, NULL on error
+ */
+GVariant *df_mutate(df_rand_t *rnd, GVariant *input, guint64 iteration);
@@ -0,0 +1,886 @@
+/** @file plan.c */
+#include <gio/gio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "plan.h"
+#include "log.h"
+#include "rand.h"
+#include "util.h"
+
+#define DF_ALIGN_TO(x, a) (((x) + (a) - 1) & ~((guint32) (a) - 1))
+
+void df_plan_free(df_plan_t *plan)
+{
+        if (!plan)
+                return;
+
+        for (guint32 i = 0; i < plan->n_ops; i++)
+                if (plan->ops[i].vtype)
+                        g_variant_type_free(plan->ops[i].vtype);
+
+        free(plan->ops);
+        free(plan->signature);
+        free(plan);
+}
+
+/* Compile a single complete type starting at sig and return pointer to the
+ * first character after it. The signature must be already validated. */
+static const char *df_plan_compile_op(df_plan_t *plan, const char *sig, guint16 nest_level)
+{
+        df_plan_op_t *op;
+        const char *p = sig + 1;
+
+        /* Each op consumes at least one character of the signature, so the
+         * array allocated in df_plan_new() is always large enough */
+        op = &plan->ops[plan->n_ops++];
+        op->type_code = *sig;
+        op->nest_level = nest_level;
+
+        switch (*sig) {
+        case 'b':
+                op->type = DF_PLAN_OP_BOOLEAN;
+                break;
+        case 'y':
+                op->type = DF_PLAN_OP_BYTE;
+                break;
+        case 'n':
+                op->type = DF_PLAN_OP_INT16;
+                break;
+        case 'q':
+                op->type = DF_PLAN_OP_UINT16;
+                break;
+        case 'i':
+                op->type = DF_PLAN_OP_INT32;
+                break;
+        case 'u':
+                op->type = DF_PLAN_OP_UINT32;
+                break;
+        case 'x':
+                op->type = DF_PLAN_OP_INT64;
+                break;
+        case 't':
+                op->type = DF_PLAN_OP_UINT64;
+                break;
+        case 'h':
+                op->type = DF_PLAN_OP_HANDLE;
+                break;
+        case 'd':
+                op->type = DF_PLAN_OP_DOUBLE;
+                break;
+        case 's':
+                op->type = DF_PLAN_OP_STRING;
+                break;
+        case 'o':
+                op->type = DF_PLAN_OP_OBJECT_PATH;
+                break;
+        case 'g':
+                op->type = DF_PLAN_OP_SIGNATURE;
+                break;
+        case 'v':
+                op->type = DF_PLAN_OP_VARIANT;
+                break;
+        case 'a':
+                op->type = DF_PLAN_OP_ARRAY;
+                op->n_children = 1;
+                p = df_plan_compile_op(plan, p, nest_level + 1);
+                break;
+        case '(':
+        case '{':
+                op->type = *sig == '(' ? DF_PLAN_OP_TUPLE : DF_PLAN_OP_DICT_ENTRY;
+                while (*p != ')' && *p != '}') {
+                        p = df_plan_compile_op(plan, p, nest_level + 1);
+                        op->n_children++;
+                }
+                /* Skip the closing bracket */
+                p++;
+                break;
+        default:
+                g_assert_not_reached();
+        }
+
+        op->end = plan->n_ops;
+
+        /* Serialization properties, see the GVariant serialization format:
+         * https://people.gnome.org/~desrt/gvariant-serialisation.pdf */
+        switch (op->type) {
+        case DF_PLAN_OP_BOOLEAN:
+        case DF_PLAN_OP_BYTE:
+                op->alignment = op->fixed_size = 1;
+                break;
+        case DF_PLAN_OP_INT16:
+        case DF_PLAN_OP_UINT16:
+                op->alignment = op->fixed_size = 2;
+                break;
+        case DF_PLAN_OP_INT32:
+        case DF_PLAN_OP_UINT32:
+        case DF_PLAN_OP_HANDLE:
+                op->alignment = op->fixed_size = 4;
+                break;
+        case DF_PLAN_OP_INT64:
+        case DF_PLAN_OP_UINT64:
+        case DF_PLAN_OP_DOUBLE:
+                op->alignment = op->fixed_size = 8;
+                break;
+        case DF_PLAN_OP_STRING:
+        case DF_PLAN_OP_OBJECT_PATH:
+        case DF_PLAN_OP_SIGNATURE:
+                op->alignment = 1;
+                break;
+        case DF_PLAN_OP_VARIANT:
+                op->alignment = 8;
+                break;
+        case DF_PLAN_OP_ARRAY:
+                op->alignment = op[1].alignment;
+                break;
+        case DF_PLAN_OP_TUPLE:
+        case DF_PLAN_OP_DICT_ENTRY: {
+                gboolean fixed = TRUE;
+                guint32 size = 0;
+
+                op->alignment = 1;
+                for (guint32 i = op - plan->ops + 1; i < op->end; i = plan->ops[i].end) {
+                        const df_plan_op_t *child = &plan->ops[i];
+
+                        op->alignment = MAX(op->alignment, child->alignment);
+                        if (child->fixed_size == 0)
+                                fixed = FALSE;
+                        size = DF_ALIGN_TO(size, child->alignment) + child->fixed_size;
+                }
+
+                /* Fixed-size tuples are padded to their alignment, the unit
+                 * tuple has a size of 1 */
+                if (fixed)
+                        op->fixed_size = MAX(DF_ALIGN_TO(size, op->alignment), 1U);
+                break;
+        }
+        default:
+                g_assert_not_reached();
+        }
+
+        if (op->type >= DF_PLAN_OP_ARRAY) {
+                g_autoptr(char) type_string = NULL;
+
+                type_string = strndup(sig, p - sig);
+                g_assert(type_string);
+                op->vtype = g_variant_type_new(type_string);
+        }
+
+        return p;
+}
+
+/* Alignment of the op's value in the D-Bus marshalling format */
+static guint8 df_plan_dbus_alignment(const df_plan_op_t *op)
+{
+        switch (op->type) {
+        case DF_PLAN_OP_BYTE:
+        case DF_PLAN_OP_SIGNATURE:
+        case DF_PLAN_OP_VARIANT:
+                return 1;
+        case DF_PLAN_OP_INT16:
+        case DF_PLAN_OP_UINT16:
+                return 2;
+        case DF_PLAN_OP_BOOLEAN:
+        case DF_PLAN_OP_INT32:
+        case DF_PLAN_OP_UINT32:
+        case DF_PLAN_OP_HANDLE:
+        case DF_PLAN_OP_STRING:
+        case DF_PLAN_OP_OBJECT_PATH:
+        case DF_PLAN_OP_ARRAY:
+                return 4;
+        default:
+                return 8;
+        }
+}
+
+/* Size of the op's value in the D-Bus marshalling format (padded to its
+ * alignment, as it would be in an array) if it's fixed, 0 otherwise */
+static guint32 df_plan_dbus_fixed_size(const df_plan_t *plan, guint32 idx)
+{
+        const df_plan_op_t *op = &plan->ops[idx];
+
+        switch (op->type) {
+        case DF_PLAN_OP_BOOLEAN:
+                /* Booleans are marshalled as 32-bit integers */
+                return 4;
+        case DF_PLAN_OP_STRING:
+        case DF_PLAN_OP_OBJECT_PATH:
+        case DF_PLAN_OP_SIGNATURE:
+        case DF_PLAN_OP_VARIANT:
+        case DF_PLAN_OP_ARRAY:
+                return 0;
+        case DF_PLAN_OP_TUPLE:
+        case DF_PLAN_OP_DICT_ENTRY: {
+                guint32 size = 0;
+
+                for (guint32 i = idx + 1; i < op->end; i = plan->ops[i].end) {
+                        guint32 child_size = df_plan_dbus_fixed_size(plan, i);
+
+                        if (child_size == 0)
+                                return 0;
+                        size = DF_ALIGN_TO(size, df_plan_dbus_alignment(&plan->ops[i])) + child_size;
+                }
+
+                /* Structs are 8-aligned; the unit tuple can't be marshalled
+                 * at all, so just don't let it take zero bytes */
+                return MAX(DF_ALIGN_TO(size, 8), 8U);
+        }
+        default:
+                return op->fixed_size;
+        }
+}
+
+/* Minimum size of the op's value in the D-Bus marshalling format, with the
+ * worst case padding, as far as the shares of a sized plan go */
+static guint32 df_plan_dbus_min_size(const df_plan_t *plan, guint32 idx)
+{
+        const df_plan_op_t *op = &plan->ops[idx];
+        guint32 size;
+
+        switch (op->type) {
+        case DF_PLAN_OP_STRING:
+        case DF_PLAN_OP_OBJECT_PATH:
+                /* Padding, length, a single character and the NUL byte */
+                return 3 + 4 + 1 + 1;
+        case DF_PLAN_OP_SIGNATURE:
+                return 1 + 1 + 1;
+        case DF_PLAN_OP_VARIANT:
+                /* The shortest signature, e.g. "(t)", and its value */
+                return 3 + 2 + 7 + 8;
+        case DF_PLAN_OP_ARRAY:
+                return 3 + 4 + 7;
+        case DF_PLAN_OP_TUPLE:
+        case DF_PLAN_OP_DICT_ENTRY:
+                size = 7;
+                for (guint32 i = idx + 1; i < op->end; i = plan->ops[i].end)
+                        size += df_plan_dbus_min_size(plan, i) + df_plan_dbus_alignment(&plan->ops[i]) - 1;
+                return size;
+        default:
+                return df_plan_dbus_fixed_size(plan, idx);
+        }
+}
+
+static guint32 df_plan_isqrt(guint32 n)
+{
+        guint32 x = n, y = (x + 1) / 2;
+
+        /* Newton's method */
+        while (y < x) {
+                x = y;
+                y = (x + n / x) / 2;
+        }
+
+        return x;
+}
+
+/* Spread size bytes (in the D-Bus marshalling format, including the leading
+ * padding) over the op at idx and its subtree */
+static void df_plan_budget_op(df_plan_t *plan, guint32 idx, guint32 size)
+{
+        df_plan_op_t *op = &plan->ops[idx];
+
+        /* Every op of a sized plan gets at least a byte, so the shares can
+         * be told apart from no limit */
+        op->size_budget = MAX(size, 1U);
+
+        switch (op->type) {
+        case DF_PLAN_OP_ARRAY: {
+                guint32 element_size;
+
+                /* Padding in front of the length, the length itself and
+                 * padding in front of the first element */
+                size = size > 3 + 4 + 7 ? size - (3 + 4 + 7) : 0;
+                size = MIN(size, DF_PLAN_MAX_DBUS_ARRAY_SIZE);
+
+                element_size = df_plan_dbus_fixed_size(plan, idx + 1);
+                if (element_size > 0)
+                        op->max_elements = size / element_size;
+                else {
+                        /* Make the elements bigger as well as more numerous
+                         * as the budget grows, but not smaller than the
+                         * smallest value */
+                        op->max_elements = MIN(df_plan_isqrt(size), size / df_plan_dbus_min_size(plan, idx + 1));
+                        element_size = op->max_elements > 0 ? size / op->max_elements : 0;
+                }
+                op->max_elements = MIN(op->max_elements, DF_PLAN_MAX_ARRAY_ELEMENTS);
+
+                df_plan_budget_op(plan, idx + 1, element_size);
+                break;
+        }
+        case DF_PLAN_OP_TUPLE:
+        case DF_PLAN_OP_DICT_ENTRY: {
+                guint32 fixed = 0, n_variable = 0;
+
+                /* Leading padding */
+                size = size > 7 ? size - 7 : 0;
+
+                /* Fixed-size members take what they need (with the worst
+                 * case padding), the rest is split evenly */
+                for (guint32 i = idx + 1; i < op->end; i = plan->ops[i].end) {
+                        guint32 child_size = df_plan_dbus_fixed_size(plan, i);
+
+                        if (child_size > 0)
+                                fixed += child_size + df_plan_dbus_alignment(&plan->ops[i]) - 1;
+                        else
+                                n_variable++;
+                }
+                size = size > fixed ? size - fixed : 0;
+
+                for (guint32 i = idx + 1; i < op->end; i = plan->ops[i].end) {
+                        guint32 child_size = df_plan_dbus_fixed_size(plan, i);
+
+                        df_plan_budget_op(plan, i, child_size ?: size / n_variable);
+                }
+                break;
+        }
+        default:
+                break;
+        }
+}
+
+df_plan_t *df_plan_new_sized(const char *signature, guint32 size)
+{
+        g_autoptr(df_plan_t) plan = NULL;
+        const char *end;
+
+        if (!signature ||
+            !g_variant_is_signature(signature) ||
+            !g_variant_type_string_is_valid(signature)) {
+                df_fail("Invalid signature: %s\n", signature);
+                return NULL;
+        }
+
+        plan = calloc(1, sizeof(*plan));
+        if (!plan)
+                return NULL;
+
+        plan->signature = strdup(signature);
+        plan->ops = calloc(strlen(signature), sizeof(*plan->ops));
+        if (!plan->signature || !plan->ops)
+                return NULL;
+
+        end = df_plan_compile_op(plan, signature, 0);
+        g_assert(*end == 0);
+
+        if (size > 0) {
+                plan->size_budget = size;
+                df_plan_budget_op(plan, 0, size);
+        }
+
+        return g_steal_pointer(&plan);
+}
+
+df_plan_t *df_plan_new(const char *signature)
+{
+        return df_plan_new_sized(signature, 0);
+}
+
+/* Maximum length of a string or an object path with the given share of the
+ * budget: its length, padding in front of it and the trailing NUL byte come
+ * off it; 0 for no limit */
+static size_t df_plan_max_length(const df_plan_op_t *op)
+{
+        if (op->size_budget == 0)
+                return 0;
+
+        return op->size_budget > 3 + 4 + 1 ? op->size_budget - (3 + 4 + 1) : 1;
+}
+
+/* Same as df_plan_max_length(), but for signatures, which have a single byte
+ * length */
+static size_t df_plan_max_signature_length(const df_plan_op_t *op)
+{
+        if (op->size_budget == 0)
+                return 0;
+
+        return op->size_budget > 1 + 1 ? op->size_budget - (1 + 1) : 1;
+}
+
+/* Maximum length of the signature of a variant's value; fixed-size values
+ * take at most 8 bytes per character of their signature, so a ninth of the
+ * variant's share leaves enough room for them too */
+static size_t df_plan_max_variant_signature_length(const df_plan_op_t *op)
+{
+        if (op->size_budget == 0)
+                return 0;
+
+        return MAX(op->size_budget / 9, 3U);
+}
+
+/* Share of the budget left for the value of a variant with the given
+ * signature: the signature (with its length and NUL byte) and padding in
+ * front of the value come off it */
+static guint32 df_plan_variant_budget(const df_plan_op_t *op, const char *signature)
+{
+        guint32 overhead = strlen(signature) + 2 + 7;
+
+        return op->size_budget > overhead ? op->size_budget - overhead : 1;
+}
+
+/* Number of elements of the array op, drawn once in sized plans; G_MAXUINT32
+ * if the elements are generated until df_plan_array_continues() says so */
+static guint32 df_plan_array_size(const df_plan_t *plan, const df_plan_op_t *op, df_rand_t *rnd, guint64 iteration)
+{
+        if (plan->size_budget == 0)
+                return G_MAXUINT32;
+
+        return df_rand_array_size_max(rnd, iteration, op->max_elements);
+}
+
+/* Whether an array with elements of the given op and the size from
+ * df_plan_array_size() gets an n-th element; both backends must call this
+ * in the same order, since it might draw from rnd */
+static gboolean df_plan_array_continues(const df_plan_op_t *element, guint32 n, guint32 size,
+                                        df_rand_t *rnd, guint64 iteration)
+{
+        if (size != G_MAXUINT32)
+                return n < size;
+
+        /* Nested arrays (e.g. aaai) have a single element on each level,
+         * only the innermost array is pseudo-randomly sized */
+        if (element->type == DF_PLAN_OP_ARRAY)
+                return n < 1;
+
+        /* Note: the array size is re-drawn on each check, which gives
+         * shorter arrays a higher probability */
+        return n < df_rand_array_size(rnd, iteration);
+}
+
+static GVariant *df_plan_generate_leaf(const df_plan_op_t *op, df_rand_t *rnd, guint64 iteration)
+{
+        switch (op->type) {
+        case DF_PLAN_OP_BOOLEAN:
+                return g_variant_new_boolean(df_rand_gboolean(iteration));
+        case DF_PLAN_OP_BYTE:
+                return g_variant_new_byte(df_rand_guint8(rnd, iteration));
+        case DF_PLAN_OP_INT16:
+                return g_variant_new_int16(df_rand_gint16(rnd, iteration));
+        case DF_PLAN_OP_UINT16:
+                return g_variant_new_uint16(df_rand_guint16(rnd, iteration));
+        case DF_PLAN_OP_INT32:
+                return g_variant_new_int32(df_rand_gint32(rnd, iteration));
+        case DF_PLAN_OP_UINT32:
+                return g_variant_new_uint32(df_rand_guint32(rnd, iteration));
+        case DF_PLAN_OP_INT64:
+                return g_variant_new_int64(df_rand_gint64(rnd, iteration));
+        case DF_PLAN_OP_UINT64:
+                return g_variant_new_uint64(df_rand_guint64(rnd, iteration));
+        case DF_PLAN_OP_HANDLE:
+                return g_variant_new_handle(df_rand_unixFD(rnd, iteration));
+        case DF_PLAN_OP_DOUBLE:
+                return g_variant_new_double(df_rand_gdouble(rnd, iteration));
+        case DF_PLAN_OP_STRING: {
+                g_autoptr(GBytes) bytes = NULL;
+                const char *str;
+
+                if (df_rand_string_max(rnd, &str, iteration, df_plan_max_length(op)) < 0) {
+                        df_fail("Failed to generate a random string\n");
+                        return NULL;
+                }
+
+                /* Dictionary entries are already NUL-terminated in the mapped
+                 * file, so just reference them */
+                bytes = df_rand_dictionary_bytes(str);
+                if (bytes)
+                        return g_variant_new_from_bytes(G_VARIANT_TYPE_STRING, bytes, FALSE);
+
+                return g_variant_new_string(str);
+        }
+        case DF_PLAN_OP_OBJECT_PATH: {
+                const char *obj_path;
+
+                if (df_rand_dbus_objpath_string_max(rnd, &obj_path, iteration, df_plan_max_length(op)) < 0) {
+                        df_fail("Failed to generate a random object path\n");
+                        return NULL;
+                }
+
+                return g_variant_new_object_path(obj_path);
+        }
+        case DF_PLAN_OP_SIGNATURE: {
+                g_autoptr(char) sig_str = NULL;
+
+                if (df_rand_dbus_signature_string_max(rnd, &sig_str, iteration,
+                                                      df_plan_max_signature_length(op)) < 0) {
+                        df_fail("Failed to generate a random signature string\n");
+                        return NULL;
+                }
+
+                return g_variant_new_signature(sig_str);
+        }
+        case DF_PLAN_OP_VARIANT: {
+                g_autoptr(df_plan_t) child = NULL;
+                g_autoptr(gchar) signature = NULL;
+                GVariant *variant = NULL;
+
+                if (op->size_budget == 0) {
+                        if (df_rand_GVariant(rnd, &variant, iteration) < 0) {
+                                df_fail("Failed to generate a random GVariant\n");
+                                return NULL;
+                        }
+
+                        return g_variant_new_variant(variant);
+                }
+
+                /* Same draws as df_rand_GVariant(), but the value has to fit
+                 * into the rest of the variant's share */
+                if (df_rand_GVariant_signature_max(rnd, &signature, iteration,
+                                                   df_plan_max_variant_signature_length(op)) < 0) {
+                        df_fail("Failed to generate a random GVariant signature\n");
+                        return NULL;
+                }
+
+                child = df_plan_new_sized(signature, df_plan_variant_budget(op, signature));
+                if (!child)
+                        return NULL;
+
+                variant = df_plan_generate(child, rnd, iteration);
+                if (!variant)
+                        return NULL;
+
+                return g_variant_new_variant(variant);
+        }
+        default:
+                g_assert_not_reached();
+        }
+
+        return NULL;
+}
+
+static void df_plan_unref_values(GVariant **values, guint32 n)
+{
+        for (guint32 i = 0; i < n; i++)
+                g_variant_unref(values[i]);
+}
+
+/* Run the op at *idx (including its subtree) and move *idx past it */
+static GVariant *df_plan_run(const df_plan_t *plan, guint32 *idx, df_rand_t *rnd, guint64 iteration)
+{
+        const df_plan_op_t *op = &plan->ops[*idx];
+        guint32 n = 0;
+
+        (*idx)++;
+
+        switch (op->type) {
+        case DF_PLAN_OP_ARRAY: {
+                GVariant *stack[DF_RAND_MAX_ARRAY_SIZE], **elements = stack;
+                g_autoptr(GPtrArray) heap = NULL;
+                guint32 start = *idx, size;
+
+                size = df_plan_array_size(plan, op, rnd, iteration);
+                if (size != G_MAXUINT32 && size > G_N_ELEMENTS(stack)) {
+                        heap = g_ptr_array_sized_new(size);
+                        elements = (GVariant **) heap->pdata;
+                }
+
+                for (; df_plan_array_continues(&plan->ops[start], n, size, rnd, iteration); n++) {
+                        g_assert(heap || n < G_N_ELEMENTS(stack));
+
+                        *idx = start;
+                        elements[n] = df_plan_run(plan, idx, rnd, iteration);
+                        if (!elements[n]) {
+                                df_plan_unref_values(elements, n);
+                                return NULL;
+                        }
+                }
+
+                *idx = op->end;
+
+                return g_variant_new_array(g_variant_type_element(op->vtype), elements, n);
+        }
+        case DF_PLAN_OP_TUPLE:
+        case DF_PLAN_OP_DICT_ENTRY: {
+                GVariant **children = g_newa(GVariant *, MAX(op->n_children, 1));
+
+                for (; n < op->n_children; n++) {
+                        children[n] = df_plan_run(plan, idx, rnd, iteration);
+                        if (!children[n]) {
+                                df_plan_unref_values(children, n);
+                                return NULL;
+                        }
+                }
+
+                if (op->type == DF_PLAN_OP_DICT_ENTRY)
+                        return g_variant_new_dict_entry(children[0], children[1]);
+
+                return g_variant_new_tuple(children, n);
+        }
+        default:
+                return df_plan_generate_leaf(op, rnd, iteration);
+        }
+}
+
+GVariant *df_plan_generate(const df_plan_t *plan, df_rand_t *rnd, guint64 iteration)
+{
+        guint32 idx = 0;
+
+        g_assert(plan);
+        g_assert(rnd);
+
+        return df_plan_run(plan, &idx, rnd, iteration);
+}
+
+static void df_wire_align(GByteArray *buffer, guint8 alignment)
+{
+        static const guint8 zeros[8];
+
+        g_byte_array_append(buffer, zeros, DF_ALIGN_TO(buffer->len, alignment) - buffer->len);
+}
+
+/* Size of a single framing offset in a container with body_size bytes of
+ * data followed by n_offsets offsets */
+static guint8 df_wire_offset_size(gsize body_size, gsize n_offsets)
+{
+        if (body_size + n_offsets <= G_MAXUINT8)
+                return 1;
+        if (body_size + 2 * n_offsets <= G_MAXUINT16)
+                return 2;
+        if (body_size + 4 * n_offsets <= G_MAXUINT32)
+                return 4;
+
+        return 8;
+}
+
+static void df_wire_write_offset(GByteArray *buffer, gsize offset, guint8 size)
+{
+        guint64 le = GUINT64_TO_LE((guint64) offset);
+
+        /* Framing offsets are always little-endian */
+        g_byte_array_append(buffer, (const guint8 *) &le, size);
+}
+
+#define df_wire_append(buffer, value) \
+        g_byte_array_append((buffer), (const guint8 *) &(value), sizeof(value))
+
+static int df_plan_write(const df_plan_t *plan, guint32 *idx, df_rand_t *rnd, guint64 iteration, GByteArray *buffer);
+
+static int df_plan_write_leaf(const df_plan_op_t *op, df_rand_t *rnd, guint64 iteration, GByteArray *buffer)
+{
+        switch (op->type) {
+        case DF_PLAN_OP_BOOLEAN: {
+                guint8 v = !!df_rand_gboolean(iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_BYTE: {
+                guint8 v = df_rand_guint8(rnd, iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_INT16: {
+                gint16 v = df_rand_gint16(rnd, iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_UINT16: {
+                guint16 v = df_rand_guint16(rnd, iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_INT32: {
+                gint32 v = df_rand_gint32(rnd, iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_UINT32: {
+                guint32 v = df_rand_guint32(rnd, iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_INT64: {
+                gint64 v = df_rand_gint64(rnd, iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_UINT64: {
+                guint64 v = df_rand_guint64(rnd, iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_HANDLE: {
+                gint32 v = df_rand_unixFD(rnd, iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_DOUBLE: {
+                gdouble v = df_rand_gdouble(rnd, iteration);
+                df_wire_append(buffer, v);
+                break;
+        }
+        case DF_PLAN_OP_STRING:
+        case DF_PLAN_OP_OBJECT_PATH:
+        case DF_PLAN_OP_SIGNATURE: {
+                g_autoptr(char) signature = NULL;
+                const char *str;
+                int r;
+
+                if (op->type == DF_PLAN_OP_STRING)
+                        r = df_rand_string_max(rnd, &str, iteration, df_plan_max_length(op));
+                else if (op->type == DF_PLAN_OP_OBJECT_PATH)
+                        r = df_rand_dbus_objpath_string_max(rnd, &str, iteration, df_plan_max_length(op));
+                else {
+                        r = df_rand_dbus_signature_string_max(rnd, &signature, iteration,
+                                                              df_plan_max_signature_length(op));
+                        str = signature;
+                }
+                if (r < 0)
+                        return df_fail_ret(-1, "Failed to generate a random '%c' value\n", op->type_code);
+
+                /* Strings are serialized including the trailing NUL byte */
+                g_byte_array_append(buffer, (const guint8 *) str, strlen(str) + 1);
+                break;
+        }
+        case DF_PLAN_OP_VARIANT: {
+                g_autoptr(df_plan_t) child = NULL;
+                g_autoptr(gchar) signature = NULL;
+                guint32 child_idx = 0;
+
+                /* Same draws as df_rand_GVariant(): the signature first, then
+                 * the value itself */
+                if (df_rand_GVariant_signature_max(rnd, &signature, iteration,
+                                                   df_plan_max_variant_signature_length(op)) < 0)
+                        return df_fail_ret(-1, "Failed to generate a random GVariant signature\n");
+
+                if (op->size_budget > 0)
+                        child = df_plan_new_sized(signature, df_plan_variant_budget(op, signature));
+                else
+                        child = df_plan_new(signature);
+                if (!child)
+                        return -1;
+
+                /* The variant itself is 8-aligned, so the child value is
+                 * aligned as well */
+                if (df_plan_write(child, &child_idx, rnd, iteration, buffer) < 0)
+                        return -1;
+
+                /* Child value, NUL byte, type string */
+                g_byte_array_append(buffer, (const guint8 *) "", 1);
+                g_byte_array_append(buffer, (const guint8 *) signature, strlen(signature));
+                break;
+        }
+        default:
+                g_assert_not_reached();
+        }
+
+        return 0;
+}
+
+/* Serialize the op at *idx (including its subtree) into buffer and move *idx
+ * past it; mirrors df_plan_run(), including the order of the random draws */
+static int df_plan_write(const df_plan_t *plan, guint32 *idx, df_rand_t *rnd, guint64 iteration, GByteArray *buffer)
+{
+        const df_plan_op_t *op = &plan->ops[*idx];
+        g_autoptr(GArray) heap_offsets = NULL;
+        gsize start, *offsets;
+        guint32 n = 0, n_offsets = 0;
+        guint8 offset_size;
+
+        (*idx)++;
+
+        if (op->type < DF_PLAN_OP_ARRAY)
+                return df_plan_write_leaf(op, rnd, iteration, buffer);
+
+        df_wire_align(buffer, op->alignment);
+        start = buffer->len;
+
+        switch (op->type) {
+        case DF_PLAN_OP_ARRAY: {
+                const df_plan_op_t *element = &plan->ops[*idx];
+                guint32 element_idx = *idx, size;
+                gsize element_offsets[DF_RAND_MAX_ARRAY_SIZE];
+
+                offsets = element_offsets;
+                size = df_plan_array_size(plan, op, rnd, iteration);
+                if (size != G_MAXUINT32 && size > G_N_ELEMENTS(element_offsets)) {
+                        heap_offsets = g_array_sized_new(FALSE, FALSE, sizeof(gsize), size);
+                        offsets = (gsize *) heap_offsets->data;
+                }
+
+                for (; df_plan_array_continues(element, n, size, rnd, iteration); n++) {
+                        g_assert(heap_offsets || n < G_N_ELEMENTS(element_offsets));
+
+                        *idx = element_idx;
+                        df_wire_align(buffer, element->alignment);
+                        if (df_plan_write(plan, idx, rnd, iteration, buffer) < 0)
+                                return -1;
+
+                        /* Arrays of fixed-size elements have no framing offsets */
+                        if (element->fixed_size == 0)
+                                offsets[n_offsets++] = buffer->len - start;
+                }
+
+                *idx = op->end;
+                break;
+        }
+        case DF_PLAN_OP_TUPLE:
+        case DF_PLAN_OP_DICT_ENTRY:
+                offsets = g_newa(gsize, MAX(op->n_children, 1));
+
+                for (; n < op->n_children; n++) {
+                        const df_plan_op_t *member = &plan->ops[*idx];
+
+                        df_wire_align(buffer, member->alignment);
+                        if (df_plan_write(plan, idx, rnd, iteration, buffer) < 0)
+                                return -1;
+
+                        /* Only non-last variable-sized members are framed */
+                        if (member->fixed_size == 0 && n + 1 < op->n_children)
+                                offsets[n_offsets++] = buffer->len - start;
+                }
+
+                if (op->fixed_size > 0) {
+                        static const guint8 zeros[8];
+
+                        /* Fixed-size tuples are padded to their size (the unit
+                         * tuple is a single zero byte) */
+                        g_assert(buffer->len - start <= op->fixed_size);
+                        g_byte_array_append(buffer, zeros, op->fixed_size - (buffer->len - start));
+                        return 0;
+                }
+
+                /* Tuple offsets are stored in reverse order */
+                for (guint32 i = 0; i < n_offsets / 2; i++) {
+                        gsize tmp = offsets[i];
+
+                        offsets[i] = offsets[n_offsets - i - 1];
+                        offsets[n_offsets - i - 1] = tmp;
+                }
+                break;
+        default:
+                g_assert_not_reached();
+        }
+
+        offset_size = df_wire_offset_size(buffer->len - start, n_offsets);
+        for (guint32 i = 0; i < n_offsets; i++)
+                df_wire_write_offset(buffer, offsets[i], offset_size);
+
+        return 0;
+}
+
+GVariant *df_plan_serialize(const df_plan_t *plan, df_rand_t *rnd, guint64 iteration, GByteArray *buffer)
+{
+        g_autoptr(GBytes) bytes = NULL;
+        guint32 idx = 0;
+
+        g_assert(plan);
+        g_assert(rnd);
+        g_assert(buffer);
+
+        g_byte_array_set_size(buffer, 0);
+        if (df_plan_write(plan, &idx, rnd, iteration, buffer) < 0)
+                return NULL;
+
+        bytes = g_bytes_new(buffer->data, buffer->len);
+
+        return g_variant_new_from_bytes(G_VARIANT_TYPE(plan->signature), bytes, FALSE);
+}
+
+df_plan_backend_t df_plan_backend_from_string(const char *s)
+{
+        if (strcmp(s, "variant") == 0)
+                return DF_PLAN_BACKEND_VARIANT;
+        if (strcmp(s, "wire") == 0)
+                return DF_PLAN_BACKEND_WIRE;
+
+        return _DF_PLAN_BACKEND_MAX;
+}
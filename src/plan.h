@@ -0,0 +1,143 @@
+/** @file plan.h */
+#pragma once
+
+#include <gio/gio.h>
+
+#include "rand.h"
+
+/** Maximum number of elements of a single array in a sized plan, so even the
+  * smallest elements don't take too long to generate */
+#define DF_PLAN_MAX_ARRAY_ELEMENTS (1U << 20)
+/** Maximum size of an array in the D-Bus marshalling format (64 MiB) */
+#define DF_PLAN_MAX_DBUS_ARRAY_SIZE (1U << 26)
+
+/* Type of a generator op; leaf ops map 1:1 to the D-Bus basic types (plus
+ * variant, which is generated as a whole) */
+typedef enum df_plan_op_type {
+        DF_PLAN_OP_BOOLEAN,
+        DF_PLAN_OP_BYTE,
+        DF_PLAN_OP_INT16,
+        DF_PLAN_OP_UINT16,
+        DF_PLAN_OP_INT32,
+        DF_PLAN_OP_UINT32,
+        DF_PLAN_OP_INT64,
+        DF_PLAN_OP_UINT64,
+        DF_PLAN_OP_HANDLE,
+        DF_PLAN_OP_DOUBLE,
+        DF_PLAN_OP_STRING,
+        DF_PLAN_OP_OBJECT_PATH,
+        DF_PLAN_OP_SIGNATURE,
+        DF_PLAN_OP_VARIANT,
+        /* Containers */
+        DF_PLAN_OP_ARRAY,
+        DF_PLAN_OP_TUPLE,
+        DF_PLAN_OP_DICT_ENTRY,
+        _DF_PLAN_OP_MAX
+} df_plan_op_type_t;
+
+/** A single generator op; a container op is followed by the ops of its
+  * children (in pre-order) */
+typedef struct df_plan_op {
+        df_plan_op_type_t type;
+        /** D-Bus type code, e.g. 's', 'a' or '(' */
+        char type_code;
+        /** Container nesting level of the op */
+        guint16 nest_level;
+        /** Number of direct children: 0 for leafs, 1 for arrays */
+        guint32 n_children;
+        /** Index of the first op following this op's subtree */
+        guint32 end;
+        /** Alignment of the serialized value (1, 2, 4 or 8) */
+        guint8 alignment;
+        /** Size of the serialized value if it's fixed, 0 otherwise */
+        guint32 fixed_size;
+        /** Type of the whole container, NULL for leafs */
+        GVariantType *vtype;
+        /** Share of the plan's size budget for a single value of this op
+          * (in the D-Bus marshalling format), 0 if the plan has none */
+        guint32 size_budget;
+        /** Maximum number of elements of an array op in a sized plan */
+        guint32 max_elements;
+} df_plan_op_t;
+
+/** Signature compiled into a flat array of generator ops */
+typedef struct df_plan {
+        char *signature;
+        df_plan_op_t *ops;
+        guint32 n_ops;
+        /** Target size of the generated values, 0 for no limit, see
+          * df_plan_new_sized() */
+        guint32 size_budget;
+} df_plan_t;
+
+/**
+ * @function Compiles a D-Bus signature (a single complete type) into
+ * a generator plan, so the signature doesn't need to be parsed again on
+ * every iteration.
+ * @param signature D-Bus signature
+ * @return New plan on success (free it with df_plan_free()), NULL on error
+ */
+df_plan_t *df_plan_new(const char *signature);
+/**
+ * @function Same as df_plan_new(), but also spreads a size budget over the
+ * container tree, once for all the generated values: arrays get up to as many
+ * elements as fit into their share (drawn once, uniformly), which is then
+ * split between the elements, and the strings, object paths and variants
+ * inside them are cut to their own share. Values generated by a sized plan
+ * don't take more than size bytes in the D-Bus marshalling format (unless
+ * a share is too small even for the shortest value, e.g. an empty string),
+ * but they aren't the same as the ones from
+ * df_generate_random_from_signature() anymore; both backends still generate
+ * the same values.
+ * @param signature D-Bus signature
+ * @param size Size budget in bytes, 0 for no limit (i.e. df_plan_new())
+ * @return New plan on success (free it with df_plan_free()), NULL on error
+ */
+df_plan_t *df_plan_new_sized(const char *signature, guint32 size);
+void df_plan_free(df_plan_t *plan);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_plan_t, df_plan_free)
+
+/**
+ * @function Generates a pseudo-random (floating) GVariant according to the
+ * plan; for the same generator state and iteration the result is the same as
+ * the one from df_generate_random_from_signature().
+ * @param plan Compiled plan
+ * @param rnd Pseudo-random number generator context
+ * @param iteration Current iteration
+ * @return Floating GVariant reference on success, NULL on error
+ */
+GVariant *df_plan_generate(const df_plan_t *plan, df_rand_t *rnd, guint64 iteration);
+
+/**
+ * @function Same as df_plan_generate(), but instead of building the value
+ * from individual GVariant instances write its serialized form into buffer
+ * and wrap a copy of it via g_variant_new_from_bytes(), i.e. do just one
+ * allocation per value. For the same generator state and iteration the
+ * result is equal to the one from df_plan_generate().
+ * @param plan Compiled plan
+ * @param rnd Pseudo-random number generator context
+ * @param iteration Current iteration
+ * @param buffer Scratch buffer, which can be reused between calls
+ * @return Floating GVariant reference on success, NULL on error
+ */
+GVariant *df_plan_serialize(const df_plan_t *plan, df_rand_t *rnd, guint64 iteration, GByteArray *buffer);
+
+/**
+ * @function Generates a value using the given backend
+ * @param buffer Scratch buffer for DF_PLAN_BACKEND_WIRE
+ */
+static inline GVariant *df_plan_generate_with(const df_plan_t *plan, df_plan_backend_t backend,
+                                              df_rand_t *rnd, guint64 iteration, GByteArray *buffer)
+{
+        if (backend == DF_PLAN_BACKEND_WIRE)
+                return df_plan_serialize(plan, rnd, iteration, buffer);
+
+        return df_plan_generate(plan, rnd, iteration);
+}
+
+/**
+ * @function Parses backend name ("variant" or "wire")
+ * @return Backend on success, _DF_PLAN_BACKEND_MAX for an unknown name
+ */
+df_plan_backend_t df_plan_backend_from_string(const char *s);
@@ -0,0 +1,169 @@
+/** @file producer.c */
+#include <gio/gio.h>
+#include <stdlib.h>
+
+#include "producer.h"
+#include "arena.h"
+#include "log.h"
+#include "plan.h"
+#include "rand.h"
+#include "util.h"
+
+static inline df_producer_slot_t *df_producer_slot(df_producer_t *p, guint64 iteration)
+{
+        return &p->slots[(iteration - p->start) % p->n_slots];
+}
+
+/* Wait until the sequence number of the slot reaches seq; returns FALSE if
+ * the producer is being stopped meanwhile */
+static gboolean df_producer_wait(df_producer_t *p, df_producer_slot_t *slot, guint64 seq)
+{
+        for (guint n = 0; __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq; n++) {
+                if (__atomic_load_n(&p->stop, __ATOMIC_RELAXED))
+                        return FALSE;
+
+                if (n < DF_PRODUCER_SPINS)
+                        g_thread_yield();
+                else
+                        g_usleep(DF_PRODUCER_BACKOFF_USEC);
+        }
+
+        return TRUE;
+}
+
+static gpointer df_producer_run(gpointer userdata)
+{
+        df_producer_thread_t *t = userdata;
+        df_producer_t *p = t->producer;
+        df_rand_t rnd = { .arena = t->arena };
+
+        for (;;) {
+                df_producer_slot_t *slot;
+                GVariant *value;
+                guint64 i;
+
+                /* Claim the next iteration; the threads may finish them in any
+                 * order, since each one has its own slot */
+                i = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED);
+                if (i >= p->end)
+                        break;
+
+                slot = df_producer_slot(p, i);
+                if (!df_producer_wait(p, slot, 2 * i))
+                        break;
+
+                /* The same as without the producer, see df_fuzz_test_method() */
+                df_rand_init(&rnd, p->seed + i);
+                value = df_plan_generate_with(p->plan, p->backend, &rnd, i, t->buffer);
+                slot->value = value ? g_variant_ref_sink(value) : NULL;
+                slot->seed = p->seed;
+                slot->iteration = i;
+                slot->arena_used = df_arena_get_used(t->arena);
+                /* The input holds its own copy of the data */
+                df_arena_reset(t->arena);
+
+                __atomic_store_n(&slot->seq, 2 * i + 1, __ATOMIC_RELEASE);
+        }
+
+        return NULL;
+}
+
+df_producer_t *df_producer_new(const df_plan_t *plan, df_plan_backend_t backend, guint64 seed,
+                               guint64 start, guint64 end, guint n_threads)
+{
+        g_autoptr(df_producer_t) p = NULL;
+
+        g_assert(plan);
+        g_assert(start <= end);
+        g_assert(n_threads > 0 && n_threads <= DF_PRODUCER_MAX_THREADS);
+
+        p = calloc(1, sizeof(*p) + n_threads * sizeof(df_producer_thread_t));
+        if (!p) {
+                df_oom();
+                return NULL;
+        }
+
+        p->plan = plan;
+        p->backend = backend;
+        p->seed = seed;
+        p->start = p->next = start;
+        p->end = end;
+        p->n_threads = n_threads;
+        p->n_slots = n_threads * DF_PRODUCER_SLOTS_PER_THREAD;
+        p->slots = calloc(p->n_slots, sizeof(*p->slots));
+        if (!p->slots) {
+                df_oom();
+                return NULL;
+        }
+
+        /* Slot k is free for iteration start + k first */
+        for (guint k = 0; k < p->n_slots; k++)
+                p->slots[k].seq = 2 * (start + k);
+
+        /* Allocate all the scratch memory first, so a thread never fails */
+        for (guint k = 0; k < n_threads; k++) {
+                p->threads[k].producer = p;
+                p->threads[k].buffer = g_byte_array_new();
+                p->threads[k].arena = df_arena_new();
+                if (!p->threads[k].arena) {
+                        df_oom();
+                        return NULL;
+                }
+        }
+
+        for (guint k = 0; k < n_threads; k++)
+                p->threads[k].thread = g_thread_new("dfuzzer-producer", df_producer_run, &p->threads[k]);
+
+        return g_steal_pointer(&p);
+}
+
+void df_producer_free(df_producer_t *p)
+{
+        if (!p)
+                return;
+
+        __atomic_store_n(&p->stop, TRUE, __ATOMIC_RELAXED);
+        for (guint k = 0; k < p->n_threads; k++)
+                if (p->threads[k].thread)
+                        g_thread_join(p->threads[k].thread);
+
+        /* Drop the inputs which weren't taken */
+        for (guint k = 0; p->slots && k < p->n_slots; k++)
+                if (p->slots[k].seq % 2 == 1 && p->slots[k].value)
+                        g_variant_unref(p->slots[k].value);
+
+        for (guint k = 0; k < p->n_threads; k++) {
+                if (p->threads[k].buffer)
+                        g_byte_array_unref(p->threads[k].buffer);
+                df_arena_free(p->threads[k].arena);
+        }
+
+        free(p->slots);
+        free(p);
+}
+
+GVariant *df_producer_take(df_producer_t *p, guint64 iteration, gsize *ret_arena_used)
+{
+        df_producer_slot_t *slot;
+        GVariant *value;
+
+        g_assert(p);
+        g_assert(iteration >= p->start && iteration < p->end);
+
+        slot = df_producer_slot(p, iteration);
+        /* The consumer is never stopped, it always gets its input */
+        (void) df_producer_wait(p, slot, 2 * iteration + 1);
+
+        /* The tags can't differ unless the iterations were taken out of order */
+        g_assert(slot->seed == p->seed);
+        g_assert(slot->iteration == iteration);
+
+        value = g_steal_pointer(&slot->value);
+        if (ret_arena_used)
+                *ret_arena_used = slot->arena_used;
+
+        /* Free the slot for the iteration one round later */
+        __atomic_store_n(&slot->seq, 2 * (iteration + p->n_slots), __ATOMIC_RELEASE);
+
+        return value;
+}
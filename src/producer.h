@@ -0,0 +1,100 @@
+/** @file producer.h */
+#pragma once
+
+#include <gio/gio.h>
+
+#include "arena.h"
+#include "fuzz.h"
+#include "plan.h"
+
+/** Maximum number of generator threads of a single producer */
+#define DF_PRODUCER_MAX_THREADS 64
+/** Number of slots of the ring for each generator thread */
+#define DF_PRODUCER_SLOTS_PER_THREAD 4
+/** A waiting thread yields this many times before it starts sleeping */
+#define DF_PRODUCER_SPINS 64
+/** How long a waiting thread sleeps between the checks of its slot */
+#define DF_PRODUCER_BACKOFF_USEC 50
+
+/** A slot of the ring, holding the input of a single iteration
+  *
+  * Each slot goes around the ring in rounds: its sequence number is
+  * 2 * iteration while it's free for the producer of the iteration and
+  * 2 * iteration + 1 once the input is ready for the consumer, who then
+  * frees it for the iteration n_slots further. The sequence number is the
+  * only field accessed by both sides at once; it's stored with release and
+  * loaded with acquire semantics, so the rest of the slot is handed over
+  * along with it. */
+typedef struct df_producer_slot {
+        guint64 seq;
+        /** Seed and iteration the input was generated from */
+        guint64 seed;
+        guint64 iteration;
+        /** Generated input (a full reference), NULL if the generation failed */
+        GVariant *value;
+        /** Arena memory used to generate the input */
+        gsize arena_used;
+} df_producer_slot_t;
+
+typedef struct df_producer df_producer_t;
+
+/** A generator thread with its own scratch memory */
+typedef struct df_producer_thread {
+        df_producer_t *producer;
+        GThread *thread;
+        df_arena_t *arena;
+        GByteArray *buffer;
+} df_producer_thread_t;
+
+/** Generates the inputs of consecutive iterations ahead on its own threads,
+  * into a bounded lock-free ring, for a single consumer which takes them in
+  * order. Each input depends only on the seed and its iteration (same as
+  * when it's generated inline), so the inputs are the same regardless of the
+  * number of threads and their timing. */
+struct df_producer {
+        const df_plan_t *plan;
+        df_plan_backend_t backend;
+        /** The input of iteration i is seeded by seed + i */
+        guint64 seed;
+        /** Iterations to generate: <start, end) */
+        guint64 start;
+        guint64 end;
+        /** Next iteration to be claimed by a generator thread */
+        guint64 next;
+        gint stop;
+        guint n_slots;
+        df_producer_slot_t *slots;
+        guint n_threads;
+        df_producer_thread_t threads[];
+};
+
+/**
+ * @function Starts generating inputs on n_threads threads
+ * @param plan Compiled plan, must outlive the producer
+ * @param backend Backend used to generate the inputs
+ * @param seed Seed of the member, see df_fuzz_member_seed()
+ * @param start First iteration
+ * @param end Iteration after the last one
+ * @param n_threads Number of generator threads, at most DF_PRODUCER_MAX_THREADS
+ * @return New producer on success (free it with df_producer_free()), NULL on
+ * error
+ */
+df_producer_t *df_producer_new(const df_plan_t *plan, df_plan_backend_t backend, guint64 seed,
+                               guint64 start, guint64 end, guint n_threads);
+/**
+ * @function Stops the generator threads and drops the inputs which weren't
+ * taken
+ */
+void df_producer_free(df_producer_t *p);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_producer_t, df_producer_free)
+
+/**
+ * @function Waits for the input of the iteration and takes it out of the ring;
+ * the iterations must be taken one after another, starting at the first one
+ * @param iteration Iteration of the input
+ * @param ret_arena_used If not NULL, the arena memory used to generate the
+ * input is stored here
+ * @return Input (a full reference) on success, NULL if its generation failed
+ */
+GVariant *df_producer_take(df_producer_t *p, guint64 iteration, gsize *ret_arena_used);
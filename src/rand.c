@@ -28,248 +28,99 @@
 #include <time.h>
 
 #include "rand.h"
+#include "dictionary.h"
 #include "log.h"
+#include "plan.h"
 #include "util.h"
 
-static struct external_dictionary df_external_dictionary;
+static df_dictionary_t *df_external_dictionary;
+
+static inline guint64 df_rand_splitmix64(guint64 *x)
+{
+        guint64 z = (*x += 0x9e3779b97f4a7c15ULL);
+
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+        return z ^ (z >> 31);
+}
 
 /**
- * @function Initializes global flag variables and seeds pseudo-random
- * numbers generators.
- * @param buf_size Maximum buffer size for generated strings (in Bytes)
+ * @function Seeds the pseudo-random numbers generator context. The state is
+ * expanded from the seed using splitmix64, as recommended by the xoshiro
+ * authors, so even similar seeds (e.g. consecutive iterations) give
+ * uncorrelated streams.
+ * @param rnd Generator context
+ * @param seed Seed for the generator
  */
-void df_rand_init(unsigned int seed)
+void df_rand_init(df_rand_t *rnd, guint64 seed)
 {
-        srand(seed);
-        srandom(seed);
+        g_assert(rnd);
+
+        for (size_t i = 0; i < G_N_ELEMENTS(rnd->s); i++)
+                rnd->s[i] = df_rand_splitmix64(&seed);
 }
 
 int df_rand_load_external_dictionary(const char *filename)
 {
-        g_autoptr(FILE) f = NULL;
-        g_autoptr(char) line = NULL;
-        char **array = NULL;
-        size_t allocated = 0, len = 0, i = 0;
-        ssize_t n;
-
-        g_assert(filename);
-
-        f = fopen(filename, "r");
-        if (!f)
-                return df_fail_ret(-errno, "Failed to open file '%s': %m\n", filename);
-
-        while ((n = getline(&line, &len, f)) > 0) {
-                /* Extend the array if we're out of space */
-                if (i >= allocated) {
-                        allocated += 10;
-                        array = realloc(array, sizeof(*array) * allocated);
-                        if (!array)
-                                return df_oom();
-                }
+        df_dictionary_t *d;
 
-                /* Drop the newline */
-                if (line[n - 1] == '\n')
-                        line[n - 1] = 0;
-
-                array[i++] = g_steal_pointer(&line);
-        }
+        d = df_dictionary_new(filename);
+        if (!d)
+                return -1;
 
-        df_external_dictionary.strings = g_steal_pointer(&array);
-        df_external_dictionary.size = i;
+        df_dictionary_free(df_external_dictionary);
+        df_external_dictionary = d;
 
         return 0;
 }
 
-/* Generate a GVariant with random data for a basic (non-compound) type
- *
- * Note: variant itself is treated as a basic type, since it's a bit special and
- *       cannot be iterated on
- */
-GVariant *df_generate_random_basic(const GVariantType *type, guint64 iteration)
+GBytes *df_rand_dictionary_bytes(const char *str)
 {
-        g_autoptr(char) ssig = NULL;
-
-        if (!type) {
-                g_assert_not_reached();
+        if (!df_external_dictionary)
                 return NULL;
-        }
-
-        ssig = g_variant_type_dup_string(type);
-
-        if (g_variant_type_equal(type, G_VARIANT_TYPE_BOOLEAN))
-                return g_variant_new(ssig, df_rand_gboolean(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_BYTE))
-                return g_variant_new(ssig, df_rand_guint8(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT16))
-                return g_variant_new(ssig, df_rand_gint16(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT16))
-                return g_variant_new(ssig, df_rand_guint16(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT32))
-                return g_variant_new(ssig, df_rand_gint32(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT32))
-                return g_variant_new(ssig, df_rand_guint32(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_INT64))
-                return g_variant_new(ssig, df_rand_gint64(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_UINT64))
-                return g_variant_new(ssig, df_rand_guint64(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_HANDLE))
-                return g_variant_new(ssig, df_rand_unixFD(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_DOUBLE))
-                return g_variant_new(ssig, df_rand_gdouble(iteration));
-        else if (g_variant_type_equal(type, G_VARIANT_TYPE_STRING)) {
-                g_autoptr(char) str = NULL;
-
-                if (df_rand_string(&str, iteration) < 0) {
-                        df_fail("Failed to generate a random string\n");
-                        return NULL;
-                }
-
-                return g_variant_new(ssig, str);
-        } else if (g_variant_type_equal(type, G_VARIANT_TYPE_OBJECT_PATH)) {
-                g_autoptr(char) obj_path = NULL;
 
-                if (df_rand_dbus_objpath_string(&obj_path, iteration) < 0) {
-                        df_fail("Failed to generate a random object path\n");
-                        return NULL;
-                }
-
-                return g_variant_new(ssig, obj_path);
-        } else if (g_variant_type_equal(type, G_VARIANT_TYPE_SIGNATURE)) {
-                g_autoptr(char) sig_str = NULL;
-
-                if (df_rand_dbus_signature_string(&sig_str, iteration) < 0) {
-                        df_fail("Failed to generate a random signature string\n");
-                        return NULL;
-                }
-
-                return g_variant_new(ssig, sig_str);
-        } else if (g_variant_type_equal(type, G_VARIANT_TYPE_VARIANT)) {
-                GVariant *variant = NULL;
-
-                if (df_rand_GVariant(&variant, iteration) < 0) {
-                        df_fail("Failed to generate a random GVariant\n");
-                        return NULL;
-                }
-
-                return g_variant_new(ssig, variant);
-        } else {
-                df_fail("Invalid basic type: %s\n", ssig);
-                g_assert_not_reached();
-        }
-
-        return NULL;
+        return df_dictionary_get_bytes(df_external_dictionary, str);
 }
 
-GVariant *df_generate_random_from_signature(const char *signature, guint64 iteration)
+/* Generate a GVariant with random data for the given signature
+ *
+ * Note: this compiles the signature every time, use df_plan_new() and
+ *       df_plan_generate() directly when generating multiple values for
+ *       the same signature
+ */
+GVariant *df_generate_random_from_signature(df_rand_t *rnd, const char *signature, guint64 iteration)
 {
-        g_autoptr(GVariantType) type = NULL;
-        g_autoptr(GVariantBuilder) builder = NULL;
+        g_autoptr(df_plan_t) plan = NULL;
 
-        if (!signature ||
-            !g_variant_is_signature(signature) ||
-            !g_variant_type_string_is_valid(signature)) {
-                df_fail("Invalid signature: %s\n", signature);
+        plan = df_plan_new(signature);
+        if (!plan)
                 return NULL;
-        }
-
-        type = g_variant_type_new(signature);
-        /* Leaf nodes */
-        if (g_variant_type_is_basic(type) || g_variant_type_is_variant(type))
-                return df_generate_random_basic(type, iteration);
-
-        builder = g_variant_builder_new(type);
-
-        for (const GVariantType *iter = g_variant_type_first(type);
-             iter;
-             iter = g_variant_type_next(iter)) {
 
-                g_autoptr(char) ssig = NULL;
-
-                ssig = g_variant_type_dup_string(iter);
-
-                if (g_variant_type_is_basic(iter) || g_variant_type_is_variant(iter)) {
-                        /* Basic type, generate a random value
-                         * Note: treat 'variant' as a basic type, since it can't
-                         *       be iterated on by g_variant_type_{first,next}()
-                         */
-                        GVariant *basic;
-
-                        basic = df_generate_random_basic(iter, iteration);
-                        if (!basic)
-                                return NULL;
-
-                        g_variant_builder_add_value(builder, basic);
-                } else if (g_variant_type_is_tuple(iter)) {
-                        /* Tuple */
-                        GVariant *tuple = NULL;
-
-                        tuple = df_generate_random_from_signature(ssig, iteration);
-                        if (!tuple)
-                                return NULL;
-
-                        g_variant_builder_add_value(builder, tuple);
-                } else if (g_variant_type_is_array(iter)) {
-                        /* Array */
-                        g_autoptr(char) array_signature = NULL;
-                        const GVariantType *array_type = NULL;
-                        int nest_level = 0;
-
-                        /* Open the "main" array container */
-                        g_variant_builder_open(builder, iter);
-
-                        /* Resolve all levels of arrays (e.g. aaaai) */
-                        for (array_type = g_variant_type_element(iter);
-                             g_variant_type_is_array(array_type);
-                             array_type = g_variant_type_element(array_type)) {
-
-                                /* Open an container for each nested array */
-                                g_variant_builder_open(builder, array_type);
-                                nest_level++;
-                        }
-
-                        array_signature = g_variant_type_dup_string(array_type);
-
-                        /* Create a pseudo-randomly sized array */
-                        for (size_t i = 0; i < df_rand_array_size(iteration); i++) {
-                                GVariant *array_item = NULL;
-
-                                array_item = df_generate_random_from_signature(array_signature, iteration);
-                                if (!array_item)
-                                        return NULL;
-
-                                g_variant_builder_add_value(builder, array_item);
-                        }
-
-                        /* Close container of each array level */
-                        for (int i = 0; i < nest_level; i++)
-                                g_variant_builder_close(builder);
+        return df_plan_generate(plan, rnd, iteration);
+}
 
-                        /* Close the "main" array container */
-                        g_variant_builder_close(builder);
-                } else {
-                        /* TODO: maybe */
-                        df_fail("Not implemented: %s\n", ssig);
-                        return NULL;
-                }
-        }
+size_t df_rand_array_size(df_rand_t *rnd, guint64 iteration)
+{
+        /* Generate an empty array on the first iteration */
+        if (iteration == 0)
+                return 0;
 
-        return g_variant_builder_end(builder);
+        return df_rand_next(rnd) % DF_RAND_MAX_ARRAY_SIZE;
 }
 
-
-size_t df_rand_array_size(guint64 iteration)
+size_t df_rand_array_size_max(df_rand_t *rnd, guint64 iteration, size_t max)
 {
-        /* Generate an empty array on the first iteration */
         if (iteration == 0)
                 return 0;
 
-        return rand() % 10;
+        return df_rand_next(rnd) % ((guint64) max + 1);
 }
 
 /**
  * @return Generated pseudo-random 8-bit unsigned integer value
  */
-guint8 df_rand_guint8(guint64 iteration)
+guint8 df_rand_guint8(df_rand_t *rnd, guint64 iteration)
 {
         switch (iteration) {
         case 0:
@@ -279,7 +130,7 @@ guint8 df_rand_guint8(guint64 iteration)
         case 2:
                 return G_MAXUINT8 / 2;
         default:
-                return rand() % G_MAXUINT8;
+                return df_rand_next(rnd) % G_MAXUINT8;
         }
 }
 
@@ -294,7 +145,7 @@ gboolean df_rand_gboolean(guint64 iteration)
 /**
  * @return Generated pseudo-random 16-bit integer value
  */
-gint16 df_rand_gint16(guint64 iteration)
+gint16 df_rand_gint16(df_rand_t *rnd, guint64 iteration)
 {
         gint16 gi16;
 
@@ -308,8 +159,8 @@ gint16 df_rand_gint16(guint64 iteration)
         case 3:
                 return G_MAXINT16 / 2;
         default:
-                gi16 = rand() % G_MAXINT16;
-                if (rand() % 2 == 0)
+                gi16 = df_rand_next(rnd) % G_MAXINT16;
+                if (df_rand_next(rnd) % 2 == 0)
                         return (gi16 * -1) - 1;
 
                 return gi16;
@@ -319,7 +170,7 @@ gint16 df_rand_gint16(guint64 iteration)
 /**
  * @return Generated pseudo-random 16-bit unsigned integer value
  */
-guint16 df_rand_guint16(guint64 iteration)
+guint16 df_rand_guint16(df_rand_t *rnd, guint64 iteration)
 {
         switch (iteration) {
         case 0:
@@ -329,14 +180,14 @@ guint16 df_rand_guint16(guint64 iteration)
         case 2:
                 return G_MAXUINT16 / 2;
         default:
-                return rand() % G_MAXUINT16;
+                return df_rand_next(rnd) % G_MAXUINT16;
         }
 }
 
 /**
  * @return Generated pseudo-random 32-bit integer value
  */
-gint32 df_rand_gint32(guint64 iteration)
+gint32 df_rand_gint32(df_rand_t *rnd, guint64 iteration)
 {
         gint32 gi32;
 
@@ -350,8 +201,8 @@ gint32 df_rand_gint32(guint64 iteration)
         case 3:
                 return G_MAXINT32 / 2;
         default:
-                gi32 = rand() % G_MAXINT32;
-                if (rand() % 2 == 0)
+                gi32 = df_rand_next(rnd) % G_MAXINT32;
+                if (df_rand_next(rnd) % 2 == 0)
                         return (gi32 * -1) - 1;
 
                 return gi32;
@@ -361,7 +212,7 @@ gint32 df_rand_gint32(guint64 iteration)
 /**
  * @return Generated pseudo-random 32-bit unsigned integer value
  */
-guint32 df_rand_guint32(guint64 iteration)
+guint32 df_rand_guint32(df_rand_t *rnd, guint64 iteration)
 {
         switch (iteration) {
         case 0:
@@ -371,14 +222,14 @@ guint32 df_rand_guint32(guint64 iteration)
         case 2:
                 return G_MAXUINT32 / 2;
         default:
-                return rand() % G_MAXUINT32;
+                return df_rand_next(rnd) % G_MAXUINT32;
         }
 }
 
 /**
  * @return Generated pseudo-random 64-bit (long) integer value
  */
-gint64 df_rand_gint64(guint64 iteration)
+gint64 df_rand_gint64(df_rand_t *rnd, guint64 iteration)
 {
         gint64 gi64;
 
@@ -392,8 +243,8 @@ gint64 df_rand_gint64(guint64 iteration)
         case 3:
                 return G_MAXINT64 / 2;
         default:
-                gi64 = rand() % G_MAXINT64;
-                if (rand() % 2 == 0)
+                gi64 = df_rand_next(rnd) % G_MAXINT64;
+                if (df_rand_next(rnd) % 2 == 0)
                         return (gi64 * -1) - 1;
 
                 return gi64;
@@ -403,7 +254,7 @@ gint64 df_rand_gint64(guint64 iteration)
 /**
  * @return Generated pseudo-random 64-bit (long) unsigned integer value
  */
-guint64 df_rand_guint64(guint64 iteration)
+guint64 df_rand_guint64(df_rand_t *rnd, guint64 iteration)
 {
         switch (iteration) {
         case 0:
@@ -413,14 +264,14 @@ guint64 df_rand_guint64(guint64 iteration)
         case 2:
                 return G_MAXUINT64 / 2;
         default:
-                return rand() % G_MAXUINT64;
+                return df_rand_next(rnd) % G_MAXUINT64;
         }
 }
 
 /**
  * @return Generated pseudo-random double precision floating point number
  */
-gdouble df_rand_gdouble(guint64 iteration)
+gdouble df_rand_gdouble(df_rand_t *rnd, guint64 iteration)
 {
         gdouble gdbl;
 
@@ -434,24 +285,25 @@ gdouble df_rand_gdouble(guint64 iteration)
         case 3:
                 return G_MAXDOUBLE / 2.0;
         default:
-                gdbl = (gdouble) random();
-                gdbl += ((gdouble) rand() / RAND_MAX);
+                /* 31-bit integral part and 53-bit fractional part */
+                gdbl = (gdouble) (df_rand_next(rnd) >> 33);
+                gdbl += (df_rand_next(rnd) >> 11) * 0x1.0p-53;
 
-                if (rand() % 2 == 0)
+                if (df_rand_next(rnd) % 2 == 0)
                         return gdbl * -1.0;
 
                 return gdbl;
         }
 }
 
-gunichar df_rand_unichar(guint16 *width)
+gunichar df_rand_unichar(df_rand_t *rnd, guint16 *width)
 {
         gunichar uc = 0;
 
         /* If width is set to 0, generate a random width in the UTF-8 interval
          * (i.e. 1 - 4 bytes) and set the result as the value */
         if (*width == 0)
-                *width = (rand() % 4) + 1;
+                *width = (df_rand_next(rnd) % 4) + 1;
 
         g_assert(*width > 0 && *width < 5);
 
@@ -464,19 +316,19 @@ gunichar df_rand_unichar(guint16 *width)
                                  *
                                  * Skip the bottom 32, i.e. [0x0, 0x20) control characters.
                                  */
-                                uc = rand() % (0x80 - 0x20) + 0x20;
+                                uc = df_rand_next(rnd) % (0x80 - 0x20) + 0x20;
                                 break;
                         case 2:
                                 /* 2-byte wide character: [0x80, 0x7FF], i.e. [128, 2047] */
-                                uc = rand() % (0x800 - 0x80) + 0x80;
+                                uc = df_rand_next(rnd) % (0x800 - 0x80) + 0x80;
                                 break;
                         case 3:
                                 /* 3-byte wide character: [0x800, 0xFFFF], i.e. [2048, 65535] */
-                                uc = rand() % (0x10000 - 0x800) + 0x800;
+                                uc = df_rand_next(rnd) % (0x10000 - 0x800) + 0x800;
                                 break;
                         case 4:
                                 /* 4-byte wide character: [0x10000, 0x10FFFF], i.e. [65536 - 1114111] */
-                                uc = rand() % (0x110000 - 0x10000) + 0x10000;
+                                uc = df_rand_next(rnd) % (0x110000 - 0x10000) + 0x10000;
                                 break;
                         default:
                                 g_assert_not_reached();
@@ -486,103 +338,263 @@ gunichar df_rand_unichar(guint16 *width)
         return uc;
 }
 
+/* Four xoshiro256** generators run in parallel; with GCC/clang vector
+ * extensions each state word of all lanes is held in a single vector, which
+ * the compiler maps to SIMD registers (2x SSE2, AVX2, NEON, ...) */
+#define DF_RAND_LANES 4
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(DF_RAND_NO_SIMD)
+#define DF_RAND_SIMD 1
+typedef guint64 df_rand_lanes_t __attribute__((vector_size(DF_RAND_LANES * sizeof(guint64))));
+#else
+typedef guint64 df_rand_lanes_t[DF_RAND_LANES];
+#endif
+
+typedef struct df_rand_bulk {
+        df_rand_lanes_t s[4];
+        /* Current block of random words and the index of the next one */
+        guint64 block[DF_RAND_LANES];
+        guint idx;
+} df_rand_bulk_t;
+
+static void df_rand_bulk_init(df_rand_bulk_t *bulk, df_rand_t *rnd)
+{
+        for (guint j = 0; j < DF_RAND_LANES; j++) {
+                guint64 seed = df_rand_next(rnd);
+
+                for (guint k = 0; k < 4; k++)
+                        bulk->s[k][j] = df_rand_splitmix64(&seed);
+        }
+
+        bulk->idx = DF_RAND_LANES;
+}
+
+static void df_rand_bulk_refill(df_rand_bulk_t *bulk)
+{
+#ifdef DF_RAND_SIMD
+        /* Same as df_rand_next(), with the multiplications replaced by shifts,
+         * since there's no 64-bit vector multiplication on most platforms */
+        df_rand_lanes_t m = bulk->s[1] + (bulk->s[1] << 2);
+        df_rand_lanes_t r = (m << 7) | (m >> 57);
+        df_rand_lanes_t t = bulk->s[1] << 17;
+
+        r += r << 3;
+        bulk->s[2] ^= bulk->s[0];
+        bulk->s[3] ^= bulk->s[1];
+        bulk->s[1] ^= bulk->s[2];
+        bulk->s[0] ^= bulk->s[3];
+        bulk->s[2] ^= t;
+        bulk->s[3] = (bulk->s[3] << 45) | (bulk->s[3] >> 19);
+
+        memcpy(bulk->block, &r, sizeof(bulk->block));
+#else
+        for (guint j = 0; j < DF_RAND_LANES; j++) {
+                df_rand_t lane = { { bulk->s[0][j], bulk->s[1][j], bulk->s[2][j], bulk->s[3][j] } };
+
+                bulk->block[j] = df_rand_next(&lane);
+                for (guint k = 0; k < 4; k++)
+                        bulk->s[k][j] = lane.s[k];
+        }
+#endif
+        bulk->idx = 0;
+}
+
+static inline guint64 df_rand_bulk_next(df_rand_bulk_t *bulk)
+{
+        if (G_UNLIKELY(bulk->idx == DF_RAND_LANES))
+                df_rand_bulk_refill(bulk);
+
+        return bulk->block[bulk->idx++];
+}
+
+/* Map a 32-bit random value to <0, range) without division */
+static inline guint32 df_rand_range32(guint32 x, guint32 range)
+{
+        return ((guint64) x * range) >> 32;
+}
+
+void df_rand_utf8(df_rand_t *rnd, char *buf, size_t size, const df_rand_utf8_mix_t *mix)
+{
+        guint8 *p = (guint8 *) buf, *end = p + size;
+        guint32 cumulative[4], total = 0;
+        df_rand_bulk_t bulk;
+
+        g_assert(rnd);
+        g_assert(buf || size == 0);
+        g_assert(mix);
+
+        for (guint i = 0; i < G_N_ELEMENTS(mix->weights); i++) {
+                total += mix->weights[i];
+                cumulative[i] = total;
+        }
+        g_assert(total > 0);
+
+        df_rand_bulk_init(&bulk, rnd);
+
+        while (p < end) {
+                /* One random word per character: the low 32 bits select the width,
+                 * the high 32 bits the character itself */
+                guint64 r = df_rand_bulk_next(&bulk);
+                guint32 v = r >> 32, c;
+                guint32 w = df_rand_range32((guint32) r, total);
+                guint width;
+
+                for (width = 1; w >= cumulative[width - 1]; width++)
+                        ;
+                /* Shrink the last character to fit into the byte budget */
+                width = MIN(width, (guint) (end - p));
+
+                switch (width) {
+                case 1:
+                        /* [0x20, 0x7F] */
+                        *p++ = 0x20 + df_rand_range32(v, 0x80 - 0x20);
+                        break;
+                case 2:
+                        /* [0x80, 0x7FF] */
+                        c = 0x80 + df_rand_range32(v, 0x800 - 0x80);
+                        *p++ = 0xC0 | (c >> 6);
+                        *p++ = 0x80 | (c & 0x3F);
+                        break;
+                case 3:
+                        /* [0x800, 0xFFFF] without the surrogates [0xD800, 0xDFFF] */
+                        c = 0x800 + df_rand_range32(v, 0x10000 - 0x800 - 0x800);
+                        if (c >= 0xD800)
+                                c += 0x800;
+                        *p++ = 0xE0 | (c >> 12);
+                        *p++ = 0x80 | ((c >> 6) & 0x3F);
+                        *p++ = 0x80 | (c & 0x3F);
+                        break;
+                case 4:
+                        /* [0x10000, 0x10FFFF] */
+                        c = 0x10000 + df_rand_range32(v, 0x110000 - 0x10000);
+                        *p++ = 0xF0 | (c >> 18);
+                        *p++ = 0x80 | ((c >> 12) & 0x3F);
+                        *p++ = 0x80 | ((c >> 6) & 0x3F);
+                        *p++ = 0x80 | (c & 0x3F);
+                        break;
+                default:
+                        g_assert_not_reached();
+                }
+        }
+}
+
 /**
- * @function Generates pseudo-random string of size size.
- * @param buf Pointer on buffer where generated string will be stored
+ * @function Generates pseudo-random string of size size (including the
+ * trailing NUL byte) in the arena.
  * @param size Size of buffer
  */
-static char *df_rand_random_string(size_t size)
+static char *df_rand_random_string(df_rand_t *rnd, size_t size)
 {
+        char *str;
+        size_t str_size;
+
         if (size == 0)
                 return NULL;
 
-        g_autoptr(GString) str = NULL;
-        size_t str_size;
+        str = df_arena_alloc(rnd->arena, size);
+        if (!str)
+                return NULL;
 
         str_size = size - 1;
-        str = g_string_sized_new(size);
-
-        for (size_t i = 0; i < str_size;) {
-                /* If we have enough space, let df_rand_unichar() decide the
-                 * width of the random character, otherwise specify it ourselves
-                 * to fit into the remaining space */
-                guint16 width = str_size - i > 4 ? 0 : str_size - i;
-                gunichar uc;
-
-                uc = df_rand_unichar(&width);
-                str = g_string_append_unichar(str, uc);
-                i += width;
-        }
+        df_rand_utf8(rnd, str, str_size, &DF_RAND_UTF8_MIX_UNIFORM);
+        str[str_size] = 0;
 
-        /* "Steal" the internal C-string from the GString class to avoid another
-         * unnecessary allocation */
-        return g_steal_pointer(&str->str);
+        return str;
 }
 
+/* List of strings that are used before we start generating random stuff */
+static const char *df_rand_test_strings[] = {
+        "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA",
+        "%s%s%s%s%s%s%s%s%s%n%s%n%n%n%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s",
+        ("%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n"
+        "%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n"),
+        "bomb(){ bomb|bomb & }; bomb",
+        ":1.285",
+        "org.freedesktop.foo",
+        "/org/freedesktop/foo",
+        "",
+        "\0",
+        "systemd-localed.service",
+        "/tmp/test",
+        "verify-active",
+        "IPAddressDeny",
+        "Description",
+        "127.0.0.1",
+};
+
 /**
- * @function Allocates memory for pseudo-random string of size counted
- * by adding generated pseudo-random number from interval <0, CHAR_MAX>
- * to df_str_len (this mechanism is responsible for generating bigger strings
- * by every call of df_rand_string()). Then pseudo-random string is generated
- * and stored in buf. At the beginning strings from global array df_str_def
- * are used. Warning: buf should be freed outside this module by callee
- * of this function.
- * @param buf Address of pointer on buffer where generated string
- * will be stored
+ * @function Picks one of the predefined strings (or strings from the external
+ * dictionary) at the beginning, then generates pseudo-random strings of size
+ * counted from a pseudo-random number and the current iteration (this
+ * mechanism is responsible for generating bigger strings with every
+ * iteration). Predefined strings are returned as they are, generated ones
+ * are allocated from rnd->arena, so no copy is made in either case.
+ * @param buf Address of pointer where the string will be stored
  * @return 0 on success, -1 on error
  */
-int df_rand_string(gchar **buf, guint64 iteration)
-{
-        /* List of strings that are used before we start generating random stuff */
-        static const char *test_strings[] = {
-                "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA",
-                "%s%s%s%s%s%s%s%s%s%n%s%n%n%n%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s",
-                ("%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n"
-                "%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n%n"),
-                "bomb(){ bomb|bomb & }; bomb",
-                ":1.285",
-                "org.freedesktop.foo",
-                "/org/freedesktop/foo",
-                "",
-                "\0",
-                "systemd-localed.service",
-                "/tmp/test",
-                "verify-active",
-                "IPAddressDeny",
-                "Description",
-                "127.0.0.1",
-        };
-        g_autoptr(gchar) ret = NULL;
-        size_t len;
+int df_rand_string(df_rand_t *rnd, const gchar **buf, guint64 iteration)
+{
+        return df_rand_string_max(rnd, buf, iteration, 0);
+}
+
+int df_rand_string_max(df_rand_t *rnd, const gchar **buf, guint64 iteration, size_t max_length)
+{
+        const char *ret = NULL;
+        size_t len, limit;
+
+        limit = df_fuzz_get_buffer_length();
+        if (max_length > 0)
+                limit = MIN(limit, max_length);
 
         /* If -f/--string-file= was used, use the loaded strings instead of the
          * pre-defined ones, before generating random ones. */
-        if (df_external_dictionary.size > 0) {
-                if (iteration < df_external_dictionary.size) {
-                        ret = strdup(df_external_dictionary.strings[iteration]);
-                        if (!ret)
-                                return df_fail_ret(-1, "Could not allocate memory for the random string\n");
-                }
-        } else if (iteration < G_N_ELEMENTS(test_strings)) {
-                ret = strdup(test_strings[iteration]);
-                if (!ret)
-                        return df_fail_ret(-1, "Could not allocate memory for the random string\n");
-        }
+        if (df_external_dictionary && !df_dictionary_is_empty(df_external_dictionary))
+                ret = df_dictionary_get(df_external_dictionary, iteration);
+        else if (iteration < G_N_ELEMENTS(df_rand_test_strings))
+                ret = df_rand_test_strings[iteration];
+
+        /* Predefined strings which don't fit are replaced by generated ones */
+        if (ret && max_length > 0 && strlen(ret) > limit)
+                ret = NULL;
 
         if (!ret) {
-                /* Genearate a pseudo-random string length in interval <0, df_fuzz_get_buffer_length()) */
-                len = (rand() * iteration) % df_fuzz_get_buffer_length();
-                len = CLAMP(len, 1, df_fuzz_get_buffer_length());
-                ret = df_rand_random_string(len);
+                /* Genearate a pseudo-random string length in interval <0, limit) */
+                len = (df_rand_next(rnd) * iteration) % limit;
+                len = CLAMP(len, 1, limit);
+                ret = df_rand_random_string(rnd, len);
+                if (!ret)
+                        return df_fail_ret(-1, "Could not allocate memory for the random string\n");
         }
 
-        *buf = g_steal_pointer(&ret);
+        *buf = ret;
 
         return 0;
 }
 
+const char *df_rand_token(df_rand_t *rnd, guint64 iteration)
+{
+        const char *token = NULL;
+        guint64 r = df_rand_next(rnd), n;
+
+        if (df_external_dictionary && !df_dictionary_is_empty(df_external_dictionary)) {
+                /* Don't index more of the dictionary than df_rand_string() would
+                 * have used by now; if the file is shorter than that, it's been
+                 * indexed as a whole by the failed lookup */
+                token = df_dictionary_get(df_external_dictionary, r % (iteration + 1));
+                if (!token && (n = df_dictionary_get_n_indexed(df_external_dictionary)) > 0)
+                        token = df_dictionary_get(df_external_dictionary, r % n);
+        }
+
+        return token ?: df_rand_test_strings[r % G_N_ELEMENTS(df_rand_test_strings)];
+}
+
 /* Generate a pseudo-random object path */
-int df_rand_dbus_objpath_string(gchar **buf, guint64 iteration)
+int df_rand_dbus_objpath_string(df_rand_t *rnd, const gchar **buf, guint64 iteration)
+{
+        return df_rand_dbus_objpath_string_max(rnd, buf, iteration, 0);
+}
+
+int df_rand_dbus_objpath_string_max(df_rand_t *rnd, const gchar **buf, guint64 iteration, size_t max_length)
 {
         /* List of object paths that are used before we start generating random stuff */
         static const char *test_object_paths[] = {
@@ -595,13 +607,19 @@ int df_rand_dbus_objpath_string(gchar **buf, guint64 iteration)
                 "/0/0/0",
                 "/_/_/_",
         };
-        g_autoptr(gchar) ret = NULL;
-
-        if (iteration < G_N_ELEMENTS(test_object_paths)) {
-                ret = strdup(test_object_paths[iteration]);
-                if (!ret)
-                        return df_fail_ret(-1, "Could not allocate memory for the random string\n");
-        } else {
+        size_t limit;
+        char *ret;
+
+        limit = df_fuzz_get_buffer_length();
+        if (max_length > 0)
+                limit = MIN(limit, max_length);
+
+        if (iteration < G_N_ELEMENTS(test_object_paths) && strlen(test_object_paths[iteration]) <= limit)
+                *buf = test_object_paths[iteration];
+        else if (limit < 3)
+                /* No room for anything but the root object path */
+                *buf = "/";
+        else {
                 gint64 size, nelem, idx = 0;
 
                 /* Rules for an object path:
@@ -617,7 +635,7 @@ int df_rand_dbus_objpath_string(gchar **buf, guint64 iteration)
 
                 /* We need at least 2 characters for the shortest object path
                  * (e.g. "/a"), not counting the root object path ("/") */
-                size = (iteration % (df_fuzz_get_buffer_length() - 2)) + 2;
+                size = (iteration % (limit - 2)) + 2;
                 /* Calculate number of 'elements', i.e. the "/abc" parts in the object path.
                  * For that, lets calculate the maximum number of elements for given size
                  * (each element needs at least two characters, hence size/2) and
@@ -626,9 +644,9 @@ int df_rand_dbus_objpath_string(gchar **buf, guint64 iteration)
                 g_assert(size >= 2);
                 /* Set the number of elements to 1 if size is < 4 to avoid dividing
                  * by zero */
-                nelem = size < 4 ? 1 : (rand() % (size / 2 - 1)) + 1;
+                nelem = size < 4 ? 1 : (gint64) (df_rand_next(rnd) % (size / 2 - 1)) + 1;
 
-                ret = g_try_new(gchar, size + 1);
+                ret = df_arena_alloc(rnd->arena, size + 1);
                 if (!ret)
                         return df_fail_ret(-1, "Could not allocate memory for the random string\n");
 
@@ -642,30 +660,29 @@ int df_rand_dbus_objpath_string(gchar **buf, guint64 iteration)
                          * "remaining size - reserved size" bytes, but at least 2 bytes.
                          *
                          * Additionally, if we're the last element, use the remaining size in full */
-                        gint64 elem_size = i + 1 == nelem ? size : (rand() % (size - reserve - 2)) + 2;
+                        gint64 elem_size = i + 1 == nelem ? size : (gint64) (df_rand_next(rnd) % (size - reserve - 2)) + 2;
                         size -= elem_size;
 
                         ret[idx++] = '/';
                         /* Fill each element with pseudo-random characters from the list of allowed
                          * characters (as defined by the D-Bus spec) */
                         for (gint64 j = 0; j < elem_size - 1; j++)
-                                ret[idx++] = OBJECT_PATH_VALID_CHARS[rand() % strlen(OBJECT_PATH_VALID_CHARS)];
+                                ret[idx++] = OBJECT_PATH_VALID_CHARS[df_rand_next(rnd) % strlen(OBJECT_PATH_VALID_CHARS)];
                 }
 
                 ret[idx] = 0;
+                *buf = ret;
         }
 
-        *buf = g_steal_pointer(&ret);
-
         return 0;
 }
 
-static inline char df_generate_random_signature_basic(void)
+static inline char df_generate_random_signature_basic(df_rand_t *rnd)
 {
-    return SIGNATURE_BASIC_TYPES[rand() % strlen(SIGNATURE_BASIC_TYPES)];
+    return SIGNATURE_BASIC_TYPES[df_rand_next(rnd) % strlen(SIGNATURE_BASIC_TYPES)];
 }
 
-static void df_generate_random_signature(GString *str, gint16 size, guint16 nest_level, gboolean complete_type)
+static void df_generate_random_signature(df_rand_t *rnd, GString *str, gint16 size, guint16 nest_level, gboolean complete_type)
 {
     const char *all_types = SIGNATURE_BASIC_TYPES "av({";
     size_t type_idx;
@@ -675,10 +692,10 @@ static void df_generate_random_signature(GString *str, gint16 size, guint16 nest
     g_assert(nest_level <= MAX_SIGNATURE_NEST_LEVEL);
 
     for (gint16 i = 0; i < size;) {
-        type_idx = rand() % strlen(all_types);
+        type_idx = df_rand_next(rnd) % strlen(all_types);
 
         if (type_idx < strlen(SIGNATURE_BASIC_TYPES) || all_types[type_idx] == 'v') {
-            g_string_append_c(str, df_generate_random_signature_basic());
+            g_string_append_c(str, df_generate_random_signature_basic(rnd));
             i++;
         } else if (all_types[type_idx] == 'a') {
             /* Check if we have a room for the shortest array, i.e. "ax" */
@@ -711,13 +728,13 @@ static void df_generate_random_signature(GString *str, gint16 size, guint16 nest
              * string length and subtract it from the string length after we return from
              * df_generate_signature().
              */
-            struct_size = max_struct_size == 1 ? max_struct_size : (rand() % (max_struct_size - 1)) + 1;
+            struct_size = max_struct_size == 1 ? max_struct_size : (gint16) (df_rand_next(rnd) % (max_struct_size - 1)) + 1;
             orig_str_length = str->len;
 
             g_string_append_c(str, '(');
             /* Don't 'request' a single complete type, since we want to utilize the full length
              * of the possible struct and we ourselves ensure the type will be complete */
-            df_generate_random_signature(str, struct_size, nest_level++, /* complete= */ FALSE);
+            df_generate_random_signature(rnd, str, struct_size, nest_level++, /* complete= */ FALSE);
             g_string_append_c(str, ')');
             i += (str->len - orig_str_length);
         } else if (all_types[type_idx] == '{') {
@@ -740,7 +757,7 @@ static void df_generate_random_signature(GString *str, gint16 size, guint16 nest
             /* Similarly to structs, generate a random size of the dict "value", and
              * store the current signature string length, so we can later determine
              * how many bytes were added in total */
-            value_size = max_value_size == 1 ? max_value_size : (rand() % (max_value_size - 1)) + 1;
+            value_size = max_value_size == 1 ? max_value_size : (gint16) (df_rand_next(rnd) % (max_value_size - 1)) + 1;
             orig_str_length = str->len;
 
             /* If the last element of the signature is not an array, add it ourselves */
@@ -748,9 +765,9 @@ static void df_generate_random_signature(GString *str, gint16 size, guint16 nest
                 g_string_append_c(str, 'a');
             g_string_append_c(str, '{');
             /* The dictionary "key" must be a basic type */
-            g_string_append_c(str, df_generate_random_signature_basic());
+            g_string_append_c(str, df_generate_random_signature_basic(rnd));
             /* The dictionary "value" must be a single complete type */
-            df_generate_random_signature(str, value_size, nest_level++, /* complete= */ TRUE);
+            df_generate_random_signature(rnd, str, value_size, nest_level++, /* complete= */ TRUE);
             g_string_append_c(str, '}');
             i += (str->len - orig_str_length);
         } else
@@ -763,15 +780,32 @@ static void df_generate_random_signature(GString *str, gint16 size, guint16 nest
     }
 }
 
-int df_rand_dbus_signature_string(gchar **buf, guint64 iteration)
+/* Generated signatures get longer with every iteration, up to
+ * MAX_SIGNATURE_LENGTH or max_length (if it's not 0) */
+static guint16 df_rand_signature_size(guint64 iteration, size_t max_length)
+{
+        size_t limit = MAX_SIGNATURE_LENGTH;
+
+        if (max_length > 0)
+                limit = MIN(limit, max_length);
+
+        return (iteration % limit) + 1;
+}
+
+int df_rand_dbus_signature_string(df_rand_t *rnd, gchar **buf, guint64 iteration)
+{
+        return df_rand_dbus_signature_string_max(rnd, buf, iteration, 0);
+}
+
+int df_rand_dbus_signature_string_max(df_rand_t *rnd, gchar **buf, guint64 iteration, size_t max_length)
 {
         g_autoptr(GString) signature = NULL;
         guint16 size;
 
-        size = (iteration % MAX_SIGNATURE_LENGTH) + 1;
+        size = df_rand_signature_size(iteration, max_length);
         signature = g_string_sized_new(size + 1);
 
-        df_generate_random_signature(signature, size, 0, /* complete= */ FALSE);
+        df_generate_random_signature(rnd, signature, size, 0, /* complete= */ FALSE);
         g_assert(g_variant_is_signature(signature->str));
 
         *buf = g_steal_pointer(&signature->str);
@@ -779,22 +813,40 @@ int df_rand_dbus_signature_string(gchar **buf, guint64 iteration)
         return 0;
 }
 
-int df_rand_GVariant(GVariant **var, guint64 iteration)
+int df_rand_GVariant_signature(df_rand_t *rnd, gchar **buf, guint64 iteration)
+{
+        return df_rand_GVariant_signature_max(rnd, buf, iteration, 0);
+}
+
+int df_rand_GVariant_signature_max(df_rand_t *rnd, gchar **buf, guint64 iteration, size_t max_length)
 {
         g_autoptr(GString) signature = NULL;
         guint16 size;
 
-        size = (iteration % MAX_SIGNATURE_LENGTH) + 1;
+        /* Leave room for the parentheses */
+        size = df_rand_signature_size(iteration, max_length > 0 ? MAX(max_length, 3U) - 2 : 0);
         signature = g_string_sized_new(size + 3);
 
         /* Variant must be a single complete type */
         g_string_append_c(signature, '(');
-        df_generate_random_signature(signature, size, 0, /* complete= */ TRUE);
+        df_generate_random_signature(rnd, signature, size, 0, /* complete= */ TRUE);
         g_string_append_c(signature, ')');
 
         g_assert(g_variant_is_signature(signature->str) && g_variant_type_string_is_valid(signature->str));
 
-        *var = df_generate_random_from_signature(signature->str, iteration);
+        *buf = g_steal_pointer(&signature->str);
+
+        return 0;
+}
+
+int df_rand_GVariant(df_rand_t *rnd, GVariant **var, guint64 iteration)
+{
+        g_autoptr(gchar) signature = NULL;
+
+        if (df_rand_GVariant_signature(rnd, &signature, iteration) < 0)
+                return -1;
+
+        *var = df_generate_random_from_signature(rnd, signature, iteration);
         if (!*var)
                 return -1;
 
@@ -804,7 +856,7 @@ int df_rand_GVariant(GVariant **var, guint64 iteration)
 /**
  * @return Generated pseudo-random FD number from interval <-1, INT_MAX)
  */
-int df_rand_unixFD(guint64 iteration)
+int df_rand_unixFD(df_rand_t *rnd, guint64 iteration)
 {
         int fd;
 
@@ -816,8 +868,8 @@ int df_rand_unixFD(guint64 iteration)
         case 3:
                 return -1;
         default:
-                fd = rand () % INT_MAX;
-                if (rand () % 10 == 0)
+                fd = df_rand_next(rnd) % INT_MAX;
+                if (df_rand_next(rnd) % 10 == 0)
                         fd *= -1;
 
                 return fd;
@@ -19,29 +19,87 @@
  */
 #pragma once
 
+#include "arena.h"
 #include "fuzz.h"
 
 #define OBJECT_PATH_VALID_CHARS "ABCDEFGHIJKLMNOPQRSTUVWXYZ" \
                                 "abcdefghijklmnopqrstuvwxyz" \
                                 "0123456789_"
 
-struct external_dictionary {
-        size_t size;
-        char **strings;
-};
+/* Upper bound (exclusive) of the generated array sizes */
+#define DF_RAND_MAX_ARRAY_SIZE 10
+
+/** Pseudo-random number generator context (xoshiro256**)
+  *
+  * All df_rand_*() functions draw from an explicitly passed context instead of
+  * a global state, so each worker (or each iteration) can have its own
+  * reproducible stream.
+  *
+  * Generated strings and object paths are allocated from the arena, so they
+  * remain valid only until the arena is reset by the owner of the context.
+  *
+  * See: https://prng.di.unimi.it/
+  */
+typedef struct df_rand {
+        guint64 s[4];
+        df_arena_t *arena;
+} df_rand_t;
 
-void df_rand_init(unsigned int seed);
+/**
+ * @function (Re)seeds the generator state; the arena is left untouched
+ */
+void df_rand_init(df_rand_t *rnd, guint64 seed);
+
+static inline guint64 df_rand_rotl(const guint64 x, int k)
+{
+        return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * @return Next pseudo-random 64-bit value from the context rnd
+ */
+static inline guint64 df_rand_next(df_rand_t *rnd)
+{
+        const guint64 result = df_rand_rotl(rnd->s[1] * 5, 7) * 9;
+        const guint64 t = rnd->s[1] << 17;
+
+        rnd->s[2] ^= rnd->s[0];
+        rnd->s[3] ^= rnd->s[1];
+        rnd->s[1] ^= rnd->s[2];
+        rnd->s[0] ^= rnd->s[3];
+        rnd->s[2] ^= t;
+        rnd->s[3] = df_rand_rotl(rnd->s[3], 45);
+
+        return result;
+}
+
+/**
+ * @function Maps the dictionary used by df_rand_string() (-f/--dictionary=);
+ * the previously loaded one is released
+ * @return 0 on success, negative value on error
+ */
 int df_rand_load_external_dictionary(const char *filename);
+/**
+ * @function Wraps a string returned by df_rand_string() without copying it,
+ * if it comes from the external dictionary
+ * @return New GBytes reference with the serialized form of the string, NULL
+ * if the string isn't a dictionary entry
+ */
+GBytes *df_rand_dictionary_bytes(const char *str);
 
-GVariant *df_generate_random_basic(const GVariantType *type, guint64 iteration);
-GVariant *df_generate_random_from_signature(const char *signature, guint64 iteration);
+GVariant *df_generate_random_from_signature(df_rand_t *rnd, const char *signature, guint64 iteration);
 
-size_t df_rand_array_size(guint64 iteration);
+size_t df_rand_array_size(df_rand_t *rnd, guint64 iteration);
+/**
+ * @function Draws an array size uniformly from interval <0, max> (the first
+ * iteration gets an empty array, same as with df_rand_array_size())
+ */
+size_t df_rand_array_size_max(df_rand_t *rnd, guint64 iteration, size_t max);
 
 /**
  * @return Generated pseudo-random 8-bit unsigned integer value
  */
-guint8 df_rand_guint8(guint64 iteration);
+guint8 df_rand_guint8(df_rand_t *rnd, guint64 iteration);
 
 /**
  * @return Generated pseudo-random boolean value
@@ -51,46 +109,117 @@ gboolean df_rand_gboolean(guint64 iteration);
 /**
  * @return Generated pseudo-random 16-bit integer value
  */
-gint16 df_rand_gint16(guint64 iteration);
+gint16 df_rand_gint16(df_rand_t *rnd, guint64 iteration);
 
 /**
  * @return Generated pseudo-random 16-bit unsigned integer value
  */
-guint16 df_rand_guint16(guint64 iteration);
+guint16 df_rand_guint16(df_rand_t *rnd, guint64 iteration);
 
 /**
  * @return Generated pseudo-random 32-bit integer value
  */
-gint32 df_rand_gint32(guint64 iteration);
+gint32 df_rand_gint32(df_rand_t *rnd, guint64 iteration);
 
 /**
  * @return Generated pseudo-random 32-bit unsigned integer value
  */
-guint32 df_rand_guint32(guint64 iteration);
+guint32 df_rand_guint32(df_rand_t *rnd, guint64 iteration);
 
 /**
  * @return Generated pseudo-random 64-bit (long) integer value
  */
-gint64 df_rand_gint64(guint64 iteration);
+gint64 df_rand_gint64(df_rand_t *rnd, guint64 iteration);
 
 /**
  * @return Generated pseudo-random 64-bit (long) unsigned integer value
  */
-guint64 df_rand_guint64(guint64 iteration);
+guint64 df_rand_guint64(df_rand_t *rnd, guint64 iteration);
 
 /**
  * @return Generated pseudo-random double precision floating point number
  */
-gdouble df_rand_gdouble(guint64 iteration);
+gdouble df_rand_gdouble(df_rand_t *rnd, guint64 iteration);
+
+gunichar df_rand_unichar(df_rand_t *rnd, guint16 *width);
+
+/** Relative weights of 1, 2, 3 and 4 bytes wide characters in strings
+  * generated by df_rand_utf8() */
+typedef struct df_rand_utf8_mix {
+        guint8 weights[4];
+} df_rand_utf8_mix_t;
+
+/** All widths are equally likely (the same mix as df_rand_unichar() with
+  * width == 0) */
+#define DF_RAND_UTF8_MIX_UNIFORM ((const df_rand_utf8_mix_t) { { 1, 1, 1, 1 } })
 
-gunichar df_rand_unichar(guint16 *width);
+/**
+ * @function Fills buf with exactly size bytes of valid UTF-8 (without the
+ * trailing NUL byte) in bulk. Random bits are generated in blocks by four
+ * parallel xoshiro256** lanes seeded from rnd, using SIMD where the compiler
+ * supports vector extensions. Characters are distributed uniformly within
+ * each width and control characters (< 0x20) are skipped. To fit into the
+ * byte budget the last character is made narrower if it doesn't fit into
+ * the remaining space, regardless of the mix.
+ * @param rnd Generator context
+ * @param buf Buffer of at least size bytes
+ * @param size Exact number of bytes to generate
+ * @param mix Relative weights of the character widths
+ */
+void df_rand_utf8(df_rand_t *rnd, char *buf, size_t size, const df_rand_utf8_mix_t *mix);
 
-int df_rand_string(gchar **buf, guint64 iteration);
-int df_rand_dbus_objpath_string(gchar **buf, guint64 iteration);
-int df_rand_dbus_signature_string(gchar **buf, guint64 iteration);
-int df_rand_GVariant(GVariant **var, guint64 iteration);
+/**
+ * @function Generates a pseudo-random string (or picks one of the predefined
+ * ones). The returned string is read-only; it's either static, owned by the
+ * dictionary, or allocated from rnd->arena.
+ * @return 0 on success, -1 on error
+ */
+int df_rand_string(df_rand_t *rnd, const gchar **buf, guint64 iteration);
+/**
+ * @function Same as df_rand_string(), but the string is at most max_length
+ * bytes long (predefined strings which are longer are skipped)
+ * @param max_length Maximum length, 0 for df_fuzz_get_buffer_length()
+ */
+int df_rand_string_max(df_rand_t *rnd, const gchar **buf, guint64 iteration, size_t max_length);
+/**
+ * @function Picks a token for splicing into strings: an entry of the external
+ * dictionary if one is loaded, one of the predefined strings otherwise.
+ * @return Token with the same ownership as strings from df_rand_string()
+ */
+const char *df_rand_token(df_rand_t *rnd, guint64 iteration);
+/**
+ * @function Generates a pseudo-random object path; ownership of the result
+ * is the same as with df_rand_string()
+ * @return 0 on success, -1 on error
+ */
+int df_rand_dbus_objpath_string(df_rand_t *rnd, const gchar **buf, guint64 iteration);
+/**
+ * @function Same as df_rand_dbus_objpath_string(), but the object path is at
+ * most max_length bytes long
+ * @param max_length Maximum length, 0 for df_fuzz_get_buffer_length()
+ */
+int df_rand_dbus_objpath_string_max(df_rand_t *rnd, const gchar **buf, guint64 iteration, size_t max_length);
+int df_rand_dbus_signature_string(df_rand_t *rnd, gchar **buf, guint64 iteration);
+/**
+ * @function Same as df_rand_dbus_signature_string(), but the signature is at
+ * most max_length bytes long
+ * @param max_length Maximum length, 0 for MAX_SIGNATURE_LENGTH
+ */
+int df_rand_dbus_signature_string_max(df_rand_t *rnd, gchar **buf, guint64 iteration, size_t max_length);
+/**
+ * @function Generates a pseudo-random signature of a variant's content, i.e.
+ * the first half of df_rand_GVariant()
+ */
+int df_rand_GVariant_signature(df_rand_t *rnd, gchar **buf, guint64 iteration);
+/**
+ * @function Same as df_rand_GVariant_signature(), but the signature is at
+ * most max_length bytes long (at least 3 bytes, e.g. "(s)")
+ * @param max_length Maximum length, 0 for no limit
+ */
+int df_rand_GVariant_signature_max(df_rand_t *rnd, gchar **buf, guint64 iteration, size_t max_length);
+int df_rand_GVariant(df_rand_t *rnd, GVariant **var, guint64 iteration);
 
 /**
  * @return Generated pseudo-random FD number from interval <-1, INT_MAX)
  */
-int df_rand_unixFD(guint64 iteration);
+int df_rand_unixFD(df_rand_t *rnd, guint64 iteration);
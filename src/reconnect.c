@@ -0,0 +1,211 @@
+/** @file reconnect.c */
+#include <gio/gio.h>
+
+#include "reconnect.h"
+#include "bus.h"
+#include "log.h"
+#include "metrics.h"
+#include "monitor.h"
+#include "util.h"
+
+static GMutex df_reconnect_lock;
+/** Protected by the lock */
+static gint64 df_reconnect_waited_usec;
+
+/** Data of the NameOwnerChanged subscription */
+typedef struct df_reconnect_watch {
+        gboolean owner_appeared;
+} df_reconnect_watch_t;
+
+static void df_reconnect_account(gint64 start)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+        gint64 waited = g_get_monotonic_time() - start;
+
+        df_metrics_add_reconnect(waited);
+
+        locker = g_mutex_locker_new(&df_reconnect_lock);
+        df_reconnect_waited_usec += waited;
+}
+
+gint64 df_reconnect_get_waited_usec(void)
+{
+        g_autoptr(GMutexLocker) locker = NULL;
+
+        locker = g_mutex_locker_new(&df_reconnect_lock);
+        return df_reconnect_waited_usec;
+}
+
+static void df_reconnect_name_owner_changed(G_GNUC_UNUSED GDBusConnection *connection,
+                                            G_GNUC_UNUSED const gchar *sender_name,
+                                            G_GNUC_UNUSED const gchar *object_path,
+                                            G_GNUC_UNUSED const gchar *interface_name,
+                                            G_GNUC_UNUSED const gchar *signal_name,
+                                            GVariant *parameters, gpointer user_data)
+{
+        df_reconnect_watch_t *watch = user_data;
+        const gchar *new_owner;
+
+        if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sss)")))
+                return;
+
+        g_variant_get(parameters, "(&s&s&s)", NULL, NULL, &new_owner);
+        if (!isempty(new_owner))
+                watch->owner_appeared = TRUE;
+}
+
+static gboolean df_reconnect_timeout(gpointer user_data)
+{
+        gboolean *expired = user_data;
+
+        *expired = TRUE;
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Iterates the context until the owner appears or delay_msec passes */
+static void df_reconnect_wait(GMainContext *context, df_reconnect_watch_t *watch, guint delay_msec)
+{
+        g_autoptr(GSource) timeout = NULL;
+        gboolean expired = FALSE;
+
+        timeout = g_timeout_source_new(delay_msec);
+        g_source_set_callback(timeout, df_reconnect_timeout, &expired, NULL);
+        g_source_attach(timeout, context);
+
+        while (!expired && !watch->owner_appeared)
+                g_main_context_iteration(context, TRUE);
+
+        g_source_destroy(timeout);
+}
+
+static int df_reconnect_get_owner_pid(GDBusConnection *dcon, const char *name, gboolean activate)
+{
+        g_autoptr(GVariant) response = NULL;
+        g_autoptr(GError) error = NULL;
+        guint32 pid;
+
+        if (activate) {
+                g_autoptr(GVariant) act_res = NULL;
+
+                act_res = g_dbus_connection_call_sync(dcon, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                                      "org.freedesktop.DBus", "StartServiceByName",
+                                                      g_variant_new("(su)", name, 0), G_VARIANT_TYPE("(u)"),
+                                                      G_DBUS_CALL_FLAGS_NONE, df_bus_get_call_timeout(), NULL, &error);
+                if (!act_res)
+                        df_debug("Error while activating '%s': %s\n", name, error->message);
+                g_clear_error(&error);
+        }
+
+        response = g_dbus_connection_call_sync(dcon, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                               "org.freedesktop.DBus", "GetConnectionUnixProcessID",
+                                               g_variant_new("(s)", name), G_VARIANT_TYPE("(u)"),
+                                               G_DBUS_CALL_FLAGS_NONE, df_bus_get_call_timeout(), NULL, &error);
+        if (!response)
+                return -1;
+
+        g_variant_get(response, "(u)", &pid);
+
+        return (int) pid;
+}
+
+int df_reconnect_wait_for_owner(GDBusConnection *dcon, const char *name, gboolean activate)
+{
+        g_autoptr(GMainContext) context = NULL;
+        df_reconnect_watch_t watch = {};
+        guint delay_msec = DF_RECONNECT_BACKOFF_MIN_MSEC;
+        gint64 start, deadline;
+        guint subscription;
+        int pid = -1;
+
+        g_assert(dcon);
+        g_assert(name);
+
+        start = g_get_monotonic_time();
+        deadline = start + DF_RECONNECT_TIMEOUT_SEC * G_USEC_PER_SEC;
+
+        /* The signals are dispatched in this context, which is iterated only
+         * by us; subscribe before checking the owner, so we can't miss it */
+        context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+        subscription = g_dbus_connection_signal_subscribe(dcon, "org.freedesktop.DBus", "org.freedesktop.DBus",
+                                                          "NameOwnerChanged", "/org/freedesktop/DBus", name,
+                                                          G_DBUS_SIGNAL_FLAGS_NONE,
+                                                          df_reconnect_name_owner_changed, &watch, NULL);
+
+        for (;;) {
+                watch.owner_appeared = FALSE;
+
+                /* The crashed process may still own the name while it's
+                 * dumping a core, so wait for an owner which is alive */
+                pid = df_reconnect_get_owner_pid(dcon, name, activate);
+                if (pid > 0 && df_check_if_exited(pid) > 0)
+                        break;
+
+                if (g_get_monotonic_time() >= deadline) {
+                        df_fail("Error: '%s' didn't come back in %d seconds\n", name, DF_RECONNECT_TIMEOUT_SEC);
+                        pid = -1;
+                        break;
+                }
+
+                df_reconnect_wait(context, &watch, delay_msec);
+                if (watch.owner_appeared)
+                        /* Try right away and start the backoff from scratch
+                         * if it's not the final owner yet */
+                        delay_msec = DF_RECONNECT_BACKOFF_MIN_MSEC;
+                else
+                        delay_msec = MIN(delay_msec * 2, DF_RECONNECT_BACKOFF_MAX_MSEC);
+        }
+
+        /* Signals which arrived meanwhile are still queued in the context as
+         * idle sources; dispatch them (they're dropped after unsubscribing)
+         * before the watch goes out of scope */
+        g_dbus_connection_signal_unsubscribe(dcon, subscription);
+        while (g_main_context_iteration(context, FALSE))
+                ;
+        g_main_context_pop_thread_default(context);
+
+        df_reconnect_account(start);
+        df_verbose("Waited %.2f s for '%s' to come back\n",
+                   (g_get_monotonic_time() - start) / (double) G_USEC_PER_SEC, name);
+
+        return pid;
+}
+
+int df_reconnect_wait_for_reply(GDBusConnection *dcon, const char *name)
+{
+        guint timeout_msec = DF_RECONNECT_BACKOFF_MIN_MSEC;
+        gint64 start, deadline;
+        int r = -1;
+
+        g_assert(dcon);
+        g_assert(name);
+
+        start = g_get_monotonic_time();
+        deadline = start + DF_RECONNECT_TIMEOUT_SEC * G_USEC_PER_SEC;
+
+        while (g_get_monotonic_time() < deadline) {
+                g_autoptr(GVariant) response = NULL;
+                g_autoptr(GError) error = NULL;
+
+                response = g_dbus_connection_call_sync(dcon, name, "/", "org.freedesktop.DBus.Peer", "Ping",
+                                                       NULL, NULL, G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                                       timeout_msec, NULL, &error);
+                /* Any reply (including an error one) means the owner is
+                 * processing messages again */
+                if (response || !(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) ||
+                                  g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_TIMEOUT) ||
+                                  g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_NO_REPLY))) {
+                        r = 0;
+                        break;
+                }
+
+                timeout_msec = MIN(timeout_msec * 2, DF_RECONNECT_BACKOFF_MAX_MSEC);
+        }
+
+        df_reconnect_account(start);
+        if (r < 0)
+                df_fail("Error: '%s' didn't respond in %d seconds\n", name, DF_RECONNECT_TIMEOUT_SEC);
+
+        return r;
+}
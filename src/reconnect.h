@@ -0,0 +1,39 @@
+/** @file reconnect.h */
+#pragma once
+
+#include <gio/gio.h>
+
+/** First delay between two attempts to reach the tested process */
+#define DF_RECONNECT_BACKOFF_MIN_MSEC 50
+/** Upper bound of the (exponentially growing) delay between attempts */
+#define DF_RECONNECT_BACKOFF_MAX_MSEC 5000
+/** Give up if the tested process doesn't come back in this time */
+#define DF_RECONNECT_TIMEOUT_SEC 60
+
+/**
+ * @function Waits until the bus name gets a new (living) owner after the
+ * previous one died. The wait is cut short whenever NameOwnerChanged announces
+ * a new owner; only if no signal arrives the owner is polled with
+ * exponential backoff (from DF_RECONNECT_BACKOFF_MIN_MSEC up to
+ * DF_RECONNECT_BACKOFF_MAX_MSEC).
+ * @param dcon D-Bus connection structure
+ * @param name D-Bus name
+ * @param activate Activate the service if it's not running
+ * @return PID of the new owner on success, -1 on error or timeout
+ */
+int df_reconnect_wait_for_owner(GDBusConnection *dcon, const char *name, gboolean activate);
+
+/**
+ * @function Waits until the owner of the bus name responds again (after
+ * a call timed out), pinging it with exponentially growing timeouts.
+ * @param dcon D-Bus connection structure
+ * @param name D-Bus name
+ * @return 0 when the owner responded, -1 on timeout
+ */
+int df_reconnect_wait_for_reply(GDBusConnection *dcon, const char *name);
+
+/**
+ * @return Total time (in microseconds) spent waiting in both functions
+ * above, summed over all threads
+ */
+gint64 df_reconnect_get_waited_usec(void);
@@ -0,0 +1,252 @@
+/** @file replay.c */
+#include <gio/gio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+#include "binlog.h"
+#include "bus.h"
+#include "log.h"
+#include "monitor.h"
+#include "util.h"
+
+/** Filter applied while loading the records */
+typedef struct df_replay_filter {
+        const char *object;
+        const char *interface;
+        const char *method;
+        GPtrArray *records;
+} df_replay_filter_t;
+
+void df_replay_record_free(df_replay_record_t *record)
+{
+        if (!record)
+                return;
+
+        free(record->interface);
+        free(record->object);
+        free(record->method);
+        free(record->signature);
+        safe_g_variant_unref(record->value);
+        free(record);
+}
+
+static df_replay_record_t *df_replay_record_new(const char *interface, const char *object, const char *method,
+                                                const char *signature, GVariant *value, df_binlog_result_t result)
+{
+        g_autoptr(df_replay_record_t) record = NULL;
+
+        record = calloc(1, sizeof(*record));
+        if (!record)
+                return NULL;
+
+        record->interface = strdup(interface);
+        record->object = strdup(object);
+        record->method = strdup(method);
+        record->signature = strdup(signature);
+        if (!record->interface || !record->object || !record->method || !record->signature)
+                return NULL;
+
+        record->value = g_variant_ref_sink(value);
+        record->result = result;
+
+        return g_steal_pointer(&record);
+}
+
+static gboolean df_replay_filter_matches(const df_replay_filter_t *filter, const char *object,
+                                         const char *interface, const char *method)
+{
+        return (!filter->object || g_str_equal(filter->object, object)) &&
+               (!filter->interface || g_str_equal(filter->interface, interface)) &&
+               (!filter->method || g_str_equal(filter->method, method));
+}
+
+static int df_replay_add_call(const df_binlog_call_t *call, gpointer userdata)
+{
+        df_replay_filter_t *filter = userdata;
+        df_replay_record_t *record;
+
+        if (!df_replay_filter_matches(filter, call->object, call->interface, call->method))
+                return 0;
+
+        record = df_replay_record_new(call->interface, call->object, call->method, call->signature,
+                                      call->value, call->result);
+        if (!record)
+                return df_oom();
+
+        g_ptr_array_add(filter->records, record);
+
+        return 0;
+}
+
+df_replay_record_t *df_replay_parse_line(const char *line)
+{
+        g_autoptr(GVariant) value = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autoptr(char) copy = NULL;
+        char *fields[5], *p, *result;
+
+        copy = strdup(line);
+        if (!copy)
+                return NULL;
+
+        /* interface;object;method;signature;value;result - only the printed
+         * value can contain a ';' */
+        p = copy;
+        for (size_t i = 0; i < G_N_ELEMENTS(fields) - 1; i++) {
+                char *sep = strchr(p, ';');
+
+                if (!sep)
+                        return NULL;
+                *sep = 0;
+                fields[i] = p;
+                p = sep + 1;
+        }
+
+        result = strrchr(p, ';');
+        if (!result)
+                return NULL;
+        *result++ = 0;
+        fields[4] = p;
+        result[strcspn(result, "\n")] = 0;
+
+        if (df_binlog_result_from_string(result) == _DF_BINLOG_RESULT_MAX)
+                return NULL;
+        if (!g_variant_type_string_is_valid(fields[3]))
+                return NULL;
+
+        value = g_variant_parse(G_VARIANT_TYPE(fields[3]), fields[4], NULL, NULL, &error);
+        if (!value) {
+                df_debug("Failed to parse logged value of %s: %s\n", fields[2], error->message);
+                return NULL;
+        }
+
+        return df_replay_record_new(fields[0], fields[1], fields[2], fields[3], value,
+                                    df_binlog_result_from_string(result));
+}
+
+static int df_replay_load_text(const char *file_name, df_replay_filter_t *filter)
+{
+        g_autoptr(FILE) f = NULL;
+        g_autoptr(char) line = NULL;
+        size_t len = 0, skipped = 0;
+
+        f = fopen(file_name, "re");
+        if (!f)
+                return df_fail_ret(-1, "Failed to open file %s: %m\n", file_name);
+
+        while (getline(&line, &len, f) > 0) {
+                df_replay_record_t *record;
+
+                record = df_replay_parse_line(line);
+                if (!record) {
+                        skipped++;
+                        continue;
+                }
+
+                if (!df_replay_filter_matches(filter, record->object, record->interface, record->method)) {
+                        df_replay_record_free(record);
+                        continue;
+                }
+
+                g_ptr_array_add(filter->records, record);
+        }
+
+        if (skipped > 0)
+                df_verbose("Skipped %zu invalid line(s) of %s\n", skipped, file_name);
+
+        return 0;
+}
+
+GPtrArray *df_replay_load(const char *file_name, const char *object, const char *interface, const char *method)
+{
+        g_autoptr(GPtrArray) records = NULL;
+        df_replay_filter_t filter;
+        int r;
+
+        records = g_ptr_array_new_with_free_func((GDestroyNotify) df_replay_record_free);
+        filter = (df_replay_filter_t) {
+                .object = object,
+                .interface = interface,
+                .method = method,
+                .records = records,
+        };
+
+        r = df_binlog_probe(file_name);
+        if (r < 0)
+                return NULL;
+        if (r > 0)
+                r = df_binlog_read(file_name, df_replay_add_call, &filter);
+        else
+                r = df_replay_load_text(file_name, &filter);
+        if (r < 0)
+                return NULL;
+
+        return g_steal_pointer(&records);
+}
+
+int df_replay_stream(GDBusConnection *dcon, const char *name, int pid, GPtrArray *records, guint n,
+                     guint *ret_culprit)
+{
+        g_autoptr(df_monitor_t) monitor = NULL;
+        int r;
+
+        g_assert(n <= records->len);
+        g_assert(ret_culprit);
+
+        if (n == 0)
+                return 0;
+
+        monitor = df_monitor_new(pid);
+        if (!monitor)
+                return df_fail_ret(-1, "Failed to start monitoring process %d\n", pid);
+
+        for (guint i = 0; i < n; i++) {
+                const df_replay_record_t *record = g_ptr_array_index(records, i);
+                g_autoptr(GVariant) response = NULL;
+                g_autoptr(GError) error = NULL;
+
+                /* Don't let the bus start the process again behind our back */
+                response = g_dbus_connection_call_sync(dcon, name, record->object, record->interface,
+                                                       record->method, record->value, NULL,
+                                                       G_DBUS_CALL_FLAGS_NO_AUTO_START, df_bus_get_call_timeout(), NULL, &error);
+                if (!response)
+                        df_debug("  %s.%s: %s\n", record->interface, record->method, error->message);
+
+                /* A failed call may be the first sign of the process dying, so
+                 * don't rely on the (possibly lagging) monitor thread */
+                r = response ? df_monitor_is_alive(monitor) : df_monitor_check(monitor);
+                if (r < 0)
+                        return df_fail_ret(-1, "Error while reading process' stat file: %m\n");
+                if (r == 0) {
+                        *ret_culprit = i;
+                        return 1;
+                }
+        }
+
+        g_usleep(DF_REPLAY_SETTLE_MSEC * 1000);
+
+        r = df_monitor_check(monitor);
+        if (r < 0)
+                return df_fail_ret(-1, "Error while reading process' stat file: %m\n");
+        if (r == 0) {
+                *ret_culprit = n - 1;
+                return 1;
+        }
+
+        return 0;
+}
+
+void df_replay_print_record(const df_replay_record_t *record)
+{
+        g_autoptr(gchar) value_str = NULL;
+
+        value_str = g_variant_print(record->value, TRUE);
+
+        df_fail("   -- Object: %s\n", record->object);
+        df_fail("   -- Interface: %s\n", record->interface);
+        df_fail("   -- Method: %s\n", record->method);
+        df_fail("   -- Signature: %s\n", record->signature);
+        df_fail("   -- Value: %s\n", value_str);
+}
@@ -0,0 +1,62 @@
+/** @file replay.h */
+#pragma once
+
+#include <gio/gio.h>
+
+#include "binlog.h"
+
+/** Time to wait after the last replayed call before checking if the tested
+  * process survived, since it may die asynchronously */
+#define DF_REPLAY_SETTLE_MSEC 200
+
+/** A logged method call to be replayed */
+typedef struct df_replay_record {
+        char *interface;
+        char *object;
+        char *method;
+        char *signature;
+        GVariant *value;
+        df_binlog_result_t result;
+} df_replay_record_t;
+
+void df_replay_record_free(df_replay_record_t *record);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_replay_record_t, df_replay_record_free)
+
+/**
+ * @function Loads method calls from a log written via -L, either in the
+ * binary or the text format (detected automatically).
+ * @param file_name Log file
+ * @param object If not NULL, load only calls on this object path
+ * @param interface If not NULL, load only calls on this interface
+ * @param method If not NULL, load only calls of this method
+ * @return Array of df_replay_record_t (in the logged order), NULL on error
+ */
+GPtrArray *df_replay_load(const char *file_name, const char *object, const char *interface, const char *method);
+
+/**
+ * @function Parses a single line of the text log
+ * @return New record, NULL if the line isn't a valid record
+ */
+df_replay_record_t *df_replay_parse_line(const char *line);
+
+/**
+ * @function Sends the first n records to the tested process one by one, each
+ * after the reply to the previous one arrives, and checks if the process
+ * survives them.
+ * @param dcon D-Bus connection structure
+ * @param name D-Bus name
+ * @param pid PID of the tested process
+ * @param records Array of df_replay_record_t
+ * @param n Number of records to send
+ * @param ret_culprit Index of the record after which the process died (only
+ * set when 1 is returned)
+ * @return 1 if the process died, 0 if it survived, -1 on error
+ */
+int df_replay_stream(GDBusConnection *dcon, const char *name, int pid, GPtrArray *records, guint n,
+                     guint *ret_culprit);
+
+/**
+ * @function Prints the record (as a failure)
+ */
+void df_replay_print_record(const df_replay_record_t *record);
@@ -0,0 +1,177 @@
+/** @file schedule.c */
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schedule.h"
+#include "fuzz.h"
+#include "log.h"
+
+static void df_schedule_entry_free(df_schedule_entry_t *entry)
+{
+        if (!entry)
+                return;
+
+        free(entry->object);
+        free(entry->interface);
+        df_dbus_method_clear(&entry->method);
+        df_method_stats_clear(&entry->stats);
+        free(entry);
+}
+
+df_schedule_t *df_schedule_new(guint64 budget, guint64 time_budget, guint64 min_iterations, guint64 max_iterations)
+{
+        df_schedule_t *schedule;
+
+        g_assert(min_iterations <= max_iterations);
+
+        schedule = calloc(1, sizeof(*schedule));
+        if (!schedule)
+                return NULL;
+
+        schedule->entries = g_ptr_array_new_with_free_func((GDestroyNotify) df_schedule_entry_free);
+        schedule->min_iterations = min_iterations;
+        schedule->max_iterations = max_iterations;
+        schedule->budget = budget;
+        if (time_budget > 0)
+                schedule->deadline_usec = g_get_monotonic_time() + (gint64) time_budget * G_USEC_PER_SEC;
+
+        return schedule;
+}
+
+void df_schedule_free(df_schedule_t *schedule)
+{
+        if (!schedule)
+                return;
+
+        g_ptr_array_unref(schedule->entries);
+        free(schedule);
+}
+
+df_schedule_entry_t *df_schedule_add(df_schedule_t *schedule, const char *object, const char *interface,
+                                     df_dbus_method_t *method, gpointer target)
+{
+        df_schedule_entry_t *entry;
+
+        entry = calloc(1, sizeof(*entry));
+        if (!entry)
+                return NULL;
+
+        entry->object = strdup(object);
+        entry->interface = strdup(interface);
+        if (!entry->object || !entry->interface) {
+                df_schedule_entry_free(entry);
+                return NULL;
+        }
+
+        entry->method = *method;
+        memset(method, 0, sizeof(*method));
+        entry->target = target;
+        entry->weight = 1.0;
+        df_method_stats_init(&entry->stats);
+
+        g_ptr_array_add(schedule->entries, entry);
+
+        return entry;
+}
+
+df_schedule_entry_t *df_schedule_next(df_schedule_t *schedule, guint64 *ret_iterations)
+{
+        df_schedule_entry_t *next = NULL;
+        guint64 n;
+
+        g_assert(ret_iterations);
+
+        if (schedule->budget > 0 && schedule->used >= schedule->budget)
+                return NULL;
+        if (schedule->deadline_usec > 0 && g_get_monotonic_time() >= schedule->deadline_usec)
+                return NULL;
+
+        /* Stride scheduling: the methods with a higher weight advance their
+         * virtual time slower, so they are picked more often. On a tie the
+         * method added first wins, so all methods get their first slice in
+         * order. */
+        for (guint i = 0; i < schedule->entries->len; i++) {
+                df_schedule_entry_t *entry = g_ptr_array_index(schedule->entries, i);
+
+                if (entry->done)
+                        continue;
+                if (!next || entry->pass < next->pass)
+                        next = entry;
+        }
+
+        if (!next)
+                return NULL;
+
+        n = MIN(DF_SCHEDULE_SLICE, schedule->max_iterations - next->next);
+        if (schedule->budget > 0)
+                n = MIN(n, schedule->budget - schedule->used);
+
+        next->slice_start = next->stats;
+        next->slice = n;
+        *ret_iterations = n;
+
+        return next;
+}
+
+void df_schedule_update(df_schedule_t *schedule, df_schedule_entry_t *entry)
+{
+        const df_method_stats_t *start = &entry->slice_start;
+        guint64 calls, exceptions, found;
+        double cost;
+
+        calls = entry->stats.calls - start->calls;
+        exceptions = entry->stats.exceptions - start->exceptions;
+        found = (entry->stats.new_errors - start->new_errors) + (entry->stats.new_edges - start->new_edges);
+
+        schedule->used += calls;
+        entry->next += entry->slice;
+
+        /* Methods which keep rejecting inputs get (almost) nothing, the ones
+         * which keep finding new errors or code get a bonus */
+        entry->weight = DF_SCHEDULE_WEIGHT_MIN;
+        if (calls > 0)
+                entry->weight += 1.0 - (double) exceptions / calls;
+        entry->weight += MIN(found, DF_SCHEDULE_WEIGHT_BONUS);
+
+        if (found == 0 && exceptions * 100 >= calls * DF_SCHEDULE_SATURATION)
+                entry->saturated++;
+        else
+                entry->saturated = 0;
+
+        /* With a time budget charge the time spent in the method (in ms), so
+         * slow methods don't eat up the budget of the fast ones */
+        if (schedule->deadline_usec > 0)
+                cost = (entry->stats.latency_usec - start->latency_usec) / 1000.0;
+        else
+                cost = calls;
+        entry->pass += MAX(cost, 1.0) / entry->weight;
+
+        if (entry->stats.skipped || entry->stats.ended_early || calls < entry->slice ||
+            entry->next >= schedule->max_iterations)
+                /* Skipped, ended early (MAX_EXCEPTIONS or coverage plateau,
+                 * counted over all the slices) or simply finished */
+                entry->done = TRUE;
+        else if (entry->saturated >= DF_SCHEDULE_SATURATED_SLICES && entry->next >= schedule->min_iterations) {
+                df_debug("    Method %s saturated after %"G_GUINT64_FORMAT" iterations\n",
+                         entry->method.name, entry->next);
+                entry->done = TRUE;
+        }
+}
+
+void df_schedule_log_stats(const df_schedule_t *schedule)
+{
+        df_verbose("Scheduled %"G_GUINT64_FORMAT" call(s) in total\n", schedule->used);
+
+        for (guint i = 0; i < schedule->entries->len; i++) {
+                const df_schedule_entry_t *entry = g_ptr_array_index(schedule->entries, i);
+                const df_method_stats_t *stats = &entry->stats;
+
+                df_verbose("  %s %s.%s: %"G_GUINT64_FORMAT" call(s), %"G_GUINT64_FORMAT"%% exceptions, "
+                           "%u error name(s), %"G_GINT64_FORMAT" us average latency\n",
+                           entry->object, entry->interface, entry->method.name, stats->calls,
+                           stats->calls > 0 ? stats->exceptions * 100 / stats->calls : 0,
+                           g_hash_table_size(stats->error_names),
+                           stats->calls > 0 ? stats->latency_usec / (gint64) stats->calls : 0);
+        }
+}
@@ -0,0 +1,104 @@
+/** @file schedule.h */
+#pragma once
+
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fuzz.h"
+
+/** Number of iterations a method is tested for at once */
+#define DF_SCHEDULE_SLICE 16
+/** Exception rate (in percent) from which a slice without any new error
+  * names or coverage counts as saturated */
+#define DF_SCHEDULE_SATURATION 95
+/** Number of consecutive saturated slices after which a method is retired */
+#define DF_SCHEDULE_SATURATED_SLICES 2
+/** Weight of a method rejecting all inputs, so it still gets some time */
+#define DF_SCHEDULE_WEIGHT_MIN 0.05
+/** Maximum extra weight of a method for new error names/coverage */
+#define DF_SCHEDULE_WEIGHT_BONUS 4
+
+/** A method scheduled for testing */
+typedef struct df_schedule_entry {
+        char *object;
+        char *interface;
+        df_dbus_method_t method;
+        /** Caller's data shared by all methods of the interface, not owned */
+        gpointer target;
+        /** Next iteration to do */
+        guint64 next;
+        df_method_stats_t stats;
+        /** Counters at the start of the current slice (the error names
+          * aren't valid) and the number of iterations of the slice */
+        df_method_stats_t slice_start;
+        guint64 slice;
+        /** Weight based on the last slice; a method with twice the weight
+          * gets twice the calls (or time) */
+        double weight;
+        /** Virtual time; the active method with the lowest one goes next */
+        double pass;
+        /** Number of consecutive saturated slices */
+        guint saturated;
+        /** TRUE if the method shouldn't be tested anymore */
+        gboolean done;
+} df_schedule_entry_t;
+
+/** Scheduler distributing a global call/time budget among methods of all
+  * fuzzed interfaces, preferring methods which produce new error names or
+  * coverage and retiring the ones that only reject the inputs */
+typedef struct df_schedule {
+        /** Array of df_schedule_entry_t */
+        GPtrArray *entries;
+        guint64 min_iterations;
+        guint64 max_iterations;
+        /** Maximum number of calls in total, 0 for no limit */
+        guint64 budget;
+        /** Number of calls done so far */
+        guint64 used;
+        /** Monotonic time after which no new slice is started, 0 for no limit */
+        gint64 deadline_usec;
+} df_schedule_t;
+
+/**
+ * @function Creates a new scheduler; the time budget starts running now.
+ * @param budget Maximum number of calls in total, 0 for no limit
+ * @param time_budget Maximum time in seconds, 0 for no limit
+ * @param min_iterations Number of iterations done before a saturated method
+ * can be retired
+ * @param max_iterations Maximum number of iterations of each method
+ * @return New scheduler, NULL on error
+ */
+df_schedule_t *df_schedule_new(guint64 budget, guint64 time_budget, guint64 min_iterations, guint64 max_iterations);
+void df_schedule_free(df_schedule_t *schedule);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_schedule_t, df_schedule_free)
+
+/**
+ * @function Adds a method to the scheduler.
+ * @param method Method; its contents are moved into the new entry
+ * @param target Caller's data, see df_schedule_entry_t
+ * @return New entry (owned by the scheduler), NULL on error
+ */
+df_schedule_entry_t *df_schedule_add(df_schedule_t *schedule, const char *object, const char *interface,
+                                     df_dbus_method_t *method, gpointer target);
+
+/**
+ * @function Picks the method to be tested next and starts its slice.
+ * @param ret_iterations Number of iterations to do, starting with entry->next
+ * @return Entry to test, NULL if the budget is exhausted or all methods are
+ * done
+ */
+df_schedule_entry_t *df_schedule_next(df_schedule_t *schedule, guint64 *ret_iterations);
+
+/**
+ * @function Finishes the current slice of entry after its statistics were
+ * updated by df_fuzz_test_method(); recomputes the weight of the method and
+ * retires it if it's saturated, was skipped or ended early.
+ */
+void df_schedule_update(df_schedule_t *schedule, df_schedule_entry_t *entry);
+
+/**
+ * @function Prints statistics of all methods (in verbose mode)
+ */
+void df_schedule_log_stats(const df_schedule_t *schedule);
@@ -0,0 +1,456 @@
+/** @file stress.c */
+#include <gio/gio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stress.h"
+#include "arena.h"
+#include "bus.h"
+#include "log.h"
+#include "metrics.h"
+#include "monitor.h"
+#include "plan.h"
+#include "rand.h"
+#include "util.h"
+
+/** The controller checks the tested process this often */
+#define DF_STRESS_CHECK_MSEC 100
+/** A client never issues calls more than this late to catch up */
+#define DF_STRESS_MAX_LAG_USEC G_USEC_PER_SEC
+
+typedef struct df_stress df_stress_t;
+
+/** A client: its own connection, main context and thread. The counters are
+  * written only by the client and read by the controller. */
+typedef struct df_stress_client {
+        df_stress_t *stress;
+        GThread *thread;
+        GCancellable *cancellable;
+        guint pending;
+        gboolean failed;
+        /** Set once the client got all its calls back after stopping */
+        gint done;
+        df_stress_step_t steps[DF_STRESS_STEPS];
+} df_stress_client_t;
+
+/** State shared by the controller and all clients */
+struct df_stress {
+        const df_stress_config_t *config;
+        const char *name;
+        const char *object;
+        const char *interface;
+        const char *method;
+        df_plan_t *plan;
+        /** Timeout of the calls: --call-timeout=, or the length of a step */
+        gint timeout_msec;
+        /** Iteration of the next call over all clients, so the calls of the
+          * clients interleave */
+        guint64 next_iteration;
+        /** Current step, set by the controller */
+        gint step;
+        gint stop;
+        df_stress_client_t clients[];
+};
+
+static void df_stress_free(df_stress_t *stress)
+{
+        free(stress);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_stress_t, df_stress_free)
+
+typedef struct df_stress_call {
+        df_stress_client_t *client;
+        gint64 issued_usec;
+        /** Step the call was issued in */
+        guint step;
+} df_stress_call_t;
+
+guint64 df_stress_step_rate(guint64 rate, guint step)
+{
+        g_assert(step < DF_STRESS_STEPS);
+
+        return MAX(rate * (step + 1) / DF_STRESS_STEPS, rate > 0 ? 1 : 0);
+}
+
+int df_stress_find_saturation(const df_stress_step_t *steps, guint n_steps)
+{
+        for (guint i = 0; i < n_steps; i++)
+                if (steps[i].timeouts > 0)
+                        return i;
+
+        return -1;
+}
+
+static inline void df_stress_add(guint64 *counter, guint64 n)
+{
+        __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+static gboolean df_stress_is_timeout(GError *error)
+{
+        g_autoptr(gchar) dbus_error = NULL;
+
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
+                return TRUE;
+
+        dbus_error = g_dbus_error_get_remote_error(error);
+
+        return dbus_error && (g_str_equal(dbus_error, "org.freedesktop.DBus.Error.Timeout") ||
+                              g_str_equal(dbus_error, "org.freedesktop.DBus.Error.NoReply"));
+}
+
+static void df_stress_call_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+        df_stress_call_t *call = user_data;
+        g_autoptr(GVariant) response = NULL;
+        g_autoptr(GError) error = NULL;
+        df_stress_client_t *client = call->client;
+        df_stress_step_t *step, *issued;
+        gint64 usec;
+
+        response = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+        usec = g_get_monotonic_time() - call->issued_usec;
+        issued = &client->steps[call->step];
+        free(call);
+        client->pending--;
+
+        /* A call times out only a while after it was issued, so timeouts are
+         * accounted to the step which overloaded the target, i.e. the one
+         * the call was issued in; that includes the calls which were still
+         * unanswered when the run stopped */
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+                df_stress_add(&issued->timeouts, 1);
+                return;
+        }
+
+        /* Replies are accounted to the step they arrived in */
+        step = &client->steps[g_atomic_int_get(&client->stress->step)];
+        df_stress_add(&step->replies, 1);
+        df_stress_add(&step->latency_usec, usec);
+        if (error)
+                df_stress_add(df_stress_is_timeout(error) ? &issued->timeouts : &step->exceptions, 1);
+        df_metrics_add_call(error, usec);
+}
+
+static void df_stress_signal(G_GNUC_UNUSED GDBusConnection *dcon, G_GNUC_UNUSED const gchar *sender,
+                             G_GNUC_UNUSED const gchar *object, G_GNUC_UNUSED const gchar *interface,
+                             G_GNUC_UNUSED const gchar *signal, G_GNUC_UNUSED GVariant *parameters,
+                             G_GNUC_UNUSED gpointer user_data)
+{
+}
+
+/* Adds a match rule and removes it right away; the rules differ in arg0, so
+ * each of them really goes to the broker */
+static void df_stress_churn(GDBusConnection *dcon, df_stress_client_t *client, guint64 iteration, df_stress_step_t *step)
+{
+        char arg0[sizeof("dfuzzer-stress-") + DECIMAL_STR_MAX(guint64)];
+        guint id;
+
+        sprintf(arg0, "dfuzzer-stress-%"G_GUINT64_FORMAT, iteration);
+        id = g_dbus_connection_signal_subscribe(dcon, NULL, client->stress->interface, NULL,
+                                                client->stress->object, arg0, G_DBUS_SIGNAL_FLAGS_NONE,
+                                                df_stress_signal, NULL, NULL);
+        g_dbus_connection_signal_unsubscribe(dcon, id);
+        df_stress_add(&step->subscriptions, 1);
+}
+
+static int df_stress_issue(GDBusConnection *dcon, df_stress_client_t *client, df_rand_t *rnd, GByteArray *buffer)
+{
+        df_stress_t *stress = client->stress;
+        g_autoptr(GVariant) value = NULL;
+        df_stress_step_t *step;
+        df_stress_call_t *call;
+        guint64 iteration;
+
+        iteration = __atomic_fetch_add(&stress->next_iteration, 1, __ATOMIC_RELAXED);
+
+        df_rand_init(rnd, stress->config->seed + iteration);
+        value = df_plan_generate_with(stress->plan, stress->config->generator, rnd, iteration, buffer);
+        if (!value)
+                return df_debug_ret(-1, "Failed to generate a variant for method '%s'\n", stress->method);
+        value = g_variant_ref_sink(value);
+        df_arena_reset(rnd->arena);
+        df_metrics_add_bytes(g_variant_get_size(value));
+
+        call = calloc(1, sizeof(*call));
+        if (!call)
+                return df_oom();
+        call->client = client;
+        call->issued_usec = g_get_monotonic_time();
+        call->step = g_atomic_int_get(&stress->step);
+
+        /* Don't let the bus start the process again behind our back */
+        g_dbus_connection_call(dcon, stress->name, stress->object, stress->interface, stress->method,
+                               value, NULL, G_DBUS_CALL_FLAGS_NO_AUTO_START, stress->timeout_msec,
+                               client->cancellable, df_stress_call_done, call);
+        client->pending++;
+
+        step = &client->steps[call->step];
+        df_stress_add(&step->issued, 1);
+        if (stress->config->churn)
+                df_stress_churn(dcon, client, iteration, step);
+
+        return 0;
+}
+
+static int df_stress_client_loop(GDBusConnection *dcon, df_stress_client_t *client, GMainContext *context)
+{
+        const df_stress_config_t *config = client->stress->config;
+        g_autoptr(GByteArray) buffer = NULL;
+        g_autoptr(df_arena_t) arena = NULL;
+        gint64 next_usec = 0, interval_usec = 0, now;
+        df_rand_t rnd;
+        gint step = -1;
+
+        buffer = g_byte_array_new();
+        arena = df_arena_new();
+        if (!arena)
+                return df_oom();
+        rnd.arena = arena;
+
+        while (!g_atomic_int_get(&client->stress->stop)) {
+                /* Dispatch whatever replies arrived */
+                while (g_main_context_iteration(context, FALSE))
+                        ;
+
+                now = g_get_monotonic_time();
+                if (config->rate > 0 && step != g_atomic_int_get(&client->stress->step)) {
+                        step = g_atomic_int_get(&client->stress->step);
+                        interval_usec = G_USEC_PER_SEC * config->clients / df_stress_step_rate(config->rate, step);
+                        next_usec = now;
+                }
+
+                if (client->pending >= DF_STRESS_MAX_PENDING) {
+                        /* The target doesn't keep up, wait for a reply (or
+                         * for the cancellation when stopping) */
+                        g_main_context_iteration(context, TRUE);
+                        continue;
+                }
+
+                if (config->rate > 0 && now < next_usec) {
+                        g_usleep(MIN(next_usec - now, 1000));
+                        continue;
+                }
+
+                if (df_stress_issue(dcon, client, &rnd, buffer) < 0)
+                        return -1;
+
+                if (config->rate > 0)
+                        next_usec = MAX(next_usec + interval_usec, now - DF_STRESS_MAX_LAG_USEC);
+        }
+
+        return 0;
+}
+
+static gpointer df_stress_client_run(gpointer user_data)
+{
+        df_stress_client_t *client = user_data;
+        g_autoptr(GDBusConnection) dcon = NULL;
+        g_autoptr(GMainContext) context = NULL;
+
+        dcon = df_bus_new_private_connection(client->stress->config->bus_type);
+        if (!dcon) {
+                client->failed = TRUE;
+                g_atomic_int_set(&client->done, TRUE);
+                return NULL;
+        }
+
+        /* Replies and signals of this client are dispatched in this context */
+        context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+
+        if (df_stress_client_loop(dcon, client, context) < 0)
+                client->failed = TRUE;
+
+        /* Wait for the calls in flight: they either get a reply, time out, or
+         * get cancelled by the controller if they take even longer */
+        while (client->pending > 0)
+                g_main_context_iteration(context, TRUE);
+        g_atomic_int_set(&client->done, TRUE);
+
+        g_main_context_pop_thread_default(context);
+        (void) g_dbus_connection_close_sync(dcon, NULL, NULL);
+
+        return NULL;
+}
+
+static void df_stress_sum_step(const df_stress_t *stress, guint step, df_stress_step_t *ret)
+{
+        memset(ret, 0, sizeof(*ret));
+
+        for (guint i = 0; i < stress->config->clients; i++) {
+                const df_stress_step_t *s = &stress->clients[i].steps[step];
+
+                ret->issued += __atomic_load_n(&s->issued, __ATOMIC_RELAXED);
+                ret->replies += __atomic_load_n(&s->replies, __ATOMIC_RELAXED);
+                ret->timeouts += __atomic_load_n(&s->timeouts, __ATOMIC_RELAXED);
+                ret->exceptions += __atomic_load_n(&s->exceptions, __ATOMIC_RELAXED);
+                ret->latency_usec += __atomic_load_n(&s->latency_usec, __ATOMIC_RELAXED);
+                ret->subscriptions += __atomic_load_n(&s->subscriptions, __ATOMIC_RELAXED);
+        }
+}
+
+static void df_stress_print_step(const df_stress_config_t *config, guint step, const df_stress_step_t *s,
+                                 gint64 usec)
+{
+        char offered[DECIMAL_STR_MAX(guint64) + sizeof("/s")] = "unlimited";
+
+        if (config->rate > 0)
+                sprintf(offered, "%"G_GUINT64_FORMAT"/s", df_stress_step_rate(config->rate, step));
+
+        df_verbose("  [STRESS] step %u/%d: offered %s, achieved %.1f/s, %"G_GUINT64_FORMAT" timeout(s), "
+                   "%"G_GUINT64_FORMAT" exception(s), average latency %.1f ms",
+                   step + 1, DF_STRESS_STEPS, offered, s->replies * (double) G_USEC_PER_SEC / MAX(usec, 1),
+                   s->timeouts, s->exceptions, s->replies > 0 ? s->latency_usec / 1000.0 / s->replies : 0.0);
+        if (config->churn)
+                df_verbose(", %"G_GUINT64_FORMAT" match rule(s) churned", s->subscriptions);
+        df_verbose("\n");
+}
+
+int df_stress_run(const df_stress_config_t *config, const char *name, const char *object,
+                  const char *interface, const char *method, const char *signature, int pid)
+{
+        g_autoptr(df_plan_t) plan = NULL;
+        g_autoptr(df_monitor_t) monitor = NULL;
+        g_autoptr(df_stress_t) stress = NULL;
+        df_stress_step_t steps[DF_STRESS_STEPS] = {}, total = {};
+        gint64 step_usec, start_usec, deadline_usec, usec = 0, elapsed[DF_STRESS_STEPS] = {};
+        gboolean died = FALSE, failed = FALSE;
+        guint n_steps = 0;
+        int saturation, r;
+
+        g_assert(config);
+        g_assert(config->clients > 0 && config->clients <= DF_STRESS_MAX_CLIENTS);
+        g_assert(config->duration_sec > 0);
+
+        plan = df_fuzz_plan_new(signature, (const char *[]) { name, object, interface, method, signature, NULL });
+        if (!plan)
+                return df_debug_ret(-1, "Failed to compile signature '%s'\n", signature);
+
+        monitor = df_monitor_new(pid);
+        if (!monitor)
+                return df_fail_ret(-1, "Failed to start monitoring process %d\n", pid);
+
+        stress = calloc(1, sizeof(*stress) + config->clients * sizeof(df_stress_client_t));
+        if (!stress)
+                return df_oom();
+
+        stress->config = config;
+        stress->name = name;
+        stress->object = object;
+        stress->interface = interface;
+        stress->method = method;
+        stress->plan = plan;
+
+        /* Calls which don't get a reply within a step count as timeouts,
+         * unless told otherwise */
+        step_usec = config->duration_sec * G_USEC_PER_SEC / DF_STRESS_STEPS;
+        stress->timeout_msec = df_bus_get_call_timeout();
+        if (stress->timeout_msec < 0)
+                stress->timeout_msec = CLAMP(step_usec / 1000, 1, G_MAXINT);
+
+        fprintf(stderr, "%s%s[STRESS: %u client(s) calling %s.%s for %"G_GUINT64_FORMAT" s, ",
+                ansi_cr(), ansi_cyan(), config->clients, interface, method, config->duration_sec);
+        if (config->rate > 0)
+                fprintf(stderr, "ramping up to %"G_GUINT64_FORMAT" calls/s]%s\n", config->rate, ansi_normal());
+        else
+                fprintf(stderr, "as fast as possible]%s\n", ansi_normal());
+
+        for (guint i = 0; i < config->clients; i++) {
+                df_stress_client_t *client = &stress->clients[i];
+
+                client->stress = stress;
+                client->cancellable = g_cancellable_new();
+                client->thread = g_thread_new("dfuzzer-stress", df_stress_client_run, client);
+        }
+
+        start_usec = g_get_monotonic_time();
+        for (guint step = 0; step < DF_STRESS_STEPS && !died; step++) {
+                gint64 step_start_usec = g_get_monotonic_time();
+
+                g_atomic_int_set(&stress->step, step);
+                n_steps = step + 1;
+
+                while (g_get_monotonic_time() - step_start_usec < step_usec) {
+                        g_usleep(MIN(DF_STRESS_CHECK_MSEC * 1000, step_usec));
+
+                        r = df_monitor_is_alive(monitor);
+                        if (r < 0) {
+                                failed = TRUE;
+                                died = TRUE;
+                                df_fail("Error while reading process' stat file: %m\n");
+                                break;
+                        } else if (r == 0) {
+                                died = TRUE;
+                                break;
+                        }
+                }
+
+                elapsed[step] = g_get_monotonic_time() - step_start_usec;
+        }
+        usec = g_get_monotonic_time() - start_usec;
+
+        /* Give the calls in flight the call timeout to get a reply; the ones
+         * which don't are cancelled and counted as timeouts */
+        g_atomic_int_set(&stress->stop, TRUE);
+        deadline_usec = g_get_monotonic_time() + (gint64) stress->timeout_msec * 1000;
+        for (guint i = 0; i < config->clients; i++)
+                while (!g_atomic_int_get(&stress->clients[i].done) && g_get_monotonic_time() < deadline_usec)
+                        g_usleep(DF_STRESS_CHECK_MSEC * 1000);
+
+        for (guint i = 0; i < config->clients; i++) {
+                df_stress_client_t *client = &stress->clients[i];
+
+                g_cancellable_cancel(client->cancellable);
+                g_thread_join(client->thread);
+                g_object_unref(client->cancellable);
+                failed = failed || client->failed;
+        }
+
+        /* Late replies and timeouts count as well, so the steps are printed
+         * only once all the calls are back */
+        for (guint step = 0; step < n_steps; step++) {
+                df_stress_sum_step(stress, step, &steps[step]);
+                df_stress_print_step(config, step, &steps[step], elapsed[step]);
+                total.issued += steps[step].issued;
+                total.replies += steps[step].replies;
+                total.timeouts += steps[step].timeouts;
+                total.exceptions += steps[step].exceptions;
+                total.subscriptions += steps[step].subscriptions;
+        }
+
+        fprintf(stderr, "%s%s[STRESS: %"G_GUINT64_FORMAT" call(s), %"G_GUINT64_FORMAT" repl(ies) in %.1f s "
+                "(%.1f/s), %"G_GUINT64_FORMAT" timeout(s), %"G_GUINT64_FORMAT" exception(s)",
+                ansi_cr(), ansi_cyan(), total.issued, total.replies, usec / (double) G_USEC_PER_SEC,
+                total.replies * (double) G_USEC_PER_SEC / MAX(usec, 1), total.timeouts, total.exceptions);
+        if (config->churn)
+                fprintf(stderr, ", %"G_GUINT64_FORMAT" match rule(s) churned", total.subscriptions);
+        fprintf(stderr, "]%s\n", ansi_normal());
+
+        saturation = df_stress_find_saturation(steps, n_steps);
+        if (saturation < 0)
+                fprintf(stderr, "%s%s[STRESS: no timeouts]%s\n", ansi_cr(), ansi_cyan(), ansi_normal());
+        else if (config->rate > 0)
+                fprintf(stderr, "%s%s[STRESS: timeouts started in step %d, offered %"G_GUINT64_FORMAT"/s, "
+                        "achieved %.1f/s]%s\n", ansi_cr(), ansi_cyan(), saturation + 1,
+                        df_stress_step_rate(config->rate, saturation),
+                        steps[saturation].replies * (double) G_USEC_PER_SEC / MAX(elapsed[saturation], 1),
+                        ansi_normal());
+        else
+                fprintf(stderr, "%s%s[STRESS: timeouts started in step %d, achieved %.1f/s]%s\n",
+                        ansi_cr(), ansi_cyan(), saturation + 1,
+                        steps[saturation].replies * (double) G_USEC_PER_SEC / MAX(elapsed[saturation], 1),
+                        ansi_normal());
+
+        if (failed)
+                return -1;
+        if (died) {
+                df_fail("%s  %sFAIL%s [M] %s - process %d exited under stress in step %u\n",
+                        ansi_cr(), ansi_red(), ansi_normal(), method, pid, n_steps);
+                return 1;
+        }
+
+        return 0;
+}
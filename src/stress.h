@@ -0,0 +1,82 @@
+/** @file stress.h */
+#pragma once
+
+#include <gio/gio.h>
+
+#include "fuzz.h"
+
+/** The offered rate is ramped up in this many equally long steps */
+#define DF_STRESS_STEPS 10
+/** Maximum number of concurrent clients */
+#define DF_STRESS_MAX_CLIENTS 256
+/** Maximum number of calls each client keeps in flight; when the target
+  * can't keep up, the client stops issuing new calls until a reply arrives */
+#define DF_STRESS_MAX_PENDING 64
+/** Default duration of the whole run */
+#define DF_STRESS_DEFAULT_DURATION_SEC 10
+
+/** Configuration of the stress mode (--stress=) */
+typedef struct df_stress_config {
+        GBusType bus_type;
+        /** Number of clients, each with its own connection and thread */
+        guint clients;
+        /** Peak offered rate in calls per second over all clients, 0 for no
+          * limit (each client then keeps DF_STRESS_MAX_PENDING calls in flight) */
+        guint64 rate;
+        guint64 duration_sec;
+        /** Subscribe to and unsubscribe from a signal after each call, so the
+          * broker has to add and remove a match rule */
+        gboolean churn;
+        df_plan_backend_t generator;
+        /** Seed of the method, the input of iteration i is seeded by seed + i */
+        guint64 seed;
+} df_stress_config_t;
+
+/** Counters of a single step, over all clients */
+typedef struct df_stress_step {
+        guint64 issued;
+        guint64 replies;
+        /** Calls issued in the step which timed out, got no reply or were
+          * still unanswered a call timeout after the run stopped */
+        guint64 timeouts;
+        /** Calls which got an error reply */
+        guint64 exceptions;
+        /** Total latency of all replies */
+        guint64 latency_usec;
+        /** Signal subscriptions added and removed */
+        guint64 subscriptions;
+} df_stress_step_t;
+
+/**
+ * @function Returns the rate offered in the step
+ * @param rate Peak rate, 0 for no limit
+ * @param step Step number, starting at 0
+ * @return Calls per second over all clients, 0 for no limit
+ */
+guint64 df_stress_step_rate(guint64 rate, guint step);
+
+/**
+ * @function Finds the step the target started timing out in
+ * @return Index of the first step with any timeouts (of the calls issued in
+ * it), -1 if there were none
+ */
+int df_stress_find_saturation(const df_stress_step_t *steps, guint n_steps);
+
+/**
+ * @function Calls the method from config->clients connections at once, with
+ * the offered rate ramped up in DF_STRESS_STEPS steps, and reports the
+ * achieved rate of each step and the step the target started timing out in.
+ * Unless a call timeout was set (see df_bus_set_call_timeout()), the calls
+ * time out after the length of a step.
+ * @param config Configuration of the run
+ * @param name D-Bus name
+ * @param object D-Bus object path
+ * @param interface D-Bus interface
+ * @param method Name of the method
+ * @param signature Signature of the method arguments (including the
+ * surrounding parentheses)
+ * @param pid PID of the tested process
+ * @return 0 if the process survived, 1 if it died, -1 on error
+ */
+int df_stress_run(const df_stress_config_t *config, const char *name, const char *object,
+                  const char *interface, const char *method, const char *signature, int pid);
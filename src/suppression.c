@@ -1,6 +1,9 @@
+#include <errno.h>
 #include <glib.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "suppression.h"
 #include "log.h"
@@ -14,6 +17,8 @@
 #define SUPPRESSION_FILE_SYSTEM "/etc/dfuzzer.conf"
 
 typedef struct suppression_item {
+        /** Position in the suppression file */
+        guint index;
         char *object;
         char *interface;
         char *method;
@@ -35,183 +40,276 @@ static void suppression_item_free(gpointer data)
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(suppression_item_t, suppression_item_free)
 
-void df_suppression_free(GList **suppressions)
+df_suppression_index_t *df_suppression_index_new(void)
 {
-        g_list_free_full(*suppressions, suppression_item_free);
-        *suppressions = NULL;
+        df_suppression_index_t *index;
+
+        index = calloc(1, sizeof(*index));
+        if (!index)
+                return NULL;
+
+        index->services = g_hash_table_new_full(g_str_hash, g_str_equal, free,
+                                                (GDestroyNotify) g_hash_table_unref);
+
+        return index;
 }
 
-int df_suppression_load(GList **suppressions, const char *service_name)
+void df_suppression_index_free(df_suppression_index_t *index)
 {
-        g_autoptr(FILE) f = NULL;
-        g_autoptr(char) line = NULL, home_supp = NULL;
-        char *env = NULL;
-        int name_found = 0;
-        size_t len = 0;
-        ssize_t n;
+        if (!index)
+                return;
 
-        g_assert(service_name);
-        g_assert(suppressions);
+        g_hash_table_unref(index->services);
+        free(index);
+}
 
-        env = getenv("HOME");
-        if (env) {
-                home_supp = strjoin(env, "/", SUPPRESSION_FILE_HOME);
-                if (!home_supp)
-                        return df_oom();
+/* Parse a single suppression line:
+ *      [object_path]:[interface_name]:method_name [description]
+ * where everything except 'method_name' is optional; omitted parts are
+ * stored as empty strings */
+static int df_suppression_parse_item(const char *line, suppression_item_t **ret_item)
+{
+        g_autoptr(char) suppression = NULL, description = NULL;
+        g_autoptr(suppression_item_t) item = NULL;
+        char *p;
+
+        /* The suppression description is optional, so let's accept such
+         * lines as well */
+        if (sscanf(line, "%ms %m[^\n]", &suppression, &description) < 1)
+                return df_fail_ret(-1, "Failed to parse line '%s'\n", line);
+
+        item = calloc(1, sizeof(*item));
+        if (!item)
+                return df_oom();
+
+        /* Extract method name */
+        p = strrchr(suppression, ':');
+        if (!p)
+                item->method = g_steal_pointer(&suppression);
+        else {
+                item->method = strdup(p + 1);
+                *p = 0;
         }
 
-        char *paths[3] = { SUPPRESSION_FILE_CWD, home_supp, SUPPRESSION_FILE_SYSTEM };
+        if (!item->method)
+                return df_oom();
 
-        for (size_t i = 0; i < G_N_ELEMENTS(paths); i++) {
-                if (!paths[i])
-                        continue;
-
-                f = fopen(paths[i], "r");
-                if (f) {
-                        df_verbose("Loading suppressions from file '%s'\n", paths[i]);
-                        break;
+        /* Extract interface name */
+        if (p) {
+                p = strrchr(suppression, ':');
+                if (!p)
+                        item->interface = strdup(suppression);
+                else {
+                        item->interface = strdup(p + 1);
+                        *p = 0;
                 }
+        } else
+                item->interface = strdup("");
 
-                df_verbose("Cannot open suppression file '%s'\n", paths[i]);
-        }
+        if (!item->interface)
+                return df_oom();
 
-        if (!f) {
-                df_fail("Cannot open any pre-defined suppression file\n");
-                return -1;
-        }
+        /* Extract object name */
+        if (p) {
+                p = strrchr(suppression, ':');
+                if (!p)
+                        item->object = strdup(suppression);
+                else
+                        /* Found another ':'? Bail out! */
+                        return df_fail_ret(-1, "Invalid suppression string '%s'\n", line);
+        } else
+                item->object = strdup("");
 
-        // determines if currently tested bus name is in suppression file
-        while (getline(&line, &len, f) > 0) {
-                if (strstr(line, service_name)) {
-                        name_found++;
-                        break;
-                }
-        }
+        if (!item->object)
+                return df_oom();
 
-        if (ferror(f)) {
-                df_fail("Error while reading from the suppression file: %m\n");
-                return -1;
-        }
+        item->description = g_steal_pointer(&description);
+        *ret_item = g_steal_pointer(&item);
 
-        // no suppressions for tested bus name
-        if (!name_found)
-                return 0;
+        return 0;
+}
+
+static char *df_suppression_key(const char *object, const char *interface, const char *method)
+{
+        return strjoin(object, "\n", interface, "\n", method);
+}
+
+int df_suppression_load_file(df_suppression_index_t *index, const char *path)
+{
+        g_autoptr(FILE) f = NULL;
+        g_autoptr(char) line = NULL;
+        GHashTable *section = NULL;
+        size_t len = 0;
+        ssize_t n;
+
+        g_assert(index);
+        g_assert(path);
 
-        df_verbose("Found suppressions for bus: '%s'\n", service_name);
+        f = fopen(path, "r");
+        if (!f)
+                return df_fail_ret(-errno, "Cannot open suppression file '%s': %m\n", path);
 
         while ((n = getline(&line, &len, f)) > 0) {
-                g_autoptr(char) suppression = NULL, description = NULL;
                 g_autoptr(suppression_item_t) item = NULL;
-                char *p;
+                char *key;
 
-                if (line[0] == '[')
-                        break;
+                /* Drop the newline character for nicer error messages */
+                if (line[n - 1] == '\n')
+                        line[--n] = 0;
 
                 /* The line contains only whitespace, skip it */
-                if (strspn(line, " \t\r\n") == (size_t) n)
+                if (strspn(line, " \t\r") == (size_t) n)
                         continue;
 
-                /* Drop the newline character for nices error messages */
-                if (line[n - 1] == '\n')
-                        line[n - 1] = 0;
+                if (line[0] == '[') {
+                        g_autoptr(char) name = NULL;
+                        char *end = strchr(line, ']');
 
-                /* The suppression description is optional, so let's accept such
-                 * lines as well */
-                if (sscanf(line, "%ms %m[^\n]", &suppression, &description) < 1)
-                        return df_fail_ret(-1, "Failed to parse line '%s'\n", line);
+                        if (!end)
+                                return df_fail_ret(-1, "Invalid section header '%s'\n", line);
 
-                item = calloc(1, sizeof(*item));
-                if (!item)
-                        return df_oom();
+                        name = strndup(line + 1, end - line - 1);
+                        if (!name)
+                                return df_oom();
 
-                /* Break down the suppression string, which should be in format:
-                 *      [object_path]:[interface_name]:method_name
-                 * where everything except 'method_name' is optional
-                 */
+                        /* Sections of the same bus name are merged */
+                        section = g_hash_table_lookup(index->services, name);
+                        if (!section) {
+                                section = g_hash_table_new_full(g_str_hash, g_str_equal, free, suppression_item_free);
+                                g_hash_table_insert(index->services, g_steal_pointer(&name), section);
+                        }
 
-                /* Extract method name */
-                p = strrchr(suppression, ':');
-                if (!p)
-                        item->method = g_steal_pointer(&suppression);
-                else {
-                        item->method = strdup(p + 1);
-                        *p = 0;
+                        continue;
                 }
 
-                if (!item->method)
-                        return df_oom();
+                /* Lines before the first section don't belong to any bus name */
+                if (!section)
+                        continue;
 
-                /* Extract interface name */
-                if (p) {
-                        p = strrchr(suppression, ':');
-                        if (!p)
-                                item->interface = strdup(suppression);
-                        else {
-                                item->interface = strdup(p + 1);
-                                *p = 0;
-                        }
+                if (df_suppression_parse_item(line, &item) < 0)
+                        return -1;
 
-                        if (!item->interface)
-                                return df_oom();
-                }
+                df_debug("Loaded suppression for method: %s:%s:%s (%s)\n",
+                         isempty(item->object) ? "*" : item->object,
+                         isempty(item->interface) ? "*" : item->interface,
+                         isempty(item->method) ? "*" : item->method,
+                         item->description ?: "n/a");
 
-                /* Extract object name */
-                if (p) {
-                        p = strrchr(suppression, ':');
-                        if (!p)
-                                item->object = strdup(suppression);
-                        else
-                                /* Found another ':'? Bail out! */
-                                return df_fail_ret(-1, "Invalid suppression string '%s'\n", line);
+                key = df_suppression_key(item->object, item->interface, item->method);
+                if (!key)
+                        return df_oom();
 
-                        if (!item->object)
-                                return df_oom();
+                /* Duplicates don't change anything, since the first matching
+                 * suppression wins */
+                if (g_hash_table_contains(section, key)) {
+                        free(key);
+                        continue;
                 }
 
-                item->description = g_steal_pointer(&description);
-                df_verbose("Loaded suppression for method: %s:%s:%s (%s)\n",
-                           isempty(item->object) ? "*" : item->object,
-                           isempty(item->interface) ? "*" : item->interface,
-                           item->method,
-                           item->description ?: "n/a");
-
-                *suppressions = g_list_append(*suppressions, g_steal_pointer(&item));
-        }
-
-        if (ferror(f)) {
-                df_fail("Error while reading from the suppression file: %m\n");
-                return -1;
+                item->index = index->n_items++;
+                g_hash_table_insert(section, key, g_steal_pointer(&item));
         }
 
-        df_verbose("Loaded %d suppression(s)\n", g_list_length(*suppressions));
+        if (ferror(f))
+                return df_fail_ret(-1, "Error while reading from the suppression file: %m\n");
 
         return 0;
 }
 
-int df_suppression_check(GList *suppressions, const char *object, const char *interface,
-                         const char *method, char **ret_description_ptr)
+int df_suppression_load(df_suppression_index_t **ret_index)
 {
-        g_assert(ret_description_ptr);
+        g_autoptr(df_suppression_index_t) index = NULL;
+        g_autoptr(char) home_supp = NULL;
+        char *env = NULL;
 
-        for (GList *i = suppressions; i; i = i->next) {
-                suppression_item_t *item = i->data;
+        g_assert(ret_index);
 
-                g_assert(item);
+        env = getenv("HOME");
+        if (env) {
+                home_supp = strjoin(env, "/", SUPPRESSION_FILE_HOME);
+                if (!home_supp)
+                        return df_oom();
+        }
 
-                /* If the method name is set but doesn't match, continue */
-                if (!isempty(method) && !isempty(item->method) && !g_str_equal(method, item->method))
-                        continue;
-                /* If the interface name is set but doesn't match, continue */
-                if (!isempty(interface) && !isempty(item->interface) && !g_str_equal(interface, item->interface))
+        char *paths[3] = { SUPPRESSION_FILE_CWD, home_supp, SUPPRESSION_FILE_SYSTEM };
+
+        index = df_suppression_index_new();
+        if (!index)
+                return df_oom();
+
+        for (size_t i = 0; i < G_N_ELEMENTS(paths); i++) {
+                if (!paths[i])
                         continue;
-                /* If the object name is set but doesn't match, continue */
-                if (!isempty(object) && !isempty(item->object) && !g_str_equal(object, item->object))
+
+                if (access(paths[i], R_OK) < 0) {
+                        df_verbose("Cannot open suppression file '%s'\n", paths[i]);
                         continue;
-                /* Everything that should match matches, so the method is suppressed */
-                *ret_description_ptr = item->description;
-                return 1;
+                }
+
+                df_verbose("Loading suppressions from file '%s'\n", paths[i]);
+                if (df_suppression_load_file(index, paths[i]) < 0)
+                        return -1;
+
+                df_verbose("Loaded %u suppression(s) for %u bus name(s)\n",
+                           index->n_items, g_hash_table_size(index->services));
+                *ret_index = g_steal_pointer(&index);
+
+                return 0;
         }
 
-        return 0;
+        df_fail("Cannot open any pre-defined suppression file\n");
+
+        return -1;
 }
 
+guint df_suppression_count(const df_suppression_index_t *index, const char *service)
+{
+        GHashTable *section;
+
+        if (!index)
+                return 0;
+
+        section = g_hash_table_lookup(index->services, service);
+
+        return section ? g_hash_table_size(section) : 0;
+}
+
+int df_suppression_check(const df_suppression_index_t *index, const char *service, const char *object,
+                         const char *interface, const char *method, const char **ret_description_ptr)
+{
+        suppression_item_t *match = NULL;
+        GHashTable *section;
+
+        g_assert(service);
+        g_assert(object);
+        g_assert(interface);
+        g_assert(method);
+        g_assert(ret_description_ptr);
+
+        if (!index)
+                return 0;
+
+        section = g_hash_table_lookup(index->services, service);
+        if (!section)
+                return 0;
+
+        /* Try all combinations of the exact and wildcard (empty) parts */
+        for (guint mask = 0; mask < 8; mask++) {
+                suppression_item_t *item;
+                const char *key;
+
+                key = strjoina(mask & 1 ? "" : object, "\n",
+                               mask & 2 ? "" : interface, "\n",
+                               mask & 4 ? "" : method);
+                item = g_hash_table_lookup(section, key);
+                if (item && (!match || item->index < match->index))
+                        match = item;
+        }
+
+        if (!match)
+                return 0;
+
+        *ret_description_ptr = match->description;
+
+        return 1;
+}
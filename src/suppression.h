@@ -1,6 +1,53 @@
 #pragma once
 
-void df_suppression_free(GList **suppressions);
-int df_suppression_load(GList **suppressions, const char *service_name);
-int df_suppression_check(GList *suppressions, const char *object, const char *interface,
-                         const char *method, char **ret_description_ptr);
+#include <gio/gio.h>
+
+/** Index of the suppressions of all bus names from a suppression file
+  *
+  * Suppressions of each bus name are hashed on their object path, interface
+  * and method name, where an omitted part is stored as an empty string and
+  * acts as a wildcard, so checking a method takes a constant number of
+  * lookups no matter how many suppressions there are. The index is not
+  * modified after it's loaded, so it can be shared by threads and by
+  * multiple tested bus names.
+  */
+typedef struct df_suppression_index {
+        /** Bus name -> GHashTable of "object\ninterface\nmethod" -> item */
+        GHashTable *services;
+        /** Total number of suppressions, also used to keep their order */
+        guint n_items;
+} df_suppression_index_t;
+
+df_suppression_index_t *df_suppression_index_new(void);
+void df_suppression_index_free(df_suppression_index_t *index);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(df_suppression_index_t, df_suppression_index_free)
+
+/**
+ * @function Loads all sections of the first suppression file found in the
+ * standard locations (./dfuzzer.conf, ~/.dfuzzer.conf, /etc/dfuzzer.conf)
+ * @param ret_index Where the new index is stored on success
+ * @return 0 on success, negative value on error
+ */
+int df_suppression_load(df_suppression_index_t **ret_index);
+/**
+ * @function Loads all sections of the given suppression file into index
+ * @return 0 on success, negative value on error
+ */
+int df_suppression_load_file(df_suppression_index_t *index, const char *path);
+
+/**
+ * @return Number of suppressions loaded for the bus name
+ */
+guint df_suppression_count(const df_suppression_index_t *index, const char *service);
+
+/**
+ * @function Checks if the method is suppressed; if multiple suppressions
+ * match, the first one from the file is used
+ * @param index Suppression index, NULL means no suppressions
+ * @param ret_description_ptr Where the (borrowed) description of the matching
+ * suppression is stored, NULL if it has none
+ * @return 1 if the method is suppressed, 0 otherwise
+ */
+int df_suppression_check(const df_suppression_index_t *index, const char *service, const char *object,
+                         const char *interface, const char *method, const char **ret_description_ptr);
@@ -0,0 +1,251 @@
+/* Microbenchmarks of the pseudo-random value generators
+ *
+ * Times each generator in isolation (no bus is needed) over buckets of
+ * iterations, since the size of the generated values grows with the
+ * iteration, and prints one JSON object per generator and bucket, e.g.:
+ *   {"generator": "df_rand_string", "iterations": "100-999", "ns_per_op": 812.4, "allocs_per_op": 0.00}
+ *
+ * Usage: bench-rand [--seed=SEED] [--ops=N]
+ */
+#include <getopt.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rand.h"
+#include "util.h"
+
+/* Count heap allocations by interposing the allocator; GLib allocates via
+ * malloc() as well, so this covers g_malloc(), g_new() & co. too */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static guint64 bench_allocs;
+
+void *malloc(size_t size)
+{
+        bench_allocs++;
+        return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+        bench_allocs++;
+        return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+        bench_allocs++;
+        return __libc_realloc(ptr, size);
+}
+#define BENCH_COUNTS_ALLOCS 1
+#else
+static const guint64 bench_allocs = 0;
+#define BENCH_COUNTS_ALLOCS 0
+#endif
+
+#define BENCH_DEFAULT_OPS 20000
+
+typedef struct bench_bucket {
+        guint64 first;
+        guint64 last;
+} bench_bucket_t;
+
+/* Iterations are bucketed by order of magnitude, the first ones mostly pick
+ * the predefined values */
+static const bench_bucket_t bench_buckets[] = {
+        { 0, 9 },
+        { 10, 99 },
+        { 100, 999 },
+        { 1000, 9999 },
+};
+
+/* Signatures for df_generate_random_from_signature(), roughly what the
+ * fuzzed methods take */
+static const char *bench_signatures[] = {
+        "s",
+        "(iusv)",
+        "a{sv}",
+        "aay",
+};
+
+static df_rand_t rnd;
+
+typedef int (*bench_func_t)(guint64 iteration, const void *userdata);
+
+static int bench_generate_random_from_signature(guint64 iteration, const void *userdata)
+{
+        g_autoptr(GVariant) variant = NULL;
+
+        variant = df_generate_random_from_signature(&rnd, userdata, iteration);
+        if (!variant)
+                return -1;
+
+        g_variant_ref_sink(variant);
+
+        return 0;
+}
+
+static int bench_rand_string(guint64 iteration, const void *userdata)
+{
+        const gchar *str;
+
+        return df_rand_string(&rnd, &str, iteration);
+}
+
+static int bench_rand_dbus_objpath_string(guint64 iteration, const void *userdata)
+{
+        const gchar *str;
+
+        return df_rand_dbus_objpath_string(&rnd, &str, iteration);
+}
+
+static int bench_rand_dbus_signature_string(guint64 iteration, const void *userdata)
+{
+        g_autoptr(gchar) str = NULL;
+
+        return df_rand_dbus_signature_string(&rnd, &str, iteration);
+}
+
+static int bench_rand_GVariant(guint64 iteration, const void *userdata)
+{
+        g_autoptr(GVariant) variant = NULL;
+
+        if (df_rand_GVariant(&rnd, &variant, iteration) < 0)
+                return -1;
+
+        g_variant_ref_sink(variant);
+
+        return 0;
+}
+
+static guint64 bench_now_nsec(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (guint64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @function Runs func ops times, cycling through the iterations of the bucket;
+ * the generator is reseeded (and the arena reset) before each op the same way
+ * as the fuzzing loop does it, which is included in the measured time.
+ * @return 0 on success, -1 on error
+ */
+static int bench_run(const char *name, const char *signature, bench_func_t func, const void *userdata,
+                     const bench_bucket_t *bucket, guint64 seed, guint64 ops)
+{
+        guint64 span = bucket->last - bucket->first + 1;
+        guint64 start, elapsed, allocs;
+
+        /* Warm up, so the arena's chunks and GLib's internal caches are already
+         * there */
+        for (guint64 i = 0; i < MIN(ops, span); i++) {
+                df_rand_init(&rnd, seed + i);
+                if (func(bucket->first + i, userdata) < 0)
+                        return -1;
+                df_arena_reset(rnd.arena);
+        }
+
+        allocs = bench_allocs;
+        start = bench_now_nsec();
+
+        for (guint64 i = 0; i < ops; i++) {
+                df_rand_init(&rnd, seed + i);
+                if (func(bucket->first + (i % span), userdata) < 0)
+                        return -1;
+                df_arena_reset(rnd.arena);
+        }
+
+        elapsed = bench_now_nsec() - start;
+        allocs = bench_allocs - allocs;
+
+        printf("{\"generator\": \"%s\"", name);
+        if (signature)
+                printf(", \"signature\": \"%s\"", signature);
+        printf(", \"iterations\": \"%"G_GUINT64_FORMAT"-%"G_GUINT64_FORMAT"\", \"ns_per_op\": %.1f",
+               bucket->first, bucket->last, (double) elapsed / ops);
+        if (BENCH_COUNTS_ALLOCS)
+                printf(", \"allocs_per_op\": %.2f", (double) allocs / ops);
+        printf("}\n");
+
+        return 0;
+}
+
+int main(int argc, char *argv[])
+{
+        static const struct option options[] = {
+                { "seed",   required_argument,  NULL,   's' },
+                { "ops",    required_argument,  NULL,   'n' },
+                { NULL,     0,                  NULL,   0   },
+        };
+        guint64 seed = 1;
+        guint64 ops = BENCH_DEFAULT_OPS;
+        int c;
+        static const struct {
+                const char *name;
+                bench_func_t func;
+        } funcs[] = {
+                { "df_rand_string",                bench_rand_string },
+                { "df_rand_dbus_objpath_string",   bench_rand_dbus_objpath_string },
+                { "df_rand_dbus_signature_string", bench_rand_dbus_signature_string },
+                { "df_rand_GVariant",              bench_rand_GVariant },
+        };
+
+        while ((c = getopt_long(argc, argv, "", options, NULL)) >= 0) {
+                switch (c) {
+                case 's':
+                        if (safe_strtoull(optarg, &seed) < 0) {
+                                fprintf(stderr, "Invalid seed: %s\n", optarg);
+                                return 1;
+                        }
+                        break;
+                case 'n':
+                        if (safe_strtoull(optarg, &ops) < 0 || ops == 0) {
+                                fprintf(stderr, "Invalid number of operations: %s\n", optarg);
+                                return 1;
+                        }
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [--seed=SEED] [--ops=N]\n", argv[0]);
+                        return 1;
+                }
+        }
+
+        rnd.arena = df_arena_new();
+        if (!rnd.arena) {
+                fprintf(stderr, "Could not allocate the arena\n");
+                return 1;
+        }
+
+        for (size_t b = 0; b < G_N_ELEMENTS(bench_buckets); b++) {
+                for (size_t i = 0; i < G_N_ELEMENTS(bench_signatures); i++)
+                        if (bench_run("df_generate_random_from_signature", bench_signatures[i],
+                                      bench_generate_random_from_signature, bench_signatures[i],
+                                      &bench_buckets[b], seed, ops) < 0)
+                                goto fail;
+
+                for (size_t i = 0; i < G_N_ELEMENTS(funcs); i++)
+                        if (bench_run(funcs[i].name, NULL, funcs[i].func, NULL,
+                                      &bench_buckets[b], seed, ops) < 0)
+                                goto fail;
+        }
+
+        df_arena_free(rnd.arena);
+
+        return 0;
+
+fail:
+        fprintf(stderr, "Generator failed\n");
+        df_arena_free(rnd.arena);
+
+        return 1;
+}
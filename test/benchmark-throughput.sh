@@ -0,0 +1,54 @@
+#!/bin/bash
+# Measures throughput of dfuzzer against dfuzzer-test-server running on
+# a private session bus. Prints one JSON object per workload, e.g.:
+#   {"workload": "s", "calls_per_sec": 12345, "bytes_per_sec": 678901, "peak_rss_kb": 9876}
+#
+# Usage: benchmark-throughput.sh DFUZZER DFUZZER_TEST_SERVER [ITERATIONS]
+
+set -eu
+set -o pipefail
+
+if [[ $# -lt 2 ]]; then
+        echo "Usage: $0 DFUZZER DFUZZER_TEST_SERVER [ITERATIONS]" >&2
+        exit 1
+fi
+
+dfuzzer="$1"
+server="$2"
+iterations="${3:-20000}"
+
+# Re-execute ourselves on a private session bus
+if [[ "${DFUZZER_BENCHMARK_BUS:-}" != 1 ]]; then
+        exec env DFUZZER_BENCHMARK_BUS=1 dbus-run-session -- "$0" "$@"
+fi
+
+# Don't touch (or activate anything on) the system bus
+export DBUS_SYSTEM_BUS_ADDRESS="unix:path=/nonexistent/dfuzzer-benchmark"
+
+"$server" --session >/dev/null &
+server_pid=$!
+trap 'kill "$server_pid"; wait "$server_pid" || :' EXIT
+
+for _ in {1..100}; do
+        if gdbus call --session --dest org.freedesktop.DBus --object-path /org/freedesktop/DBus \
+                      --method org.freedesktop.DBus.NameHasOwner org.freedesktop.dfuzzerServer | grep -q true; then
+                break
+        fi
+        sleep 0.1
+done
+
+for workload in s asv aay v; do
+        out="$("$dfuzzer" --seed=1 -I "$iterations" -s \
+                          -n org.freedesktop.dfuzzerServer \
+                          -o /org/freedesktop/dfuzzerObject \
+                          -i org.freedesktop.dfuzzerInterface \
+                          -t "df_bench_$workload" 2>&1 | sed 's/\x1b\[[0-9;]*m//g')"
+        if [[ ! "$out" =~ \[THROUGHPUT:\ ([0-9]+)\ calls/s,\ ([0-9]+)\ B/s\ generated,\ peak\ RSS\ ([0-9]+)\ kB\] ]]; then
+                echo "$out" >&2
+                echo "Failed to run the '$workload' workload" >&2
+                exit 1
+        fi
+
+        printf '{"workload": "%s", "calls_per_sec": %s, "bytes_per_sec": %s, "peak_rss_kb": %s}\n' \
+               "$workload" "${BASH_REMATCH[1]}" "${BASH_REMATCH[2]}" "${BASH_REMATCH[3]}"
+done
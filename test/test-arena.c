@@ -0,0 +1,67 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+
+static void test_df_arena_alloc(void)
+{
+        g_autoptr(df_arena_t) arena = NULL;
+        guint8 *a, *b;
+
+        arena = df_arena_new();
+        g_assert_nonnull(arena);
+        g_assert_cmpuint(df_arena_get_used(arena), ==, 0);
+
+        /* Allocations are 8-aligned and don't overlap */
+        a = df_arena_alloc(arena, 3);
+        b = df_arena_alloc(arena, 16);
+        g_assert_nonnull(a);
+        g_assert_nonnull(b);
+        g_assert_cmpuint((guintptr) a % 8, ==, 0);
+        g_assert_cmpuint((guintptr) b % 8, ==, 0);
+        g_assert_true(b >= a + 3);
+        memset(a, 'a', 3);
+        memset(b, 'b', 16);
+        g_assert_cmpint(a[2], ==, 'a');
+        g_assert_cmpuint(df_arena_get_used(arena), ==, 8 + 16);
+
+        /* Memory is reused after a reset */
+        df_arena_reset(arena);
+        g_assert_cmpuint(df_arena_get_used(arena), ==, 0);
+        g_assert_true(df_arena_alloc(arena, 3) == (void *) a);
+}
+
+static void test_df_arena_coalesce(void)
+{
+        g_autoptr(df_arena_t) arena = NULL;
+        guint8 *p;
+
+        arena = df_arena_new();
+        g_assert_nonnull(arena);
+
+        /* Allocations larger than a chunk, spread over multiple chunks */
+        for (guint i = 0; i < 4; i++) {
+                p = df_arena_alloc(arena, DF_ARENA_CHUNK_SIZE + 1);
+                g_assert_nonnull(p);
+                memset(p, 0xff, DF_ARENA_CHUNK_SIZE + 1);
+        }
+
+        /* After a reset all of them should fit into a single chunk */
+        df_arena_reset(arena);
+        p = df_arena_alloc(arena, DF_ARENA_CHUNK_SIZE);
+        g_assert_nonnull(p);
+        for (guint i = 1; i < 4; i++)
+                g_assert_true(df_arena_alloc(arena, DF_ARENA_CHUNK_SIZE) == p + i * DF_ARENA_CHUNK_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_arena/df_arena_alloc", test_df_arena_alloc);
+        g_test_add_func("/df_arena/df_arena_coalesce", test_df_arena_coalesce);
+
+        return g_test_run();
+}
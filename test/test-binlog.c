@@ -0,0 +1,68 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "binlog.h"
+#include "log.h"
+#include "util.h"
+
+static void test_df_binlog(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) v1 = NULL, v2 = NULL;
+        g_autoptr(gchar) path = NULL, text = NULL, expected = NULL, p1 = NULL, p2 = NULL;
+        g_autoptr(FILE) out = NULL;
+        char *out_buf = NULL;
+        size_t out_size = 0;
+        int fd;
+
+        fd = g_file_open_tmp("test-binlog-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        v1 = g_variant_ref_sink(g_variant_new("(sa{sv}u)", "a;string", NULL, 42));
+        v2 = g_variant_ref_sink(g_variant_new("(ayo)", NULL, "/org/test"));
+        p1 = g_variant_print(v1, TRUE);
+        p2 = g_variant_print(v2, TRUE);
+
+        g_assert_cmpint(df_log_open_log_file(path), ==, 0);
+        g_assert_cmpint(df_binlog_start(1234), ==, 0);
+        g_assert_true(df_binlog_is_enabled());
+        df_binlog_write_call(DF_BINLOG_SUCCESS, "org.test.If", "/", "Foo", "(sa{sv}u)", 1, 0, v1);
+        df_binlog_write_call(DF_BINLOG_SUCCESS, "org.test.If", "/", "Foo", "(sa{sv}u)", 1, 1, v1);
+        df_binlog_write_call(DF_BINLOG_CRASH, "org.test.If", "/obj", "Bar", "(ayo)", 2, 7, v2);
+        /* Text records don't end up in the binary log */
+        df_log_file("garbage");
+        g_assert_cmpint(df_log_flush(), ==, 0);
+
+        out = open_memstream(&out_buf, &out_size);
+        g_assert_nonnull(out);
+        g_assert_cmpint(df_binlog_decode(path, out), ==, 0);
+        g_assert_cmpint(fflush(out), ==, 0);
+
+        expected = g_strdup_printf("org.test.If;/;Foo;(sa{sv}u);%1$s;Success\n"
+                                   "org.test.If;/;Foo;(sa{sv}u);%1$s;Success\n"
+                                   "org.test.If;/obj;Bar;(ayo);%2$s;Crash\n",
+                                   p1, p2);
+        g_assert_cmpstr(out_buf, ==, expected);
+
+        /* Text isn't a binary log */
+        g_assert_true(g_file_set_contents(path, "org.test.If;/;Foo;(s);('');Success\n", -1, &error));
+        g_assert_no_error(error);
+        g_assert_cmpint(df_binlog_decode(path, out), <, 0);
+
+        out = safe_fclose(out);
+        free(out_buf);
+        (void) unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_binlog/df_binlog", test_df_binlog);
+
+        return g_test_run();
+}
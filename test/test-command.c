@@ -0,0 +1,81 @@
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "command.h"
+#include "util.h"
+
+static void test_df_command_run(void)
+{
+        g_autoptr(df_command_t) c = NULL;
+
+        c = df_command_new("exit 3", FALSE, 1, FALSE);
+        g_assert_nonnull(c);
+        g_assert_cmpint(c->pid, ==, 0);
+        g_assert_cmpint(df_command_run(c, "/", "a.b", "c", 0), ==, 3);
+}
+
+static void test_df_command_coprocess(void)
+{
+        g_autoptr(df_command_t) c = NULL;
+
+        /* Fails after the second iteration of /org/x a.b Fail */
+        c = df_command_new("while read -r o i m n; do "
+                           "  if [ \"$o $i $m $n\" = '/org/x a.b Fail 2' ]; then echo 5; else echo 0; fi; "
+                           "done", FALSE, 1, TRUE);
+        g_assert_nonnull(c);
+        g_assert_cmpint(c->pid, >, 0);
+
+        g_assert_cmpint(df_command_run(c, "/org/x", "a.b", "Fail", 1), ==, 0);
+        g_assert_cmpint(df_command_run(c, "/org/x", "a.b", "Fail", 2), ==, 5);
+        g_assert_cmpint(df_command_run(c, "/org/x", "a.b", "Other", 2), ==, 0);
+}
+
+static void test_df_command_coprocess_invalid(void)
+{
+        static const char *commands[] = {
+                /* Exits after the first check */
+                "read -r line; echo 0",
+                "while read -r line; do echo nope; done",
+                "while read -r line; do echo -1; done",
+        };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(commands); i++) {
+                g_autoptr(df_command_t) c = NULL;
+
+                c = df_command_new(commands[i], FALSE, 1, TRUE);
+                g_assert_nonnull(c);
+                /* The first one fails on the second check only */
+                if (i == 0)
+                        g_assert_cmpint(df_command_run(c, "/", "a.b", "c", 0), ==, 0);
+                g_assert_cmpint(df_command_run(c, "/", "a.b", "c", 1), <, 0);
+        }
+}
+
+static void test_df_command_is_due(void)
+{
+        g_autoptr(df_command_t) every = NULL, batch = NULL, end = NULL;
+
+        every = df_command_new("true", FALSE, 1, FALSE);
+        batch = df_command_new("true", FALSE, 3, FALSE);
+        end = df_command_new("true", FALSE, 0, FALSE);
+        g_assert_nonnull(every);
+        g_assert_nonnull(batch);
+        g_assert_nonnull(end);
+
+        g_assert_true(df_command_is_due(every, 1));
+        g_assert_false(df_command_is_due(batch, 2));
+        g_assert_true(df_command_is_due(batch, 3));
+        g_assert_false(df_command_is_due(end, 1000));
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_command/df_command_run", test_df_command_run);
+        g_test_add_func("/df_command/df_command_coprocess", test_df_command_coprocess);
+        g_test_add_func("/df_command/df_command_coprocess_invalid", test_df_command_coprocess_invalid);
+        g_test_add_func("/df_command/df_command_is_due", test_df_command_is_due);
+
+        return g_test_run();
+}
@@ -0,0 +1,65 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "coverage.h"
+
+#define TEST_MAP_SIZE 256
+
+static void test_df_coverage_collect(void)
+{
+        g_autoptr(df_coverage_t) coverage = NULL;
+        /* The map is read a word at a time */
+        guint64 words[TEST_MAP_SIZE / sizeof(guint64)] = {};
+        guint8 *map = (guint8 *) words;
+
+        /* Hits before the reader was created don't count */
+        map[7] = 3;
+        coverage = df_coverage_new_from_map(map, TEST_MAP_SIZE);
+        g_assert_nonnull(coverage);
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 0);
+
+        /* New edges */
+        map[7]++;
+        map[100]++;
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 2);
+        g_assert_cmpuint(coverage->n_edges, ==, 2);
+
+        /* The same edges with the same number of hits are not new */
+        map[7]++;
+        map[100]++;
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 0);
+
+        /* ...but a new hit-count class is */
+        map[7] += 2;
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 1);
+        g_assert_cmpuint(coverage->n_edges, ==, 2);
+        /* 3 hits fall into a different class than 2 hits */
+        map[7] += 3;
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 1);
+        /* 5 and 6 hits are in the same class (4 - 7) */
+        map[7] += 5;
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 1);
+        map[7] += 6;
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 0);
+
+        /* Counters wrap around */
+        map[255] = 250;
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 1);
+        map[255] += 10;
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 1);
+        g_assert_cmpuint(coverage->n_edges, ==, 3);
+
+        /* No changes, no new coverage */
+        g_assert_cmpuint(df_coverage_collect(coverage), ==, 0);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_coverage/df_coverage_collect", test_df_coverage_collect);
+
+        return g_test_run();
+}
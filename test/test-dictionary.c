@@ -0,0 +1,114 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dictionary.h"
+#include "util.h"
+
+static gchar *write_dictionary(const char *contents, gsize size)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        int fd;
+
+        fd = g_file_open_tmp("test-dictionary-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        g_assert_true(g_file_set_contents(path, contents, size, &error));
+        g_assert_no_error(error);
+
+        return g_steal_pointer(&path);
+}
+
+static void test_df_dictionary_get(void)
+{
+        static const char contents[] = "first\n\nthird line\nlast";
+        g_autoptr(df_dictionary_t) d = NULL;
+        g_autoptr(gchar) path = NULL, file_contents = NULL;
+        gsize size;
+
+        path = write_dictionary(contents, strlen(contents));
+        d = df_dictionary_new(path);
+        g_assert_nonnull(d);
+        g_assert_false(df_dictionary_is_empty(d));
+
+        /* Nothing is indexed until asked for */
+        g_assert_cmpuint(d->offsets->len, ==, 0);
+        g_assert_cmpstr(df_dictionary_get(d, 0), ==, "first");
+        g_assert_cmpuint(d->offsets->len, ==, 1);
+
+        /* Skipping ahead indexes everything in between */
+        g_assert_cmpstr(df_dictionary_get(d, 2), ==, "third line");
+        g_assert_cmpuint(d->offsets->len, ==, 3);
+        g_assert_cmpstr(df_dictionary_get(d, 1), ==, "");
+        /* The last line doesn't need a newline */
+        g_assert_cmpstr(df_dictionary_get(d, 3), ==, "last");
+        g_assert_null(df_dictionary_get(d, 4));
+        g_assert_null(df_dictionary_get(d, G_MAXUINT64));
+
+        /* The mapping is private, the file itself stays untouched */
+        g_assert_true(g_file_get_contents(path, &file_contents, &size, NULL));
+        g_assert_cmpmem(file_contents, size, contents, strlen(contents));
+
+        g_assert_cmpint(unlink(path), ==, 0);
+}
+
+static void test_df_dictionary_get_bytes(void)
+{
+        g_autoptr(df_dictionary_t) d = NULL;
+        g_autoptr(GBytes) bytes = NULL;
+        g_autoptr(GVariant) variant = NULL;
+        g_autoptr(gchar) path = NULL;
+        const char *str;
+
+        path = write_dictionary("Leeroy Jenkins\ntail", strlen("Leeroy Jenkins\ntail"));
+        d = df_dictionary_new(path);
+        g_assert_nonnull(d);
+
+        /* Entries are wrapped in place, including the NUL byte */
+        str = df_dictionary_get(d, 0);
+        bytes = df_dictionary_get_bytes(d, str);
+        g_assert_nonnull(bytes);
+        g_assert_true(g_bytes_get_data(bytes, NULL) == (gconstpointer) str);
+        g_assert_cmpuint(g_bytes_get_size(bytes), ==, strlen("Leeroy Jenkins") + 1);
+
+        variant = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE_STRING, bytes, FALSE));
+        g_assert_cmpstr(g_variant_get_string(variant, NULL), ==, "Leeroy Jenkins");
+
+        /* The unterminated last line is a copy, as well as strings not coming
+         * from the dictionary at all */
+        g_assert_null(df_dictionary_get_bytes(d, df_dictionary_get(d, 1)));
+        g_assert_null(df_dictionary_get_bytes(d, "Leeroy Jenkins"));
+        g_assert_null(df_dictionary_get_bytes(d, NULL));
+
+        g_assert_cmpint(unlink(path), ==, 0);
+}
+
+static void test_df_dictionary_empty(void)
+{
+        g_autoptr(df_dictionary_t) d = NULL;
+        g_autoptr(gchar) path = NULL;
+
+        path = write_dictionary("", 0);
+        d = df_dictionary_new(path);
+        g_assert_nonnull(d);
+        g_assert_true(df_dictionary_is_empty(d));
+        g_assert_null(df_dictionary_get(d, 0));
+
+        g_assert_cmpint(unlink(path), ==, 0);
+
+        g_assert_null(df_dictionary_new("/nonexistent/dfuzzer/dictionary"));
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_dictionary/df_dictionary_get", test_df_dictionary_get);
+        g_test_add_func("/df_dictionary/df_dictionary_get_bytes", test_df_dictionary_get_bytes);
+        g_test_add_func("/df_dictionary/df_dictionary_empty", test_df_dictionary_empty);
+
+        return g_test_run();
+}
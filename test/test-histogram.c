@@ -0,0 +1,72 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "histogram.h"
+
+static void test_df_histogram_percentile(void)
+{
+        df_histogram_t h = {0,}, other = {0,};
+
+        g_assert_cmpuint(df_histogram_percentile(&h, 50), ==, 0);
+
+        /* Small values are exact */
+        for (guint64 i = 1; i <= 8; i++)
+                df_histogram_add(&h, i - 1);
+        g_assert_cmpuint(h.count, ==, 8);
+        g_assert_cmpuint(df_histogram_percentile(&h, 0), ==, 0);
+        g_assert_cmpuint(df_histogram_percentile(&h, 50), ==, 3);
+        g_assert_cmpuint(df_histogram_percentile(&h, 100), ==, 7);
+
+        /* Bigger ones are within 12.5 % */
+        df_histogram_reset(&h);
+        for (guint64 i = 1; i <= 1000; i++)
+                df_histogram_add(&h, i * 1000);
+        g_assert_cmpuint(h.max, ==, 1000000);
+        g_assert_cmpuint(df_histogram_percentile(&h, 50), >=, 500000);
+        g_assert_cmpuint(df_histogram_percentile(&h, 50), <=, 500000 * 9 / 8);
+        g_assert_cmpuint(df_histogram_percentile(&h, 99), >=, 990000);
+        g_assert_cmpuint(df_histogram_percentile(&h, 99), <=, 1000000);
+        /* Never more than the maximum */
+        g_assert_cmpuint(df_histogram_percentile(&h, 100), ==, 1000000);
+
+        /* Huge values end up in the last bucket */
+        df_histogram_add(&other, G_MAXUINT64);
+        g_assert_cmpuint(df_histogram_percentile(&other, 50), ==, G_MAXUINT64);
+
+        df_histogram_merge(&h, &other);
+        g_assert_cmpuint(h.count, ==, 1001);
+        g_assert_cmpuint(h.max, ==, G_MAXUINT64);
+        g_assert_cmpuint(df_histogram_percentile(&h, 50), <=, 500000 * 9 / 8);
+        g_assert_cmpuint(df_histogram_percentile(&h, 100), ==, G_MAXUINT64);
+}
+
+static void test_df_histogram_buckets(void)
+{
+        df_histogram_t h;
+
+        /* Each value must land in a bucket whose upper bound is not below
+         * the value itself and is within the precision */
+        for (guint64 v = 0; v < (1 << 20); v += 7) {
+                guint64 p;
+
+                df_histogram_reset(&h);
+                df_histogram_add(&h, v);
+                /* Make the maximum irrelevant */
+                h.max = G_MAXUINT64;
+                p = df_histogram_percentile(&h, 50);
+                g_assert_cmpuint(p, >=, v);
+                g_assert_cmpuint(p, <=, v + v / DF_HISTOGRAM_SUB_BUCKETS);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_histogram/df_histogram_percentile", test_df_histogram_percentile);
+        g_test_add_func("/df_histogram/df_histogram_buckets", test_df_histogram_buckets);
+
+        return g_test_run();
+}
@@ -0,0 +1,121 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "introspection.h"
+#include "util.h"
+
+static void write_cache(const char *path, const char *name, const char *object, const char *xml)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) cache = NULL;
+        GVariantBuilder builder;
+
+        g_variant_builder_init(&builder, G_VARIANT_TYPE("a{ss}"));
+        g_variant_builder_add(&builder, "{ss}", object, xml);
+        cache = g_variant_ref_sink(g_variant_new(DF_INTROSPECTION_CACHE_TYPE, name, &builder));
+        if (G_BYTE_ORDER != G_LITTLE_ENDIAN) {
+                GVariant *swapped = g_variant_byteswap(cache);
+
+                g_variant_unref(cache);
+                cache = swapped;
+        }
+
+        g_assert_true(g_file_set_contents(path, g_variant_get_data(cache), g_variant_get_size(cache), &error));
+        g_assert_no_error(error);
+}
+
+static void test_df_introspection_cache(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) cache = NULL, objects = NULL;
+        g_autoptr(gchar) path = NULL, contents = NULL, name = NULL, xml = NULL;
+        const char *missing = "/nonexistent/dfuzzer/test.introspection";
+        gsize size;
+        int fd;
+
+        fd = g_file_open_tmp("test-introspection-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        /* Missing cache is not an error, it's just the first run */
+        df_introspection_cache_clear();
+        g_assert_cmpint(df_introspection_cache_load(missing, "org.test"), ==, 0);
+
+        /* Cache of the other bus name is not used */
+        write_cache(path, "org.other", "/", "<node/>");
+        g_assert_cmpint(df_introspection_cache_load(path, "org.test"), <, 0);
+
+        /* Load data of two different names, save just one of them */
+        g_assert_cmpint(df_introspection_cache_load(path, "org.other"), ==, 0);
+        write_cache(path, "org.test", "/org/test", "<node><node name='child'/></node>");
+        g_assert_cmpint(df_introspection_cache_load(path, "org.test"), ==, 0);
+        g_assert_cmpint(unlink(path), ==, 0);
+        g_assert_cmpint(df_introspection_cache_save(path, "org.test"), ==, 0);
+
+        g_assert_true(g_file_get_contents(path, &contents, &size, &error));
+        g_assert_no_error(error);
+        cache = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE(DF_INTROSPECTION_CACHE_TYPE),
+                                                           contents, size, FALSE, NULL, NULL));
+        if (G_BYTE_ORDER != G_LITTLE_ENDIAN) {
+                GVariant *swapped = g_variant_byteswap(cache);
+
+                g_variant_unref(cache);
+                cache = swapped;
+        }
+
+        g_variant_get(cache, "(s@a{ss})", &name, &objects);
+        g_assert_cmpstr(name, ==, "org.test");
+        g_assert_cmpuint(g_variant_n_children(objects), ==, 1);
+        g_assert_true(g_variant_lookup(objects, "/org/test", "s", &xml));
+        g_assert_cmpstr(xml, ==, "<node><node name='child'/></node>");
+
+        /* Nothing is left after clearing the cache */
+        df_introspection_cache_clear();
+        g_assert_cmpint(df_introspection_cache_save(path, "org.test"), ==, 0);
+        g_clear_pointer(&cache, g_variant_unref);
+        g_clear_pointer(&objects, g_variant_unref);
+        g_clear_pointer(&name, g_free);
+        g_clear_pointer(&contents, g_free);
+        g_assert_true(g_file_get_contents(path, &contents, &size, &error));
+        g_assert_no_error(error);
+        cache = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE(DF_INTROSPECTION_CACHE_TYPE),
+                                                           contents, size, FALSE, NULL, NULL));
+        g_variant_get(cache, "(s@a{ss})", &name, &objects);
+        g_assert_cmpuint(g_variant_n_children(objects), ==, 0);
+
+        (void) unlink(path);
+}
+
+static void test_df_interface_has_readable_properties(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GDBusNodeInfo) node = NULL;
+
+        node = g_dbus_node_info_new_for_xml(
+                        "<node>"
+                        "<interface name='org.test.None'><method name='Foo'/></interface>"
+                        "<interface name='org.test.WriteOnly'><property name='A' type='s' access='write'/></interface>"
+                        "<interface name='org.test.Readable'>"
+                        "<property name='A' type='s' access='write'/>"
+                        "<property name='B' type='u' access='readwrite'/>"
+                        "</interface>"
+                        "</node>", &error);
+        g_assert_no_error(error);
+
+        g_assert_false(df_interface_has_readable_properties(g_dbus_node_info_lookup_interface(node, "org.test.None")));
+        g_assert_false(df_interface_has_readable_properties(g_dbus_node_info_lookup_interface(node, "org.test.WriteOnly")));
+        g_assert_true(df_interface_has_readable_properties(g_dbus_node_info_lookup_interface(node, "org.test.Readable")));
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_introspection/df_introspection_cache", test_df_introspection_cache);
+        g_test_add_func("/df_introspection/df_interface_has_readable_properties",
+                        test_df_interface_has_readable_properties);
+
+        return g_test_run();
+}
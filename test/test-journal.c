@@ -0,0 +1,132 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "journal.h"
+#include "util.h"
+
+static gchar *journal_path(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        int fd;
+
+        fd = g_file_open_tmp("test-journal-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        return g_steal_pointer(&path);
+}
+
+static void test_df_journal_resume(void)
+{
+        g_autoptr(df_journal_t) j = NULL;
+        g_autoptr(gchar) path = NULL;
+        int result = -1;
+
+        path = journal_path();
+
+        j = df_journal_open(path, FALSE);
+        g_assert_nonnull(j);
+        g_assert_false(j->have_seed);
+        g_assert_cmpint(df_journal_set_seed(j, 1234), ==, 0);
+        /* The first seed stays */
+        g_assert_cmpint(df_journal_set_seed(j, 5678), ==, 0);
+        g_assert_cmpint(df_journal_append(j, DF_JOURNAL_METHOD, 4, 100, 2000, "/org/x", "a.b", "Foo"), ==, 0);
+        g_assert_cmpint(df_journal_append(j, DF_JOURNAL_PROPERTY, 0, 10, 0, "/org/x", "a.b", "Bar"), ==, 0);
+        g_assert_cmpint(df_journal_append(j, DF_JOURNAL_INTERFACE, 2, 0, 0, "/org/x", "a.b", NULL), ==, 0);
+        /* Nothing is looked up in the journal being written */
+        g_assert_false(df_journal_lookup(j, DF_JOURNAL_METHOD, "/org/x", "a.b", "Foo", &result));
+        df_journal_free(g_steal_pointer(&j));
+
+        j = df_journal_open(path, TRUE);
+        g_assert_nonnull(j);
+        g_assert_true(j->have_seed);
+        g_assert_cmpuint(j->seed, ==, 1234);
+        g_assert_true(df_journal_lookup(j, DF_JOURNAL_METHOD, "/org/x", "a.b", "Foo", &result));
+        g_assert_cmpint(result, ==, 4);
+        g_assert_true(df_journal_lookup(j, DF_JOURNAL_PROPERTY, "/org/x", "a.b", "Bar", &result));
+        g_assert_cmpint(result, ==, 0);
+        g_assert_true(df_journal_lookup(j, DF_JOURNAL_INTERFACE, "/org/x", "a.b", NULL, &result));
+        g_assert_cmpint(result, ==, 2);
+        /* Kinds don't mix */
+        g_assert_false(df_journal_lookup(j, DF_JOURNAL_METHOD, "/org/x", "a.b", "Bar", &result));
+        g_assert_false(df_journal_lookup(j, DF_JOURNAL_METHOD, "/org/y", "a.b", "Foo", &result));
+        g_assert_false(df_journal_lookup(NULL, DF_JOURNAL_METHOD, "/org/x", "a.b", "Foo", &result));
+        df_journal_free(g_steal_pointer(&j));
+
+        /* A fresh run starts over */
+        j = df_journal_open(path, FALSE);
+        g_assert_nonnull(j);
+        df_journal_free(g_steal_pointer(&j));
+        j = df_journal_open(path, TRUE);
+        g_assert_nonnull(j);
+        g_assert_false(j->have_seed);
+        g_assert_false(df_journal_lookup(j, DF_JOURNAL_METHOD, "/org/x", "a.b", "Foo", &result));
+
+        g_assert_cmpint(unlink(path), ==, 0);
+}
+
+static void test_df_journal_torn(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(df_journal_t) j = NULL;
+        g_autoptr(gchar) path = NULL, contents = NULL;
+        int result;
+
+        path = journal_path();
+        g_assert_true(g_file_set_contents(path, "S 42\nM 0 10 5 /org/x a.b Foo\nM 1 10 5 /org/x a.b Ba", -1, &error));
+        g_assert_no_error(error);
+
+        j = df_journal_open(path, TRUE);
+        g_assert_nonnull(j);
+        g_assert_true(df_journal_lookup(j, DF_JOURNAL_METHOD, "/org/x", "a.b", "Foo", &result));
+        g_assert_false(df_journal_lookup(j, DF_JOURNAL_METHOD, "/org/x", "a.b", "Ba", &result));
+        /* The torn line is dropped, so new lines don't get appended to it */
+        g_assert_cmpint(df_journal_append(j, DF_JOURNAL_METHOD, 1, 10, 5, "/org/x", "a.b", "Bar"), ==, 0);
+        df_journal_free(g_steal_pointer(&j));
+
+        g_assert_true(g_file_get_contents(path, &contents, NULL, &error));
+        g_assert_no_error(error);
+        g_assert_cmpstr(contents, ==, "S 42\nM 0 10 5 /org/x a.b Foo\nM 1 10 5 /org/x a.b Bar\n");
+
+        g_assert_cmpint(unlink(path), ==, 0);
+}
+
+static void test_df_journal_invalid(void)
+{
+        static const char *invalid[] = {
+                "S\n",
+                "S x\n",
+                "X 0 0 0 /org/x a.b Foo\n",
+                "M 0 0 0 /org/x a.b\n",
+                "I 0 0 0 /org/x a.b Foo\n",
+                "M -1 0 0 /org/x a.b Foo\n",
+        };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(invalid); i++) {
+                g_autoptr(GError) error = NULL;
+                g_autoptr(df_journal_t) j = NULL;
+                g_autoptr(gchar) path = NULL;
+
+                path = journal_path();
+                g_assert_true(g_file_set_contents(path, invalid[i], -1, &error));
+                g_assert_no_error(error);
+
+                j = df_journal_open(path, TRUE);
+                g_assert_null(j);
+                g_assert_cmpint(unlink(path), ==, 0);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_journal/df_journal_resume", test_df_journal_resume);
+        g_test_add_func("/df_journal/df_journal_torn", test_df_journal_torn);
+        g_test_add_func("/df_journal/df_journal_invalid", test_df_journal_invalid);
+
+        return g_test_run();
+}
@@ -0,0 +1,146 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "util.h"
+
+static gpointer add_calls(gpointer user_data)
+{
+        g_autoptr(GError) error = NULL;
+
+        error = g_dbus_error_new_for_dbus_error("org.freedesktop.DBus.Error.InvalidArgs", "test");
+
+        for (guint i = 0; i < 100; i++)
+                df_metrics_add_call(i % 4 == 0 ? error : NULL, i);
+        df_metrics_add_bytes(1000);
+
+        return NULL;
+}
+
+static void test_df_metrics_collect(void)
+{
+        g_auto(df_metrics_snapshot_t) s = {};
+        g_autoptr(gchar) text = NULL, status = NULL;
+        GThread *threads[4];
+        guint64 *count;
+
+        for (guint i = 0; i < G_N_ELEMENTS(threads); i++)
+                threads[i] = g_thread_new("test-metrics", add_calls, NULL);
+        for (guint i = 0; i < G_N_ELEMENTS(threads); i++)
+                g_thread_join(threads[i]);
+        df_metrics_add_reconnect(1500000);
+
+        /* The counters outlive their threads */
+        df_metrics_collect(&s);
+        g_assert_cmpuint(s.calls, ==, 400);
+        g_assert_cmpuint(s.exceptions, ==, 100);
+        g_assert_cmpuint(s.bytes, ==, 4000);
+        g_assert_cmpuint(s.reconnects, ==, 1);
+        g_assert_cmpuint(s.latency.count, ==, 400);
+        g_assert_cmpuint(s.latency.max, ==, 99);
+        g_assert_cmpuint(s.latency_usec, ==, 4 * 99 * 100 / 2);
+        g_assert_cmpuint(g_hash_table_size(s.errors), ==, 1);
+        count = g_hash_table_lookup(s.errors, "org.freedesktop.DBus.Error.InvalidArgs");
+        g_assert_nonnull(count);
+        g_assert_cmpuint(*count, ==, 100);
+
+        text = df_metrics_format_openmetrics(&s);
+        g_assert_nonnull(strstr(text, "\ndfuzzer_calls_total 400\n"));
+        g_assert_nonnull(strstr(text, "\ndfuzzer_exceptions_total{name=\"org.freedesktop.DBus.Error.InvalidArgs\"} 100\n"));
+        g_assert_nonnull(strstr(text, "\ndfuzzer_reconnect_wait_seconds_total 1.500000\n"));
+        /* Values 0-15 */
+        g_assert_nonnull(strstr(text, "\ndfuzzer_call_latency_seconds_bucket{le=\"0.000015\"} 64\n"));
+        /* Values 0-127, i.e. all of them */
+        g_assert_nonnull(strstr(text, "\ndfuzzer_call_latency_seconds_bucket{le=\"0.000127\"} 400\n"));
+        g_assert_nonnull(strstr(text, "\ndfuzzer_call_latency_seconds_count 400\n"));
+        g_assert_true(g_str_has_suffix(text, "\n# EOF\n"));
+
+        status = df_metrics_format_status(&s, NULL, G_USEC_PER_SEC);
+        g_assert_true(g_str_has_prefix(status, "[STATS: 400 calls (400.0/s), 100 exceptions"));
+
+        df_metrics_stop();
+}
+
+static void test_df_metrics_error_names(void)
+{
+        g_auto(df_metrics_snapshot_t) s = {};
+
+        for (guint i = 0; i < DF_METRICS_MAX_ERROR_NAMES + 10; i++) {
+                g_autoptr(GError) error = NULL;
+                g_autoptr(gchar) name = NULL;
+
+                name = g_strdup_printf("org.example.Error.E%u", i);
+                error = g_dbus_error_new_for_dbus_error(name, "test");
+                df_metrics_add_call(error, 1);
+        }
+
+        df_metrics_collect(&s);
+        g_assert_cmpuint(g_hash_table_size(s.errors), ==, DF_METRICS_MAX_ERROR_NAMES);
+        g_assert_cmpuint(s.other_errors, ==, 10);
+        g_assert_cmpuint(s.exceptions, ==, DF_METRICS_MAX_ERROR_NAMES + 10);
+
+        df_metrics_stop();
+}
+
+static void test_df_metrics_export(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) dir = NULL, path = NULL, socket_path = NULL, target = NULL, contents = NULL;
+        struct sockaddr_un sa = { .sun_family = AF_UNIX };
+        char buf[65536];
+        size_t n = 0;
+        ssize_t k;
+        int fd;
+
+        dir = g_dir_make_tmp("test-metrics-XXXXXX", &error);
+        g_assert_no_error(error);
+
+        /* File, written once more when stopped */
+        path = g_build_filename(dir, "metrics.txt", NULL);
+        g_assert_cmpint(df_metrics_start(0, path), ==, 0);
+        df_metrics_add_call(NULL, 10);
+        df_metrics_stop();
+        g_assert_true(g_file_get_contents(path, &contents, NULL, &error));
+        g_assert_no_error(error);
+        g_assert_nonnull(strstr(contents, "\ndfuzzer_calls_total 1\n"));
+        g_assert_cmpint(unlink(path), ==, 0);
+
+        /* Socket, queried via HTTP */
+        socket_path = g_build_filename(dir, "metrics.sock", NULL);
+        target = g_strconcat("unix:", socket_path, NULL);
+        g_assert_cmpint(df_metrics_start(0, target), ==, 0);
+        df_metrics_add_call(NULL, 10);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        g_assert_cmpint(fd, >=, 0);
+        strcpy(sa.sun_path, socket_path);
+        g_assert_cmpint(connect(fd, (struct sockaddr *) &sa, sizeof(sa)), ==, 0);
+        g_assert_cmpint(write(fd, "GET /metrics HTTP/1.0\r\n\r\n", 25), ==, 25);
+        while ((k = read(fd, buf + n, sizeof(buf) - 1 - n)) > 0)
+                n += k;
+        buf[n] = 0;
+        close(fd);
+
+        g_assert_true(g_str_has_prefix(buf, "HTTP/1.0 200 OK\r\n"));
+        g_assert_nonnull(strstr(buf, "\r\n\r\n# TYPE dfuzzer_calls counter\n"));
+        g_assert_true(g_str_has_suffix(buf, "\n# EOF\n"));
+
+        df_metrics_stop();
+        g_assert_false(g_file_test(socket_path, G_FILE_TEST_EXISTS));
+        g_assert_cmpint(rmdir(dir), ==, 0);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_metrics/df_metrics_collect", test_df_metrics_collect);
+        g_test_add_func("/df_metrics/df_metrics_error_names", test_df_metrics_error_names);
+        g_test_add_func("/df_metrics/df_metrics_export", test_df_metrics_export);
+
+        return g_test_run();
+}
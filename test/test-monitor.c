@@ -0,0 +1,49 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "monitor.h"
+
+static void test_df_monitor(void)
+{
+        g_autoptr(df_monitor_t) monitor = NULL;
+        pid_t pid;
+
+        pid = fork();
+        g_assert_cmpint(pid, >=, 0);
+        if (pid == 0) {
+                pause();
+                _exit(0);
+        }
+
+        monitor = df_monitor_new(pid);
+        g_assert_nonnull(monitor);
+        g_assert_cmpint(df_monitor_is_alive(monitor), ==, 1);
+        g_assert_cmpint(df_monitor_check(monitor), ==, 1);
+
+        /* Reap the child, so it doesn't linger around as a zombie */
+        g_assert_cmpint(kill(pid, SIGKILL), ==, 0);
+        g_assert_cmpint(waitpid(pid, NULL, 0), ==, pid);
+
+        g_assert_cmpint(df_monitor_check(monitor), ==, 0);
+        /* The monitor thread should notice as well, eventually */
+        for (guint i = 0; i < 500 && df_monitor_is_alive(monitor) != 0; i++)
+                g_usleep(10 * 1000);
+        g_assert_cmpint(df_monitor_is_alive(monitor), ==, 0);
+
+        /* A process that doesn't exist (anymore) */
+        g_assert_cmpint(df_check_if_exited(pid), ==, 0);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_monitor/df_monitor", test_df_monitor);
+
+        return g_test_run();
+}
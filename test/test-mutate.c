@@ -0,0 +1,200 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "corpus.h"
+#include "mutate.h"
+#include "plan.h"
+#include "rand.h"
+
+#define MUTATE_TEST_ITERATIONS 500
+
+static df_rand_t rnd;
+
+static void test_df_mutate(void)
+{
+        static const char *signatures[] = {
+                "(s)",
+                "(a{sv})",
+                "(aay)",
+                "(v)",
+                "(ybnqiuxtdsogh)",
+                "(a(sa{sv})av)",
+                "(a{oa{sv}}(()))",
+        };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(signatures); i++) {
+                g_autoptr(df_plan_t) plan = NULL;
+                g_autoptr(GVariant) value = NULL;
+                guint changed = 0;
+
+                plan = df_plan_new(signatures[i]);
+                g_assert_nonnull(plan);
+                value = g_variant_ref_sink(df_plan_generate(plan, &rnd, 20));
+                g_assert_nonnull(value);
+
+                for (guint64 iteration = 0; iteration < MUTATE_TEST_ITERATIONS; iteration++) {
+                        g_autoptr(GVariant) mutated = NULL;
+
+                        /* Mutations keep the type */
+                        mutated = df_mutate(&rnd, value, iteration);
+                        g_assert_nonnull(mutated);
+                        g_assert_false(g_variant_is_floating(mutated));
+                        g_assert_true(g_variant_is_of_type(mutated, G_VARIANT_TYPE(signatures[i])));
+                        if (!g_variant_equal(mutated, value))
+                                changed++;
+
+                        /* Mutate the mutations as well, to get deeper trees */
+                        if (iteration % 10 == 0) {
+                                g_variant_unref(value);
+                                value = g_steal_pointer(&mutated);
+                        }
+                        df_arena_reset(rnd.arena);
+                }
+
+                /* Most of the mutations should actually change something */
+                g_assert_cmpuint(changed, >, MUTATE_TEST_ITERATIONS / 2);
+        }
+}
+
+static void test_df_mutate_sized(void)
+{
+        static const struct {
+                const char *signature;
+                guint32 element_size;
+        } cases[] = {
+                { "(ay)", 1 },
+                { "(au)", 4 },
+        };
+        g_autoptr(GByteArray) buffer = g_byte_array_new();
+
+        for (size_t i = 0; i < G_N_ELEMENTS(cases); i++) {
+                g_autoptr(df_plan_t) plan = NULL;
+                g_autoptr(GVariant) value = NULL;
+                gsize n = 0;
+
+                /* Just enough for the array to reach the cap (less the
+                 * padding of the tuple and the array's length) */
+                plan = df_plan_new_sized(cases[i].signature,
+                                         DF_PLAN_MAX_ARRAY_ELEMENTS * cases[i].element_size + 7 + 14);
+                g_assert_nonnull(plan);
+                g_assert_cmpuint(plan->ops[1].max_elements, ==, DF_PLAN_MAX_ARRAY_ELEMENTS);
+
+                /* Find a value with a large array, every other one has it */
+                for (guint64 iteration = 1; n <= DF_PLAN_MAX_ARRAY_ELEMENTS / 2; iteration++) {
+                        g_autoptr(GVariant) array = NULL;
+
+                        g_assert_cmpuint(iteration, <, 64);
+
+                        g_clear_pointer(&value, g_variant_unref);
+                        value = g_variant_ref_sink(df_plan_serialize(plan, &rnd, iteration, buffer));
+                        g_assert_nonnull(value);
+                        df_arena_reset(rnd.arena);
+
+                        array = g_variant_get_child_value(value, 0);
+                        n = g_variant_n_children(array);
+                }
+
+                /* The children of such arrays don't fit on the stack */
+                for (guint64 iteration = 0; iteration < 8; iteration++) {
+                        g_autoptr(GVariant) mutated = NULL, array = NULL;
+
+                        mutated = df_mutate(&rnd, value, iteration);
+                        g_assert_nonnull(mutated);
+                        g_assert_true(g_variant_is_of_type(mutated, G_VARIANT_TYPE(cases[i].signature)));
+
+                        array = g_variant_get_child_value(mutated, 0);
+                        g_assert_cmpuint(g_variant_n_children(array), >=, n - 1);
+                        g_assert_cmpuint(g_variant_n_children(array), <=, n + 1);
+                        df_arena_reset(rnd.arena);
+                }
+        }
+}
+
+static void test_df_mutate_typed(void)
+{
+        g_autoptr(GVariant) number = NULL, string = NULL, variant = NULL, dict = NULL;
+        gboolean boundary = FALSE, spliced = FALSE, nested = FALSE, swapped = FALSE;
+
+        number = g_variant_ref_sink(g_variant_new("(u)", 12345));
+        string = g_variant_ref_sink(g_variant_new("(s)", "hello world"));
+        variant = g_variant_ref_sink(g_variant_new("(v)", g_variant_new_int32(42)));
+        dict = g_variant_ref_sink(g_variant_new_parsed("({'a': <uint32 1>, 'b': <uint32 2>},)"));
+
+        for (guint64 iteration = 0; iteration < MUTATE_TEST_ITERATIONS; iteration++) {
+                g_autoptr(GVariant) m_number = NULL, m_string = NULL, m_variant = NULL, m_dict = NULL;
+                g_autoptr(GVariant) child = NULL, entries = NULL, a = NULL, b = NULL;
+                const char *str;
+                guint32 u;
+
+                /* Integers are set to boundary values */
+                m_number = df_mutate(&rnd, number, iteration);
+                g_variant_get(m_number, "(u)", &u);
+                if (u == 0 || u == G_MAXUINT32 || u == G_MAXINT32)
+                        boundary = TRUE;
+
+                /* Strings stay valid UTF-8 and get tokens spliced in */
+                m_string = df_mutate(&rnd, string, iteration);
+                g_variant_get(m_string, "(&s)", &str);
+                g_assert_true(g_utf8_validate(str, -1, NULL));
+                if (strstr(str, "hello") && strlen(str) > strlen("hello world") && !strstr(str, "worldhello"))
+                        spliced = TRUE;
+
+                /* Variants are nested */
+                m_variant = df_mutate(&rnd, variant, iteration);
+                g_variant_get(m_variant, "(v)", &child);
+                if (g_variant_is_of_type(child, G_VARIANT_TYPE_VARIANT))
+                        nested = TRUE;
+
+                /* Values of dict entries are swapped, keeping the keys */
+                m_dict = df_mutate(&rnd, dict, iteration);
+                g_variant_get_child(m_dict, 0, "@a{sv}", &entries);
+                a = g_variant_lookup_value(entries, "a", G_VARIANT_TYPE_UINT32);
+                b = g_variant_lookup_value(entries, "b", G_VARIANT_TYPE_UINT32);
+                if (a && b && g_variant_get_uint32(a) == 2 && g_variant_get_uint32(b) == 1)
+                        swapped = TRUE;
+
+                df_arena_reset(rnd.arena);
+        }
+
+        g_assert_true(boundary);
+        g_assert_true(spliced);
+        g_assert_true(nested);
+        g_assert_true(swapped);
+}
+
+static void test_df_corpus(void)
+{
+        g_autoptr(df_corpus_t) corpus = NULL;
+
+        corpus = df_corpus_new();
+        g_assert_nonnull(corpus);
+        g_assert_null(df_corpus_pick(corpus, &rnd));
+
+        for (guint32 i = 0; i < DF_CORPUS_MAX_SIZE * 2; i++) {
+                g_autoptr(GVariant) value = g_variant_ref_sink(g_variant_new("(u)", i));
+
+                df_corpus_add(corpus, &rnd, value);
+                g_assert_cmpuint(df_corpus_size(corpus), ==, MIN(i + 1, DF_CORPUS_MAX_SIZE));
+        }
+
+        for (guint i = 0; i < 100; i++)
+                g_assert_true(g_variant_is_of_type(df_corpus_pick(corpus, &rnd), G_VARIANT_TYPE("(u)")));
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+        /* See the comment in test-rand.c */
+        df_rand_init(&rnd, g_test_rand_int());
+        rnd.arena = df_arena_new();
+        g_assert_nonnull(rnd.arena);
+
+        g_test_add_func("/df_mutate/df_mutate", test_df_mutate);
+        g_test_add_func("/df_mutate/df_mutate_sized", test_df_mutate_sized);
+        g_test_add_func("/df_mutate/df_mutate_typed", test_df_mutate_typed);
+        g_test_add_func("/df_mutate/df_corpus", test_df_corpus);
+
+        return g_test_run();
+}
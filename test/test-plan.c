@@ -0,0 +1,249 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fuzz.h"
+#include "plan.h"
+#include "rand.h"
+#include "util.h"
+
+#define PLAN_TEST_ITERATIONS 500
+
+static df_rand_t rnd;
+
+static void test_df_plan_new(void)
+{
+        static const struct {
+                const char *signature;
+                guint32 n_ops;
+        } cases[] = {
+                { "s",                  1  },
+                { "()",                 1  },
+                { "(s)",                2  },
+                { "a{sv}",              4  },
+                { "(aay)",              4  },
+                { "(ybnqiuxtdsogh)",    14 },
+                { "(a(sa{sv})av)",      10 },
+        };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(cases); i++) {
+                g_autoptr(df_plan_t) plan = NULL;
+
+                plan = df_plan_new(cases[i].signature);
+                g_assert_nonnull(plan);
+                g_assert_cmpuint(plan->n_ops, ==, cases[i].n_ops);
+                /* The root op spans the whole plan */
+                g_assert_cmpuint(plan->ops[0].end, ==, plan->n_ops);
+                g_assert_cmpint(plan->ops[0].type_code, ==, cases[i].signature[0]);
+        }
+
+        /* Invalid signatures */
+        g_assert_null(df_plan_new(NULL));
+        g_assert_null(df_plan_new(""));
+        g_assert_null(df_plan_new("(s"));
+        g_assert_null(df_plan_new("ss"));
+        g_assert_null(df_plan_new("a{vs}"));
+}
+
+static void test_df_plan_generate(void)
+{
+        static const char *signatures[] = {
+                "(s)",
+                "(a{sv})",
+                "(aay)",
+                "(v)",
+                "(aaai)",
+                "(ybnqiuxtdsogh)",
+                "(a(sa{sv})av)",
+                "(a{oa{sv}}(()))",
+        };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(signatures); i++) {
+                g_autoptr(df_plan_t) plan = NULL;
+
+                plan = df_plan_new(signatures[i]);
+                g_assert_nonnull(plan);
+
+                for (guint64 iteration = 0; iteration < PLAN_TEST_ITERATIONS; iteration++) {
+                        g_autoptr(GVariant) value = NULL;
+
+                        value = g_variant_ref_sink(df_plan_generate(plan, &rnd, iteration));
+                        g_assert_nonnull(value);
+                        g_assert_true(g_variant_is_of_type(value, G_VARIANT_TYPE(signatures[i])));
+                        df_arena_reset(rnd.arena);
+                }
+        }
+}
+
+static void test_df_plan_serialize(void)
+{
+        static const char *signatures[] = {
+                "s",
+                "()",
+                "(y)",
+                "(yi)",
+                "(s)",
+                "(iy)",
+                "(a{sv})",
+                "(aay)",
+                "(v)",
+                "(aaai)",
+                "(ybnqiuxtdsogh)",
+                "(a(sa{sv})av)",
+                "(a{oa{sv}}(()))",
+                "(a(yt)a{yy}as)",
+        };
+        g_autoptr(GByteArray) buffer = g_byte_array_new();
+        guint64 seed = ((guint64) g_test_rand_int() << 32) | g_test_rand_int();
+
+        for (size_t i = 0; i < G_N_ELEMENTS(signatures); i++) {
+                g_autoptr(df_plan_t) plan = NULL;
+
+                plan = df_plan_new(signatures[i]);
+                g_assert_nonnull(plan);
+
+                for (guint64 iteration = 0; iteration < PLAN_TEST_ITERATIONS; iteration++) {
+                        g_autoptr(GVariant) a = NULL, b = NULL;
+                        df_rand_t r = { .arena = rnd.arena };
+
+                        /* Both backends must generate the same value from the same state */
+                        df_rand_init(&r, seed + iteration);
+                        a = g_variant_ref_sink(df_plan_generate(plan, &r, iteration));
+                        df_rand_init(&r, seed + iteration);
+                        b = g_variant_ref_sink(df_plan_serialize(plan, &r, iteration, buffer));
+                        g_assert_nonnull(a);
+                        g_assert_nonnull(b);
+                        /* ...and the serialized data must be already in normal form */
+                        g_assert_true(g_variant_is_normal_form(b));
+                        g_assert_true(g_variant_equal(a, b));
+                        df_arena_reset(rnd.arena);
+                }
+        }
+}
+
+static void test_df_plan_new_sized(void)
+{
+        g_autoptr(df_plan_t) plan = NULL;
+
+        /* Fixed-size elements fill the array's share (less its length and
+         * padding) */
+        plan = df_plan_new_sized("ay", 65536);
+        g_assert_nonnull(plan);
+        g_assert_cmpuint(plan->size_budget, ==, 65536);
+        g_assert_cmpuint(plan->ops[0].max_elements, ==, 65536 - 14);
+        df_plan_free(g_steal_pointer(&plan));
+
+        /* Booleans take 4 bytes, structs are padded to 8 bytes */
+        plan = df_plan_new_sized("a(yb)", 8014);
+        g_assert_nonnull(plan);
+        g_assert_cmpuint(plan->ops[0].max_elements, ==, 1000);
+        df_plan_free(g_steal_pointer(&plan));
+
+        /* Variable-sized elements grow in number and size at the same rate */
+        plan = df_plan_new_sized("as", 10014);
+        g_assert_nonnull(plan);
+        g_assert_cmpuint(plan->ops[0].max_elements, ==, 100);
+        g_assert_cmpuint(plan->ops[1].size_budget, ==, 100);
+        df_plan_free(g_steal_pointer(&plan));
+
+        /* Fixed-size members take what they need, the rest is split evenly */
+        plan = df_plan_new_sized("(tsv)", 1007);
+        g_assert_nonnull(plan);
+        g_assert_cmpuint(plan->ops[1].size_budget, ==, 8);
+        g_assert_cmpuint(plan->ops[2].size_budget, ==, (1000 - 15) / 2);
+        g_assert_cmpuint(plan->ops[3].size_budget, ==, (1000 - 15) / 2);
+        df_plan_free(g_steal_pointer(&plan));
+
+        /* No budget, no shares */
+        plan = df_plan_new_sized("as", 0);
+        g_assert_nonnull(plan);
+        g_assert_cmpuint(plan->size_budget, ==, 0);
+        g_assert_cmpuint(plan->ops[0].max_elements, ==, 0);
+        g_assert_cmpuint(plan->ops[1].size_budget, ==, 0);
+}
+
+static void test_df_plan_sized_generate(void)
+{
+        static const char *signatures[] = {
+                "(s)",
+                "(ay)",
+                "(a{sv})",
+                "(aas)",
+                "(a(sog))",
+                "(a(yt)a{yy}as)",
+                "(a{oa{sv}}v)",
+        };
+        static const guint64 sizes[] = { MIN_MESSAGE_SIZE, 65536 };
+        const char *header[] = { "org.freedesktop.dfuzzer", "/org/freedesktop/dfuzzer", "org.freedesktop.dfuzzer",
+                                 "Test", NULL, NULL };
+        g_autoptr(GByteArray) buffer = g_byte_array_new();
+        guint64 seed = ((guint64) g_test_rand_int() << 32) | g_test_rand_int();
+
+        for (size_t i = 0; i < G_N_ELEMENTS(sizes); i++) {
+                df_fuzz_set_message_size(sizes[i]);
+
+                for (size_t j = 0; j < G_N_ELEMENTS(signatures); j++) {
+                        g_autoptr(df_plan_t) plan = NULL;
+                        guint64 largest = 0;
+
+                        header[4] = signatures[j];
+                        plan = df_fuzz_plan_new(signatures[j], header);
+                        g_assert_nonnull(plan);
+                        g_assert_cmpuint(plan->size_budget, >, 0);
+                        g_assert_cmpuint(plan->size_budget, <, sizes[i]);
+
+                        for (guint64 iteration = 0; iteration < PLAN_TEST_ITERATIONS / 5; iteration++) {
+                                g_autoptr(GDBusMessage) message = NULL;
+                                g_autoptr(GVariant) a = NULL, b = NULL;
+                                g_autoptr(GError) error = NULL;
+                                g_autoptr(gchar) blob = NULL;
+                                df_rand_t r = { .arena = rnd.arena };
+                                gsize size;
+
+                                /* Sized plans generate the same values with both backends as well */
+                                df_rand_init(&r, seed + iteration);
+                                a = g_variant_ref_sink(df_plan_generate(plan, &r, iteration));
+                                df_rand_init(&r, seed + iteration);
+                                b = g_variant_ref_sink(df_plan_serialize(plan, &r, iteration, buffer));
+                                g_assert_nonnull(a);
+                                g_assert_nonnull(b);
+                                g_assert_true(g_variant_is_normal_form(b));
+                                g_assert_true(g_variant_equal(a, b));
+                                df_arena_reset(rnd.arena);
+
+                                /* ...and the whole message fits */
+                                message = g_dbus_message_new_method_call(header[0], header[1], header[2], header[3]);
+                                g_dbus_message_set_body(message, a);
+                                blob = (gchar *) g_dbus_message_to_blob(message, &size,
+                                                                        G_DBUS_CAPABILITY_FLAGS_NONE, &error);
+                                g_assert_no_error(error);
+                                g_assert_cmpuint(size, <=, sizes[i]);
+                                largest = MAX(largest, size);
+                        }
+
+                        /* Arrays aren't stuck at DF_RAND_MAX_ARRAY_SIZE elements */
+                        if (strchr(signatures[j], 'a'))
+                                g_assert_cmpuint(largest, >, sizes[i] / 8);
+                }
+        }
+
+        df_fuzz_set_message_size(0);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+        /* See the comment in test-rand.c */
+        df_rand_init(&rnd, g_test_rand_int());
+        rnd.arena = df_arena_new();
+        g_assert_nonnull(rnd.arena);
+
+        g_test_add_func("/df_plan/df_plan_new", test_df_plan_new);
+        g_test_add_func("/df_plan/df_plan_generate", test_df_plan_generate);
+        g_test_add_func("/df_plan/df_plan_serialize", test_df_plan_serialize);
+        g_test_add_func("/df_plan/df_plan_new_sized", test_df_plan_new_sized);
+        g_test_add_func("/df_plan/df_plan_sized_generate", test_df_plan_sized_generate);
+
+        return g_test_run();
+}
@@ -0,0 +1,99 @@
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "plan.h"
+#include "producer.h"
+#include "rand.h"
+#include "util.h"
+
+#define PRODUCER_TEST_ITERATIONS 300
+
+static void test_df_producer_take(void)
+{
+        static const char *signatures[] = {
+                "(s)",
+                "(a{sv})",
+                "(ybnqiuxtdsogh)",
+                "(a(sa{sv})av)",
+        };
+        static const guint threads[] = { 1, 3, 8 };
+        guint64 seed = ((guint64) g_test_rand_int() << 32) | g_test_rand_int();
+        g_autoptr(df_arena_t) arena = df_arena_new();
+
+        g_assert_nonnull(arena);
+
+        for (size_t i = 0; i < G_N_ELEMENTS(signatures); i++) {
+                g_autoptr(df_plan_t) plan = NULL;
+
+                plan = df_plan_new(signatures[i]);
+                g_assert_nonnull(plan);
+
+                for (size_t j = 0; j < G_N_ELEMENTS(threads); j++) {
+                        for (df_plan_backend_t backend = 0; backend < _DF_PLAN_BACKEND_MAX; backend++) {
+                                g_autoptr(GByteArray) buffer = g_byte_array_new();
+                                g_autoptr(df_producer_t) p = NULL;
+                                guint64 start = j * 7;
+
+                                p = df_producer_new(plan, backend, seed, start, start + PRODUCER_TEST_ITERATIONS,
+                                                    threads[j]);
+                                g_assert_nonnull(p);
+
+                                /* The inputs are the same as the ones generated inline,
+                                 * regardless of the number of threads */
+                                for (guint64 it = start; it < start + PRODUCER_TEST_ITERATIONS; it++) {
+                                        g_autoptr(GVariant) a = NULL, b = NULL;
+                                        df_rand_t rnd = { .arena = arena };
+                                        gsize arena_used = 0;
+
+                                        df_rand_init(&rnd, seed + it);
+                                        a = g_variant_ref_sink(df_plan_generate_with(plan, backend, &rnd, it, buffer));
+                                        df_arena_reset(arena);
+                                        b = df_producer_take(p, it, &arena_used);
+                                        g_assert_nonnull(a);
+                                        g_assert_nonnull(b);
+                                        g_assert_false(g_variant_is_floating(b));
+                                        g_assert_true(g_variant_equal(a, b));
+                                }
+                        }
+                }
+        }
+}
+
+static void test_df_producer_free(void)
+{
+        g_autoptr(df_plan_t) plan = NULL;
+
+        plan = df_plan_new("(a{sv}as)");
+        g_assert_nonnull(plan);
+
+        /* Stopping with the ring full, or with nothing taken at all */
+        for (guint taken = 0; taken < 3; taken++) {
+                g_autoptr(df_producer_t) p = NULL;
+
+                p = df_producer_new(plan, DF_PLAN_BACKEND_VARIANT, 42, 0, 1000, 2);
+                g_assert_nonnull(p);
+
+                for (guint64 it = 0; it < taken; it++) {
+                        g_autoptr(GVariant) v = NULL;
+
+                        v = df_producer_take(p, it, NULL);
+                        g_assert_nonnull(v);
+                }
+
+                /* Let the threads fill the ring up */
+                g_usleep(10 * 1000);
+        }
+
+        /* An empty range */
+        df_producer_free(df_producer_new(plan, DF_PLAN_BACKEND_WIRE, 42, 5, 5, 4));
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_producer/df_producer_take", test_df_producer_take);
+        g_test_add_func("/df_producer/df_producer_free", test_df_producer_free);
+
+        return g_test_run();
+}
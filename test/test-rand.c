@@ -1,12 +1,16 @@
 #include <gio/gio.h>
 #include <glib.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "rand.h"
 #include "util.h"
 
 #define RAND_TEST_ITERATIONS 5000
 
+static df_rand_t rnd;
+
 static void test_df_rand_unichar(void)
 {
         guint16 width;
@@ -17,7 +21,7 @@ static void test_df_rand_unichar(void)
                 /* This section runs in a subprocess */
                 width = 5;
 
-                (void) df_rand_unichar(&width);
+                (void) df_rand_unichar(&rnd, &width);
         }
 
         /* Respawn the current test in a subprocess */
@@ -30,7 +34,7 @@ static void test_df_rand_unichar(void)
                 uc = 0;
                 width = i;
 
-                uc = df_rand_unichar(&width);
+                uc = df_rand_unichar(&rnd, &width);
 
                 /* The returned unichar should be in an UTF-8 range */
                 g_assert_true(uc <= 0x10FFFF);
@@ -42,7 +46,7 @@ static void test_df_rand_unichar(void)
         for (guint32 i = 0; i < RAND_TEST_ITERATIONS; i++) {
                 width = uc = 0;
 
-                uc = df_rand_unichar(&width);
+                uc = df_rand_unichar(&rnd, &width);
 
                 /* The returned unichar should be in an UTF-8 range */
                 g_assert_true(uc <= 0x10FFFF);
@@ -51,34 +55,105 @@ static void test_df_rand_unichar(void)
         }
 }
 
+/* Count characters of each width in a valid UTF-8 string */
+static void count_utf8_widths(const char *str, size_t size, guint64 counts[4])
+{
+        const char *end = str + size;
+
+        memset(counts, 0, 4 * sizeof(*counts));
+        for (const char *p = str; p < end; p = g_utf8_next_char(p)) {
+                gunichar uc = g_utf8_get_char(p);
+
+                /* No control characters */
+                g_assert_cmpuint(uc, >=, 0x20);
+                counts[g_unichar_to_utf8(uc, NULL) - 1]++;
+        }
+}
+
+static void test_df_rand_utf8(void)
+{
+        static const size_t sizes[] = { 0, 1, 2, 3, 4, 5, 7, 31, 32, 33, 4096, 50000 };
+        static const df_rand_utf8_mix_t single_widths[] = {
+                { { 1, 0, 0, 0 } },
+                { { 0, 1, 0, 0 } },
+                { { 0, 0, 1, 0 } },
+                { { 0, 0, 0, 1 } },
+        };
+        g_autoptr(char) buf = malloc(50000);
+        guint64 counts[4], total = 0;
+
+        g_assert_nonnull(buf);
+
+        /* Exact byte budget, valid UTF-8 */
+        for (size_t i = 0; i < G_N_ELEMENTS(sizes); i++) {
+                df_rand_utf8(&rnd, buf, sizes[i], &DF_RAND_UTF8_MIX_UNIFORM);
+                g_assert_true(g_utf8_validate(buf, sizes[i], NULL));
+                count_utf8_widths(buf, sizes[i], counts);
+        }
+
+        /* Single width mixes generate only characters of that width (if the
+         * size is a multiple of the width) */
+        for (size_t i = 0; i < G_N_ELEMENTS(single_widths); i++) {
+                size_t size = 12000;
+
+                df_rand_utf8(&rnd, buf, size, &single_widths[i]);
+                g_assert_true(g_utf8_validate(buf, size, NULL));
+                count_utf8_widths(buf, size, counts);
+                g_assert_cmpuint(counts[i], ==, size / (i + 1));
+        }
+
+        /* Uniform mix: roughly the same number of characters of each width */
+        df_rand_utf8(&rnd, buf, 50000, &DF_RAND_UTF8_MIX_UNIFORM);
+        g_assert_true(g_utf8_validate(buf, 50000, NULL));
+        count_utf8_widths(buf, 50000, counts);
+        for (size_t i = 0; i < 4; i++)
+                total += counts[i];
+        for (size_t i = 0; i < 4; i++) {
+                g_assert_cmpuint(counts[i], >, total / 4 * 9 / 10);
+                g_assert_cmpuint(counts[i], <, total / 4 * 11 / 10);
+        }
+
+        /* Weighted mix: 3:1 in favor of 1 byte wide characters */
+        df_rand_utf8(&rnd, buf, 50000, &(const df_rand_utf8_mix_t) { { 3, 1, 0, 0 } });
+        count_utf8_widths(buf, 50000, counts);
+        g_assert_cmpuint(counts[2] + counts[3], ==, 0);
+        g_assert_cmpuint(counts[0], >, counts[1] * 27 / 10);
+        g_assert_cmpuint(counts[0], <, counts[1] * 33 / 10);
+}
+
 static void test_df_rand_string(void)
 {
         for (guint32 i = 0; i < RAND_TEST_ITERATIONS; i++) {
-                g_autoptr(gchar) str = NULL;
+                const gchar *str = NULL;
                 /* Test the "upper" guint64 interval in the second half of the iterations */
                 guint64 iteration = i < RAND_TEST_ITERATIONS / 2 ? i : (guint64) g_test_rand_int_range(0, G_MAXINT32) + G_MAXINT32;
 
-                g_assert_true(df_rand_string(&str, iteration) == 0);
+                g_assert_true(df_rand_string(&rnd, &str, iteration) == 0);
                 g_assert_nonnull(str);
+                g_assert_true(g_utf8_validate(str, -1, NULL));
+                g_assert_cmpuint(strlen(str), <, df_fuzz_get_buffer_length());
+                df_arena_reset(rnd.arena);
         }
 }
 
 static void test_df_rand_dbus_objpath_string(void)
 {
         for (guint32 i = 0; i < RAND_TEST_ITERATIONS; i++) {
-                g_autoptr(gchar) str = NULL;
+                const gchar *str = NULL;
                 /* Test the "upper" guint64 interval in the second half of the iterations */
                 guint64 iteration = i < RAND_TEST_ITERATIONS / 2 ? i : (guint64) g_test_rand_int_range(0, G_MAXINT32) + G_MAXINT32;
 
-                g_assert_true(df_rand_dbus_objpath_string(&str, iteration) == 0);
+                g_assert_true(df_rand_dbus_objpath_string(&rnd, &str, iteration) == 0);
                 g_assert_nonnull(str);
+                df_arena_reset(rnd.arena);
         }
 
         /* Test certain specific/problematic cases */
-        g_autoptr(gchar) str = NULL;
+        const gchar *str = NULL;
 
-        g_assert_true(df_rand_dbus_objpath_string(&str, df_fuzz_get_buffer_length() - 2) == 0);
+        g_assert_true(df_rand_dbus_objpath_string(&rnd, &str, df_fuzz_get_buffer_length() - 2) == 0);
         g_assert_nonnull(str);
+        df_arena_reset(rnd.arena);
 }
 
 static void test_df_rand_dbus_signature_string(void)
@@ -88,7 +163,7 @@ static void test_df_rand_dbus_signature_string(void)
                 /* Test the "upper" guint64 interval in the second half of the iterations */
                 guint64 iteration = i < RAND_TEST_ITERATIONS / 2 ? i : (guint64) g_test_rand_int_range(0, G_MAXINT32) + G_MAXINT32;
 
-                g_assert_true(df_rand_dbus_signature_string(&str, iteration) == 0);
+                g_assert_true(df_rand_dbus_signature_string(&rnd, &str, iteration) == 0);
                 g_assert_true(g_variant_is_signature(str));
                 g_assert_nonnull(str);
         }
@@ -101,9 +176,46 @@ static void test_df_rand_GVariant(void)
                 /* Test the "upper" guint64 interval in the second half of the iterations */
                 guint64 iteration = i < RAND_TEST_ITERATIONS / 2 ? i : (guint64) g_test_rand_int_range(0, G_MAXINT32) + G_MAXINT32;
 
-                g_assert_true(df_rand_GVariant(&variant, iteration) == 0);
+                g_assert_true(df_rand_GVariant(&rnd, &variant, iteration) == 0);
                 g_assert_nonnull(variant);
+                df_arena_reset(rnd.arena);
+        }
+}
+
+static void test_df_rand_reproducible(void)
+{
+        static const char *signatures[] = {
+                "(s)",
+                "(a{sv})",
+                "(aay)",
+                "(v)",
+                "(ybnqiuxtdsogh)",
+                "(a(sa{sv})av)",
+        };
+        guint64 seed = ((guint64) g_test_rand_int() << 32) | g_test_rand_int();
+
+        for (size_t i = 0; i < G_N_ELEMENTS(signatures); i++) {
+                for (guint64 iteration = 0; iteration < 64; iteration++) {
+                        g_autoptr(GVariant) a = NULL, b = NULL;
+                        df_rand_t r = { .arena = rnd.arena };
+
+                        /* The same seed must give the same value */
+                        df_rand_init(&r, seed + iteration);
+                        a = g_variant_ref_sink(df_generate_random_from_signature(&r, signatures[i], iteration));
+                        df_rand_init(&r, seed + iteration);
+                        b = g_variant_ref_sink(df_generate_random_from_signature(&r, signatures[i], iteration));
+                        g_assert_nonnull(a);
+                        g_assert_nonnull(b);
+                        g_assert_true(g_variant_equal(a, b));
+                        df_arena_reset(rnd.arena);
+                }
         }
+
+        /* Different seeds should give different streams */
+        df_rand_t r1 = {}, r2 = {};
+        df_rand_init(&r1, seed);
+        df_rand_init(&r2, seed + 1);
+        g_assert_cmpuint(df_rand_next(&r1), !=, df_rand_next(&r2));
 }
 
 int main(int argc, char *argv[])
@@ -118,13 +230,17 @@ int main(int argc, char *argv[])
          *
          * See: https://docs.gtk.org/glib/func.test_rand_int.html
          * */
-        df_rand_init(g_test_rand_int());
+        df_rand_init(&rnd, g_test_rand_int());
+        rnd.arena = df_arena_new();
+        g_assert_nonnull(rnd.arena);
 
         g_test_add_func("/df_rand/df_rand_unichar", test_df_rand_unichar);
+        g_test_add_func("/df_rand/df_rand_utf8", test_df_rand_utf8);
         g_test_add_func("/df_rand/df_rand_string", test_df_rand_string);
         g_test_add_func("/df_rand/df_rand_dbus_objpath_string", test_df_rand_dbus_objpath_string);
         g_test_add_func("/df_rand/df_rand_dbus_signature_string", test_df_rand_dbus_signature_string);
         g_test_add_func("/df_rand/df_rand_GVariant", test_df_rand_GVariant);
+        g_test_add_func("/df_rand/df_rand_reproducible", test_df_rand_reproducible);
 
         return g_test_run();
 }
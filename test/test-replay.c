@@ -0,0 +1,83 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "replay.h"
+#include "util.h"
+
+static void test_df_replay_parse_line(void)
+{
+        g_autoptr(df_replay_record_t) record = NULL;
+        g_autoptr(GVariant) expected = NULL;
+        static const char *invalid[] = {
+                "",
+                "\n",
+                "org.test.If;/;Foo;(s);('a');",
+                "org.test.If;/;Foo;(s);('a');Whatever\n",
+                "org.test.If;/;Foo;(s);(1,);Success\n",
+                "org.test.If;/;Foo;(s('a');Success\n",
+                "org.test.If;/;Foo;Success\n",
+        };
+
+        /* Printed values can contain the separator as well */
+        record = df_replay_parse_line("org.test.If;/org/test;Foo;(sau);('a;b;c', [1, 2]);Crash\n");
+        g_assert_nonnull(record);
+        g_assert_cmpstr(record->interface, ==, "org.test.If");
+        g_assert_cmpstr(record->object, ==, "/org/test");
+        g_assert_cmpstr(record->method, ==, "Foo");
+        g_assert_cmpstr(record->signature, ==, "(sau)");
+        g_assert_cmpint(record->result, ==, DF_BINLOG_CRASH);
+        expected = g_variant_ref_sink(g_variant_new_parsed("('a;b;c', [@u 1, 2])"));
+        g_assert_true(g_variant_equal(record->value, expected));
+
+        for (size_t i = 0; i < G_N_ELEMENTS(invalid); i++) {
+                df_replay_record_t *r = df_replay_parse_line(invalid[i]);
+
+                g_assert_null(r);
+        }
+}
+
+static void test_df_replay_load(void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GPtrArray) records = NULL;
+        g_autoptr(gchar) path = NULL;
+        int fd;
+
+        fd = g_file_open_tmp("test-replay-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        g_assert_true(g_file_set_contents(path,
+                                          "org.test.If;/;Foo;(s);('a');Success\n"
+                                          "garbage\n"
+                                          "org.test.If;/;Bar;(u);(1,);Success\n"
+                                          "org.test.Other;/;Foo;(s);('b');Success\n"
+                                          "org.test.If;/;Foo;(s);('c');Crash\n",
+                                          -1, &error));
+        g_assert_no_error(error);
+
+        records = df_replay_load(path, NULL, NULL, NULL);
+        g_assert_nonnull(records);
+        g_assert_cmpuint(records->len, ==, 4);
+        g_ptr_array_unref(records);
+
+        records = df_replay_load(path, "/", "org.test.If", "Foo");
+        g_assert_nonnull(records);
+        g_assert_cmpuint(records->len, ==, 2);
+        g_assert_cmpint(((df_replay_record_t *) g_ptr_array_index(records, 0))->result, ==, DF_BINLOG_SUCCESS);
+        g_assert_cmpint(((df_replay_record_t *) g_ptr_array_index(records, 1))->result, ==, DF_BINLOG_CRASH);
+
+        (void) unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_replay/df_replay_parse_line", test_df_replay_parse_line);
+        g_test_add_func("/df_replay/df_replay_load", test_df_replay_load);
+
+        return g_test_run();
+}
@@ -0,0 +1,124 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schedule.h"
+
+static df_schedule_entry_t *add_method(df_schedule_t *schedule, const char *name)
+{
+        df_dbus_method_t method = {
+                .name = strdup(name),
+                .signature = strdup("(s)"),
+        };
+        df_schedule_entry_t *entry;
+
+        entry = df_schedule_add(schedule, "/", "org.test.Interface", &method, NULL);
+        g_assert_nonnull(entry);
+        /* The method was moved into the entry */
+        g_assert_null(method.name);
+        g_assert_cmpstr(entry->method.name, ==, name);
+
+        return entry;
+}
+
+/* Pretend iterations calls were done: all of them raise an exception, and
+ * with found > 0 that many of them raise one never seen before */
+static void fake_slice(df_method_stats_t *stats, guint64 iterations, guint64 found)
+{
+        for (guint64 i = 0; i < iterations; i++) {
+                stats->calls++;
+                stats->exceptions++;
+                stats->latency_usec += 100;
+                if (i < found) {
+                        g_hash_table_add(stats->error_names, g_strdup_printf("org.test.Error%u", g_hash_table_size(stats->error_names)));
+                        stats->new_errors++;
+                } else
+                        g_hash_table_add(stats->error_names, g_strdup("org.test.InvalidArgs"));
+        }
+}
+
+static void test_df_schedule_budget(void)
+{
+        g_autoptr(df_schedule_t) schedule = NULL;
+        df_schedule_entry_t *saturated, *productive, *entry;
+        guint64 iterations;
+
+        schedule = df_schedule_new(1000, 0, 10, G_MAXUINT32);
+        g_assert_nonnull(schedule);
+        saturated = add_method(schedule, "Saturated");
+        productive = add_method(schedule, "Productive");
+
+        while ((entry = df_schedule_next(schedule, &iterations))) {
+                g_assert_cmpuint(iterations, >, 0);
+                g_assert_cmpuint(iterations, <=, DF_SCHEDULE_SLICE);
+
+                fake_slice(&entry->stats, iterations, entry == productive ? 1 : 0);
+                df_schedule_update(schedule, entry);
+        }
+
+        /* The whole budget is used, mostly by the productive method */
+        g_assert_cmpuint(schedule->used, ==, 1000);
+        g_assert_true(saturated->done);
+        g_assert_false(productive->done);
+        g_assert_cmpuint(saturated->next, >=, schedule->min_iterations);
+        g_assert_cmpuint(saturated->next, <=, DF_SCHEDULE_SLICE * (DF_SCHEDULE_SATURATED_SLICES + 1));
+        g_assert_cmpuint(productive->next, ==, 1000 - saturated->next);
+        g_assert_cmpuint(productive->stats.calls, ==, productive->next);
+}
+
+static void test_df_schedule_retire(void)
+{
+        g_autoptr(df_schedule_t) schedule = NULL;
+        df_schedule_entry_t *skipped, *early, *limited, *capped, *entry;
+        guint64 iterations;
+
+        /* No budget, so it's limited only by the iterations of each method */
+        schedule = df_schedule_new(0, 0, 1, 40);
+        g_assert_nonnull(schedule);
+        skipped = add_method(schedule, "Skipped");
+        early = add_method(schedule, "Early");
+        limited = add_method(schedule, "Limited");
+        capped = add_method(schedule, "Capped");
+
+        while ((entry = df_schedule_next(schedule, &iterations))) {
+                g_assert_cmpuint(entry->next + iterations, <=, 40);
+
+                if (entry == skipped) {
+                        fake_slice(&entry->stats, 1, 1);
+                        entry->stats.skipped = TRUE;
+                } else if (entry == early)
+                        /* E.g. MAX_EXCEPTIONS reached */
+                        fake_slice(&entry->stats, iterations - 1, 1);
+                else if (entry == limited) {
+                        /* E.g. MAX_EXCEPTIONS reached with the very last call
+                         * of the second slice */
+                        fake_slice(&entry->stats, iterations, iterations);
+                        entry->stats.ended_early = entry->next > 0;
+                } else
+                        fake_slice(&entry->stats, iterations, iterations);
+                df_schedule_update(schedule, entry);
+        }
+
+        g_assert_true(skipped->done);
+        g_assert_cmpuint(skipped->stats.calls, ==, 1);
+        g_assert_true(early->done);
+        g_assert_cmpuint(early->stats.calls, ==, DF_SCHEDULE_SLICE - 1);
+        g_assert_true(limited->done);
+        g_assert_cmpuint(limited->stats.calls, ==, 2 * DF_SCHEDULE_SLICE);
+        g_assert_true(capped->done);
+        g_assert_cmpuint(capped->next, ==, 40);
+        g_assert_cmpuint(capped->stats.calls, ==, 40);
+        g_assert_cmpuint(g_hash_table_size(capped->stats.error_names), ==, 40);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_schedule/budget", test_df_schedule_budget);
+        g_test_add_func("/df_schedule/retire", test_df_schedule_retire);
+
+        return g_test_run();
+}
@@ -0,0 +1,47 @@
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "stress.h"
+#include "util.h"
+
+static void test_df_stress_step_rate(void)
+{
+        /* No limit stays no limit */
+        for (guint i = 0; i < DF_STRESS_STEPS; i++)
+                g_assert_cmpuint(df_stress_step_rate(0, i), ==, 0);
+
+        /* Ramped up linearly, reaching the peak in the last step */
+        g_assert_cmpuint(df_stress_step_rate(1000, 0), ==, 1000 / DF_STRESS_STEPS);
+        g_assert_cmpuint(df_stress_step_rate(1000, DF_STRESS_STEPS / 2 - 1), ==, 500);
+        g_assert_cmpuint(df_stress_step_rate(1000, DF_STRESS_STEPS - 1), ==, 1000);
+
+        /* Even a tiny rate offers something in each step */
+        g_assert_cmpuint(df_stress_step_rate(1, 0), ==, 1);
+}
+
+static void test_df_stress_find_saturation(void)
+{
+        df_stress_step_t steps[DF_STRESS_STEPS] = {};
+
+        g_assert_cmpint(df_stress_find_saturation(steps, DF_STRESS_STEPS), ==, -1);
+
+        /* Exceptions are not timeouts */
+        steps[2].exceptions = 10;
+        g_assert_cmpint(df_stress_find_saturation(steps, DF_STRESS_STEPS), ==, -1);
+
+        steps[7].timeouts = 1;
+        steps[9].timeouts = 100;
+        g_assert_cmpint(df_stress_find_saturation(steps, DF_STRESS_STEPS), ==, 7);
+        /* Only the steps which were run count */
+        g_assert_cmpint(df_stress_find_saturation(steps, 5), ==, -1);
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_stress/df_stress_step_rate", test_df_stress_step_rate);
+        g_test_add_func("/df_stress/df_stress_find_saturation", test_df_stress_find_saturation);
+
+        return g_test_run();
+}
@@ -0,0 +1,108 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "suppression.h"
+#include "util.h"
+
+static gchar *write_suppressions(const char *contents)
+{
+        g_autoptr(GError) error = NULL;
+        g_autoptr(gchar) path = NULL;
+        int fd;
+
+        fd = g_file_open_tmp("test-suppression-XXXXXX", &path, &error);
+        g_assert_no_error(error);
+        close(fd);
+
+        g_assert_true(g_file_set_contents(path, contents, -1, &error));
+        g_assert_no_error(error);
+
+        return g_steal_pointer(&path);
+}
+
+static void test_df_suppression_check(void)
+{
+        g_autoptr(df_suppression_index_t) index = NULL;
+        g_autoptr(gchar) path = NULL;
+        const char *description;
+
+        path = write_suppressions(
+                        "ignored before any section\n"
+                        "[org.foo.bar]\n"
+                        "hello potentially destructive\n"
+                        "\n"
+                        "/org::world\n"
+                        "/org:boo:world more specific, but later\n"
+                        "/org/all::\n"
+                        "[org.foo.baz]\n"
+                        ":org.freedesktop.Foo: the whole interface\n"
+                        "[org.foo.bar]\n"
+                        "::again merged into the first section\n");
+
+        index = df_suppression_index_new();
+        g_assert_nonnull(index);
+        g_assert_cmpint(df_suppression_load_file(index, path), ==, 0);
+        g_assert_cmpint(unlink(path), ==, 0);
+
+        g_assert_cmpuint(index->n_items, ==, 6);
+        g_assert_cmpuint(df_suppression_count(index, "org.foo.bar"), ==, 5);
+        g_assert_cmpuint(df_suppression_count(index, "org.foo.baz"), ==, 1);
+        g_assert_cmpuint(df_suppression_count(index, "org.foo"), ==, 0);
+
+        /* Method only */
+        g_assert_cmpint(df_suppression_check(index, "org.foo.bar", "/x", "a.b", "hello", &description), ==, 1);
+        g_assert_cmpstr(description, ==, "potentially destructive");
+        /* Only exact bus names match */
+        g_assert_cmpint(df_suppression_check(index, "org.foo.barx", "/x", "a.b", "hello", &description), ==, 0);
+        g_assert_cmpint(df_suppression_check(index, "org.foo.baz", "/x", "a.b", "hello", &description), ==, 0);
+
+        /* The first matching suppression wins */
+        description = "unset";
+        g_assert_cmpint(df_suppression_check(index, "org.foo.bar", "/org", "boo", "world", &description), ==, 1);
+        g_assert_null(description);
+
+        /* Whole objects and interfaces */
+        g_assert_cmpint(df_suppression_check(index, "org.foo.bar", "/org/all", "a.b", "anything", &description), ==, 1);
+        g_assert_cmpint(df_suppression_check(index, "org.foo.baz", "/", "org.freedesktop.Foo", "Bar", &description), ==, 1);
+        g_assert_cmpstr(description, ==, "the whole interface");
+        g_assert_cmpint(df_suppression_check(index, "org.foo.baz", "/", "org.freedesktop.Bar", "Bar", &description), ==, 0);
+
+        /* The merged section suppresses everything */
+        g_assert_cmpint(df_suppression_check(index, "org.foo.bar", "/x", "a.b", "x", &description), ==, 1);
+        g_assert_cmpstr(description, ==, "again merged into the first section");
+
+        /* No index, no suppressions */
+        g_assert_cmpint(df_suppression_check(NULL, "org.foo.bar", "/x", "a.b", "hello", &description), ==, 0);
+}
+
+static void test_df_suppression_invalid(void)
+{
+        static const char *invalid[] = {
+                "[org.foo.bar]\n:::Ping\n",
+                "[org.foo.bar]\n:::\n",
+                "[org.foo.bar\nPing\n",
+        };
+
+        for (size_t i = 0; i < G_N_ELEMENTS(invalid); i++) {
+                g_autoptr(df_suppression_index_t) index = NULL;
+                g_autoptr(gchar) path = NULL;
+
+                path = write_suppressions(invalid[i]);
+                index = df_suppression_index_new();
+                g_assert_nonnull(index);
+                g_assert_cmpint(df_suppression_load_file(index, path), <, 0);
+                g_assert_cmpint(unlink(path), ==, 0);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/df_suppression/df_suppression_check", test_df_suppression_check);
+        g_test_add_func("/df_suppression/df_suppression_invalid", test_df_suppression_invalid);
+
+        return g_test_run();
+}